@@ -0,0 +1,80 @@
+/* arena.h */
+/* Region allocation for temporaries that are all freed at once */
+/*
+ * An arena hands out memory from large blocks by moving an offset, and
+ * takes all of it back at once. Loaders and bakers keep their transient
+ * arrays in one, so a load makes a few large allocations instead of
+ * many small and growing ones, and leaves no holes in the heap.
+ *
+ * arenaMark() and arenaRelease() work like a stack: a release frees
+ * everything allocated after the mark, in O(1), and keeps the blocks
+ * for the next user. A function can therefore borrow an arena that its
+ * caller is also using, as long as it releases what it took before it
+ * returns. arenaScratch() is an arena of the calling thread's own, for
+ * exactly that, so parallel jobs never share one. Memory from an arena
+ * is aligned to ARENA_ALIGN bytes and is not zeroed.
+ *
+ * Released blocks stay with the arena for reuse. A one-off user of a
+ * long-lived arena, like a load on the main thread's scratch arena,
+ * calls arenaTrim() when it is done so they do not stay resident.
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#define ARENA_ALIGN 16
+#define ARENA_BLOCKSIZE (1024*1024) // Smallest block, unless arenaInit() is told otherwise
+
+typedef struct arenaBlock arenaBlock;
+
+struct arenaBlock {
+	arenaBlock *next;
+	long size;  // Bytes of memory after the header
+	long base;  // Position of the first byte, counting the blocks before
+};
+
+typedef struct {
+	arenaBlock *first;
+	arenaBlock *current; // Allocations come from here; the blocks after it are free
+	long used;           // Bytes taken from the current block
+	long last;           // Offset of the last allocation in it, or -1, for arenaGrow()
+	long blocksize;      // Smallest block to allocate
+	long reserved;       // Bytes allocated for all blocks
+	long peak;           // Highest position reached, the memory the arena needed
+	int nblocks;
+} arena;
+
+/* Set up an empty arena. blocksize <= 0 means ARENA_BLOCKSIZE. Nothing is allocated yet. */
+void arenaInit(arena *a, long blocksize);
+
+/* Free all blocks */
+void arenaDelete(arena *a);
+
+/* Allocate bytes. Returns NULL if out of memory. */
+void *arenaAlloc(arena *a, long bytes);
+
+/* Make an allocation bigger, in place if it was the last one, like realloc() */
+void *arenaGrow(arena *a, void *old, long oldbytes, long newbytes);
+
+/* The current position, to release back to */
+long arenaMark(const arena *a);
+
+/* Free everything allocated after the mark */
+void arenaRelease(arena *a, long mark);
+
+/* Free everything, but keep the blocks */
+void arenaReset(arena *a);
+
+/* Free the blocks that hold nothing, after the current one, or all if the arena is empty */
+void arenaTrim(arena *a);
+
+/* The calling thread's scratch arena, set up on first use */
+arena *arenaScratch(void);
+
+/* Free the calling thread's scratch arena, e.g. before the thread exits */
+void arenaScratchDelete(void);
+
+/* Print the peak use, the use now and the memory still reserved to stdout */
+void arenaPrint(const arena *a, const char *name);
+
+#endif
@@ -0,0 +1,66 @@
+/* blockReader.h */
+/* Read a file in fixed-size blocks on a thread of its own, decompressing it on the way */
+/*
+ * A blockReader lets a parser work on a file while the next part of it
+ * is still being read and decompressed. A reader thread fills a ring of
+ * BLOCKREADER_BLOCKS blocks of BLOCKREADER_BLOCKSIZE bytes, and the
+ * parser takes them in order with blockReaderNext(). The file is never
+ * held in memory as a whole, and a compressed file is never written
+ * out in decompressed form. Blocks end wherever they happen to, so a
+ * parser of lines has to carry an unfinished line over to the next one.
+ *
+ * The format is recognized by the first bytes of the file, not by its
+ * name: gzip (.gz) needs a build with zlib (HAVE_ZLIB), Zstandard
+ * (.zst) one with libzstd (HAVE_ZSTD). Anything else is read as it is.
+ */
+
+#ifndef BLOCKREADER_H
+#define BLOCKREADER_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+#define BLOCKREADER_BLOCKSIZE (256*1024)
+#define BLOCKREADER_BLOCKS 4
+
+/* File formats */
+#define BLOCKREADER_PLAIN 0
+#define BLOCKREADER_GZIP 1
+#define BLOCKREADER_ZSTD 2
+
+typedef struct {
+	FILE *file;
+	const char *filename;  // Not copied, for messages
+	int format;            // BLOCKREADER_PLAIN, BLOCKREADER_GZIP or BLOCKREADER_ZSTD
+	void *decoder;         // gzFile or ZSTD_DCtx, depending on the format
+	unsigned char *input;  // Compressed input not yet decoded (zstd)
+	long inputsize;
+	long inputpos;
+	int inputend;          // The whole file has been read
+	size_t lastresult;     // Last ZSTD_decompressStream() result, 0 at the end of a frame
+	char *blocks[BLOCKREADER_BLOCKS];
+	int sizes[BLOCKREADER_BLOCKS];
+	int head;              // Oldest filled block, the one the parser has
+	int count;             // Filled blocks, including the parser's
+	int taken;             // The parser has the block at head
+	int done;              // The reader thread has reached the end
+	int stop;              // The parser has given up, the reader thread should too
+	int error;             // The file could not be read or decompressed
+	long filebytes;        // Read from the file
+	long bytes;            // After decompression
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t filled; // Signaled when a block is filled, or at the end
+	pthread_cond_t emptied; // Signaled when a block is given back
+} blockReader;
+
+/* Open a file and start reading it. Returns 1 on success. */
+int blockReaderOpen(blockReader *reader, const char *filename);
+
+/* Give back the previous block and return the next one, or NULL at the end or on an error */
+const char *blockReaderNext(blockReader *reader, int *size);
+
+/* Stop reading and close the file. Returns 1 if the whole file was read without errors. */
+int blockReaderClose(blockReader *reader);
+
+#endif
@@ -0,0 +1,142 @@
+/* bundle.h */
+/* One packed file with all the meshes, textures and shaders, made offline by the cook tool */
+/*
+ * Loading an OBJ mesh means parsing text, and a TGA texture still needs
+ * its mipmaps made at load time. tools/cook.c does all of that once and
+ * writes the results into a bundle: a header, the resources as blobs
+ * aligned to BUNDLE_ALIGN bytes, and a table of contents at the end. At
+ * runtime the bundle is memory mapped, and a resource is served from the
+ * mapping without copying: a mesh goes straight to glBufferData(), a
+ * shader source is a C string in place. A blob may be LZ4 compressed, in
+ * which case it is decompressed once, on first use, into memory that the
+ * bundle owns. The formats are the in-memory structs below, written as
+ * they are, so a bundle is only valid on little-endian machines like the
+ * ones it was cooked on.
+ *
+ * Meshes are stored as packed soups (see soupCreatePacked()), textures
+ * with all their mipmap levels as RGB, RGBA or BC1 (DXT1) blocks. BC1
+ * is not core OpenGL, so textures cooked with --bc1 only load where the
+ * driver has GL_EXT_texture_compression_s3tc.
+ */
+
+#ifndef BUNDLE_H
+#define BUNDLE_H
+
+#include <stdio.h>
+
+#include "mappedFile.h"
+
+#define BUNDLE_MAGIC "TNMB"
+#define BUNDLE_VERSION 1
+#define BUNDLE_ALIGN 64       // Blobs start at multiples of this
+#define BUNDLE_NAMESIZE 48    // Longest resource name, including the terminating 0
+#define BUNDLE_MAXLEVELS 16   // Mipmap levels, enough for 32768 x 32768
+
+/* Resource types */
+#define BUNDLE_MESH 1
+#define BUNDLE_TEXTURE 2
+#define BUNDLE_SHADER 3
+
+/* How a blob is stored */
+#define BUNDLE_RAW 0
+#define BUNDLE_LZ4 1
+
+/* Texture formats */
+#define BUNDLE_RGB8 1
+#define BUNDLE_RGBA8 2
+#define BUNDLE_BC1 3          // 8 bytes per 4x4 block, no alpha
+
+typedef struct {
+	char magic[4];
+	int version;
+	int count;               // Number of entries in the table of contents
+	int reserved;
+	long long tocoffset;     // Where the table of contents starts
+} bundleHeader;
+
+/* One entry in the table of contents */
+typedef struct {
+	char name[BUNDLE_NAMESIZE]; // File name without the directory, e.g. "trex.obj"
+	int type;                // BUNDLE_MESH, BUNDLE_TEXTURE or BUNDLE_SHADER
+	int compression;         // BUNDLE_RAW or BUNDLE_LZ4
+	long long offset;        // Where the blob starts in the file
+	long long size;          // Bytes stored in the file
+	long long rawsize;       // Bytes after decompression
+} bundleEntry;
+
+/* A mesh blob starts with this, followed by the vertices and then the indices */
+typedef struct {
+	int nverts;
+	int ntris;
+	int vertexbytes;         // SOUP_PACKEDVERTEXBYTES
+	int indexbytes;          // 2 or 4
+	int vertexoffset;        // From the start of the blob
+	int indexoffset;
+	float bounds[6];         // xmin xmax ymin ymax zmin zmax
+} bundleMesh;
+
+/* A texture blob starts with this, followed by the levels, largest first */
+typedef struct {
+	int width;
+	int height;
+	int format;              // BUNDLE_RGB8, BUNDLE_RGBA8 or BUNDLE_BC1
+	int levels;
+	int offsets[BUNDLE_MAXLEVELS]; // From the start of the blob
+	int sizes[BUNDLE_MAXLEVELS];
+} bundleTexture;
+
+/* An open bundle */
+typedef struct {
+	mappedFile file;           // The whole file
+	const bundleEntry *entries;
+	int count;
+	void **unpacked;           // Decompressed copies of LZ4 blobs, per entry, made on demand
+} bundle;
+
+/* Something to write a bundle with */
+typedef struct {
+	FILE *file;
+	const char *filename;
+	bundleEntry *entries;
+	int count;
+	int capacity;
+	long long offset;          // Where the next blob goes
+	int compress;              // Try LZ4 on every blob, and keep it where it helps
+	long long rawbytes;        // Totals, for the report
+	long long storedbytes;
+} bundleWriter;
+
+/* Map a bundle file and check its table of contents. Returns 1 on success. */
+int bundleOpen(bundle *b, const char *filename);
+
+/* Unmap the file and free the decompressed blobs */
+void bundleClose(bundle *b);
+
+/* Look up a resource by name, or return NULL */
+const bundleEntry *bundleFind(const bundle *b, const char *name);
+
+/* The contents of a blob: in the mapping if stored raw, else decompressed. NULL on error. */
+const void *bundleData(bundle *b, const bundleEntry *entry);
+
+/* A shader source, as a 0-terminated string that belongs to the bundle. NULL if missing. */
+const char *bundleShaderSource(bundle *b, const char *name);
+
+/* Create a GL soup from a mesh in the bundle. Returns 1 on success. */
+int bundleCreateSoup(bundle *b, const char *name, triangleSoup *soup);
+
+/* Create a GL texture with all mipmap levels from the bundle. Returns 1 on success. */
+int bundleCreateTexture(bundle *b, const char *name, Texture *texture);
+
+/* Print the table of contents */
+void bundlePrintInfo(const bundle *b);
+
+/* Start writing a bundle. With compress set, every blob is tried with LZ4. */
+int bundleWriterOpen(bundleWriter *w, const char *filename, int compress);
+
+/* Add a blob to the bundle being written. Returns 1 on success. */
+int bundleWriterAdd(bundleWriter *w, const char *name, int type, const void *data, long long size);
+
+/* Write the table of contents and close the file. Returns 1 on success. */
+int bundleWriterClose(bundleWriter *w);
+
+#endif
@@ -0,0 +1,37 @@
+/* fileWatch.h */
+/* Notice when files on disk change, for reloading them while the program runs */
+/*
+ * A fileWatch remembers the modification time and size of a few files
+ * and reports when any of them differs from the last check. It uses
+ * stat(), so checking is cheap enough to do several times per second,
+ * but it is polled: call fileWatchChanged() at the rate that changes
+ * should be noticed. An editor may write a file in several steps, so
+ * a change is only reported once the file has looked the same for one
+ * whole check interval.
+ */
+
+#ifndef FILEWATCH_H
+#define FILEWATCH_H
+
+#include <time.h>
+
+#define FILEWATCH_MAXFILES 8
+
+typedef struct {
+	const char *paths[FILEWATCH_MAXFILES]; // Not copied, must stay valid
+	time_t mtimes[FILEWATCH_MAXFILES];
+	long sizes[FILEWATCH_MAXFILES];
+	int nfiles;
+	int unsettled;   // A change was seen but not yet reported
+} fileWatch;
+
+/* Start with no files */
+void fileWatchInit(fileWatch *watch);
+
+/* Watch one more file. Returns 0 if there is no room for it. */
+int fileWatchAdd(fileWatch *watch, const char *path);
+
+/* Returns 1 once after any watched file has changed and settled since the last call */
+int fileWatchChanged(fileWatch *watch);
+
+#endif
@@ -0,0 +1,61 @@
+/* framePacer.h */
+/* Cap the frame rate by sleeping, instead of rendering frames nobody sees */
+/*
+ * With glfwSwapInterval(0) the render loop runs flat out and keeps a
+ * core busy. A framePacer with a target rate makes the loop wait
+ * before each frame, starting the work as late as it can while still
+ * finishing by the frame's deadline: the frame cost is predicted from
+ * the recent frames, and the wait is a sleep followed by a short spin,
+ * because sleeps overshoot. The overshoot is measured, and the sleep
+ * ends that much early. framePacerPrint() compares the CPU time used
+ * with what the same frames would have used without a cap.
+ */
+
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <stdio.h>
+
+typedef struct {
+	double period;        // Seconds per frame, 0 for no cap
+	double deadline;      // When the current frame should be done
+	double workstart;     // When the current frame's work started
+	double workcpu;       // Thread CPU time at that point
+	double costmean;      // Predicted wall time of a frame's work (moving average)
+	double costdev;       // Its mean absolute deviation
+	double overshoot;     // How late sleeps wake up, on average
+	unsigned long frames; // Frames done
+	unsigned long missed; // Frames done after their deadline
+	double slept;         // Total seconds asleep
+	double spun;          // Total seconds spent spinning
+	double worktime;      // Total wall time of the frames' work
+	double workcputime;   // Total CPU time of the frames' work
+	double wallstart;     // Start of the measurement
+	double cpustart;
+} framePacer;
+
+/* Start pacing at targetfps frames per second, or just measure if it is 0 */
+void framePacerInit(framePacer *pacer, double targetfps);
+
+/* Wait until it is time to start the next frame. Call right before the frame's work. */
+void framePacerWait(framePacer *pacer);
+
+/* The frame's work is done (after the swap). Updates the prediction and the deadline. */
+void framePacerFrameDone(framePacer *pacer);
+
+/* Start the measurement over, e.g. after a warmup */
+void framePacerReset(framePacer *pacer);
+
+/* CPU use of the calling thread since the start, as a fraction of one core */
+double framePacerUtilization(const framePacer *pacer);
+
+/* CPU use while working, which is what an uncapped loop would use all the time */
+double framePacerUncappedUtilization(const framePacer *pacer);
+
+/* Print the pacing statistics to the console */
+void framePacerPrint(const framePacer *pacer);
+
+/* Print the pacing statistics as a JSON object */
+void framePacerPrintJSON(FILE *file, const framePacer *pacer);
+
+#endif
@@ -0,0 +1,39 @@
+/* framePipeline.h */
+/* Bound the number of frames the GPU may lag behind the CPU, with fences */
+/*
+ * Without a bound, the driver queues as many frames as it likes, and
+ * the CPU runs ahead until some call blocks at an unpredictable point.
+ * framePipelineEndFrame() puts a fence after each frame's commands, and
+ * framePipelineBeginFrame() waits for the fence from "inflight" frames
+ * ago before the CPU records another frame. With inflight 1, the CPU
+ * waits for each frame to finish before starting the next one. Larger
+ * values let the CPU work on the next frames while the GPU is busy,
+ * at the cost of latency.
+ */
+
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#define FRAMEPIPELINE_MAXINFLIGHT 4 // Most frames that may be in flight
+
+typedef struct {
+	int inflight;                               // Frames the GPU may lag behind, 1 to FRAMEPIPELINE_MAXINFLIGHT
+	GLsync fences[FRAMEPIPELINE_MAXINFLIGHT];   // Ring of fences, one per frame in flight
+	unsigned long frame;                        // Frames begun so far
+	double waited;                              // Seconds spent waiting for fences
+	unsigned long stalls;                       // Frames that had to wait
+} framePipeline;
+
+/* Set up for at most inflight frames in flight. Requires a current GL context. */
+void framePipelineInit(framePipeline *pipeline, int inflight);
+
+/* Delete the fences that are left */
+void framePipelineDelete(framePipeline *pipeline);
+
+/* Wait until there is room for another frame */
+void framePipelineBeginFrame(framePipeline *pipeline);
+
+/* Put a fence after the commands of the frame. Call after glfwSwapBuffers() or the last draw. */
+void framePipelineEndFrame(framePipeline *pipeline);
+
+#endif
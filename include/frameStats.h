@@ -0,0 +1,84 @@
+/* frameStats.h */
+/* Frame time statistics: a ring of raw per-frame samples for export, */
+/* and log-linear ("HDR") histograms for percentiles over the whole run */
+
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <stdio.h>
+
+#define FRAMESTATS_RINGSIZE 16384 // Raw samples kept for export (the most recent ones)
+#define HISTOGRAM_SUBBUCKETS 16   // Linear buckets per power of two (about 6% resolution)
+#define HISTOGRAM_MAJORBUCKETS 32 // Powers of two, covering 1 microsecond to hours
+#define FRAMESTATS_HITCHFACTOR 2.0 // A frame longer than this times the median is a hitch
+
+/* A histogram of durations with constant relative precision */
+typedef struct {
+	unsigned int counts[HISTOGRAM_MAJORBUCKETS*HISTOGRAM_SUBBUCKETS];
+	unsigned long total; // Number of recorded values
+	double sum;          // Sum of all values, in milliseconds
+	double min;          // Exact smallest value, in milliseconds
+	double max;          // Exact largest value, in milliseconds
+} histogram;
+
+/* One frame worth of measurements, all in milliseconds */
+typedef struct {
+	double wall; // Wall clock time since the previous frame
+	double cpu;  // CPU time used by the render thread since the previous frame
+	double gpu;  // GPU time for the frame, filled in later by a gpuTimer (-1 if unknown)
+} frameSample;
+
+/* Statistics for a sequence of frames */
+typedef struct {
+	frameSample *ring;     // The last FRAMESTATS_RINGSIZE samples
+	unsigned long frames;  // Total number of recorded frames
+	unsigned long hitches; // Frames longer than FRAMESTATS_HITCHFACTOR * median
+	histogram wall;        // Distribution of wall clock frame times
+	histogram cpu;         // Distribution of CPU frame times
+	histogram gpu;         // Distribution of GPU frame times (empty without a gpuTimer)
+	double medianWall;     // Cached median, refreshed periodically for hitch detection
+	double lastWall;       // Timestamps of the previous tick, in seconds
+	double lastCPU;
+	int started;           // Nonzero once the first tick has set the timestamps
+} frameStats;
+
+/* Clear a histogram */
+void histogramInit(histogram *h);
+
+/* Add a duration (in milliseconds) to a histogram */
+void histogramRecord(histogram *h, double ms);
+
+/* Estimate the value below which a fraction p (0 to 1) of all values fall */
+double histogramPercentile(const histogram *h, double p);
+
+/* Mean of all recorded values, in milliseconds */
+double histogramMean(const histogram *h);
+
+/* Print mean, p50/p95/p99 and max of a histogram as a JSON object */
+void histogramPrintJSON(FILE *file, const histogram *h);
+
+/* Initialize a frameStats object and allocate its sample ring */
+void frameStatsInit(frameStats *stats);
+
+/* Free the memory held by a frameStats object */
+void frameStatsDelete(frameStats *stats);
+
+/* Record the end of a frame. Times are in seconds, from any consistent clocks. */
+void frameStatsTick(frameStats *stats, double wallTime, double cpuTime);
+
+/* Attach a GPU time (in milliseconds) to a frame that was recorded earlier */
+void frameStatsSetGPU(frameStats *stats, unsigned long frame, double ms);
+
+/* Print a human readable summary to the console */
+void frameStatsPrint(const frameStats *stats);
+
+/* Print the summary (and optionally the raw samples) as a JSON object */
+void frameStatsPrintJSON(FILE *file, const frameStats *stats, int withSamples);
+
+/* Write the raw sample series to a CSV file */
+int frameStatsWriteCSV(const frameStats *stats, const char *filename);
+
+/* Write the summary and the raw sample series to a JSON file */
+int frameStatsWriteJSON(const frameStats *stats, const char *filename);
+
+#endif
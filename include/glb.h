@@ -0,0 +1,29 @@
+/* glb.h */
+/* Meshes from binary glTF 2.0 (.glb) files, uploaded straight from the mapped file */
+/*
+ * A .glb file is a JSON chunk that describes the data, followed by a
+ * binary chunk with the vertex and index arrays in the form the GPU
+ * takes them. The file is mapped, the JSON is read for the layout of
+ * the accessors, and the buffer views are given to glBufferData() as
+ * they are, with glVertexAttribPointer() set up for their layout, so
+ * nothing is parsed or copied vertex by vertex. Any component type and
+ * stride that glTF allows works, interleaved or not.
+ *
+ * Only the first primitive of the first mesh is loaded, and node
+ * transforms are not applied. POSITION goes to attribute 0, NORMAL to
+ * 1 and TEXCOORD_0 to 2, like in the other soups. POSITION and NORMAL
+ * are required, as the shaders light with the normal. Without
+ * TEXCOORD_0, attribute 2 is left disabled, so the shader sees
+ * (0, 0, 0, 1). glTF puts the texture coordinate origin at the top
+ * left, not at the bottom left like OBJ, so a texture comes out upside
+ * down unless the shader flips t. Sparse accessors, and modes other than triangles, are not
+ * supported. Nothing is kept in main memory, like with SOUP_RELEASE.
+ */
+
+#ifndef GLB_H
+#define GLB_H
+
+/* Load the first mesh in a .glb file and send it to the GPU. Returns 1 on success. */
+int glbReadSoup(triangleSoup *soup, const char *filename);
+
+#endif
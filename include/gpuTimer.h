@@ -0,0 +1,66 @@
+/* gpuTimer.h */
+/* GPU time per render pass, from timestamp queries read back a few frames late */
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <stdio.h>
+#include "frameStats.h"
+
+#define GPUTIMER_MAXZONES 32 // Most timed passes in one frame
+#define GPUTIMER_LATENCY 4   // Frames in flight before a query result is read back
+
+/* Accumulated timings for all passes with the same name */
+typedef struct {
+	const char *name; // Pass name (must be a string literal or otherwise persistent)
+	double lastms;    // Time in the most recently read back frame
+	histogram hist;   // Distribution over all frames
+} gpuZone;
+
+/* One frame worth of timestamp queries */
+typedef struct {
+	GLuint queries[GPUTIMER_MAXZONES][2]; // Begin and end timestamp for each pass
+	const char *names[GPUTIMER_MAXZONES];
+	int nzones;            // Passes issued in this frame
+	int pending;           // Nonzero while results are still to be read back
+	unsigned long frame;   // Frame number (frameStats index) these queries belong to
+} gpuTimerFrame;
+
+/* A ring of query frames, and per-pass statistics */
+typedef struct {
+	gpuTimerFrame frames[GPUTIMER_LATENCY];
+	int current;           // Index into frames[] for the frame being recorded
+	int recording;         // Zero if the current frame is not being timed
+	int open;              // Nonzero between gpuTimerBegin() and gpuTimerEnd()
+	gpuZone zones[GPUTIMER_MAXZONES];
+	int nzones;            // Distinct pass names seen so far
+	unsigned long dropped; // Frames skipped because the GPU was too far behind
+	frameStats *stats;     // Receives the total GPU time per frame (may be NULL)
+	long long clockOffset; // CPU clock minus GPU clock, to put GPU zones in the trace
+} gpuTimer;
+
+/* Create the query objects. Requires a current GL context. */
+void gpuTimerInit(gpuTimer *timer, frameStats *stats);
+
+/* Delete the query objects */
+void gpuTimerDelete(gpuTimer *timer);
+
+/* Start a new frame: collect finished results, then reuse the oldest slot */
+void gpuTimerBeginFrame(gpuTimer *timer, unsigned long frame);
+
+/* Wait for the GPU and collect all pending results (stalls, for use at exit) */
+void gpuTimerFlush(gpuTimer *timer);
+
+/* Start timing a pass. Passes may not nest. */
+void gpuTimerBegin(gpuTimer *timer, const char *name);
+
+/* Stop timing the current pass */
+void gpuTimerEnd(gpuTimer *timer);
+
+/* Print the per-pass statistics to the console */
+void gpuTimerPrint(const gpuTimer *timer);
+
+/* Print the per-pass statistics as a JSON object */
+void gpuTimerPrintJSON(FILE *file, const gpuTimer *timer);
+
+#endif
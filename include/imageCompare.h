@@ -0,0 +1,15 @@
+/* imageCompare.h */
+/* Error measures between two rendered images of the same size */
+
+#ifndef IMAGECOMPARE_H
+#define IMAGECOMPARE_H
+
+#define IMAGE_PSNR_MAX 99.0 // Reported for identical images, instead of infinity
+
+/* Peak signal to noise ratio in dB over the RGB channels of two RGBA images */
+double imagePSNR(const unsigned char *a, const unsigned char *b, int width, int height);
+
+/* Mean structural similarity (SSIM) of the luminance of two RGBA images, 1 if identical */
+double imageSSIM(const unsigned char *a, const unsigned char *b, int width, int height);
+
+#endif
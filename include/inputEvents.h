@@ -0,0 +1,62 @@
+/* inputEvents.h */
+/* Keyboard, mouse and window events from GLFW callbacks, in a lock-free queue */
+/*
+ * Instead of asking GLFW for the state of every key and button in
+ * every frame, the callbacks that GLFW calls from glfwPollEvents()
+ * push one inputEvent per change into a queue, and the render loop
+ * pops them once per frame and updates its own state from them. A
+ * frame without input finds the queue empty and does nothing else.
+ * The queue is a ring with one producer (the thread that polls GLFW
+ * events, which must be the main thread) and one consumer, so the
+ * consumer may be another thread, e.g. a render thread that owns the
+ * GL context. If the consumer falls behind by more than the size of
+ * the ring, new events are dropped and counted.
+ */
+
+#ifndef INPUTEVENTS_H
+#define INPUTEVENTS_H
+
+#include <stdatomic.h>
+
+#define INPUTEVENTS_QUEUESIZE 1024 // Must be a power of two
+
+enum {
+	INPUT_KEY,      // key, action (GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT), mods
+	INPUT_BUTTON,   // Mouse button: key is the button, action, mods
+	INPUT_CURSOR,   // Cursor moved to (x, y)
+	INPUT_RESIZE,   // Window resized to (x, y) = (width, height)
+	INPUT_REFRESH   // The window contents were damaged and must be drawn again
+};
+
+typedef struct {
+	int type;
+	int key;
+	int action;
+	int mods;
+	double x;
+	double y;
+	double time;   // timerSeconds() when GLFW delivered the event
+} inputEvent;
+
+typedef struct {
+	inputEvent events[INPUTEVENTS_QUEUESIZE];
+	atomic_uint head;        // Next event to pop, written only by the consumer
+	atomic_uint tail;        // Next free slot, written only by the producer
+	atomic_ulong dropped;    // Events lost because the queue was full
+	GLFWwindow *window;
+} inputEvents;
+
+/*
+ * Install the callbacks on a window, and queue its current size and
+ * cursor position so the consumer starts out with a known state.
+ * Uses the window's user pointer.
+ */
+void inputEventsInit(inputEvents *input, GLFWwindow *window);
+
+/* Remove the callbacks */
+void inputEventsDelete(inputEvents *input);
+
+/* Take the oldest event from the queue. Returns 0 if it is empty. */
+int inputEventsPop(inputEvents *input, inputEvent *event);
+
+#endif
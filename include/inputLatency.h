@@ -0,0 +1,61 @@
+/* inputLatency.h */
+/* Timestamps for mouse and key input, and the time from each event to the swap that shows it */
+/*
+ * GLFW calls back for every mouse and key event while glfwPollEvents()
+ * runs, and each event is stamped with timerSeconds() there. Cursor
+ * motion only counts while the left button is held and the rotator
+ * turns the view, since hovering never reaches the screen. Key repeats
+ * do not count either, the press has already started the motion.
+ * When the render loop reads the input (inputLatencyLatch()), the
+ * oldest event not yet read is the one that has waited the longest,
+ * and when the frame that used it is swapped (inputLatencySwapped()), the time since that event
+ * is recorded. The time from the latch to the swap is recorded too, to
+ * show how much of the latency is the frame's own work after the input
+ * was read. This ends at the swap call, not at the display: the time
+ * the compositor and the screen add is not visible to the application.
+ * Events that happen between two polls are stamped at the second poll,
+ * so the true latency can be up to one poll interval longer.
+ */
+
+#ifndef INPUTLATENCY_H
+#define INPUTLATENCY_H
+
+#include <stdio.h>
+
+#include "frameStats.h"
+
+typedef struct {
+	double pending;        // Time of the oldest event not yet latched, 0 if none
+	double latched;        // Time of the oldest event read by the current frame, 0 if none
+	double latchtime;      // When the current frame read the input
+	unsigned long events;  // Input events seen
+	unsigned long frames;  // Swapped frames that showed new input
+	histogram eventToSwap; // Oldest event in a frame until its swap, in milliseconds
+	histogram latchToSwap; // Input read until the swap, in milliseconds
+	GLFWcursorposfun previouspos;      // Callbacks installed before ours, still called
+	GLFWmousebuttonfun previousbutton;
+	GLFWkeyfun previouskey;
+} inputLatency;
+
+/* Install the mouse and key callbacks on a window. Only one inputLatency can be active at a time. */
+void inputLatencyInit(inputLatency *latency, GLFWwindow *window);
+
+/* Remove the callbacks again */
+void inputLatencyDelete(inputLatency *latency, GLFWwindow *window);
+
+/* The frame reads the input now. Call right where the input is sampled. */
+void inputLatencyLatch(inputLatency *latency);
+
+/* Forget the events not yet latched, when they will not lead to a new frame */
+void inputLatencyDiscard(inputLatency *latency);
+
+/* The frame that read the input has been swapped. Call right after glfwSwapBuffers(). */
+void inputLatencySwapped(inputLatency *latency);
+
+/* Print the latency percentiles to the console */
+void inputLatencyPrint(const inputLatency *latency);
+
+/* Print the latency distributions as a JSON object */
+void inputLatencyPrintJSON(FILE *file, const inputLatency *latency);
+
+#endif
@@ -0,0 +1,128 @@
+/* jobSystem.h */
+/* A work stealing job scheduler shared by everything that runs in parallel */
+/*
+ * One jobSystem owns the worker threads for the whole program. The
+ * thread that calls jobSystemInit() is worker 0 and works too, whenever
+ * it waits for a job. Every worker has its own queue: it runs the job
+ * it pushed last first, and a worker with an empty queue steals the
+ * oldest job from another one.
+ *
+ * A job is a function and a pointer, in a job struct that belongs to
+ * the caller and must stay valid until the job is done. A job can wait
+ * for other jobs (jobAddDependency()), and is only queued when all of
+ * them are done, so a job also works as the continuation of the ones
+ * it depends on. Jobs with JOB_MAIN_THREAD, typically OpenGL calls,
+ * only ever run on worker 0, from jobWait() or jobRunMainThread().
+ * Jobs may submit and wait for other jobs. A job that needs temporary
+ * memory takes it from arenaScratch(), which is its worker's own, and
+ * releases it to a mark before it returns; the workers free their
+ * scratch arenas when they exit.
+ */
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define JOB_MAIN_THREAD 1        // Flag: run only on worker 0, the main thread
+#define JOB_MAXCONTINUATIONS 8   // Most jobs that can depend on one job
+
+/* A job: do the work described by data, on worker number thread */
+typedef void (*jobFunction)(void *data, int thread);
+
+/* Do the items begin to end-1 of the work described by data, on worker number thread */
+typedef void (*jobRangeFunction)(void *data, int begin, int end, int thread);
+
+typedef struct job job;
+
+struct job {
+	jobFunction function;
+	void *data;
+	int flags;
+	atomic_int unfinished;     // Dependencies not done, plus one until submitted
+	atomic_int done;
+	job *continuations[JOB_MAXCONTINUATIONS]; // Jobs that depend on this one
+	int ncontinuations;
+};
+
+/* Jobs waiting to run, oldest at head. Pushed and popped at the tail by the owner, stolen at the head. */
+typedef struct {
+	pthread_mutex_t lock;
+	job **jobs;       // Ring buffer
+	int capacity;
+	int head;
+	int count;
+} jobQueue;
+
+/* Utilization of one worker, since the start or the last jobSystemResetCounters() */
+typedef struct {
+	unsigned long jobs;     // Jobs run
+	unsigned long steals;   // Of which were taken from other workers
+	double busy;            // Seconds spent running jobs
+} jobCounters;
+
+typedef struct jobSystem jobSystem;
+
+/* What a worker thread needs to know about itself */
+typedef struct {
+	jobSystem *system;
+	int index;               // 0 for the main thread
+	atomic_ulong jobs;       // For jobCounters
+	atomic_ulong steals;
+	atomic_ullong busy;      // In nanoseconds
+} jobWorker;
+
+struct jobSystem {
+	int nthreads;             // Including the main thread
+	pthread_t *threads;
+	jobWorker *workers;
+	jobQueue *queues;         // One per worker
+	jobQueue mainqueue;       // JOB_MAIN_THREAD jobs that are ready
+	atomic_int queued;        // Ready jobs in the worker queues
+	pthread_mutex_t lock;     // Protects the fields below, and goes with wake
+	pthread_cond_t wake;      // Broadcast when a job is queued or done
+	int sleepers;             // Threads waiting for wake
+	int quit;                 // Nonzero when the workers should exit
+};
+
+/* Start nthreads-1 workers. nthreads <= 0 means one per processor. Returns 1 on success. */
+int jobSystemInit(jobSystem *system, int nthreads);
+
+/* Stop and join the workers. All submitted jobs must be done. */
+void jobSystemDelete(jobSystem *system);
+
+/* Number of processors, at least 1 */
+int jobSystemProcessors(void);
+
+/* Set up a job. It does not run until it is submitted. */
+void jobInit(job *j, jobFunction function, void *data, int flags);
+
+/* Make later wait for earlier. Call before submitting earlier. Returns 1 on success. */
+int jobAddDependency(job *later, job *earlier);
+
+/* Queue the job, or let it be queued when its dependencies are done */
+void jobSubmit(jobSystem *system, job *j);
+
+/* Nonzero if the job has run */
+int jobDone(job *j);
+
+/* Wait for a submitted job, running other jobs meanwhile */
+void jobWait(jobSystem *system, job *j);
+
+/* Run function over begin to end-1 in pieces of at most grain items, and wait for all of them */
+void jobParallelFor(jobSystem *system, int begin, int end, int grain, jobRangeFunction function, void *data);
+
+/* Run the JOB_MAIN_THREAD jobs that are ready. Call from the main thread, e.g. once per frame. Returns the number run. */
+int jobRunMainThread(jobSystem *system);
+
+/* Read the counters of one worker */
+void jobSystemCounters(jobSystem *system, int thread, jobCounters *counters);
+
+/* Zero all counters */
+void jobSystemResetCounters(jobSystem *system);
+
+/* Print the counters of all workers to stdout */
+void jobSystemPrintCounters(jobSystem *system);
+
+#endif
@@ -0,0 +1,55 @@
+/* json.h */
+/* A small JSON reader that builds a tree of values */
+/*
+ * Enough for the files this framework reads back in (benchmark
+ * results, scene descriptions), not a general purpose library:
+ * the whole document is parsed into a tree of malloc()ed nodes,
+ * which is then queried by key or index and freed in one call.
+ */
+
+#ifndef JSON_H
+#define JSON_H
+
+#define JSON_NULL 0
+#define JSON_FALSE 1
+#define JSON_TRUE 2
+#define JSON_NUMBER 3
+#define JSON_STRING 4
+#define JSON_ARRAY 5
+#define JSON_OBJECT 6
+
+#define JSON_MAXDEPTH 256 // Deepest nesting accepted, to bound the recursion
+
+typedef struct jsonValue jsonValue;
+struct jsonValue {
+	int type;          // JSON_NULL, JSON_FALSE, ...
+	double number;     // Value of a JSON_NUMBER (also 0 or 1 for booleans)
+	char *string;      // Value of a JSON_STRING, UTF-8 and zero terminated
+	char *key;         // Member name if this value is in an object, else NULL
+	jsonValue *child;  // First element of an array or member of an object
+	jsonValue *next;   // Next element or member in the parent
+	int count;         // Number of elements or members
+};
+
+/* Parse a JSON text of the given length. Returns NULL and a message in error on failure. */
+jsonValue *jsonParse(const char *text, long length, char *error, int errorsize);
+
+/* Read and parse a JSON file. Errors are printed. Returns NULL on failure. */
+jsonValue *jsonReadFile(const char *filename);
+
+/* Free a value and everything below it */
+void jsonFree(jsonValue *value);
+
+/* Member of an object by name, or NULL */
+jsonValue *jsonGet(const jsonValue *object, const char *key);
+
+/* Element of an array by index, or NULL */
+jsonValue *jsonIndex(const jsonValue *array, int index);
+
+/* The number in a value, or fallback if it is missing or not a number */
+double jsonNumber(const jsonValue *value, double fallback);
+
+/* The string in a value, or fallback if it is missing or not a string */
+const char *jsonString(const jsonValue *value, const char *fallback);
+
+#endif
@@ -0,0 +1,40 @@
+/* lateLatch.h */
+/* A small uniform buffer for the view transform, written right before the draw */
+/*
+ * The camera is the one thing in a frame that the user watches respond
+ * to their hand, so it should come from input read as late as possible.
+ * All other state for the frame is set up first, and then the input is
+ * sampled and the modelview matrix written to the next slot of a ring
+ * in a uniform buffer, which is bound for the draw that follows. The
+ * slots are written unsynchronized, so the ring must have more slots
+ * than there are frames in flight (see framePipeline.h): the GPU is
+ * then done with a slot before it comes around again.
+ * Shaders read it when compiled with LATE_LATCH defined.
+ */
+
+#ifndef LATELATCH_H
+#define LATELATCH_H
+
+#define LATELATCH_BINDING 0   // Uniform buffer binding point for the "LateLatch" block
+#define LATELATCH_MAXSLOTS 8
+
+typedef struct {
+	GLuint buffer;
+	int slots;             // Size of the ring
+	int slot;              // Slot written last
+	GLintptr stride;       // Bytes from one slot to the next, as aligned as GL requires
+} lateLatch;
+
+/* Create the buffer with a ring of slots. Requires a current GL context. Returns 1 on success. */
+int lateLatchInit(lateLatch *latch, int slots);
+
+/* Delete the buffer */
+void lateLatchDelete(lateLatch *latch);
+
+/* Connect the "LateLatch" block of a program to the buffer. Returns 0 if the program has no such block. */
+int lateLatchBind(const lateLatch *latch, GLuint program);
+
+/* Write MV to the next slot and bind that slot for the next draw */
+void lateLatchWrite(lateLatch *latch, const GLfloat MV[16]);
+
+#endif
@@ -0,0 +1,27 @@
+/* lz4Block.h */
+/* Compression and decompression in the LZ4 block format */
+/*
+ * LZ4 trades compression ratio for speed: decompression runs at
+ * several GB/s, so compressed data can be cheaper to load than the
+ * raw bytes even from a fast disk. This is a small implementation of
+ * the block format only (no frame headers or checksums), compatible
+ * with LZ4_compress_default() and LZ4_decompress_safe() from the
+ * reference library. The compressor is a simple greedy one with a
+ * hash table of 4-byte sequences, which is fast but compresses a bit
+ * less than the reference. The decompressor checks every length and
+ * offset, so corrupt input cannot make it read or write out of bounds.
+ */
+
+#ifndef LZ4BLOCK_H
+#define LZ4BLOCK_H
+
+/* Largest compressed size for srcsize bytes of input */
+int lz4CompressBound(int srcsize);
+
+/* Compress src into dst. Returns the compressed size, or 0 if it does not fit in dstcapacity. */
+int lz4Compress(const unsigned char *src, int srcsize, unsigned char *dst, int dstcapacity);
+
+/* Decompress src into exactly dstsize bytes at dst. Returns dstsize, or -1 if src is corrupt. */
+int lz4Decompress(const unsigned char *src, int srcsize, unsigned char *dst, int dstsize);
+
+#endif
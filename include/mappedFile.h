@@ -0,0 +1,26 @@
+/* mappedFile.h */
+/* A whole file in memory, mapped where the system can, read where it cannot */
+/*
+ * Binary formats that are used as they are on disk (asset bundles,
+ * binary glTF) are mapped rather than read: nothing is copied up
+ * front, and the pages come in as they are touched. Where there is no
+ * mmap(), the file is read into a malloc()ed copy instead, so the
+ * caller sees the same read-only block of memory either way.
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+typedef struct {
+	const unsigned char *data; // The whole file, read-only
+	long long size;
+	int mapped;                // data is a mapping, not a malloc'ed copy
+} mappedFile;
+
+/* Map a file. Returns 1 on success, 0 if it cannot be opened or is empty. */
+int mappedFileOpen(mappedFile *file, const char *filename);
+
+/* Unmap or free the file */
+void mappedFileClose(mappedFile *file);
+
+#endif
@@ -0,0 +1,31 @@
+/* meteor.h */
+/* The meteor look of the shaders, evaluated on the CPU */
+
+#ifndef METEOR_H
+#define METEOR_H
+
+#include "triangleSoup.h"
+#include "jobSystem.h"
+
+#define METEOR_BAKEDFLOATS 4 // Floats per vertex from meteorBakeDisplacement(): the offset and its gradient
+
+/* Offset along the normal that the vertex shader gives a point on the unit sphere, and its gradient. gradient may be NULL. */
+float meteorDisplacement(float x, float y, float z, int octaves, float gradient[3]);
+
+/* The unit normal that the vertex shader lights a displaced vertex with, from its normal and the gradient */
+void meteorBendNormal(const float normal[3], const float gradient[3], float bent[3]);
+
+/*
+ * The offset and gradient for every vertex of a soup, in a new array of
+ * METEOR_BAKEDFLOATS * soup->nverts floats, or NULL. jobs may be NULL.
+ */
+GLfloat *meteorBakeDisplacement(const triangleSoup *soup, int octaves, jobSystem *jobs);
+
+/*
+ * Color that the fragment shader gives a point, from its rest position
+ * pos, its interpolated (not normalized) view space normal and the time.
+ * f1only matches CELLULAR_F1_ONLY. The result is RGB, not clamped.
+ */
+void meteorShade(const float pos[3], const float normal[3], float time, int f1only, float rgb[3]);
+
+#endif
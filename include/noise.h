@@ -0,0 +1,32 @@
+/* noise.h */
+/* CPU versions of the GLSL noise functions used by the shaders */
+/*
+ * These follow the shader code (Stefan Gustavson's and Ashima Arts'
+ * webgl-noise) operation by operation in single precision, so that
+ * values computed here match what the shaders compute to within
+ * rounding. That makes it possible to move noise evaluation between
+ * the GPU and the CPU, e.g. to bake it into vertex data.
+ */
+
+#ifndef NOISE_H
+#define NOISE_H
+
+/* 3D simplex noise, snoise(vec3) in the shaders. Range about -1 to 1. */
+float noiseSimplex3(float x, float y, float z);
+
+/* 3D simplex noise and its gradient, snoise(vec3, out vec3) in the vertex shader. gradient may be NULL. */
+float noiseSimplex3Grad(float x, float y, float z, float gradient[3]);
+
+/* 4D classic Perlin noise, cnoise(vec4) in the shaders */
+float noiseClassic4(float x, float y, float z, float w);
+
+/* 4D classic Perlin noise and its gradient in x, y and z, cnoise(vec4, out vec3). gradient may be NULL. */
+float noiseClassic4Grad(float x, float y, float z, float w, float gradient[3]);
+
+/* 4D simplex noise, snoise(vec4) in the fragment shader */
+float noiseSimplex4(float x, float y, float z, float w);
+
+/* 3D cellular noise, cellular(vec3): distances F1 and F2 to the nearest feature points */
+void noiseCellular3(float x, float y, float z, float F[2]);
+
+#endif
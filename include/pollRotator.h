@@ -1,7 +1,16 @@
+#include "inputEvents.h"
+
+// Bits in rotatorKey.keys for the arrow keys held down
+#define ROTATOR_RIGHT 1
+#define ROTATOR_LEFT 2
+#define ROTATOR_UP 4
+#define ROTATOR_DOWN 8
+
 typedef struct {
 	float phi;
 	float theta;
 	double lastTime;
+	int keys; // Arrow keys held down, for the event-driven functions
 } rotatorKey;
 
 typedef struct {
@@ -11,6 +20,8 @@ typedef struct {
 	int lastY;
 	int lastLeft;
 	int lastRight;
+	int windowWidth; // For the event-driven functions
+	int windowHeight;
 } rotatorMouse;
 
 void initRotatorKey(rotatorKey *state);
@@ -21,3 +32,12 @@ void initRotatorMouse(rotatorMouse *state);
 
 void pollRotatorMouse(GLFWwindow* window, rotatorMouse *state);
 
+// Event-driven alternatives to the poll functions: feed every event from an
+// inputEvents queue to the Event functions, and call updateRotatorKey() once
+// per frame. It does nothing while no arrow key is held down.
+void rotatorKeyEvent(rotatorKey *state, const inputEvent *event);
+
+void updateRotatorKey(rotatorKey *state);
+
+void rotatorMouseEvent(rotatorMouse *state, const inputEvent *event);
+
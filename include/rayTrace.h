@@ -0,0 +1,61 @@
+/* rayTrace.h */
+/* A CPU ray tracer for reference images of a displaced triangleSoup */
+/*
+ * Slow compared to rasterizing, but it takes no shortcuts: the mesh is
+ * displaced and traced exactly as given, every sample is shaded with
+ * the full fragment shader logic from meteor.c, and pixels can be
+ * supersampled. The images are meant as the ground truth that faster
+ * paths (fewer octaves, baked noise, coarser meshes, the GPU itself)
+ * are compared against. Rays are traced in packets of four through a
+ * bounding volume hierarchy, with SSE2 where available, and the image
+ * is split into tiles that are rendered in parallel as jobs.
+ */
+
+#ifndef RAYTRACE_H
+#define RAYTRACE_H
+
+#include "triangleSoup.h"
+#include "jobSystem.h"
+#include "softRaster.h" // For softShading
+
+#define RAYTRACE_TILE 16    // Side of the square image tiles, in pixels
+#define RAYTRACE_LEAFSIZE 4 // Most triangles in a leaf of the hierarchy
+
+/* A node in the bounding volume hierarchy */
+typedef struct {
+	float bmin[3], bmax[3]; // Bounding box
+	int first;              // First triangle (leaf) or first child (inner node)
+	int count;              // Number of triangles, 0 for an inner node
+} rayNode;
+
+/* A triangle in view space, with what the shading needs at its corners */
+typedef struct {
+	float v0[3], e1[3], e2[3]; // Corner and the two edges from it
+	int v[3];                  // Vertex indices, for the varyings
+} rayTriangle;
+
+typedef struct {
+	rayNode *nodes;
+	int nnodes;
+	rayTriangle *triangles;
+	int ntriangles;
+	float *pos;      // Rest position per vertex ("pos" in the shaders)
+	float *normal;   // View space normal per vertex ("interpolatedNormal")
+	softShading shading;
+} rayScene;
+
+/* Displace the soup, move it to view space with MV and build the hierarchy. Returns 1 on success. */
+int rayTraceBuild(rayScene *scene, const triangleSoup *soup, const GLfloat MV[16], const softShading *shading);
+
+/* Free a scene */
+void rayTraceDelete(rayScene *scene);
+
+/*
+ * Render RGBA pixels, bottom row first, seen through the projection P
+ * (a perspective matrix like the ones from gluPerspective or glFrustum),
+ * with samples x samples rays per pixel. background is RGBA.
+ */
+void rayTraceRender(const rayScene *scene, jobSystem *jobs, unsigned char *pixels,
+	int width, int height, const GLfloat P[16], int samples, const float background[4]);
+
+#endif
@@ -0,0 +1,30 @@
+/* renderTarget.h */
+/* An offscreen framebuffer to render into, for headless runs and readback */
+
+#ifndef RENDERTARGET_H
+#define RENDERTARGET_H
+
+typedef struct {
+	GLuint framebuffer;   // Framebuffer object ID to bind to GL_FRAMEBUFFER
+	GLuint colortexture;  // RGBA8 color attachment
+	GLuint depthbuffer;   // 24 bit depth renderbuffer
+	int width, height;    // Size in pixels
+	unsigned char *pixels; // RGBA pixels from the last renderTargetRead(), or NULL
+} renderTarget;
+
+/* Create a framebuffer of the given size. Returns 1 on success, 0 on failure. */
+int renderTargetInit(renderTarget *target, int width, int height);
+
+/* Free the framebuffer and its attachments */
+void renderTargetDelete(renderTarget *target);
+
+/* Render into the framebuffer from now on, and set the viewport to cover it */
+void renderTargetBind(renderTarget *target);
+
+/* Render into the window again */
+void renderTargetUnbind(void);
+
+/* Read the color attachment back to main memory (stalls until the GPU is done) */
+unsigned char *renderTargetRead(renderTarget *target);
+
+#endif
@@ -0,0 +1,59 @@
+/* resources.h */
+/* Registry of CPU and GPU memory held by soups, textures and shader programs */
+/*
+ * Every object that holds memory registers itself with its current
+ * CPU and GPU byte counts, and updates or releases its entry when that
+ * changes. GPU sizes are what the framework asked for (buffer sizes,
+ * texture levels), not what the driver actually allocates, which
+ * cannot be queried portably. The registry is safe to use from any
+ * thread.
+ */
+
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <stdio.h>
+
+#define RESOURCE_SOUP 0
+#define RESOURCE_TEXTURE 1
+#define RESOURCE_PROGRAM 2
+#define RESOURCE_KINDS 3
+
+#define RESOURCE_MAX 256 // Most live resources tracked at once
+
+typedef struct {
+	const void *key;  // Address of the owning object, or a GL name cast to a pointer
+	int kind;         // RESOURCE_SOUP, RESOURCE_TEXTURE or RESOURCE_PROGRAM
+	char name[64];    // File name or description
+	long cpuBytes;    // Memory held in main memory
+	long gpuBytes;    // Memory held in GL buffers and textures
+} resourceEntry;
+
+/* Register a resource, or update the sizes of one already registered. */
+/* The name may be NULL to keep the current name. */
+void resourceTrack(int kind, const void *key, const char *name, long cpuBytes, long gpuBytes);
+
+/* Remove a resource from the registry */
+void resourceRelease(int kind, const void *key);
+
+/* Current total bytes for one kind of resource, or for all if kind is -1 */
+long resourceTotalCPU(int kind);
+long resourceTotalGPU(int kind);
+
+/* Highest totals seen so far */
+long resourcePeakCPU(void);
+long resourcePeakGPU(void);
+
+/* Set budgets in bytes (0 for none). Exceeding one prints a warning. */
+void resourceSetBudget(long cpuBytes, long gpuBytes);
+
+/* Nonzero if the current totals exceed a budget */
+int resourceOverBudget(void);
+
+/* Print all live resources, largest first, with totals and peaks */
+void resourcePrint(void);
+
+/* Print totals, peaks and all live resources as a JSON object */
+void resourcePrintJSON(FILE *file);
+
+#endif
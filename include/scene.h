@@ -0,0 +1,50 @@
+/* scene.h */
+/* Many copies of one mesh, animated and culled on the CPU every frame */
+/*
+ * The copies are laid out on a square grid that fills the view, each
+ * one centered and scaled to fit its cell, and all spinning at a rate
+ * tied to the frame number so that every run draws exactly the same
+ * images. sceneUpdate() is the per-frame CPU work: it computes the
+ * modelview matrices and drops the copies that are outside the view
+ * frustum, leaving a draw list that only needs to be submitted. It
+ * touches no GL state, so it can run on a worker for the next frame
+ * while the main thread submits the current one.
+ */
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "triangleSoup.h"
+#include "jobSystem.h"
+
+typedef struct {
+	int nobjects;
+	GLfloat center[3];  // Bounding sphere of the mesh
+	GLfloat radius;
+} scene;
+
+/* What to draw in one frame */
+typedef struct {
+	int frame;          // The frame the list was made for
+	int count;          // Objects to draw
+	GLfloat *MV;        // Their modelview matrices, 16 floats each
+	unsigned char *visible; // Scratch, one per object
+	int capacity;       // Objects there is room for
+} sceneDrawList;
+
+/* Set up nobjects copies of the soup, which needs valid bounds. Returns 1 on success. */
+int sceneInit(scene *s, const triangleSoup *soup, int nobjects);
+
+/* Nothing to free at the moment, but pairs with sceneInit() */
+void sceneDelete(scene *s);
+
+/* Allocate a draw list with room for all objects in a scene. Returns 1 on success. */
+int sceneDrawListInit(sceneDrawList *list, const scene *s);
+
+/* Free a draw list */
+void sceneDrawListDelete(sceneDrawList *list);
+
+/* Animate and cull for a frame, seen through P, spread over jobs if it is not NULL */
+void sceneUpdate(const scene *s, int frame, const GLfloat P[16], sceneDrawList *list, jobSystem *jobs);
+
+#endif
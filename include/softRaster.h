@@ -0,0 +1,87 @@
+/* softRaster.h */
+/* A multithreaded software renderer for triangleSoup objects with the meteor shaders */
+/*
+ * For machines without a usable GPU. The vertex and fragment shaders
+ * are not interpreted: their logic is compiled in, from meteor.c.
+ * Vertices are shaded in parallel, triangles are set up and sorted
+ * into screen tiles ("binned"), and the tiles are then rasterized and
+ * shaded in parallel as jobs, with SSE2 for the edge functions
+ * and the depth test where available. The result follows the GL rules
+ * that matter for matching images: pixel centers at half integers,
+ * a top-left fill rule, back face culling of clockwise triangles, a
+ * less-than depth test and perspective correct interpolation.
+ * Triangles that reach outside the near or far plane are dropped, not
+ * clipped, which is no loss for the meteor scenes.
+ */
+
+#ifndef SOFTRASTER_H
+#define SOFTRASTER_H
+
+#include "triangleSoup.h"
+#include "jobSystem.h"
+
+#define SOFTRASTER_TILE 64 // Side of the square screen tiles, in pixels
+
+/* What the GL path sets with uniforms and shader defines */
+typedef struct {
+	float time;                  // The "time" uniform
+	int octaves;                 // OCTAVES
+	int f1only;                  // CELLULAR_F1_ONLY
+	const GLfloat *displacement; // From meteorBakeDisplacement() (BAKED_DISPLACEMENT), or NULL
+} softShading;
+
+/* A vertex after the vertex stage */
+typedef struct {
+	float x, y, z;   // Window coordinates, z from 0 to 1
+	float invw;      // 1/w, for perspective correct interpolation
+	float pos[3];    // Rest position, "pos" in the shaders
+	float normal[3]; // View space normal, "interpolatedNormal"
+	int clipped;     // Nonzero if outside the near or far plane
+} softVertex;
+
+/* A triangle set up for rasterization */
+typedef struct {
+	int v[3];               // Vertex indices
+	float A[3], B[3], C[3]; // Edge functions A*x + B*y + C, positive inside
+	int topleft[3];         // Nonzero for edges that own the pixels exactly on them
+	float invarea;          // 1 / (sum of the edge functions)
+	int xmin, xmax, ymin, ymax; // Pixels covered by the bounding box, inclusive
+} softTriangle;
+
+/* The triangles that touch one tile, in drawing order */
+typedef struct {
+	int *triangles;
+	int count, capacity;
+} softBin;
+
+typedef struct {
+	int width, height;     // Size in pixels
+	unsigned char *color;  // RGBA, bottom row first like glReadPixels()
+	float *depth;          // Window z, cleared to 1
+	int tilesx, tilesy;
+	softBin *bins;         // tilesx*tilesy bins
+	softVertex *vertices;  // Vertex stage output for the current draw
+	int vertexcapacity;
+	softTriangle *triangles; // Triangles set up for the current draw
+	int ntriangles, trianglecapacity;
+	jobSystem *jobs;       // Not owned
+	// The draw in progress, for the tasks
+	const triangleSoup *soup;
+	GLfloat MV[16], MVP[16];
+	softShading shading;
+} softRaster;
+
+/* Allocate the buffers. The stages run on jobs. Returns 1 on success. */
+int softRasterInit(softRaster *raster, int width, int height, jobSystem *jobs);
+
+/* Free everything */
+void softRasterDelete(softRaster *raster);
+
+/* Fill the color buffer with one color and the depth buffer with 1 */
+void softRasterClear(softRaster *raster, float r, float g, float b, float a);
+
+/* Draw a soup, which must have its vertex and index arrays in main memory */
+void softRasterDraw(softRaster *raster, const triangleSoup *soup,
+	const GLfloat MV[16], const GLfloat P[16], const softShading *shading);
+
+#endif
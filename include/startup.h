@@ -0,0 +1,60 @@
+/* startup.h */
+/* Startup profiler: times each loading phase, with bytes and throughput */
+/*
+ * Phases nest, so soupReadOBJ can report its file read, parse and
+ * upload steps inside one "soupReadOBJ" phase. The profiler only
+ * listens to the thread that called startupInit(), so loaders that
+ * run on other threads later on do not disturb it.
+ */
+
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdio.h>
+
+#define STARTUP_MAXPHASES 128 // Phases recorded, the rest are ignored
+#define STARTUP_MAXDEPTH 16   // Deepest nesting of phases
+
+/* What a phase spends its time on, for the throughput column */
+#define STARTUP_CPU 0     // Plain computation
+#define STARTUP_IO 1      // Reading files (bytes = file bytes read)
+#define STARTUP_PARSE 2   // Parsing text (bytes = text bytes parsed)
+#define STARTUP_UPLOAD 3  // Sending data to the GPU (bytes = bytes uploaded)
+#define STARTUP_COMPILE 4 // Compiling or linking shaders (bytes = source bytes)
+
+typedef struct {
+	const char *name;   // Phase name (must be persistent, e.g. a string literal)
+	char detail[64];    // File name, shader stage or similar
+	int kind;           // STARTUP_CPU, STARTUP_IO, ...
+	int depth;          // Nesting level, 0 for top level phases
+	double start;       // Seconds, timerSeconds() clock
+	double seconds;     // Duration
+	long bytes;         // Bytes processed, or 0
+} startupPhase;
+
+/* Start profiling. If syncGPU is nonzero, GPU phases wait for the GPU to finish. */
+void startupInit(int syncGPU);
+
+/* Nonzero if GPU phases should call glFinish() before they end */
+int startupSyncGPU(void);
+
+/* Begin a phase. The detail string may be NULL. */
+void startupBegin(const char *name, const char *detail, int kind);
+
+/* End the innermost phase, reporting how many bytes it processed */
+void startupEnd(long bytes);
+
+/* Mark the end of startup (call after the first frame is presented). */
+/* Returns 1 the first time it is called, and 0 after that. */
+int startupFirstFrame(void);
+
+/* Print a table of all phases, and the largest contributors */
+void startupPrint(void);
+
+/* Print all phases as a JSON object */
+void startupPrintJSON(FILE *file);
+
+/* Write all phases to a JSON file */
+int startupWriteJSON(const char *filename);
+
+#endif
@@ -41,4 +41,6 @@ typedef struct
 int loadTGA(Texture *texture, char *filename);		// Load a TGA file
 int loadUncompressedTGA(Texture *texture, FILE *tgafile);	// Load an uncompressed file
 void createTexture(Texture *texture, char *filename); // Load GL texture from file
+void deleteTexture(Texture *texture); // Free GL texture and image data
+int saveTGA(char *filename, const GLubyte *pixels, int width, int height); // Save RGBA pixels, bottom row first
 
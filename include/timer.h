@@ -0,0 +1,20 @@
+/* timer.h */
+/* Portable high resolution wall clock and thread CPU clock */
+/* These work without a GLFW context, so tools can use them too */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+/* Monotonic wall clock time in nanoseconds from an arbitrary origin */
+unsigned long long timerNanoseconds(void);
+
+/* Monotonic wall clock time in seconds from an arbitrary origin */
+double timerSeconds(void);
+
+/* CPU time consumed by the calling thread, in seconds */
+double timerCPUSeconds(void);
+
+/* Sleep for about the given number of seconds. The OS may oversleep, by up to a timer tick. */
+void timerSleep(double seconds);
+
+#endif
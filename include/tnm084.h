@@ -4,6 +4,8 @@
  * This code is in the public domain.
  */
 
+#include "frameStats.h"
+
 #ifdef __WIN32__
 /* Global function pointers for everything we need beyond OpenGL 1.1 */
 extern PFNGLCREATEPROGRAMPROC           glCreateProgram;
@@ -38,6 +40,32 @@ extern PFNGLVERTEXATTRIBPOINTERPROC     glVertexAttribPointer;
 extern PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray;
 extern PFNGLACTIVETEXTUREPROC           glActiveTexture;
 extern PFNGLGENERATEMIPMAPPROC          glGenerateMipmap;
+extern PFNGLGENQUERIESPROC              glGenQueries;
+extern PFNGLDELETEQUERIESPROC           glDeleteQueries;
+extern PFNGLQUERYCOUNTERPROC            glQueryCounter;
+extern PFNGLGETQUERYOBJECTIVPROC        glGetQueryObjectiv;
+extern PFNGLGETQUERYOBJECTUI64VPROC     glGetQueryObjectui64v;
+extern PFNGLGETINTEGER64VPROC           glGetInteger64v;
+extern PFNGLGENFRAMEBUFFERSPROC         glGenFramebuffers;
+extern PFNGLDELETEFRAMEBUFFERSPROC      glDeleteFramebuffers;
+extern PFNGLBINDFRAMEBUFFERPROC         glBindFramebuffer;
+extern PFNGLFRAMEBUFFERTEXTURE2DPROC    glFramebufferTexture2D;
+extern PFNGLFRAMEBUFFERRENDERBUFFERPROC glFramebufferRenderbuffer;
+extern PFNGLCHECKFRAMEBUFFERSTATUSPROC  glCheckFramebufferStatus;
+extern PFNGLGENRENDERBUFFERSPROC        glGenRenderbuffers;
+extern PFNGLDELETERENDERBUFFERSPROC     glDeleteRenderbuffers;
+extern PFNGLBINDRENDERBUFFERPROC        glBindRenderbuffer;
+extern PFNGLRENDERBUFFERSTORAGEPROC     glRenderbufferStorage;
+extern PFNGLFENCESYNCPROC               glFenceSync;
+extern PFNGLCLIENTWAITSYNCPROC          glClientWaitSync;
+extern PFNGLDELETESYNCPROC              glDeleteSync;
+extern PFNGLBUFFERSUBDATAPROC           glBufferSubData;
+extern PFNGLMAPBUFFERRANGEPROC          glMapBufferRange;
+extern PFNGLUNMAPBUFFERPROC             glUnmapBuffer;
+extern PFNGLBINDBUFFERRANGEPROC         glBindBufferRange;
+extern PFNGLGETUNIFORMBLOCKINDEXPROC    glGetUniformBlockIndex;
+extern PFNGLUNIFORMBLOCKBINDINGPROC     glUniformBlockBinding;
+extern PFNGLCOMPRESSEDTEXIMAGE2DPROC   glCompressedTexImage2D;
 #endif
 
 
@@ -66,10 +94,24 @@ unsigned char* readShaderFile(const char *filename);
  */
 GLuint createShader(char *vertexshaderfile, char *fragmentshaderfile);
 
+/*
+ * createShaderWithDefines() - createShader() with preprocessor lines
+ * inserted after the #version line of both shaders, or NULL for none.
+ */
+GLuint createShaderWithDefines(char *vertexshaderfile, char *fragmentshaderfile, const char *defines);
+
+/*
+ * createShaderFromSource() - compile and link shader sources already in
+ * memory, with optional defines as for createShaderWithDefines().
+ */
+GLuint createShaderFromSource(const char *vertexsource, const char *fragmentsource, const char *name,
+	const char *defines);
+
 /*
  * computeFPS() - Calculate, display and return frame rate statistics.
+ * Pass a frameStats object to also record every frame, or NULL.
  */
-double computeFPS(GLFWwindow *window);
+double computeFPS(GLFWwindow *window, frameStats *stats);
 
 /*
  * mat4rotx() - create a rotation matrix for rotation around the X axis
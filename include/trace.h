@@ -0,0 +1,78 @@
+/* trace.h */
+/* Timeline zones for CPU threads and the GPU, written as Chrome trace JSON */
+/* (load the file in ui.perfetto.dev or chrome://tracing) */
+/*
+ * All instrumentation goes through the TRACE_* macros below. Unless
+ * TRACE_ENABLED is defined (cmake -DTNM084_TRACE=ON), they expand to
+ * nothing, so the zones cost nothing in a normal build.
+ *
+ * Every thread appends to its own buffer, so recording a zone is two
+ * clock reads and two stores, without locks. A thread takes part just
+ * by recording its first zone. TRACE_WRITE() must only be called when
+ * no other thread is recording, typically at exit.
+ *
+ * TRACE_ZONE(name) times the rest of the enclosing block, also when the
+ * block is left by return or break. TRACE_BEGIN(name)/TRACE_END() are
+ * for zones that do not match a block, and must pair up on each thread.
+ * Names must be string literals or otherwise outlive the trace.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_GPU_THREAD 1000 // Pseudo thread id for the GPU track
+
+#ifdef TRACE_ENABLED
+
+#define TRACE_INIT(threadname) traceInit(threadname)
+#define TRACE_THREAD_NAME(name) traceSetThreadName(name)
+#define TRACE_BEGIN(name) traceBegin(name)
+#define TRACE_END() traceEnd()
+#define TRACE_COMPLETE(name, thread, start, duration) traceComplete(name, thread, start, duration)
+#define TRACE_WRITE(filename) traceWrite(filename)
+
+#ifdef __GNUC__
+#define TRACE_CONCAT2(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT2(a, b)
+#define TRACE_ZONE(name) int TRACE_CONCAT(traceZone, __LINE__) \
+	__attribute__((cleanup(traceEndScope), unused)) = traceBeginScope(name)
+#else
+#define TRACE_ZONE(name) ((void)0) // Needs the cleanup attribute of GCC and Clang
+#endif
+
+#else
+
+#define TRACE_INIT(threadname) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END() ((void)0)
+#define TRACE_COMPLETE(name, thread, start, duration) ((void)0)
+#define TRACE_WRITE(filename) ((void)0)
+#define TRACE_ZONE(name) ((void)0)
+
+#endif
+
+/* Set the time origin of the trace and name the calling thread */
+void traceInit(const char *threadname);
+
+/* Name the calling thread in the trace */
+void traceSetThreadName(const char *name);
+
+/* Start a zone on the calling thread */
+void traceBegin(const char *name);
+
+/* End the most recently started zone on the calling thread */
+void traceEnd(void);
+
+/* Record a finished zone with explicit timing (timerNanoseconds() clock) on any track */
+void traceComplete(const char *name, int thread, unsigned long long start,
+	unsigned long long duration);
+
+/* Helpers for TRACE_ZONE() */
+int traceBeginScope(const char *name);
+void traceEndScope(int *unused);
+
+/* Write all recorded events to a Chrome trace JSON file */
+int traceWrite(const char *filename);
+
+#endif
@@ -1,3 +1,26 @@
+#ifndef TRIANGLESOUP_H
+#define TRIANGLESOUP_H
+
+#include "blockReader.h" // For soupLoader
+#include "arena.h"
+
+/* What to keep in main memory once the geometry is on the GPU */
+#define SOUP_KEEP 0      // Keep the full vertex and index arrays (the default)
+#define SOUP_RELEASE 1   // Free both arrays, rendering only needs the VAO
+#define SOUP_POSITIONS 2 // Keep only xyz per vertex, and the indices, for CPU queries
+
+#define SOUP_GROUPNAMESIZE 64
+
+/* A part of a soup: the triangles after an OBJ "g" or "o" record, which */
+/* are a range in the index array that can be drawn or skipped on its own */
+typedef struct {
+       char name[SOUP_GROUPNAMESIZE];
+       int firsttri;      // First triangle of the part in the index array
+       int ntris;
+       GLfloat bounds[6]; // Extents of the part, like those of the whole soup
+       int visible;       // 0 makes soupRender() skip the part, e.g. when it is culled
+} soupGroup;
+
 /* A struct to hold geometry data and send it off for rendering */
 typedef struct {
        GLuint vao;          // Vertex array object, the main handle for geometry
@@ -7,29 +30,123 @@ typedef struct {
        GLuint *indexarray;   // Element index array
        int nverts; // Number of vertices in the vertex array
        int ntris;  // Number of triangles in the index array (may be zero)
+       int residency;  // SOUP_KEEP, SOUP_RELEASE or SOUP_POSITIONS
+       GLfloat *positionarray; // Vertex positions x y z, only with SOUP_POSITIONS
+       GLfloat bounds[6];      // Extents xmin xmax ymin ymax zmin zmax, always kept
+       GLuint attributebuffer; // Extra per-vertex attribute from soupSetAttribute(), or 0
+       int attributesize;      // Floats per vertex in that attribute
+       GLenum indextype;       // GL_UNSIGNED_INT, GL_UNSIGNED_SHORT for a small packed soup, or as in a .glb file
+       int vertexbytes;        // Bytes per vertex on the GPU: 32, 16 for a packed soup, or as in a .glb file
+       soupGroup *groups;      // The parts, in index array order, or NULL if the soup is all one part
+       int ngroups;
 } triangleSoup;
 
+/* The vertex format of a packed soup, 16 bytes per vertex: */
+/* position as 3 half floats and 2 bytes of padding, normal as */
+/* GL_INT_2_10_10_10_REV (normalized, w unused), texcoords as 2 half floats */
+#define SOUP_PACKEDVERTEXBYTES 16
+
 /* Initialize a triangleSoup object to all zeros */
 void soupInit(triangleSoup *soup);
 
 /* Clean up allocated data in a triangleSoup object */
 void soupDelete(triangleSoup *soup);
 
+/* Choose what stays in main memory after upload (applied at once if already uploaded) */
+void soupSetResidency(triangleSoup *soup, int residency);
+
+/* Add one more per-vertex attribute, with size floats per vertex, after upload */
+void soupSetAttribute(triangleSoup *soup, GLuint location, int size, const GLfloat *values);
+
 /* Create a simple box geometry */
 void soupCreateBox(triangleSoup *soup, float xsize, float ysize, float zsize);
 
 /* Create a sphere (approximated by polygon segments) */
 void soupCreateSphere(triangleSoup *soup, float radius, int segments);
 
+/* Fill in the arrays for the same sphere, without OpenGL */
+void soupGenerateSphere(triangleSoup *soup, float radius, int segments);
+
+/* Sizes found when parsing an OBJ file */
+typedef struct {
+       long bytes;    // Text parsed, after decompression
+       long filebytes; // Read from the file, fewer bytes if it is compressed
+       long lines;    // Lines of text
+       int positions; // Number of "v" lines
+       int normals;   // Number of "vn" lines
+       int texcoords; // Number of "vt" lines
+       int faces;     // Number of "f" lines
+} objInfo;
+
+/* Create the GL buffers directly from packed vertices and 16 or 32 bit indices. */
+/* The data is only read, so it may point into a mapped file. Nothing stays in main memory. */
+void soupCreatePacked(triangleSoup *soup, const void *vertices, int nverts,
+       const void *indices, int ntris, GLenum indextype, const GLfloat bounds[6], const char *name);
+
+/* The OBJ parser's state. Nothing is counted in advance, so the arrays grow. */
+typedef struct {
+       float *verts, *normals, *texcoords;     // Temporaries, in the loader's arena
+       int capverts, capnormals, captexcoords; // Capacities, in elements
+       int capfaces, capindices;               // Faces that soup->vertexarray and soup->indexarray have room for
+       int i_v, i_n, i_t, i_f;                 // Elements read so far
+       long lines;
+       soupGroup *groups;                      // Parts from "g" and "o" records, if there are any
+       int ngroups, capgroups;
+} objParser;
+
+/* An OBJ file that is loaded a little at a time, see soupLoadOBJBegin() */
+typedef struct {
+       blockReader reader;
+       objParser parser;
+       arena scratch;     // The parser's temporary arrays, freed at once at the end
+       const char *blockpos, *blockend; // What is left to parse of the current block
+       char line[256];    // A line cut off at the end of a block
+       int length;
+       int done;          // The last block has been parsed
+       int error;         // The file could not be read or parsed
+       int finished;      // The reader is closed and the soup is complete, or deleted
+       int captris;       // Triangles the GPU buffers have room for
+} soupLoader;
+
 /* Load geometry from an OBJ file */
 void soupReadOBJ(triangleSoup* soup, char* filename);
 
+/* Start loading an OBJ file into GPU buffers sized for the whole file, with nothing drawn yet */
+int soupLoadOBJBegin(soupLoader *loader, triangleSoup *soup, const char *filename);
+
+/* Parse for about the given seconds and upload the new triangles. Returns 0 when done or failed. */
+int soupLoadOBJStep(soupLoader *loader, triangleSoup *soup, double seconds);
+
+/* Stop loading before the end, and delete the soup */
+void soupLoadOBJCancel(soupLoader *loader, triangleSoup *soup);
+
+/* Parse an OBJ file into main memory only, without OpenGL. info may be NULL. */
+int soupParseOBJ(triangleSoup* soup, const char* filename, objInfo *info);
+
+/* Merge identical vertices before upload. Returns the new vertex count. */
+int soupDeduplicate(triangleSoup *soup);
+
+/* Save the arrays to a binary cache file, and load them back without OpenGL */
+int soupWriteCache(const triangleSoup *soup, const char *filename);
+int soupReadCache(triangleSoup *soup, const char *filename);
+
+/* Heap allocations made by the soup functions so far, and their total size */
+unsigned long soupAllocations(void);
+long soupAllocatedBytes(void);
+
 /* Print data from a triangleSoup object, for debugging purposes */
 void soupPrint(triangleSoup soup);
 
 /* Print information about a triangleSoup object (stats and extents) */
 void soupPrintInfo(triangleSoup soup);
 
-/* Render the geometry in a triangleSoup object */
+/* The group with a given name, or -1 */
+int soupFindGroup(const triangleSoup *soup, const char *name);
+
+/* Render the geometry in a triangleSoup object, skipping groups that are not visible */
 void soupRender(triangleSoup soup);
 
+/* Render one group of a triangleSoup object, visible or not */
+void soupRenderGroup(triangleSoup soup, int group);
+
+#endif
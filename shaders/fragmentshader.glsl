@@ -1,6 +1,13 @@
 #version 330 core
 
+// Define STILL_LAVA to render the surface frozen at time 0. The shader
+// then does not use time at all, and the program can stop redrawing
+// while nothing else changes.
+#ifdef STILL_LAVA
+const float time = 0.0;
+#else
 uniform float time;
+#endif
 uniform sampler2D tex;
 
 in vec3 interpolatedNormal;
@@ -283,7 +290,7 @@ vec2 cellular(vec3 P) {
 	vec3 d33 = dx33 * dx33 + dy33 * dy33 + dz33 * dz33;
 
 	// Sort out the two smallest distances (F1, F2)
-#if 0
+#ifdef CELLULAR_F1_ONLY
 	// Cheat and sort out only F1
 	vec3 d1 = min(min(d11,d12), d13);
 	vec3 d2 = min(min(d21,d22), d23);
@@ -1,10 +1,31 @@
 #version 330 core
 
+// Quality settings. The defaults give the full quality look, and any of
+// them can be overridden from C with createShaderWithDefines().
+#ifndef OCTAVES
+#define OCTAVES 10 // Octaves of fBm in the elevation
+#endif
+// Define BAKED_DISPLACEMENT to read the displacement and its gradient
+// from attribute 3, precomputed on the CPU by meteorBakeDisplacement(),
+// instead of evaluating the noise for every vertex in every frame.
+// Define LATE_LATCH to read MV from the uniform block "LateLatch",
+// written by lateLatchWrite() right before the draw.
+
 layout(location = 0) in vec3 Position;
 layout(location = 1) in vec3 Normal;
 layout(location = 2) in vec2 TexCoord;
-
+#ifdef BAKED_DISPLACEMENT
+layout(location = 3) in vec4 Displacement; // Offset, then its gradient
+#endif
+
+#ifdef LATE_LATCH
+layout(std140) uniform LateLatch {
+    mat4 latchedMV;
+};
+#define MV latchedMV
+#else
 uniform mat4 MV;
+#endif
 uniform mat4 P;
 uniform float time;
 
@@ -24,6 +45,10 @@ out vec2 st;
 // Distributed under the MIT license. See LICENSE file.
 // https://github.com/stegu/webgl-noise
 //
+// snoise() and cnoise() also return the analytic gradient of the noise,
+// as in the "noise3Dgrad" variant, so that the displaced normal costs
+// little more than the displacement.
+//
 
 vec3 mod289(vec3 x) {
   return x - floor(x * (1.0 / 289.0)) * 289.0;
@@ -45,7 +70,7 @@ vec4 fade(vec4 t) {
   return t*t*t*(t*(t*6.0-15.0)+10.0);
 }
 
-float snoise(vec3 v)
+float snoise(vec3 v, out vec3 gradient)
 {
   const vec2  C = vec2(1.0/6.0, 1.0/3.0) ;
   const vec4  D = vec4(0.0, 0.5, 1.0, 2.0);
@@ -113,15 +138,21 @@ float snoise(vec3 v)
   p2 *= norm.z;
   p3 *= norm.w;
 
-// Mix final noise value
+// Mix final noise value, and its gradient
   vec4 m = max(0.6 - vec4(dot(x0,x0), dot(x1,x1), dot(x2,x2), dot(x3,x3)), 0.0);
-  m = m * m;
-  return 42.0 * dot( m*m, vec4( dot(p0,x0), dot(p1,x1),
-                                dot(p2,x2), dot(p3,x3) ) );
+  vec4 m2 = m * m;
+  vec4 m4 = m2 * m2;
+  vec4 pdotx = vec4(dot(p0,x0), dot(p1,x1), dot(p2,x2), dot(p3,x3));
+  vec4 temp = m2 * m * pdotx;
+  gradient = -8.0 * (temp.x * x0 + temp.y * x1 + temp.z * x2 + temp.w * x3);
+  gradient += m4.x * p0 + m4.y * p1 + m4.z * p2 + m4.w * p3;
+  gradient *= 42.0;
+  return 42.0 * dot(m4, pdotx);
   }
 
-// Classic Perlin noise
-float cnoise(vec4 P)
+// Classic Perlin noise, and its gradient with respect to P.xyz
+
+float cnoise(vec4 P, out vec3 gradient)
 {
   vec4 Pi0 = floor(P); // Integer part for indexing
   vec4 Pi1 = Pi0 + 1.0; // Integer part + 1
@@ -252,9 +283,39 @@ float cnoise(vec4 P)
   vec4 n_zw = mix(n_0w, n_1w, fade_xyzw.z);
   vec2 n_yzw = mix(n_zw.xy, n_zw.zw, fade_xyzw.y);
   float n_xyzw = mix(n_yzw.x, n_yzw.y, fade_xyzw.x);
+
+  // The gradient has two parts: the corner gradients, blended with the
+  // same weights as the values, and the change of the weights themselves,
+  // which is the derivative of fade() times the difference across the cell
+  vec4 dfade_xyzw = 30.0 * Pf0 * Pf0 * (Pf0 * (Pf0 - 2.0) + 1.0);
+  vec4 w_xy = vec4(1.0 - fade_xyzw.x, fade_xyzw.x, 1.0 - fade_xyzw.x, fade_xyzw.x)
+            * vec4(1.0 - fade_xyzw.yy, fade_xyzw.yy);
+  vec3 g_00 = mat4x3(g0000.xyz, g1000.xyz, g0100.xyz, g1100.xyz) * w_xy;
+  vec3 g_01 = mat4x3(g0001.xyz, g1001.xyz, g0101.xyz, g1101.xyz) * w_xy;
+  vec3 g_10 = mat4x3(g0010.xyz, g1010.xyz, g0110.xyz, g1110.xyz) * w_xy;
+  vec3 g_11 = mat4x3(g0011.xyz, g1011.xyz, g0111.xyz, g1111.xyz) * w_xy;
+  vec3 g_zw = mix(mix(g_00, g_01, fade_xyzw.w), mix(g_10, g_11, fade_xyzw.w), fade_xyzw.z);
+  vec4 n_dz = n_1w - n_0w;
+  vec2 n_dzx = mix(n_dz.xz, n_dz.yw, fade_xyzw.x);
+  gradient = g_zw + dfade_xyzw.xyz * vec3(n_yzw.y - n_yzw.x,
+                                          mix(n_zw.z - n_zw.x, n_zw.w - n_zw.y, fade_xyzw.x),
+                                          mix(n_dzx.x, n_dzx.y, fade_xyzw.y));
+  gradient *= 2.2;
   return 2.2 * n_xyzw;
 }
 
+float snoise(vec3 v)
+{
+  vec3 gradient;
+  return snoise(v, gradient);
+}
+
+float cnoise(vec4 P)
+{
+  vec3 gradient;
+  return cnoise(P, gradient);
+}
+
 // Classic Perlin noise, periodic version
 float pnoise(vec4 P, vec4 rep)
 {
@@ -396,20 +457,38 @@ void main() {
     //vec3 pos = Position + 0.01 * Normal * 5.0*sin(time + classicalnoise);
 
     // Meteor
-    float classicalnoise = cnoise(vec4(Position, 1.0));
-
-    float elevation = snoise(vec3(1.6 * Position) - 0.5);
-
-    float freq;
-    for (freq=1.0; freq<1024.0; freq*=2.0) {
-        elevation += 0.5/freq*(snoise(Position*4.0*freq)-0.5);
+#ifdef BAKED_DISPLACEMENT
+    float displacement = Displacement.x;
+    vec3 gradient = Displacement.yzw;
+#else
+    vec3 noisegradient;
+    float classicalnoise = cnoise(vec4(Position, 1.0), noisegradient);
+    vec3 classicalgradient = noisegradient;
+
+    float elevation = snoise(vec3(1.6 * Position) - 0.5, noisegradient);
+    vec3 elevationgradient = 1.6 * noisegradient;
+
+    float freq = 1.0;
+    int octave;
+    for (octave=0; octave<OCTAVES; octave++) {
+        elevation += 0.5/freq*(snoise(Position*4.0*freq, noisegradient)-0.5);
+        elevationgradient += 2.0 * noisegradient; // 0.5/freq, times 4.0*freq from the chain rule
+        freq *= 2.0;
     }
 
-    vec3 finalelevation = 10.0 * elevation * 0.01 * Normal;
-    vec3 variedpos = Position + 0.02 * Normal * 10.0 * classicalnoise + finalelevation;
+    float displacement = 0.02 * 10.0 * classicalnoise + 10.0 * elevation * 0.01;
+    vec3 gradient = 0.02 * 10.0 * classicalgradient + 10.0 * 0.01 * elevationgradient;
+#endif
+    vec3 variedpos = Position + displacement * Normal;
+
+    // The displaced surface tilts against the part of the gradient that
+    // lies in the tangent plane. This ignores the curvature of the mesh,
+    // which is fine while the displacement is small.
+    vec3 unitnormal = normalize(Normal);
+    vec3 bentnormal = normalize(unitnormal - (gradient - dot(gradient, unitnormal) * unitnormal));
 
     gl_Position = (P * MV) * vec4(variedpos, 1.0);
-    interpolatedNormal = mat3(MV) * Normal;
+    interpolatedNormal = mat3(MV) * bentnormal;
     pos = Position;
     st = TexCoord;
 }
@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 // In MacOS X, tell GLFW to include the modern OpenGL headers.
@@ -51,7 +52,19 @@
 #include "tnm084.h"
 #include "tgaloader.h"
 #include "triangleSoup.h"
+#include "bundle.h"
 #include "pollRotator.h"
+#include "frameStats.h"
+#include "gpuTimer.h"
+#include "trace.h"
+#include "startup.h"
+#include "resources.h"
+#include "framePipeline.h"
+#include "framePacer.h"
+#include "lateLatch.h"
+#include "inputLatency.h"
+#include "inputEvents.h"
+#include "fileWatch.h"
 
 // There's still no Makefile for MacOS X, but this fixes the problem of
 // accessing local files from deep down within an application bundle.
@@ -67,6 +80,22 @@
 #define VERTEXSHADERFILENAME PATH "../shaders/vertexshader.glsl"
 #define FRAGMENTSHADERFILENAME PATH "../shaders/fragmentshader.glsl"
 
+// Raw frame times are written here at exit, for offline analysis
+#define FRAMESTATSCSVFILENAME "framestats.csv"
+#define FRAMESTATSJSONFILENAME "framestats.json"
+// Timeline of CPU and GPU zones, written at exit if built with TNM084_TRACE
+#define TRACEFILENAME "trace.json"
+// Time spent in each phase of startup, written after the first frame
+#define STARTUPFILENAME "startup.json"
+// Frames the GPU may lag behind the CPU before the CPU waits for it
+#define FRAMESINFLIGHT 2
+// The shaders read MV from a uniform buffer written right before the draw
+#define SHADERDEFINES "#define LATE_LATCH\n"
+// Seconds between checks for changed shader files, and the longest idle wait
+#define WATCHINTERVAL 0.25
+// Seconds per frame spent parsing a mesh that is loaded with "--mesh FILE"
+#define LOADSECONDS 0.004
+
 /*
  * setupViewport() - set up the OpenGL viewport to handle window resizing
  */
@@ -85,6 +114,28 @@ void setupViewport(GLFWwindow* window, GLfloat *P) {
 }
 
 
+/*
+ * handleEvents() - apply the queued input events. Returns 1 if they
+ * change what is on screen, so a new frame has to be drawn.
+ */
+static int handleEvents(inputEvents *input, rotatorMouse *rotator, GLFWwindow *window, int *reload) {
+
+	inputEvent event;
+	float phi = rotator->phi, theta = rotator->theta;
+	int redraw = 0;
+
+	while(inputEventsPop(input, &event)) {
+		rotatorMouseEvent(rotator, &event);
+		if(event.type == INPUT_RESIZE || event.type == INPUT_REFRESH) redraw = 1;
+		if(event.type == INPUT_KEY && event.action == GLFW_PRESS) {
+			if(event.key == GLFW_KEY_SPACE) *reload = 1;
+			if(event.key == GLFW_KEY_ESCAPE) glfwSetWindowShouldClose(window, GL_TRUE);
+		}
+	}
+	return redraw || *reload || rotator->phi != phi || rotator->theta != theta;
+}
+
+
 /*
  * main(argc, argv) - the standard C entry point for the program
  */
@@ -98,6 +149,28 @@ int main(int argc, char *argv[]) {
 
     float time;
 	double fps = 0.0;
+	frameStats stats; // Per-frame timing, percentiles and hitches
+	gpuTimer gputimer; // GPU time per render pass
+	framePipeline pipeline; // Fences that keep the CPU from running too far ahead
+	framePacer pacer; // Sleeps between frames when a target frame rate is set
+	lateLatch latch; // MV written from input read as late as possible
+	inputLatency latency; // Time from input events to the swaps that show them
+	inputEvents input; // Events from the GLFW callbacks, consumed once per frame
+	fileWatch watch; // The shader files, reloaded when they change
+	int reload = 0; // Set by the spacebar or a changed shader file
+	double targetfps = 0.0; // Uncapped unless "--fps N" is given
+	int ondemand = 0; // "--ondemand": only draw when something has changed
+	int redraw = 1; // Something has changed since the last frame
+	int animated; // The shader program uses time, so every frame is different
+	double lastwatch = 0.0;
+	int still = 0; // "--still": the lava does not move
+	char defines[128];
+	const char *bundlefile = NULL; // "--bundle FILE": the texture and shaders from a cooked bundle
+	bundle assets;
+	const char *meshfile = NULL; // "--mesh FILE": an OBJ file, drawn while it loads
+	soupLoader loader;
+	int loading = 0; // The mesh is still coming in, a part of it per frame
+	int i;
 
 	GLFWmonitor* monitor;
     const GLFWvidmode* vidmode;  // GLFW struct to hold information on the display
@@ -105,14 +178,40 @@ int main(int argc, char *argv[]) {
 
 	rotatorMouse rotator;
 
+	// "--fps N" caps the frame rate at N, "--ondemand" skips frames where
+	// nothing changes, and "--still" freezes the lava so that the shaders
+	// do not change the picture over time either. "--bundle FILE" takes the
+	// texture and the shaders from a bundle made by the cook tool instead
+	// of from their own files. "--mesh FILE" shows an OBJ file instead of
+	// the sphere, starting with the first frame, while it is loaded.
+	for(i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "--fps") && i + 1 < argc) targetfps = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--ondemand")) ondemand = 1;
+		else if(!strcmp(argv[i], "--still")) still = 1;
+		else if(!strcmp(argv[i], "--bundle") && i + 1 < argc) bundlefile = argv[++i];
+		else if(!strcmp(argv[i], "--mesh") && i + 1 < argc) meshfile = argv[++i];
+		else {
+			printf("Usage: %s [--fps N] [--ondemand] [--still] [--bundle FILE] [--mesh FILE]\n", argv[0]);
+			return -1;
+		}
+	}
+	snprintf(defines, sizeof(defines), "%s%s", SHADERDEFINES, still ? "#define STILL_LAVA\n" : "");
+
+	TRACE_INIT("main");
+	startupInit(1); // Time every startup phase, waiting for the GPU where it matters
 	initRotatorMouse(&rotator);
+	frameStatsInit(&stats);
 	
     // Initialise GLFW, bail out if unsuccessful
+    TRACE_BEGIN("startup");
+    startupBegin("glfwInit", NULL, STARTUP_CPU);
     if (!glfwInit()) {
     	printf("Failed to initialise GLFW. Exiting.\n");
     	return -1;
     }
+    startupEnd(0);
 
+	startupBegin("createWindow", NULL, STARTUP_CPU);
 	monitor = glfwGetPrimaryMonitor();
 	vidmode = glfwGetVideoMode(monitor);
 
@@ -142,12 +241,21 @@ int main(int argc, char *argv[]) {
     // to query for those extensions and connect to instances of them.
     // (It's Microsoft Windows that forces us to do this, not OpenGL.)
     loadExtensions();
+    startupEnd(0);
 
     printf("GL vendor:       %s\n", glGetString(GL_VENDOR));
     printf("GL renderer:     %s\n", glGetString(GL_RENDERER));
     printf("GL version:      %s\n", glGetString(GL_VERSION));
     printf("Desktop size:    %d x %d pixels\n", vidmode->width, vidmode->height);
 
+	// Create the timer queries for measuring GPU time per pass
+	gpuTimerInit(&gputimer, &stats);
+	framePipelineInit(&pipeline, FRAMESINFLIGHT);
+	// One slot more than the frames in flight, so the slot written is never in use
+	lateLatchInit(&latch, FRAMESINFLIGHT + 1);
+	inputEventsInit(&input, window);
+	inputLatencyInit(&latency, window); // After inputEventsInit(), it forwards to those callbacks
+
 	// Set up some matrices.
 	GLfloat MV[16]; // Modelview matrix
 	
@@ -178,42 +286,118 @@ int main(int argc, char *argv[]) {
 
 	// Create geometry for rendering
 	soupInit(&myShape); // Initialize all fields to zero
-	soupCreateSphere(&myShape, 1.0, 50); // A latitude-longitude sphere mesh
-	//soupReadOBJ(&myShape, MESHFILENAME); // A triangle mesh from an OBJ file
-	soupPrintInfo(myShape);
+	soupSetResidency(&myShape, SOUP_RELEASE); // Only the GPU copy is needed for rendering
+	if(meshfile) {
+		// A triangle mesh from an OBJ file, parsed and uploaded a little
+		// every frame, so the first part is drawn right away
+		loading = soupLoadOBJBegin(&loader, &myShape, meshfile);
+	}
+	else {
+		soupCreateSphere(&myShape, 1.0, 50); // A latitude-longitude sphere mesh
+		//soupReadOBJ(&myShape, MESHFILENAME); // A triangle mesh from an OBJ file
+		soupPrintInfo(myShape);
+	}
 
 	// Enable texturing, in case it's not already the default
 	glEnable(GL_TEXTURE_2D);
-	// Load a texture from a TGA file
-	createTexture(&texture, TEXTUREFILENAME);
-
-	// Create a shader program object from GLSL code in two files
-	programObject = createShader(VERTEXSHADERFILENAME, FRAGMENTSHADERFILENAME);
+	fileWatchInit(&watch);
+	if(bundlefile) {
+		// Everything comes ready made from the bundle, and it never changes
+		// while we run, so there are no files to watch
+		if(!bundleOpen(&assets, bundlefile)) {
+			glfwTerminate();
+			return -1;
+		}
+		bundleCreateTexture(&assets, "earth2048.tga", &texture);
+		programObject = createShaderFromSource(bundleShaderSource(&assets, "vertexshader.glsl"),
+			bundleShaderSource(&assets, "fragmentshader.glsl"), bundlefile, defines);
+	}
+	else {
+		// Load a texture from a TGA file
+		createTexture(&texture, TEXTUREFILENAME);
+
+		// Create a shader program object from GLSL code in two files
+		programObject = createShaderWithDefines(VERTEXSHADERFILENAME, FRAGMENTSHADERFILENAME, defines);
+		fileWatchAdd(&watch, VERTEXSHADERFILENAME);
+		fileWatchAdd(&watch, FRAGMENTSHADERFILENAME);
+	}
+	lateLatchBind(&latch, programObject);
 
 	// Get the uniform locations for the things we want to change during runtime
 	location_MV = glGetUniformLocation( programObject, "MV" );
 	location_P = glGetUniformLocation( programObject, "P" );
 	location_time = glGetUniformLocation( programObject, "time" );
 	location_tex = glGetUniformLocation( programObject, "tex" );
+	// The linker drops uniforms that are never used, so a program that
+	// does not depend on time has no location for it
+	animated = (location_time != -1);
+	TRACE_END(); // startup
+
+	framePacerInit(&pacer, targetfps);
 
     // Main loop: render frames until the program is terminated
     while (!glfwWindowShouldClose(window))
     {
+		// On demand, sleep in GLFW until something needs a new frame: input
+		// that changes the view, a changed shader file, or an animated shader.
+		// A mesh that is still loading changes every frame too.
+		if(ondemand && !animated && !redraw && !loading) {
+			TRACE_BEGIN("idle");
+			while(!redraw && !glfwWindowShouldClose(window)) {
+				glfwWaitEventsTimeout(WATCHINTERVAL);
+				redraw = handleEvents(&input, &rotator, window, &reload);
+				if(!redraw) inputLatencyDiscard(&latency); // These events will never be shown
+				if(glfwGetTime() - lastwatch >= WATCHINTERVAL) {
+					lastwatch = glfwGetTime();
+					if(fileWatchChanged(&watch)) reload = redraw = 1;
+				}
+			}
+			TRACE_END();
+			if(glfwWindowShouldClose(window)) break;
+		}
+		else if(glfwGetTime() - lastwatch >= WATCHINTERVAL) {
+			lastwatch = glfwGetTime();
+			if(fileWatchChanged(&watch)) reload = 1;
+		}
+		redraw = 0;
+
+		// Reload and recompile the shader program if the spacebar was pressed
+		// or a shader file was changed
+        if(reload) {
+			reload = 0;
+			glDeleteProgram(programObject);
+			resourceRelease(RESOURCE_PROGRAM, (void*)(size_t)programObject);
+			if(bundlefile) programObject = createShaderFromSource(bundleShaderSource(&assets, "vertexshader.glsl"),
+				bundleShaderSource(&assets, "fragmentshader.glsl"), bundlefile, defines);
+			else programObject = createShaderWithDefines(VERTEXSHADERFILENAME, FRAGMENTSHADERFILENAME, defines);
+			lateLatchBind(&latch, programObject);
+			location_MV = glGetUniformLocation( programObject, "MV" );
+			location_P = glGetUniformLocation( programObject, "P" );
+			location_time = glGetUniformLocation( programObject, "time" );
+			location_tex = glGetUniformLocation( programObject, "tex" );
+			animated = (location_time != -1);
+        }
+
+		// With a target frame rate, sleep until it is time for the next frame
+		framePacerWait(&pacer);
+
         // Calculate and update the frames per second (FPS) display
-        fps = computeFPS(window);
+        fps = computeFPS(window, &stats);
+		TRACE_BEGIN("frame");
+		framePipelineBeginFrame(&pipeline);
+		gpuTimerBeginFrame(&gputimer, stats.frames);
 
 		// Set the background RGBA color, and clear the buffers for drawing
+		gpuTimerBegin(&gputimer, "clear");
         glClearColor(0.3f, 0.3f, 0.3f, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gpuTimerEnd(&gputimer);
 
         // Set up the viewport
         setupViewport(window, P);
 
-		// Handle mouse input to rotate the view
-		pollRotatorMouse(window, &rotator);
-		//printf("phi = %6.2f, theta = %6.2f\n", rotator.phi, rotator.theta);
-
 		// Activate our shader program.
+		TRACE_BEGIN("uniforms");
 		glUseProgram( programObject );
 
 		// Tell the shader that we are using texture unit 0
@@ -227,6 +411,27 @@ int main(int argc, char *argv[]) {
 			glUniform1f( location_time, time );
 		}
 
+		// Update the perspective projection matrix P
+		if ( location_P != -1 ) {
+			glUniformMatrix4fv( location_P, 1, GL_FALSE, P );
+		}
+
+        // Draw the scene
+		glEnable(GL_DEPTH_TEST); // Use the Z buffer
+		glEnable(GL_CULL_FACE);  // Use back face culling
+		glCullFace(GL_BACK);
+		//glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+
+		TRACE_END(); // uniforms
+
+		// Handle mouse input to rotate the view. This is done as late as
+		// possible, right before the draw, so the view shows the newest input.
+		TRACE_BEGIN("input");
+		glfwPollEvents();
+		inputLatencyLatch(&latency);
+		redraw = handleEvents(&input, &rotator, window, &reload); // If so, the next frame is needed too
+		//printf("phi = %6.2f, theta = %6.2f\n", rotator.phi, rotator.theta);
+
 		// Modify MV according to user input
 		mat4roty(R1, rotator.phi * M_PI/180.0);
 		mat4rotx(R2, rotator.theta * M_PI/180.0);
@@ -234,50 +439,78 @@ int main(int argc, char *argv[]) {
 		mat4mult(Tz,MV,MV);
 		// mat4print(MV);
 
-		// Update the transformation matrix MV, a uniform variable
+		// Update the transformation matrix MV, in the late latch buffer
+		// or as a plain uniform if the shader was built without it
+		lateLatchWrite(&latch, MV);
 		if ( location_MV != -1 ) {
 			glUniformMatrix4fv( location_MV, 1, GL_FALSE, MV );
 		}
+		TRACE_END(); // input
 
-		// Update the perspective projection matrix P
-		if ( location_P != -1 ) {
-			glUniformMatrix4fv( location_P, 1, GL_FALSE, P );
+		// Take in the next part of a mesh that is loading
+		if(loading) {
+			loading = soupLoadOBJStep(&loader, &myShape, LOADSECONDS);
+			if(!loading && !loader.error) soupPrintInfo(myShape);
 		}
 
-        // Draw the scene
-		glEnable(GL_DEPTH_TEST); // Use the Z buffer
-		glEnable(GL_CULL_FACE);  // Use back face culling
-		glCullFace(GL_BACK);
-		//glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
-
 		// Render the geometry
+		TRACE_BEGIN("soupRender");
+		gpuTimerBegin(&gputimer, "soupRender");
 		soupRender(myShape);
+		gpuTimerEnd(&gputimer);
+		TRACE_END();
 
 		// Play nice and deactivate the shader program
 		glUseProgram(0);
 
 		// Swap buffers, i.e. display the image and prepare for next frame.
+		TRACE_BEGIN("swap");
         glfwSwapBuffers(window);
+		TRACE_END();
+		inputLatencySwapped(&latency);
+		framePipelineEndFrame(&pipeline);
+		framePacerFrameDone(&pacer);
+
+		// Report where the time to the first frame went
+		if(startupFirstFrame()) {
+			startupPrint();
+			startupWriteJSON(STARTUPFILENAME);
+			resourcePrint();
+		}
 
-		// Make sure GLFW takes the time to process keyboard and mouse input
-		glfwPollEvents();
-
-		// Reload and recompile the shader program if the spacebar is pressed.
-        if(glfwGetKey(window, GLFW_KEY_SPACE)) {
-			glDeleteProgram(programObject);
-			programObject = createShader(VERTEXSHADERFILENAME, FRAGMENTSHADERFILENAME);
-        }
-
-        // Exit the program if the ESC key is pressed.
-        if(glfwGetKey(window, GLFW_KEY_ESCAPE)) {
-          glfwSetWindowShouldClose(window, GL_TRUE);
-        }
+		TRACE_END(); // frame
     }
 
+	gpuTimerPrint(&gputimer);
+	framePacerPrint(&pacer);
+	inputLatencyPrint(&latency);
+	inputLatencyDelete(&latency, window);
+	inputEventsDelete(&input);
+	lateLatchDelete(&latch);
+	gpuTimerDelete(&gputimer);
+	framePipelineDelete(&pipeline);
+
+	// Release the GPU resources while we still have a context
+	if(loading) soupLoadOBJCancel(&loader, &myShape);
+	soupDelete(&myShape);
+	deleteTexture(&texture);
+	glDeleteProgram(programObject);
+	resourceRelease(RESOURCE_PROGRAM, (void*)(size_t)programObject);
+	if(bundlefile) bundleClose(&assets);
+	printf("Peak resource memory: %.2f MB CPU, %.2f MB GPU\n",
+		resourcePeakCPU() / 1048576.0, resourcePeakGPU() / 1048576.0);
+
     // Close the OpenGL window and terminate GLFW.
     glfwDestroyWindow(window);
     glfwTerminate();
 
+	// Report the frame time distribution and save the raw series
+	frameStatsPrint(&stats);
+	frameStatsWriteCSV(&stats, FRAMESTATSCSVFILENAME);
+	frameStatsWriteJSON(&stats, FRAMESTATSJSONFILENAME);
+	frameStatsDelete(&stats);
+	TRACE_WRITE(TRACEFILENAME);
+
 	// Exit gracefully
     return 0;
 }
@@ -0,0 +1,183 @@
+/* arena.c */
+/* Region allocation for temporaries that are all freed at once */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+// The header is padded so that the memory after it stays aligned
+#define ARENA_HEADER ((long)(sizeof(arenaBlock) + ARENA_ALIGN - 1) & ~(long)(ARENA_ALIGN - 1))
+#define ARENA_ROUND(bytes) (((bytes) + ARENA_ALIGN - 1) & ~(long)(ARENA_ALIGN - 1))
+#define ARENA_DATA(block) ((char*)(block) + ARENA_HEADER)
+
+static _Thread_local arena scratch;
+static _Thread_local int scratchready = 0;
+
+/* Set up an empty arena */
+void arenaInit(arena *a, long blocksize) {
+	memset(a, 0, sizeof(arena));
+	a->last = -1;
+	a->blocksize = blocksize > 0 ? blocksize : ARENA_BLOCKSIZE;
+}
+
+/* Free all blocks */
+void arenaDelete(arena *a) {
+	arenaBlock *block, *next;
+
+	for(block = a->first; block; block = next) {
+		next = block->next;
+		free(block);
+	}
+	a->first = a->current = NULL;
+	a->used = a->reserved = 0;
+	a->last = -1;
+	a->nblocks = 0;
+}
+
+/*
+ * arenaNextBlock() - move on to a block with room for bytes, the next
+ * free one if it is big enough, or a new one. Returns 0 if out of memory.
+ */
+static int arenaNextBlock(arena *a, long bytes) {
+	arenaBlock *block = a->current ? a->current->next : a->first;
+	arenaBlock *next;
+	long size;
+
+	if(!block || block->size < bytes) {
+		// Free blocks that are too small go, so the arena does not keep them forever
+		while(block) {
+			next = block->next;
+			a->reserved -= ARENA_HEADER + block->size;
+			a->nblocks--;
+			free(block);
+			block = next;
+		}
+		// Blocks grow with the arena, so a big load needs few of them
+		size = a->blocksize;
+		if(size < a->reserved) size = a->reserved;
+		if(size < bytes) size = bytes;
+		block = (arenaBlock*)malloc(ARENA_HEADER + size);
+		if(!block) {
+			fprintf(stderr, "arena: out of memory for %ld bytes.\n", bytes);
+			if(a->current) a->current->next = NULL;
+			else a->first = NULL;
+			return 0;
+		}
+		block->next = NULL;
+		block->size = size;
+		a->reserved += ARENA_HEADER + size;
+		a->nblocks++;
+		if(a->current) a->current->next = block;
+		else a->first = block;
+	}
+	block->base = a->current ? a->current->base + a->current->size : 0;
+	a->current = block;
+	a->used = 0;
+	return 1;
+}
+
+/* Allocate bytes */
+void *arenaAlloc(arena *a, long bytes) {
+	long rounded = ARENA_ROUND(bytes > 0 ? bytes : 1);
+
+	if(!a->current || a->used + rounded > a->current->size) {
+		if(!arenaNextBlock(a, rounded)) return NULL;
+	}
+	a->last = a->used;
+	a->used += rounded;
+	if(a->current->base + a->used > a->peak) a->peak = a->current->base + a->used;
+	return ARENA_DATA(a->current) + a->last;
+}
+
+/*
+ * arenaGrow() - make an allocation bigger. The last allocation grows in
+ * place if its block has room; anything else is copied to a new one,
+ * and the old space is only freed with the rest of the arena.
+ */
+void *arenaGrow(arena *a, void *old, long oldbytes, long newbytes) {
+	long rounded = ARENA_ROUND(newbytes > 0 ? newbytes : 1);
+	void *moved;
+
+	if(old && a->current && a->last >= 0 && (char*)old == ARENA_DATA(a->current) + a->last
+		&& a->last + rounded <= a->current->size) {
+		a->used = a->last + rounded;
+		if(a->current->base + a->used > a->peak) a->peak = a->current->base + a->used;
+		return old;
+	}
+	moved = arenaAlloc(a, newbytes);
+	if(moved && old) memcpy(moved, old, oldbytes < newbytes ? oldbytes : newbytes);
+	return moved;
+}
+
+/* The current position */
+long arenaMark(const arena *a) {
+	return a->current ? a->current->base + a->used : 0;
+}
+
+/*
+ * arenaRelease() - free everything allocated after the mark. The mark
+ * is usually in the current block; if not, the blocks are searched
+ * from the first, and the ones after it are kept for reuse.
+ */
+void arenaRelease(arena *a, long mark) {
+	arenaBlock *block;
+
+	if(!a->current) return;
+	a->last = -1;
+	if(mark >= a->current->base) {
+		if(mark - a->current->base < a->used) a->used = mark - a->current->base;
+		return;
+	}
+	for(block = a->first; block->next && mark > block->base + block->size; block = block->next);
+	a->current = block;
+	a->used = mark - block->base;
+}
+
+/* Free everything, but keep the blocks */
+void arenaReset(arena *a) {
+	arenaRelease(a, 0);
+}
+
+/*
+ * arenaTrim() - give the blocks that hold nothing back to the heap: the
+ * ones after the current block, and all of them if the arena is empty.
+ */
+void arenaTrim(arena *a) {
+	arenaBlock *block, *next;
+
+	if(!a->current) return;
+	if(a->current == a->first && a->used == 0) {
+		arenaDelete(a);
+		return;
+	}
+	for(block = a->current->next; block; block = next) {
+		next = block->next;
+		a->reserved -= ARENA_HEADER + block->size;
+		a->nblocks--;
+		free(block);
+	}
+	a->current->next = NULL;
+}
+
+/* The calling thread's scratch arena */
+arena *arenaScratch(void) {
+	if(!scratchready) {
+		arenaInit(&scratch, 0);
+		scratchready = 1;
+	}
+	return &scratch;
+}
+
+/* Free the calling thread's scratch arena */
+void arenaScratchDelete(void) {
+	if(scratchready) arenaDelete(&scratch);
+	scratchready = 0;
+}
+
+/* Print the peak use, and what the arena still holds */
+void arenaPrint(const arena *a, const char *name) {
+	printf("%s: peak %.2f MB, %.2f MB in use, %.2f MB still reserved in %d blocks\n",
+		name, a->peak / 1048576.0, arenaMark(a) / 1048576.0, a->reserved / 1048576.0, a->nblocks);
+}
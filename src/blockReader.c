@@ -0,0 +1,277 @@
+/* blockReader.c */
+/* Read a file in fixed-size blocks on a thread of its own, decompressing it on the way */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "blockReader.h"
+#include "trace.h"
+
+/* Free the decoder and close the file */
+static void blockReaderCloseFile(blockReader *reader) {
+#ifdef HAVE_ZLIB
+	if(reader->format == BLOCKREADER_GZIP && reader->decoder) gzclose((gzFile)reader->decoder);
+#endif
+#ifdef HAVE_ZSTD
+	if(reader->format == BLOCKREADER_ZSTD && reader->decoder) ZSTD_freeDCtx((ZSTD_DCtx*)reader->decoder);
+#endif
+	reader->decoder = NULL;
+	if(reader->file) fclose(reader->file);
+	reader->file = NULL;
+	free(reader->input);
+	reader->input = NULL;
+}
+
+#ifdef HAVE_ZSTD
+/* Decompress up to size bytes. Returns the number of bytes, 0 at the end, -1 on an error. */
+static long blockReaderFillZstd(blockReader *reader, char *block, int size) {
+	ZSTD_inBuffer in;
+	ZSTD_outBuffer out;
+	size_t before, result;
+
+	out.dst = block;
+	out.size = size;
+	out.pos = 0;
+	while(out.pos < out.size) {
+		if(reader->inputpos == reader->inputsize && !reader->inputend) {
+			reader->inputsize = (long)fread(reader->input, 1, ZSTD_DStreamInSize(), reader->file);
+			reader->inputpos = 0;
+			reader->filebytes += reader->inputsize;
+			if(reader->inputsize == 0) reader->inputend = 1;
+		}
+		in.src = reader->input;
+		in.size = reader->inputsize;
+		in.pos = reader->inputpos;
+		before = out.pos;
+		// With no input left, this only flushes what the decoder still holds
+		result = ZSTD_decompressStream((ZSTD_DCtx*)reader->decoder, &out, &in);
+		if(ZSTD_isError(result)) {
+			fprintf(stderr, "Zstandard decompression failed: %s\n", ZSTD_getErrorName(result));
+			return -1;
+		}
+		// A call that did nothing says what the next frame would need, not whether the last one ended
+		if(out.pos != before || (long)in.pos != reader->inputpos) reader->lastresult = result;
+		reader->inputpos = (long)in.pos;
+		if(reader->inputend && out.pos == before) {
+			if(reader->lastresult != 0) {
+				fprintf(stderr, "Zstandard file is truncated: %s\n", reader->filename);
+				return -1;
+			}
+			break;
+		}
+	}
+	return (long)out.pos;
+}
+#endif
+
+/* Fill one block from the file. Returns the number of bytes, 0 at the end, -1 on an error. */
+static long blockReaderFill(blockReader *reader, char *block, int size) {
+	long n;
+#ifdef HAVE_ZLIB
+	int zerror;
+#endif
+
+	switch(reader->format) {
+#ifdef HAVE_ZLIB
+	case BLOCKREADER_GZIP:
+		n = gzread((gzFile)reader->decoder, block, (unsigned)size);
+		// A truncated file is not an error to gzread(), only to gzerror()
+		gzerror((gzFile)reader->decoder, &zerror);
+		if(n < 0 || zerror != Z_OK) {
+			fprintf(stderr, "gzip decompression failed: %s\n", gzerror((gzFile)reader->decoder, &zerror));
+			return -1;
+		}
+		reader->filebytes = (long)gzoffset((gzFile)reader->decoder);
+		return n;
+#endif
+#ifdef HAVE_ZSTD
+	case BLOCKREADER_ZSTD:
+		return blockReaderFillZstd(reader, block, size);
+#endif
+	default:
+		n = (long)fread(block, 1, size, reader->file);
+		reader->filebytes += n;
+		if(n == 0 && ferror(reader->file)) {
+			fprintf(stderr, "Cannot read file: %s\n", reader->filename);
+			return -1;
+		}
+		return n;
+	}
+}
+
+/* The reader thread: fill blocks until the end of the file, or until told to stop */
+static void *blockReaderMain(void *data) {
+	blockReader *reader = (blockReader*)data;
+	int slot;
+	long n;
+
+	TRACE_THREAD_NAME("blockReader");
+	for(;;) {
+		pthread_mutex_lock(&reader->lock);
+		while(reader->count == BLOCKREADER_BLOCKS && !reader->stop)
+			pthread_cond_wait(&reader->emptied, &reader->lock);
+		if(reader->stop) {
+			pthread_mutex_unlock(&reader->lock);
+			break;
+		}
+		slot = (reader->head + reader->count) % BLOCKREADER_BLOCKS;
+		pthread_mutex_unlock(&reader->lock);
+
+		// The slot is not the parser's, so it can be filled without the lock
+		TRACE_BEGIN("fill");
+		n = blockReaderFill(reader, reader->blocks[slot], BLOCKREADER_BLOCKSIZE);
+		TRACE_END();
+
+		pthread_mutex_lock(&reader->lock);
+		if(n <= 0) {
+			reader->done = 1;
+			reader->error = (n < 0);
+		}
+		else {
+			reader->sizes[slot] = (int)n;
+			reader->bytes += n;
+			reader->count++;
+		}
+		pthread_cond_signal(&reader->filled);
+		pthread_mutex_unlock(&reader->lock);
+		if(n <= 0) break;
+	}
+	return NULL;
+}
+
+/*
+ * blockReaderOpen() - open a file, see what format it is in, and start
+ * the reader thread. Returns 1 on success.
+ */
+int blockReaderOpen(blockReader *reader, const char *filename) {
+	unsigned char magic[4] = {0, 0, 0, 0};
+	int i;
+
+	memset(reader, 0, sizeof(blockReader));
+	reader->filename = filename;
+	reader->file = fopen(filename, "rb");
+	if(!reader->file) {
+		fprintf(stderr, "Cannot open file: %s\n", filename);
+		return 0;
+	}
+	if(fread(magic, 1, 4, reader->file) < 2) magic[0] = 0;
+	rewind(reader->file);
+
+	if(magic[0] == 0x1f && magic[1] == 0x8b) {
+#ifdef HAVE_ZLIB
+		reader->format = BLOCKREADER_GZIP;
+		fclose(reader->file); // zlib reads the file itself
+		reader->file = NULL;
+		reader->decoder = gzopen(filename, "rb");
+		if(reader->decoder) gzbuffer((gzFile)reader->decoder, 128*1024);
+#else
+		fprintf(stderr, "Built without zlib, cannot read gzip file: %s\n", filename);
+		blockReaderCloseFile(reader);
+		return 0;
+#endif
+	}
+	else if(magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+#ifdef HAVE_ZSTD
+		reader->format = BLOCKREADER_ZSTD;
+		reader->decoder = ZSTD_createDCtx();
+		reader->input = (unsigned char*)malloc(ZSTD_DStreamInSize());
+		if(!reader->input) {
+			ZSTD_freeDCtx((ZSTD_DCtx*)reader->decoder);
+			reader->decoder = NULL;
+		}
+#else
+		fprintf(stderr, "Built without libzstd, cannot read Zstandard file: %s\n", filename);
+		blockReaderCloseFile(reader);
+		return 0;
+#endif
+	}
+	else reader->format = BLOCKREADER_PLAIN;
+	if(reader->format != BLOCKREADER_PLAIN && !reader->decoder) {
+		fprintf(stderr, "Cannot start decompressing: %s\n", filename);
+		blockReaderCloseFile(reader);
+		return 0;
+	}
+
+	for(i = 0; i < BLOCKREADER_BLOCKS; i++) {
+		reader->blocks[i] = (char*)malloc(BLOCKREADER_BLOCKSIZE);
+		if(!reader->blocks[i]) {
+			fprintf(stderr, "blockReaderOpen: out of memory.\n");
+			while(i-- > 0) free(reader->blocks[i]);
+			blockReaderCloseFile(reader);
+			return 0;
+		}
+	}
+	pthread_mutex_init(&reader->lock, NULL);
+	pthread_cond_init(&reader->filled, NULL);
+	pthread_cond_init(&reader->emptied, NULL);
+	if(pthread_create(&reader->thread, NULL, blockReaderMain, reader) != 0) {
+		fprintf(stderr, "Cannot start reader thread: %s\n", filename);
+		pthread_mutex_destroy(&reader->lock);
+		pthread_cond_destroy(&reader->filled);
+		pthread_cond_destroy(&reader->emptied);
+		for(i = 0; i < BLOCKREADER_BLOCKS; i++) free(reader->blocks[i]);
+		blockReaderCloseFile(reader);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * blockReaderNext() - give the block from the last call back to the
+ * reader thread, and wait for the next one. Returns NULL at the end of
+ * the file, or if it could not be read; reader->error tells which.
+ */
+const char *blockReaderNext(blockReader *reader, int *size) {
+	const char *block = NULL;
+
+	pthread_mutex_lock(&reader->lock);
+	if(reader->taken) {
+		reader->head = (reader->head + 1) % BLOCKREADER_BLOCKS;
+		reader->count--;
+		reader->taken = 0;
+		pthread_cond_signal(&reader->emptied);
+	}
+	while(reader->count == 0 && !reader->done)
+		pthread_cond_wait(&reader->filled, &reader->lock);
+	if(reader->count > 0) {
+		block = reader->blocks[reader->head];
+		*size = reader->sizes[reader->head];
+		reader->taken = 1;
+	}
+	pthread_mutex_unlock(&reader->lock);
+	if(!block) *size = 0;
+	return block;
+}
+
+/*
+ * blockReaderClose() - stop the reader thread, also in the middle of the
+ * file, and free everything. Returns 1 if the whole file was read.
+ */
+int blockReaderClose(blockReader *reader) {
+	int complete, i;
+
+	pthread_mutex_lock(&reader->lock);
+	reader->stop = 1;
+	pthread_cond_signal(&reader->emptied);
+	pthread_mutex_unlock(&reader->lock);
+	pthread_join(reader->thread, NULL);
+	complete = reader->done && !reader->error;
+
+	pthread_mutex_destroy(&reader->lock);
+	pthread_cond_destroy(&reader->filled);
+	pthread_cond_destroy(&reader->emptied);
+	for(i = 0; i < BLOCKREADER_BLOCKS; i++) {
+		free(reader->blocks[i]);
+		reader->blocks[i] = NULL;
+	}
+	blockReaderCloseFile(reader);
+	return complete;
+}
@@ -0,0 +1,388 @@
+/* bundle.c */
+/* One packed file with all the meshes, textures and shaders, made offline by the cook tool */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// In Linux, tell GLFW to include the modern OpenGL functions.
+#ifdef __linux__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <GLFW/glfw3.h>
+
+#ifdef __WIN32__
+#include <GL/glext.h>
+#endif
+
+#include "tnm084.h" // To be able to use OpenGL extensions below
+#include "triangleSoup.h"
+#include "tgaloader.h"
+#include "bundle.h"
+#include "lz4Block.h"
+#include "startup.h"
+#include "resources.h"
+#include "trace.h"
+
+
+/*
+ * bundleOpen() - map a bundle file and check that the header and every
+ * entry in the table of contents lie within the file
+ */
+int bundleOpen(bundle *b, const char *filename) {
+	const bundleHeader *header;
+	int i;
+
+	TRACE_ZONE("bundleOpen");
+	b->entries = NULL;
+	b->unpacked = NULL;
+	b->count = 0;
+	startupBegin("bundleOpen", filename, STARTUP_IO);
+	if(!mappedFileOpen(&b->file, filename)) {
+		startupEnd(0);
+		printError("Cannot open bundle", filename);
+		return 0;
+	}
+	startupEnd(0); // Nothing is read yet, the pages come in as they are used
+
+	header = (const bundleHeader*)b->file.data;
+	if(b->file.size < (long long)sizeof(bundleHeader) || memcmp(header->magic, BUNDLE_MAGIC, 4)
+		|| header->version != BUNDLE_VERSION || header->count < 0 || header->tocoffset < 0
+		|| header->tocoffset + header->count * (long long)sizeof(bundleEntry) > b->file.size) {
+		printError("Not a valid bundle", filename);
+		bundleClose(b);
+		return 0;
+	}
+	b->entries = (const bundleEntry*)(b->file.data + header->tocoffset);
+	b->count = header->count;
+	for(i = 0; i < b->count; i++) {
+		const bundleEntry *e = &b->entries[i];
+		if(e->offset < 0 || e->size < 0 || e->rawsize < 0 || e->offset + e->size > b->file.size
+			|| memchr(e->name, 0, BUNDLE_NAMESIZE) == NULL
+			|| (e->compression == BUNDLE_RAW && e->rawsize != e->size)) {
+			printError("Corrupt bundle table of contents", filename);
+			bundleClose(b);
+			return 0;
+		}
+	}
+	b->unpacked = (void**)calloc(b->count > 0 ? b->count : 1, sizeof(void*));
+	if(!b->unpacked) {
+		printError("Memory error", "bundleOpen");
+		bundleClose(b);
+		return 0;
+	}
+	return 1;
+}
+
+/* Unmap the file and free the decompressed blobs */
+void bundleClose(bundle *b) {
+	int i;
+
+	if(b->unpacked) {
+		for(i = 0; i < b->count; i++) free(b->unpacked[i]);
+		free(b->unpacked);
+	}
+	b->unpacked = NULL;
+	mappedFileClose(&b->file);
+	b->entries = NULL;
+	b->count = 0;
+}
+
+/* Look up a resource by name, or return NULL */
+const bundleEntry *bundleFind(const bundle *b, const char *name) {
+	int i;
+
+	for(i = 0; i < b->count; i++) {
+		if(!strcmp(b->entries[i].name, name)) return &b->entries[i];
+	}
+	return NULL;
+}
+
+/* The contents of a blob: in the mapping if stored raw, else decompressed. NULL on error. */
+const void *bundleData(bundle *b, const bundleEntry *entry) {
+	int index = (int)(entry - b->entries);
+	unsigned char *raw;
+
+	if(entry->compression == BUNDLE_RAW) return b->file.data + entry->offset;
+	if(entry->compression != BUNDLE_LZ4 || entry->rawsize > 0x7fffffff || entry->size > 0x7fffffff) return NULL;
+	if(b->unpacked[index]) return b->unpacked[index];
+
+	startupBegin("decompress", entry->name, STARTUP_CPU);
+	raw = (unsigned char*)malloc(entry->rawsize > 0 ? entry->rawsize : 1);
+	if(raw && lz4Decompress(b->file.data + entry->offset, (int)entry->size, raw, (int)entry->rawsize) < 0) {
+		printError("Corrupt compressed data in bundle", entry->name);
+		free(raw);
+		raw = NULL;
+	}
+	startupEnd(raw ? entry->rawsize : 0);
+	b->unpacked[index] = raw;
+	return raw;
+}
+
+/* A shader source, as a 0-terminated string that belongs to the bundle. NULL if missing. */
+const char *bundleShaderSource(bundle *b, const char *name) {
+	const bundleEntry *entry = bundleFind(b, name);
+	const char *source;
+
+	if(!entry || entry->type != BUNDLE_SHADER || entry->rawsize < 1) {
+		printError("Shader not found in bundle", name);
+		return NULL;
+	}
+	source = (const char*)bundleData(b, entry);
+	if(source && source[entry->rawsize - 1] != 0) return NULL; // The cook tool stores the 0
+	return source;
+}
+
+/* Create a GL soup from a mesh in the bundle. Returns 1 on success. */
+int bundleCreateSoup(bundle *b, const char *name, triangleSoup *soup) {
+	const bundleEntry *entry = bundleFind(b, name);
+	const unsigned char *blob;
+	const bundleMesh *mesh;
+	GLfloat bounds[6];
+	int i;
+
+	TRACE_ZONE("bundleCreateSoup");
+	if(!entry || entry->type != BUNDLE_MESH) {
+		printError("Mesh not found in bundle", name);
+		return 0;
+	}
+	blob = (const unsigned char*)bundleData(b, entry);
+	mesh = (const bundleMesh*)blob;
+	if(!blob || entry->rawsize < (long long)sizeof(bundleMesh) || mesh->nverts < 0 || mesh->ntris < 0
+		|| mesh->vertexbytes != SOUP_PACKEDVERTEXBYTES || (mesh->indexbytes != 2 && mesh->indexbytes != 4)
+		|| mesh->vertexoffset < (int)sizeof(bundleMesh) || mesh->indexoffset < (int)sizeof(bundleMesh)
+		|| mesh->vertexoffset + (long long)mesh->nverts * mesh->vertexbytes > entry->rawsize
+		|| mesh->indexoffset + 3LL * mesh->ntris * mesh->indexbytes > entry->rawsize) {
+		printError("Corrupt mesh in bundle", name);
+		return 0;
+	}
+	for(i = 0; i < 6; i++) bounds[i] = mesh->bounds[i];
+	soupCreatePacked(soup, blob + mesh->vertexoffset, mesh->nverts, blob + mesh->indexoffset, mesh->ntris,
+		mesh->indexbytes == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT, bounds, name);
+	return 1;
+}
+
+/*
+ * bundleCreateTexture() - create a GL texture from a texture in the
+ * bundle, uploading the cooked mipmap levels instead of generating them
+ */
+int bundleCreateTexture(bundle *b, const char *name, Texture *texture) {
+	const bundleEntry *entry = bundleFind(b, name);
+	const unsigned char *blob;
+	const bundleTexture *tex;
+	int level, width, height;
+	long bytes = 0, gpubytes = 0;
+	long long expected;
+
+	TRACE_ZONE("bundleCreateTexture");
+	texture->imageData = NULL; // Safe to deleteTexture() even if this fails
+	texture->texID = 0;
+	if(!entry || entry->type != BUNDLE_TEXTURE) {
+		printError("Texture not found in bundle", name);
+		return 0;
+	}
+	blob = (const unsigned char*)bundleData(b, entry);
+	tex = (const bundleTexture*)blob;
+	if(!blob || entry->rawsize < (long long)sizeof(bundleTexture)
+		|| tex->levels < 1 || tex->levels > BUNDLE_MAXLEVELS || tex->width < 1 || tex->height < 1
+		|| (tex->format != BUNDLE_RGB8 && tex->format != BUNDLE_RGBA8 && tex->format != BUNDLE_BC1)) {
+		printError("Corrupt texture in bundle", name);
+		return 0;
+	}
+	// Each level must hold exactly what GL reads for its size, or the upload reads past the blob
+	for(level = 0; level < tex->levels; level++) {
+		width = tex->width >> level;
+		height = tex->height >> level;
+		if(width < 1) width = 1;
+		if(height < 1) height = 1;
+		if(tex->format == BUNDLE_BC1) expected = ((width + 3LL) / 4) * ((height + 3LL) / 4) * 8;
+		else expected = (long long)width * height * (tex->format == BUNDLE_RGBA8 ? 4 : 3);
+		if(tex->offsets[level] < (int)sizeof(bundleTexture) || tex->sizes[level] != expected
+			|| (long long)tex->offsets[level] + tex->sizes[level] > entry->rawsize) {
+			printError("Corrupt texture in bundle", name);
+			return 0;
+		}
+	}
+
+	// BC1 is not core OpenGL, so a BC1 bundle needs a driver with the extension
+	if(tex->format == BUNDLE_BC1 && !glfwExtensionSupported("GL_EXT_texture_compression_s3tc")) {
+		printError("BC1 textures need GL_EXT_texture_compression_s3tc", name);
+		return 0;
+	}
+
+	texture->width = tex->width;
+	texture->height = tex->height;
+	texture->bpp = (tex->format == BUNDLE_RGBA8) ? 32 : 24;
+	texture->type = (tex->format == BUNDLE_RGBA8) ? GL_RGBA : GL_RGB;
+
+	startupBegin("upload", name, STARTUP_UPLOAD);
+	glGenTextures(1, &(texture->texID));
+	glBindTexture(GL_TEXTURE_2D, texture->texID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, tex->levels - 1);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // RGB rows of odd widths are not padded
+	for(level = 0; level < tex->levels; level++) {
+		width = tex->width >> level;
+		height = tex->height >> level;
+		if(width < 1) width = 1;
+		if(height < 1) height = 1;
+		if(tex->format == BUNDLE_BC1) {
+			glCompressedTexImage2D(GL_TEXTURE_2D, level, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, width, height, 0,
+				tex->sizes[level], blob + tex->offsets[level]);
+			gpubytes += tex->sizes[level];
+		}
+		else {
+			glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0,
+				texture->type, GL_UNSIGNED_BYTE, blob + tex->offsets[level]);
+			gpubytes += (long)width * height * 4;
+		}
+		bytes += tex->sizes[level];
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if(startupSyncGPU()) glFinish();
+	startupEnd(bytes);
+
+	resourceTrack(RESOURCE_TEXTURE, texture, name, 0, gpubytes);
+	return 1;
+}
+
+/* Print the table of contents */
+void bundlePrintInfo(const bundle *b) {
+	static const char *types[] = { "?", "mesh", "texture", "shader" };
+	int i;
+
+	printf("Bundle: %d resources, %.2f MB\n", b->count, b->file.size / 1048576.0);
+	for(i = 0; i < b->count; i++) {
+		const bundleEntry *e = &b->entries[i];
+		printf("  %-24s %-8s %10lld bytes", e->name, (e->type >= 1 && e->type <= 3) ? types[e->type] : types[0],
+			e->rawsize);
+		if(e->compression == BUNDLE_LZ4) printf(", LZ4 %10lld bytes (%.1f%%)", e->size,
+			e->rawsize > 0 ? 100.0 * e->size / e->rawsize : 0.0);
+		printf("\n");
+	}
+}
+
+/* Write zeros up to the next multiple of BUNDLE_ALIGN */
+static int bundleWriterPad(bundleWriter *w) {
+	static const unsigned char zeros[BUNDLE_ALIGN] = { 0 };
+	int pad = (int)((BUNDLE_ALIGN - w->offset % BUNDLE_ALIGN) % BUNDLE_ALIGN);
+
+	if(pad > 0 && fwrite(zeros, 1, pad, w->file) != (size_t)pad) return 0;
+	w->offset += pad;
+	return 1;
+}
+
+/* Start writing a bundle. With compress set, every blob is tried with LZ4. */
+int bundleWriterOpen(bundleWriter *w, const char *filename, int compress) {
+	bundleHeader header;
+
+	w->filename = filename;
+	w->entries = NULL;
+	w->count = 0;
+	w->capacity = 0;
+	w->compress = compress;
+	w->rawbytes = 0;
+	w->storedbytes = 0;
+	w->file = fopen(filename, "wb");
+	if(w->file == NULL) {
+		printError("Cannot write bundle", filename);
+		return 0;
+	}
+	// A placeholder, rewritten with the real count and offset at the end
+	memset(&header, 0, sizeof(header));
+	if(fwrite(&header, sizeof(header), 1, w->file) != 1) {
+		printError("Error writing bundle", filename);
+		return 0;
+	}
+	w->offset = sizeof(header);
+	return 1;
+}
+
+/*
+ * bundleWriterAdd() - add a blob, LZ4 compressed if that is switched
+ * on and saves at least an eighth, and remember it for the table
+ */
+int bundleWriterAdd(bundleWriter *w, const char *name, int type, const void *data, long long size) {
+	bundleEntry *entry;
+	unsigned char *packed = NULL;
+	int i, packedsize = 0;
+
+	for(i = 0; i < w->count; i++) {
+		if(!strcmp(w->entries[i].name, name)) {
+			printError("Bundle resource name is already used", name);
+			return 0;
+		}
+	}
+	if(strlen(name) >= BUNDLE_NAMESIZE) {
+		printError("Bundle resource name is too long", name);
+		return 0;
+	}
+	if(w->count == w->capacity) {
+		int capacity = w->capacity ? 2 * w->capacity : 16;
+		bundleEntry *entries = (bundleEntry*)realloc(w->entries, capacity * sizeof(bundleEntry));
+		if(!entries) {
+			printError("Memory error", "bundleWriterAdd");
+			return 0;
+		}
+		w->entries = entries;
+		w->capacity = capacity;
+	}
+	if(!bundleWriterPad(w)) return 0;
+
+	entry = &w->entries[w->count];
+	memset(entry, 0, sizeof(bundleEntry));
+	strcpy(entry->name, name);
+	entry->type = type;
+	entry->offset = w->offset;
+	entry->rawsize = size;
+	entry->compression = BUNDLE_RAW;
+	entry->size = size;
+
+	if(w->compress && size > 0 && size < 0x7fff0000) {
+		packed = (unsigned char*)malloc(lz4CompressBound((int)size));
+		if(packed) packedsize = lz4Compress((const unsigned char*)data, (int)size, packed,
+			lz4CompressBound((int)size));
+		if(packedsize > 0 && packedsize < size - size / 8) {
+			entry->compression = BUNDLE_LZ4;
+			entry->size = packedsize;
+			data = packed;
+		}
+	}
+	if(fwrite(data, 1, (size_t)entry->size, w->file) != (size_t)entry->size) {
+		printError("Error writing bundle", w->filename);
+		free(packed);
+		return 0;
+	}
+	free(packed);
+	w->offset += entry->size;
+	w->rawbytes += entry->rawsize;
+	w->storedbytes += entry->size;
+	w->count++;
+	return 1;
+}
+
+/* Write the table of contents and close the file. Returns 1 on success. */
+int bundleWriterClose(bundleWriter *w) {
+	bundleHeader header;
+	int ok;
+
+	ok = bundleWriterPad(w);
+	memcpy(header.magic, BUNDLE_MAGIC, 4);
+	header.version = BUNDLE_VERSION;
+	header.count = w->count;
+	header.reserved = 0;
+	header.tocoffset = w->offset;
+	ok = ok && fwrite(w->entries, sizeof(bundleEntry), w->count, w->file) == (size_t)w->count
+		&& fseek(w->file, 0, SEEK_SET) == 0
+		&& fwrite(&header, sizeof(header), 1, w->file) == 1;
+	ok = (fclose(w->file) == 0) && ok;
+	if(!ok) printError("Error writing bundle", w->filename);
+	free(w->entries);
+	w->entries = NULL;
+	w->file = NULL;
+	return ok;
+}
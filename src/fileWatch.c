@@ -0,0 +1,69 @@
+/* fileWatch.c */
+/* Notice when files on disk change, for reloading them while the program runs */
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "fileWatch.h"
+
+/* Read the modification time and size of a file. A missing file gets zeros. */
+static void fileWatchStat(const char *path, time_t *mtime, long *size) {
+	struct stat info;
+
+	if(stat(path, &info) == 0) {
+		*mtime = info.st_mtime;
+		*size = (long)info.st_size;
+	}
+	else {
+		*mtime = 0;
+		*size = 0;
+	}
+}
+
+/* Start with no files */
+void fileWatchInit(fileWatch *watch) {
+	watch->nfiles = 0;
+	watch->unsettled = 0;
+}
+
+/* Watch one more file. Returns 0 if there is no room for it. */
+int fileWatchAdd(fileWatch *watch, const char *path) {
+	int i = watch->nfiles;
+
+	if(i >= FILEWATCH_MAXFILES) {
+		fprintf(stderr, "fileWatch: cannot watch more than %d files\n", FILEWATCH_MAXFILES);
+		return 0;
+	}
+	watch->paths[i] = path;
+	fileWatchStat(path, &watch->mtimes[i], &watch->sizes[i]);
+	watch->nfiles++;
+	return 1;
+}
+
+/*
+ * fileWatchChanged() - returns 1 once after any watched file has
+ * changed, when it has looked the same for a whole check interval
+ */
+int fileWatchChanged(fileWatch *watch) {
+	time_t mtime;
+	long size;
+	int i, changed = 0;
+
+	for(i = 0; i < watch->nfiles; i++) {
+		fileWatchStat(watch->paths[i], &mtime, &size);
+		if(mtime != watch->mtimes[i] || size != watch->sizes[i]) {
+			watch->mtimes[i] = mtime;
+			watch->sizes[i] = size;
+			changed = 1;
+		}
+	}
+	if(changed) {
+		watch->unsettled = 1; // Still being written, perhaps
+		return 0;
+	}
+	if(watch->unsettled) {
+		watch->unsettled = 0;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,126 @@
+/* framePacer.c */
+/* Cap the frame rate by sleeping, instead of rendering frames nobody sees */
+
+#include <stdio.h>
+#include <math.h>
+
+#include "framePacer.h"
+#include "timer.h"
+#include "trace.h"
+
+#define FRAMEPACER_SPINMARGIN 0.0002  // Seconds of spinning planned after each sleep
+#define FRAMEPACER_OVERSHOOT 0.001    // First guess at the sleep overshoot
+#define FRAMEPACER_SAFETY 2.0         // Deviations added to the predicted frame cost
+
+
+/* Start pacing at targetfps frames per second, or just measure if it is 0 */
+void framePacerInit(framePacer *pacer, double targetfps) {
+	pacer->period = (targetfps > 0.0) ? 1.0 / targetfps : 0.0;
+	pacer->costmean = 0.0;
+	pacer->costdev = 0.0;
+	pacer->overshoot = FRAMEPACER_OVERSHOOT;
+	framePacerReset(pacer);
+}
+
+/* Start the measurement over, e.g. after a warmup */
+void framePacerReset(framePacer *pacer) {
+	pacer->frames = 0;
+	pacer->missed = 0;
+	pacer->slept = 0.0;
+	pacer->spun = 0.0;
+	pacer->worktime = 0.0;
+	pacer->workcputime = 0.0;
+	pacer->wallstart = timerSeconds();
+	pacer->cpustart = timerCPUSeconds();
+	pacer->deadline = pacer->wallstart + pacer->period;
+	pacer->workstart = pacer->wallstart;
+	pacer->workcpu = pacer->cpustart;
+}
+
+/*
+ * framePacerWait() - sleep, then spin, until the latest time the next
+ * frame can start and still be done by its deadline
+ */
+void framePacerWait(framePacer *pacer) {
+	double now = timerSeconds(), start, sleep, t0, late;
+
+	if(pacer->period > 0.0) {
+		start = pacer->deadline - (pacer->costmean + FRAMEPACER_SAFETY * pacer->costdev);
+		if(start > now) {
+			TRACE_ZONE("pacing");
+			sleep = start - now - pacer->overshoot - FRAMEPACER_SPINMARGIN;
+			if(sleep > 0.0) {
+				t0 = now;
+				timerSleep(sleep);
+				now = timerSeconds();
+				pacer->slept += now - t0;
+				// Adapt quickly to longer overshoots, slowly to shorter ones
+				late = (now - t0) - sleep;
+				if(late < 0.0) late = 0.0;
+				pacer->overshoot += ((late > pacer->overshoot) ? 0.5 : 0.05) * (late - pacer->overshoot);
+			}
+			t0 = now;
+			while(now < start) now = timerSeconds();
+			pacer->spun += now - t0;
+		}
+	}
+	pacer->workstart = now;
+	pacer->workcpu = timerCPUSeconds();
+}
+
+/* The frame's work is done (after the swap). Updates the prediction and the deadline. */
+void framePacerFrameDone(framePacer *pacer) {
+	double now = timerSeconds(), cost = now - pacer->workstart;
+
+	pacer->worktime += cost;
+	pacer->workcputime += timerCPUSeconds() - pacer->workcpu;
+	if(pacer->frames++ == 0 && pacer->costmean == 0.0) pacer->costmean = cost;
+	else {
+		pacer->costdev += 0.1 * (fabs(cost - pacer->costmean) - pacer->costdev);
+		pacer->costmean += 0.1 * (cost - pacer->costmean);
+	}
+
+	if(pacer->period > 0.0) {
+		if(now > pacer->deadline) pacer->missed++;
+		pacer->deadline += pacer->period;
+		// More than a whole frame behind: start a new cadence instead of catching up
+		if(pacer->deadline < now) pacer->deadline = now + pacer->period;
+	}
+}
+
+/* CPU use of the calling thread since the start, as a fraction of one core */
+double framePacerUtilization(const framePacer *pacer) {
+	double wall = timerSeconds() - pacer->wallstart;
+	return (wall > 0.0) ? (timerCPUSeconds() - pacer->cpustart) / wall : 0.0;
+}
+
+/* CPU use while working, which is what an uncapped loop would use all the time */
+double framePacerUncappedUtilization(const framePacer *pacer) {
+	return (pacer->worktime > 0.0) ? pacer->workcputime / pacer->worktime : 0.0;
+}
+
+/* Print the pacing statistics to the console */
+void framePacerPrint(const framePacer *pacer) {
+	double used = framePacerUtilization(pacer), uncapped = framePacerUncappedUtilization(pacer);
+
+	if(pacer->period > 0.0) {
+		printf("Frame pacing: %.1f fps target, %lu frames, %lu late\n", 1.0 / pacer->period,
+			pacer->frames, pacer->missed);
+	}
+	else printf("Frame pacing: uncapped, %lu frames\n", pacer->frames);
+	printf("  CPU use %.1f%% of a core, %.1f%% uncapped, %.1f%% saved\n", 100.0 * used,
+		100.0 * uncapped, 100.0 * (uncapped - used));
+	printf("  %.1f ms asleep, %.1f ms spinning, sleep overshoot %.3f ms, frame cost %.3f +- %.3f ms\n",
+		1000.0 * pacer->slept, 1000.0 * pacer->spun, 1000.0 * pacer->overshoot,
+		1000.0 * pacer->costmean, 1000.0 * pacer->costdev);
+}
+
+/* Print the pacing statistics as a JSON object */
+void framePacerPrintJSON(FILE *file, const framePacer *pacer) {
+	fprintf(file, "{\"target_fps\": %.3f, \"frames\": %lu, \"late\": %lu, \"cpu_utilization\": %.4f, "
+		"\"uncapped_utilization\": %.4f, \"slept_ms\": %.3f, \"spun_ms\": %.3f, \"overshoot_ms\": %.4f, "
+		"\"predicted_cost_ms\": %.4f}",
+		pacer->period > 0.0 ? 1.0 / pacer->period : 0.0, pacer->frames, pacer->missed,
+		framePacerUtilization(pacer), framePacerUncappedUtilization(pacer),
+		1000.0 * pacer->slept, 1000.0 * pacer->spun, 1000.0 * pacer->overshoot, 1000.0 * pacer->costmean);
+}
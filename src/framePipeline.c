@@ -0,0 +1,82 @@
+/* framePipeline.c */
+/* Bound the number of frames the GPU may lag behind the CPU, with fences */
+
+#include <stdio.h>
+
+// In Linux, tell GLFW to include the modern OpenGL functions.
+#ifdef __linux__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <GLFW/glfw3.h>
+
+#ifdef __WIN32__
+#include <GL/glext.h>
+#endif
+
+#include "tnm084.h" // To be able to use OpenGL extensions below
+#include "timer.h"
+#include "trace.h"
+#include "framePipeline.h"
+
+#define FRAMEPIPELINE_TIMEOUT 1000000000ULL // Nanoseconds before a wait is reported as stuck
+
+
+/* Set up for at most inflight frames in flight. Requires a current GL context. */
+void framePipelineInit(framePipeline *pipeline, int inflight) {
+	int i;
+
+	if(inflight < 1) inflight = 1;
+	if(inflight > FRAMEPIPELINE_MAXINFLIGHT) inflight = FRAMEPIPELINE_MAXINFLIGHT;
+	pipeline->inflight = inflight;
+	for(i=0; i<FRAMEPIPELINE_MAXINFLIGHT; i++) pipeline->fences[i] = NULL;
+	pipeline->frame = 0;
+	pipeline->waited = 0.0;
+	pipeline->stalls = 0;
+}
+
+/* Delete the fences that are left */
+void framePipelineDelete(framePipeline *pipeline) {
+	int i;
+
+	for(i=0; i<FRAMEPIPELINE_MAXINFLIGHT; i++) {
+		if(pipeline->fences[i]) glDeleteSync(pipeline->fences[i]);
+		pipeline->fences[i] = NULL;
+	}
+}
+
+/*
+ * framePipelineBeginFrame() - wait for the frame that was begun
+ * inflight frames ago, whose fence is in the slot we are about to reuse
+ */
+void framePipelineBeginFrame(framePipeline *pipeline) {
+	int slot = (int)(pipeline->frame % pipeline->inflight);
+	GLsync fence = pipeline->fences[slot];
+	double t0;
+	GLenum result;
+
+	pipeline->frame++;
+	if(fence == NULL) return;
+	result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	if(result == GL_TIMEOUT_EXPIRED) {
+		TRACE_ZONE("fence wait");
+		t0 = timerSeconds();
+		do {
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FRAMEPIPELINE_TIMEOUT);
+			if(result == GL_TIMEOUT_EXPIRED) fprintf(stderr, "framePipelineBeginFrame: still waiting for the GPU.\n");
+		} while(result == GL_TIMEOUT_EXPIRED);
+		pipeline->waited += timerSeconds() - t0;
+		pipeline->stalls++;
+	}
+	if(result == GL_WAIT_FAILED) fprintf(stderr, "framePipelineBeginFrame: glClientWaitSync() failed.\n");
+	glDeleteSync(fence);
+	pipeline->fences[slot] = NULL;
+}
+
+/* Put a fence after the commands of the frame */
+void framePipelineEndFrame(framePipeline *pipeline) {
+	int slot = (int)((pipeline->frame + pipeline->inflight - 1) % pipeline->inflight);
+
+	if(pipeline->fences[slot]) glDeleteSync(pipeline->fences[slot]);
+	pipeline->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
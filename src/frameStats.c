@@ -0,0 +1,258 @@
+/* frameStats.c */
+/* Frame time statistics with percentiles, hitch counting and CSV/JSON export */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frameStats.h"
+
+/*
+ * histogramBucket() - find the bucket for a duration in whole microseconds.
+ * Values below HISTOGRAM_SUBBUCKETS get one bucket each. Above that,
+ * every power of two is split into HISTOGRAM_SUBBUCKETS equal parts,
+ * which keeps the relative error below 1/HISTOGRAM_SUBBUCKETS everywhere.
+ */
+static int histogramBucket(unsigned long long us) {
+	int msb, major, sub;
+
+	if(us < HISTOGRAM_SUBBUCKETS) return (int)us;
+	msb = 0;
+	while((us >> msb) > 1) msb++; // Index of the highest set bit, at least 4
+	major = msb - 3;
+	if(major >= HISTOGRAM_MAJORBUCKETS) return HISTOGRAM_MAJORBUCKETS*HISTOGRAM_SUBBUCKETS - 1;
+	sub = (int)(us >> (msb - 4)) - HISTOGRAM_SUBBUCKETS;
+	return major*HISTOGRAM_SUBBUCKETS + sub;
+}
+
+/*
+ * histogramBucketMiddle() - the midpoint of a bucket, in milliseconds
+ */
+static double histogramBucketMiddle(int bucket) {
+	int major = bucket / HISTOGRAM_SUBBUCKETS;
+	int sub = bucket % HISTOGRAM_SUBBUCKETS;
+	double lower, width;
+
+	if(major == 0) {
+		lower = sub;
+		width = 1.0;
+	}
+	else {
+		width = (double)(1ULL << (major - 1));
+		lower = (HISTOGRAM_SUBBUCKETS + sub) * width;
+	}
+	return 0.001 * (lower + 0.5*width);
+}
+
+/* Clear a histogram */
+void histogramInit(histogram *h) {
+	memset(h->counts, 0, sizeof(h->counts));
+	h->total = 0;
+	h->sum = 0.0;
+	h->min = 0.0;
+	h->max = 0.0;
+}
+
+/* Add a duration (in milliseconds) to a histogram */
+void histogramRecord(histogram *h, double ms) {
+	if(ms < 0.0) ms = 0.0;
+	h->counts[histogramBucket((unsigned long long)(ms * 1000.0))]++;
+	if(h->total == 0 || ms < h->min) h->min = ms;
+	if(h->total == 0 || ms > h->max) h->max = ms;
+	h->total++;
+	h->sum += ms;
+}
+
+/*
+ * histogramPercentile() - estimate a percentile from the bucket counts.
+ * The result is the midpoint of the bucket holding the requested rank,
+ * clamped to the exact min and max so p=0 and p=1 are exact.
+ */
+double histogramPercentile(const histogram *h, double p) {
+	unsigned long rank, cumulative;
+	int i;
+	double value;
+
+	if(h->total == 0) return 0.0;
+	if(p <= 0.0) return h->min;
+	if(p >= 1.0) return h->max;
+	rank = (unsigned long)(p * h->total + 0.5);
+	if(rank < 1) rank = 1;
+	cumulative = 0;
+	for(i=0; i<HISTOGRAM_MAJORBUCKETS*HISTOGRAM_SUBBUCKETS; i++) {
+		cumulative += h->counts[i];
+		if(cumulative >= rank) break;
+	}
+	value = histogramBucketMiddle(i);
+	if(value < h->min) value = h->min;
+	if(value > h->max) value = h->max;
+	return value;
+}
+
+/* Mean of all recorded values, in milliseconds */
+double histogramMean(const histogram *h) {
+	return h->total ? h->sum / h->total : 0.0;
+}
+
+/* Print mean, p50/p95/p99 and max of a histogram as a JSON object */
+void histogramPrintJSON(FILE *file, const histogram *h) {
+	fprintf(file, "{\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f}",
+		histogramMean(h), histogramPercentile(h, 0.50), histogramPercentile(h, 0.95),
+		histogramPercentile(h, 0.99), h->max);
+}
+
+
+/* Initialize a frameStats object and allocate its sample ring */
+void frameStatsInit(frameStats *stats) {
+	stats->ring = (frameSample*)malloc(FRAMESTATS_RINGSIZE * sizeof(frameSample));
+	if(stats->ring == NULL) {
+		fprintf(stderr, "Could not allocate frame statistics sample ring.\n");
+	}
+	stats->frames = 0;
+	stats->hitches = 0;
+	histogramInit(&stats->wall);
+	histogramInit(&stats->cpu);
+	histogramInit(&stats->gpu);
+	stats->medianWall = 0.0;
+	stats->lastWall = 0.0;
+	stats->lastCPU = 0.0;
+	stats->started = 0;
+}
+
+/* Free the memory held by a frameStats object */
+void frameStatsDelete(frameStats *stats) {
+	if(stats->ring) {
+		free((void*)stats->ring);
+	}
+	stats->ring = NULL;
+	stats->frames = 0;
+}
+
+/*
+ * frameStatsTick() - record the end of a frame.
+ * The first call only sets the reference timestamps. Every later call
+ * records the time since the previous call as one frame.
+ */
+void frameStatsTick(frameStats *stats, double wallTime, double cpuTime) {
+	double wall, cpu;
+
+	if(!stats->started) {
+		stats->lastWall = wallTime;
+		stats->lastCPU = cpuTime;
+		stats->started = 1;
+		return;
+	}
+	wall = 1000.0 * (wallTime - stats->lastWall);
+	cpu = 1000.0 * (cpuTime - stats->lastCPU);
+	stats->lastWall = wallTime;
+	stats->lastCPU = cpuTime;
+
+	if(stats->ring) {
+		stats->ring[stats->frames % FRAMESTATS_RINGSIZE].wall = wall;
+		stats->ring[stats->frames % FRAMESTATS_RINGSIZE].cpu = cpu;
+		stats->ring[stats->frames % FRAMESTATS_RINGSIZE].gpu = -1.0;
+	}
+	histogramRecord(&stats->wall, wall);
+	histogramRecord(&stats->cpu, cpu);
+
+	// The median moves slowly, so there is no need to recompute it every frame
+	if((stats->frames & 31) == 0) {
+		stats->medianWall = histogramPercentile(&stats->wall, 0.5);
+	}
+	if(stats->frames >= 32 && wall > FRAMESTATS_HITCHFACTOR * stats->medianWall) {
+		stats->hitches++;
+	}
+	stats->frames++;
+}
+
+/*
+ * frameStatsSetGPU() - attach a GPU time to an earlier frame.
+ * GPU timings arrive a few frames late, so they are matched to their
+ * frame by index. Frames that have already left the ring still count
+ * in the histogram.
+ */
+void frameStatsSetGPU(frameStats *stats, unsigned long frame, double ms) {
+	if(stats->ring && frame < stats->frames && stats->frames - frame <= FRAMESTATS_RINGSIZE) {
+		stats->ring[frame % FRAMESTATS_RINGSIZE].gpu = ms;
+	}
+	histogramRecord(&stats->gpu, ms);
+}
+
+/* Print a human readable summary to the console */
+void frameStatsPrint(const frameStats *stats) {
+	printf("Frame statistics: %lu frames, %lu hitches (> %.1f x median)\n",
+		stats->frames, stats->hitches, FRAMESTATS_HITCHFACTOR);
+	printf("          mean      p50      p95      p99      max (ms)\n");
+	printf("wall: %8.3f %8.3f %8.3f %8.3f %8.3f\n", histogramMean(&stats->wall),
+		histogramPercentile(&stats->wall, 0.50), histogramPercentile(&stats->wall, 0.95),
+		histogramPercentile(&stats->wall, 0.99), stats->wall.max);
+	printf("cpu:  %8.3f %8.3f %8.3f %8.3f %8.3f\n", histogramMean(&stats->cpu),
+		histogramPercentile(&stats->cpu, 0.50), histogramPercentile(&stats->cpu, 0.95),
+		histogramPercentile(&stats->cpu, 0.99), stats->cpu.max);
+	if(stats->gpu.total > 0) {
+		printf("gpu:  %8.3f %8.3f %8.3f %8.3f %8.3f\n", histogramMean(&stats->gpu),
+			histogramPercentile(&stats->gpu, 0.50), histogramPercentile(&stats->gpu, 0.95),
+			histogramPercentile(&stats->gpu, 0.99), stats->gpu.max);
+	}
+}
+
+/* Print the summary (and optionally the raw samples) as a JSON object */
+void frameStatsPrintJSON(FILE *file, const frameStats *stats, int withSamples) {
+	unsigned long i, first;
+
+	fprintf(file, "{\"frames\": %lu, \"hitches\": %lu, ", stats->frames, stats->hitches);
+	fprintf(file, "\"wall_ms\": ");
+	histogramPrintJSON(file, &stats->wall);
+	fprintf(file, ", \"cpu_ms\": ");
+	histogramPrintJSON(file, &stats->cpu);
+	if(stats->gpu.total > 0) {
+		fprintf(file, ", \"gpu_ms\": ");
+		histogramPrintJSON(file, &stats->gpu);
+	}
+	if(withSamples && stats->ring) {
+		first = stats->frames > FRAMESTATS_RINGSIZE ? stats->frames - FRAMESTATS_RINGSIZE : 0;
+		fprintf(file, ",\n \"first_sample\": %lu, \"samples\": [", first);
+		for(i=first; i<stats->frames; i++) {
+			fprintf(file, "%s[%.4f, %.4f, %.4f]", (i>first) ? ",\n  " : "\n  ",
+				stats->ring[i % FRAMESTATS_RINGSIZE].wall, stats->ring[i % FRAMESTATS_RINGSIZE].cpu,
+				stats->ring[i % FRAMESTATS_RINGSIZE].gpu);
+		}
+		fprintf(file, "]");
+	}
+	fprintf(file, "}");
+}
+
+/* Write the raw sample series to a CSV file */
+int frameStatsWriteCSV(const frameStats *stats, const char *filename) {
+	FILE *file;
+	unsigned long i, first;
+
+	if(stats->ring == NULL) return 0;
+	file = fopen(filename, "w");
+	if(file == NULL) {
+		fprintf(stderr, "Cannot write frame statistics to %s.\n", filename);
+		return 0;
+	}
+	fprintf(file, "frame,wall_ms,cpu_ms,gpu_ms\n");
+	first = stats->frames > FRAMESTATS_RINGSIZE ? stats->frames - FRAMESTATS_RINGSIZE : 0;
+	for(i=first; i<stats->frames; i++) {
+		fprintf(file, "%lu,%.4f,%.4f,%.4f\n", i,
+			stats->ring[i % FRAMESTATS_RINGSIZE].wall, stats->ring[i % FRAMESTATS_RINGSIZE].cpu,
+			stats->ring[i % FRAMESTATS_RINGSIZE].gpu);
+	}
+	fclose(file);
+	return 1;
+}
+
+/* Write the summary and the raw sample series to a JSON file */
+int frameStatsWriteJSON(const frameStats *stats, const char *filename) {
+	FILE *file = fopen(filename, "w");
+	if(file == NULL) {
+		fprintf(stderr, "Cannot write frame statistics to %s.\n", filename);
+		return 0;
+	}
+	frameStatsPrintJSON(file, stats, 1);
+	fprintf(file, "\n");
+	fclose(file);
+	return 1;
+}
@@ -0,0 +1,381 @@
+/* glb.c */
+/* Meshes from binary glTF 2.0 (.glb) files, uploaded straight from the mapped file */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// In Linux, tell GLFW to include the modern OpenGL functions.
+#ifdef __linux__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <GLFW/glfw3.h>
+
+#ifdef __WIN32__
+#include <GL/glext.h>
+#endif
+
+#include "tnm084.h" // To be able to use OpenGL extensions below
+#include "triangleSoup.h"
+#include "glb.h"
+#include "mappedFile.h"
+#include "json.h"
+#include "startup.h"
+#include "resources.h"
+#include "trace.h"
+
+#define GLB_MAGIC 0x46546C67u  // "glTF"
+#define GLB_VERSION 2
+#define GLB_CHUNK_JSON 0x4E4F534Au
+#define GLB_CHUNK_BIN 0x004E4942u
+#define GLB_MODE_TRIANGLES 4
+
+/* Where an accessor's elements are in the binary chunk, and how GL should read them */
+typedef struct {
+	const unsigned char *data; // First element
+	int count;
+	int components;            // 1 for SCALAR up to 4 for VEC4
+	GLenum type;               // glTF component types are GL enums: GL_FLOAT, GL_UNSIGNED_SHORT, ...
+	int normalized;
+	int elementbytes;          // Bytes in one element
+	int stride;                // Bytes from one element to the next
+	int view;                  // Buffer view index
+	long long start;           // Offset of the first element in the binary chunk
+	long long end;             // Offset just past the last one
+} glbAccessor;
+
+/* Everything about a mesh primitive that is needed to upload it */
+typedef struct {
+	glbAccessor attribute[3];  // POSITION, NORMAL, TEXCOORD_0
+	int present[3];
+	int span[3];               // Which span each attribute is in
+	long long spanstart[3];    // One span of the binary chunk per buffer view used
+	long long spanend[3];
+	long long spanbase[3];     // Where the span goes in the vertex buffer
+	int spanview[3];
+	int nspans;
+	long long vertexbytes;
+	glbAccessor indices;
+	GLuint *generated;         // Indices made here for a mesh without them, or NULL
+	GLfloat bounds[6];
+} glbLayout;
+
+/* An unsigned 32 bit little-endian number at any alignment */
+static unsigned int glbRead32(const unsigned char *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+/* Bytes per component of a glTF component type, or 0 if it is not one */
+static int glbComponentBytes(int type) {
+	switch(type) {
+		case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+		case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+		case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+		default: return 0;
+	}
+}
+
+/*
+ * glbGetAccessor() - look up accessor number index in the JSON, and
+ * check that all of its elements lie within the binary chunk.
+ * Returns 1 on success.
+ */
+static int glbGetAccessor(const jsonValue *root, int index, const unsigned char *bin, long long binsize,
+	glbAccessor *accessor, const char *filename) {
+	const jsonValue *a = jsonIndex(jsonGet(root, "accessors"), index);
+	const jsonValue *view, *buffer;
+	const char *type;
+	long long viewoffset, viewlength, offset;
+	int componentbytes;
+
+	if(!a) {
+		printError("Missing glTF accessor", filename);
+		return 0;
+	}
+	if(jsonGet(a, "sparse")) {
+		printError("Sparse glTF accessors are not supported", filename);
+		return 0;
+	}
+	accessor->view = (int)jsonNumber(jsonGet(a, "bufferView"), -1);
+	accessor->type = (GLenum)jsonNumber(jsonGet(a, "componentType"), 0);
+	accessor->count = (int)jsonNumber(jsonGet(a, "count"), 0);
+	accessor->normalized = (jsonGet(a, "normalized") && jsonGet(a, "normalized")->type == JSON_TRUE);
+	type = jsonString(jsonGet(a, "type"), "");
+	if(!strcmp(type, "SCALAR")) accessor->components = 1;
+	else if(!strcmp(type, "VEC2")) accessor->components = 2;
+	else if(!strcmp(type, "VEC3")) accessor->components = 3;
+	else if(!strcmp(type, "VEC4")) accessor->components = 4;
+	else accessor->components = 0;
+	componentbytes = glbComponentBytes((int)accessor->type);
+
+	// An accessor without a buffer view is all zeros, which no mesh needs
+	view = jsonIndex(jsonGet(root, "bufferViews"), accessor->view);
+	buffer = view ? jsonIndex(jsonGet(root, "buffers"), (int)jsonNumber(jsonGet(view, "buffer"), -1)) : NULL;
+	if(!view || accessor->components == 0 || componentbytes == 0 || accessor->count < 1) {
+		printError("Unsupported glTF accessor", filename);
+		return 0;
+	}
+	// Only the binary chunk is read: a buffer with a uri is in another file
+	if(!buffer || jsonNumber(jsonGet(view, "buffer"), -1) != 0 || jsonGet(buffer, "uri")) {
+		printError("glTF data outside the .glb file is not supported", filename);
+		return 0;
+	}
+
+	viewoffset = (long long)jsonNumber(jsonGet(view, "byteOffset"), 0);
+	viewlength = (long long)jsonNumber(jsonGet(view, "byteLength"), 0);
+	offset = (long long)jsonNumber(jsonGet(a, "byteOffset"), 0);
+	accessor->elementbytes = accessor->components * componentbytes;
+	accessor->stride = (int)jsonNumber(jsonGet(view, "byteStride"), 0);
+	if(accessor->stride == 0) accessor->stride = accessor->elementbytes; // Tightly packed
+	accessor->start = viewoffset + offset;
+	accessor->end = accessor->start + (long long)(accessor->count - 1) * accessor->stride + accessor->elementbytes;
+	if(viewoffset < 0 || viewlength < 0 || offset < 0 || accessor->stride < accessor->elementbytes
+		|| viewoffset + viewlength > binsize || offset + (accessor->end - accessor->start) > viewlength) {
+		printError("glTF accessor is outside its buffer", filename);
+		return 0;
+	}
+	accessor->data = bin + accessor->start;
+	return 1;
+}
+
+/* The largest index in an index accessor */
+static unsigned int glbMaxIndex(const glbAccessor *indices) {
+	unsigned int max = 0, value;
+	int i;
+
+	for(i = 0; i < indices->count; i++) {
+		if(indices->type == GL_UNSIGNED_BYTE) value = indices->data[i];
+		else if(indices->type == GL_UNSIGNED_SHORT) value = indices->data[2*i] | (indices->data[2*i+1] << 8);
+		else value = glbRead32(indices->data + 4*i);
+		if(value > max) max = value;
+	}
+	return max;
+}
+
+/*
+ * glbBounds() - the extents from the "min" and "max" of the POSITION
+ * accessor, which glTF requires. Returns 0 if they are missing.
+ */
+static int glbBounds(const jsonValue *root, int index, GLfloat bounds[6]) {
+	const jsonValue *a = jsonIndex(jsonGet(root, "accessors"), index);
+	const jsonValue *min = jsonGet(a, "min"), *max = jsonGet(a, "max");
+	int i;
+
+	if(!min || !max || min->count < 3 || max->count < 3) return 0;
+	for(i = 0; i < 3; i++) {
+		bounds[2*i] = (GLfloat)jsonNumber(jsonIndex(min, i), 0.0);
+		bounds[2*i+1] = (GLfloat)jsonNumber(jsonIndex(max, i), 0.0);
+	}
+	return 1;
+}
+
+/*
+ * glbGetLayout() - find the first primitive of the first mesh, its
+ * attributes and indices, and the part of the binary chunk that each
+ * buffer view used by the attributes needs. Returns 1 on success.
+ */
+static int glbGetLayout(const jsonValue *root, const unsigned char *bin, long long binsize,
+	glbLayout *layout, const char *filename) {
+	static const char *names[3] = {"POSITION", "NORMAL", "TEXCOORD_0"};
+	const jsonValue *primitive, *attributes;
+	glbAccessor *a;
+	int index[3], i, j;
+
+	layout->generated = NULL;
+	layout->nspans = 0;
+	layout->vertexbytes = 0;
+	primitive = jsonIndex(jsonGet(jsonIndex(jsonGet(root, "meshes"), 0), "primitives"), 0);
+	attributes = jsonGet(primitive, "attributes");
+	if(!primitive || !attributes || jsonNumber(jsonGet(attributes, "POSITION"), -1) < 0) {
+		printError("No mesh with positions in glTF file", filename);
+		return 0;
+	}
+	if((int)jsonNumber(jsonGet(primitive, "mode"), GLB_MODE_TRIANGLES) != GLB_MODE_TRIANGLES) {
+		printError("Only triangle meshes are supported in glTF file", filename);
+		return 0;
+	}
+	// The shaders normalize Normal, which the default (0, 0, 0) would turn into NaN
+	if(jsonNumber(jsonGet(attributes, "NORMAL"), -1) < 0) {
+		printError("glTF mesh has no normals, which the shaders need", filename);
+		return 0;
+	}
+
+	for(i = 0; i < 3; i++) {
+		a = &layout->attribute[i];
+		index[i] = (int)jsonNumber(jsonGet(attributes, names[i]), -1);
+		layout->present[i] = (index[i] >= 0);
+		if(!layout->present[i]) continue;
+		if(!glbGetAccessor(root, index[i], bin, binsize, a, filename)) return 0;
+		if(a->count != layout->attribute[0].count || a->type == GL_UNSIGNED_INT) {
+			printError("Mismatched glTF vertex attributes", filename);
+			return 0;
+		}
+		for(j = 0; j < layout->nspans && layout->spanview[j] != a->view; j++);
+		if(j == layout->nspans) {
+			layout->spanview[j] = a->view;
+			layout->spanstart[j] = a->start;
+			layout->spanend[j] = a->end;
+			layout->nspans++;
+		}
+		if(a->start < layout->spanstart[j]) layout->spanstart[j] = a->start;
+		if(a->end > layout->spanend[j]) layout->spanend[j] = a->end;
+		layout->span[i] = j;
+	}
+	for(j = 0; j < layout->nspans; j++) {
+		layout->spanbase[j] = layout->vertexbytes;
+		// Keep the next span 4 byte aligned, as GL wants attributes to be
+		layout->vertexbytes += (layout->spanend[j] - layout->spanstart[j] + 3) & ~3LL;
+	}
+
+	a = &layout->indices;
+	if(jsonGet(primitive, "indices")) {
+		if(!glbGetAccessor(root, (int)jsonNumber(jsonGet(primitive, "indices"), -1), bin, binsize, a, filename))
+			return 0;
+		if(a->components != 1 || a->stride != a->elementbytes || a->count % 3 != 0
+			|| (a->type != GL_UNSIGNED_BYTE && a->type != GL_UNSIGNED_SHORT && a->type != GL_UNSIGNED_INT)
+			|| glbMaxIndex(a) >= (unsigned int)layout->attribute[0].count) {
+			printError("Invalid glTF indices", filename);
+			return 0;
+		}
+	}
+	else {
+		// Three vertices per triangle. A soup is drawn with an index buffer, so make one.
+		a->count = layout->attribute[0].count;
+		if(a->count % 3 != 0 || !(layout->generated = (GLuint*)malloc(a->count * sizeof(GLuint)))) {
+			printError("Cannot index glTF mesh", filename);
+			return 0;
+		}
+		for(i = 0; i < a->count; i++) layout->generated[i] = i;
+		a->type = GL_UNSIGNED_INT;
+		a->elementbytes = sizeof(GLuint);
+		a->data = (const unsigned char*)layout->generated;
+	}
+
+	if(!glbBounds(root, index[0], layout->bounds)) {
+		printError("glTF positions have no min and max", filename);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * glbUpload() - create the GL buffers from the binary chunk as it is,
+ * and point the attributes at the accessors within them
+ */
+static void glbUpload(triangleSoup *soup, const glbLayout *layout, const unsigned char *bin, const char *filename) {
+	const glbAccessor *a;
+	long long indexbytes = (long long)layout->indices.count * layout->indices.elementbytes;
+	int i, j;
+
+	soup->nverts = layout->attribute[0].count;
+	soup->ntris = layout->indices.count / 3;
+	soup->indextype = layout->indices.type;
+	soup->vertexbytes = 0;
+	for(i = 0; i < 3; i++) if(layout->present[i]) soup->vertexbytes += layout->attribute[i].elementbytes;
+	soup->residency = SOUP_RELEASE;
+	for(i = 0; i < 6; i++) soup->bounds[i] = layout->bounds[i];
+
+	startupBegin("upload", NULL, STARTUP_UPLOAD);
+	glGenVertexArrays(1, &(soup->vao));
+	glBindVertexArray(soup->vao);
+	glGenBuffers(1, &(soup->vertexbuffer));
+	glGenBuffers(1, &(soup->indexbuffer));
+
+	// One buffer view, interleaved or not, goes in with a single call.
+	// Several are placed one after the other in the same buffer.
+	glBindBuffer(GL_ARRAY_BUFFER, soup->vertexbuffer);
+	if(layout->nspans == 1) {
+		glBufferData(GL_ARRAY_BUFFER, layout->vertexbytes, bin + layout->spanstart[0], GL_STATIC_DRAW);
+	}
+	else {
+		glBufferData(GL_ARRAY_BUFFER, layout->vertexbytes, NULL, GL_STATIC_DRAW);
+		for(j = 0; j < layout->nspans; j++) {
+			glBufferSubData(GL_ARRAY_BUFFER, layout->spanbase[j],
+				layout->spanend[j] - layout->spanstart[j], bin + layout->spanstart[j]);
+		}
+	}
+	for(i = 0; i < 3; i++) {
+		a = &layout->attribute[i];
+		if(!layout->present[i]) {
+			glDisableVertexAttribArray(i);
+			continue;
+		}
+		glEnableVertexAttribArray(i);
+		glVertexAttribPointer(i, a->components, a->type, a->normalized ? GL_TRUE : GL_FALSE, a->stride,
+			(void*)(size_t)(layout->spanbase[layout->span[i]] + a->start - layout->spanstart[layout->span[i]]));
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, soup->indexbuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexbytes, layout->indices.data, GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	if(startupSyncGPU()) glFinish();
+	startupEnd(layout->vertexbytes + indexbytes);
+	resourceTrack(RESOURCE_SOUP, soup, filename, 0, layout->vertexbytes + indexbytes);
+}
+
+/*
+ * glbReadSoup() - map a .glb file, find the layout of the first mesh
+ * primitive in the JSON chunk, and upload its buffer views as they are
+ * in the binary chunk. Returns 1 on success.
+ */
+int glbReadSoup(triangleSoup *soup, const char *filename) {
+	mappedFile file;
+	const unsigned char *json = NULL, *bin = NULL, *chunk;
+	long long jsonsize = 0, binsize = 0, chunksize, filesize;
+	jsonValue *root;
+	glbLayout layout;
+	char error[256];
+	int ok;
+
+	TRACE_ZONE("glbReadSoup");
+	startupBegin("glbReadSoup", filename, STARTUP_CPU);
+
+	if(!mappedFileOpen(&file, filename)) {
+		printError("Cannot open glTF file", filename);
+		startupEnd(0);
+		return 0;
+	}
+	// A 12 byte header, then chunks of an 8 byte header and data padded to 4 bytes
+	if(file.size < 12 || glbRead32(file.data) != GLB_MAGIC || glbRead32(file.data + 4) != GLB_VERSION
+		|| glbRead32(file.data + 8) > file.size) {
+		printError("Not a binary glTF 2.0 file", filename);
+		mappedFileClose(&file);
+		startupEnd(0);
+		return 0;
+	}
+	for(chunk = file.data + 12; chunk + 8 <= file.data + file.size; chunk += 8 + ((chunksize + 3) & ~3LL)) {
+		chunksize = glbRead32(chunk);
+		if(chunksize > file.data + file.size - (chunk + 8)) break;
+		if(glbRead32(chunk + 4) == GLB_CHUNK_JSON && !json) {
+			json = chunk + 8;
+			jsonsize = chunksize;
+		}
+		else if(glbRead32(chunk + 4) == GLB_CHUNK_BIN && !bin) {
+			bin = chunk + 8;
+			binsize = chunksize;
+		}
+	}
+
+	startupBegin("parse", "JSON", STARTUP_PARSE);
+	root = json ? jsonParse((const char*)json, (long)jsonsize, error, sizeof(error)) : NULL;
+	startupEnd(jsonsize);
+	if(!root) printError("Cannot read the glTF JSON chunk", json ? error : filename);
+
+	ok = root && glbGetLayout(root, bin, binsize, &layout, filename);
+	if(ok) {
+		glbUpload(soup, &layout, bin, filename);
+		printf("glbReadSoup(\"%s\"): %d vertices, %d triangles, %d buffer views.\n",
+			filename, soup->nverts, soup->ntris, layout.nspans);
+	}
+	if(root) free(layout.generated);
+	jsonFree(root);
+	filesize = file.size;
+	mappedFileClose(&file);
+	startupEnd(ok ? filesize : 0);
+	return ok;
+}
@@ -0,0 +1,223 @@
+/* gpuTimer.c */
+/* GPU time per render pass, from timestamp queries read back a few frames late */
+/*
+ * Each pass is bracketed by two glQueryCounter(GL_TIMESTAMP) queries
+ * rather than a GL_TIME_ELAPSED query, because timestamps can be issued
+ * back to back without the one-active-query limit, and the frame span
+ * falls out for free. The queries of a frame are not read until
+ * GPUTIMER_LATENCY-1 frames later, and only if the GPU reports them
+ * as available, so the CPU never waits for the GPU. If the GPU falls
+ * so far behind that a slot is still busy when it comes around again,
+ * that frame is simply not timed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+// In Linux, tell GLFW to include the modern OpenGL functions.
+#ifdef __linux__
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GLFW/glfw3.h>
+
+#ifdef __WIN32__
+#include <GL/glext.h>
+#endif
+
+#include "tnm084.h" // To be able to use OpenGL extensions below
+#include "timer.h"
+#include "trace.h"
+#include "gpuTimer.h"
+
+
+/* Create the query objects. Requires a current GL context. */
+void gpuTimerInit(gpuTimer *timer, frameStats *stats) {
+	int i;
+	GLint64 gputime;
+
+	for(i=0; i<GPUTIMER_LATENCY; i++) {
+		glGenQueries(2*GPUTIMER_MAXZONES, &(timer->frames[i].queries[0][0]));
+		timer->frames[i].nzones = 0;
+		timer->frames[i].pending = 0;
+		timer->frames[i].frame = 0;
+	}
+	timer->current = -1;
+	timer->recording = 0;
+	timer->open = 0;
+	timer->nzones = 0;
+	timer->dropped = 0;
+	timer->stats = stats;
+
+	// GL_TIMESTAMP uses the GPU clock. Sample both clocks once so GPU zones
+	// can be placed on the same timeline as the CPU zones in a trace.
+	glGetInteger64v(GL_TIMESTAMP, &gputime);
+	timer->clockOffset = (long long)timerNanoseconds() - (long long)gputime;
+}
+
+/* Delete the query objects */
+void gpuTimerDelete(gpuTimer *timer) {
+	int i;
+
+	for(i=0; i<GPUTIMER_LATENCY; i++) {
+		glDeleteQueries(2*GPUTIMER_MAXZONES, &(timer->frames[i].queries[0][0]));
+		timer->frames[i].pending = 0;
+	}
+	timer->current = -1;
+	timer->recording = 0;
+}
+
+/*
+ * gpuTimerZone() - find or create the statistics slot for a pass name
+ */
+static gpuZone *gpuTimerZone(gpuTimer *timer, const char *name) {
+	int i;
+
+	for(i=0; i<timer->nzones; i++) {
+		if(!strcmp(timer->zones[i].name, name)) return &(timer->zones[i]);
+	}
+	if(timer->nzones == GPUTIMER_MAXZONES) return NULL;
+	timer->zones[i].name = name;
+	timer->zones[i].lastms = 0.0;
+	histogramInit(&(timer->zones[i].hist));
+	timer->nzones++;
+	return &(timer->zones[i]);
+}
+
+/*
+ * gpuTimerCollect() - read back one frame of queries if they are all done.
+ * Returns 1 if the slot is free for reuse, 0 if the GPU is not finished.
+ */
+static int gpuTimerCollect(gpuTimer *timer, gpuTimerFrame *f) {
+	GLint available;
+	GLuint64 begin, end, first, last;
+	double sums[GPUTIMER_MAXZONES];
+	gpuZone *zones[GPUTIMER_MAXZONES];
+	int i, j;
+
+	if(!f->pending) return 1;
+	for(i=f->nzones-1; i>=0; i--) { // The last query is the most likely to be unfinished
+		glGetQueryObjectiv(f->queries[i][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available) return 0;
+		glGetQueryObjectiv(f->queries[i][0], GL_QUERY_RESULT_AVAILABLE, &available);
+		if(!available) return 0;
+	}
+
+	// Several passes in one frame may share a name (one per object, say),
+	// so sum them up per name before recording.
+	first = last = 0;
+	for(i=0; i<f->nzones; i++) {
+		glGetQueryObjectui64v(f->queries[i][0], GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(f->queries[i][1], GL_QUERY_RESULT, &end);
+		if(i == 0 || begin < first) first = begin;
+		if(i == 0 || end > last) last = end;
+		TRACE_COMPLETE(f->names[i], TRACE_GPU_THREAD, begin + timer->clockOffset, end - begin);
+		zones[i] = gpuTimerZone(timer, f->names[i]);
+		sums[i] = 0.0;
+		for(j=0; zones[j] != zones[i]; j++); // First pass with the same name
+		sums[j] += 1e-6 * (double)(end - begin);
+	}
+	for(i=0; i<f->nzones; i++) {
+		if(zones[i] == NULL) continue;
+		for(j=0; j<i; j++) {
+			if(zones[j] == zones[i]) break;
+		}
+		if(j == i) { // First pass with this name in the frame
+			zones[i]->lastms = sums[i];
+			histogramRecord(&(zones[i]->hist), sums[i]);
+		}
+	}
+	if(timer->stats) {
+		frameStatsSetGPU(timer->stats, f->frame, 1e-6 * (double)(last - first));
+	}
+	f->pending = 0;
+	return 1;
+}
+
+/*
+ * gpuTimerBeginFrame() - start a new frame.
+ * Results from all finished frames are collected first. The slot for this
+ * frame is the oldest one, and if it still has results pending the GPU
+ * is more than GPUTIMER_LATENCY frames behind and this frame goes untimed.
+ */
+void gpuTimerBeginFrame(gpuTimer *timer, unsigned long frame) {
+	int i, slot;
+
+	slot = (timer->current < 0) ? 0 : (timer->current + 1) % GPUTIMER_LATENCY;
+	for(i=1; i<=GPUTIMER_LATENCY; i++) { // Oldest first
+		gpuTimerCollect(timer, &(timer->frames[(slot + i) % GPUTIMER_LATENCY]));
+	}
+	timer->open = 0;
+	timer->current = slot;
+	timer->recording = !timer->frames[slot].pending;
+	if(!timer->recording) {
+		timer->dropped++;
+		return;
+	}
+	timer->frames[slot].nzones = 0;
+	timer->frames[slot].frame = frame;
+}
+
+/*
+ * gpuTimerFlush() - wait for the GPU and collect every pending frame.
+ * This stalls the CPU, so it is meant for the end of a run, where
+ * the last few frames would otherwise go unreported.
+ */
+void gpuTimerFlush(gpuTimer *timer) {
+	int i;
+
+	glFinish();
+	for(i=1; i<=GPUTIMER_LATENCY; i++) { // Oldest first
+		gpuTimerCollect(timer, &(timer->frames[(timer->current + i + GPUTIMER_LATENCY) % GPUTIMER_LATENCY]));
+	}
+}
+
+/* Start timing a pass. Passes may not nest. */
+void gpuTimerBegin(gpuTimer *timer, const char *name) {
+	gpuTimerFrame *f;
+
+	if(!timer->recording || timer->open) return;
+	f = &(timer->frames[timer->current]);
+	if(f->nzones == GPUTIMER_MAXZONES) return;
+	glQueryCounter(f->queries[f->nzones][0], GL_TIMESTAMP);
+	f->names[f->nzones] = name;
+	timer->open = 1;
+}
+
+/* Stop timing the current pass */
+void gpuTimerEnd(gpuTimer *timer) {
+	gpuTimerFrame *f;
+
+	if(!timer->open) return;
+	f = &(timer->frames[timer->current]);
+	glQueryCounter(f->queries[f->nzones][1], GL_TIMESTAMP);
+	f->nzones++;
+	f->pending = 1;
+	timer->open = 0;
+}
+
+/* Print the per-pass statistics to the console */
+void gpuTimerPrint(const gpuTimer *timer) {
+	int i;
+	const histogram *h;
+
+	printf("GPU pass times (%lu frames not timed):\n", timer->dropped);
+	printf("                    mean      p50      p95      p99      max (ms)\n");
+	for(i=0; i<timer->nzones; i++) {
+		h = &(timer->zones[i].hist);
+		printf("%-14s %8.3f %8.3f %8.3f %8.3f %8.3f\n", timer->zones[i].name,
+			histogramMean(h), histogramPercentile(h, 0.50), histogramPercentile(h, 0.95),
+			histogramPercentile(h, 0.99), h->max);
+	}
+}
+
+/* Print the per-pass statistics as a JSON object */
+void gpuTimerPrintJSON(FILE *file, const gpuTimer *timer) {
+	int i;
+
+	fprintf(file, "{");
+	for(i=0; i<timer->nzones; i++) {
+		fprintf(file, "%s\"%s\": ", i ? ", " : "", timer->zones[i].name);
+		histogramPrintJSON(file, &(timer->zones[i].hist));
+	}
+	fprintf(file, "}");
+}
@@ -0,0 +1,88 @@
+/*
+ * imageCompare.c - error measures between two rendered images.
+ *
+ * PSNR is a plain per-pixel measure, good at telling how much changed.
+ * SSIM (Wang et al. 2004) compares local means, contrast and structure,
+ * which is closer to how visible a change is: a little noise spread
+ * over the whole image matters less than a lost edge. Both take RGBA
+ * images with 8 bits per channel, as read back by renderTargetRead().
+ */
+
+#include <math.h>
+
+#include "imageCompare.h"
+
+#define SSIM_WINDOW 8 // Side of the square windows that SSIM is computed over
+#define SSIM_STEP 4   // Distance between windows
+
+/*
+ * imagePSNR(a, b, width, height) - peak signal to noise ratio, in dB.
+ * The alpha channel is ignored.
+ */
+double imagePSNR(const unsigned char *a, const unsigned char *b, int width, int height) {
+	double sum = 0.0, d, mse;
+	long i, n = (long)width * height;
+
+	for(i=0; i<n; i++) {
+		d = (double)a[4*i] - b[4*i];
+		sum += d*d;
+		d = (double)a[4*i+1] - b[4*i+1];
+		sum += d*d;
+		d = (double)a[4*i+2] - b[4*i+2];
+		sum += d*d;
+	}
+	mse = (n > 0) ? sum / (3.0 * n) : 0.0;
+	if(mse <= 0.0) return IMAGE_PSNR_MAX;
+	d = 10.0 * log10(255.0 * 255.0 / mse);
+	return (d < IMAGE_PSNR_MAX) ? d : IMAGE_PSNR_MAX;
+}
+
+/*
+ * luminance() - Rec. 601 luma of one RGBA pixel
+ */
+static double luminance(const unsigned char *p) {
+	return 0.299 * p[0] + 0.587 * p[1] + 0.114 * p[2];
+}
+
+/*
+ * imageSSIM(a, b, width, height) - mean SSIM over overlapping windows.
+ * Uses the usual constants K1 = 0.01 and K2 = 0.03 for 8 bit data.
+ * Images smaller than one window are compared as a single window.
+ */
+double imageSSIM(const unsigned char *a, const unsigned char *b, int width, int height) {
+	const double C1 = (0.01*255.0)*(0.01*255.0), C2 = (0.03*255.0)*(0.03*255.0);
+	int wx = (width < SSIM_WINDOW) ? width : SSIM_WINDOW;
+	int wy = (height < SSIM_WINDOW) ? height : SSIM_WINDOW;
+	int x0, y0, x, y, windows = 0;
+	double sa, sb, saa, sbb, sab, la, lb, n, ma, mb, va, vb, cov, total = 0.0;
+	long i;
+
+	if(wx < 1 || wy < 1) return 1.0;
+	n = (double)wx * wy;
+	for(y0=0; y0+wy<=height; y0+=SSIM_STEP) {
+		for(x0=0; x0+wx<=width; x0+=SSIM_STEP) {
+			sa = sb = saa = sbb = sab = 0.0;
+			for(y=y0; y<y0+wy; y++) {
+				for(x=x0; x<x0+wx; x++) {
+					i = 4 * ((long)y * width + x);
+					la = luminance(a + i);
+					lb = luminance(b + i);
+					sa += la;
+					sb += lb;
+					saa += la*la;
+					sbb += lb*lb;
+					sab += la*lb;
+				}
+			}
+			ma = sa / n;
+			mb = sb / n;
+			va = saa / n - ma*ma;
+			vb = sbb / n - mb*mb;
+			cov = sab / n - ma*mb;
+			total += ((2.0*ma*mb + C1) * (2.0*cov + C2))
+				/ ((ma*ma + mb*mb + C1) * (va + vb + C2));
+			windows++;
+		}
+	}
+	return (windows > 0) ? total / windows : 1.0;
+}
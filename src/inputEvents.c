@@ -0,0 +1,103 @@
+/* inputEvents.c */
+/* Keyboard, mouse and window events from GLFW callbacks, in a lock-free queue */
+
+#include <stdio.h>
+
+#include <GLFW/glfw3.h>
+
+#include "inputEvents.h"
+#include "timer.h"
+
+/* Queue an event. Called only from the thread that polls GLFW events. */
+static void inputEventsPush(GLFWwindow *window, int type, int key, int action, int mods, double x, double y) {
+	inputEvents *input = (inputEvents*)glfwGetWindowUserPointer(window);
+	unsigned int tail, head;
+	inputEvent *event;
+
+	if(!input) return;
+	tail = atomic_load_explicit(&input->tail, memory_order_relaxed);
+	head = atomic_load_explicit(&input->head, memory_order_acquire);
+	if(tail - head >= INPUTEVENTS_QUEUESIZE) {
+		atomic_fetch_add_explicit(&input->dropped, 1, memory_order_relaxed);
+		return;
+	}
+	event = &input->events[tail & (INPUTEVENTS_QUEUESIZE - 1)];
+	event->type = type;
+	event->key = key;
+	event->action = action;
+	event->mods = mods;
+	event->x = x;
+	event->y = y;
+	event->time = timerSeconds();
+	atomic_store_explicit(&input->tail, tail + 1, memory_order_release); // Publish the event
+}
+
+static void inputEventsKey(GLFWwindow *window, int key, int scancode, int action, int mods) {
+	(void)scancode;
+	inputEventsPush(window, INPUT_KEY, key, action, mods, 0.0, 0.0);
+}
+
+static void inputEventsButton(GLFWwindow *window, int button, int action, int mods) {
+	inputEventsPush(window, INPUT_BUTTON, button, action, mods, 0.0, 0.0);
+}
+
+static void inputEventsCursor(GLFWwindow *window, double x, double y) {
+	inputEventsPush(window, INPUT_CURSOR, 0, 0, 0, x, y);
+}
+
+static void inputEventsResize(GLFWwindow *window, int width, int height) {
+	inputEventsPush(window, INPUT_RESIZE, 0, 0, 0, width, height);
+}
+
+static void inputEventsRefresh(GLFWwindow *window) {
+	inputEventsPush(window, INPUT_REFRESH, 0, 0, 0, 0.0, 0.0);
+}
+
+/*
+ * inputEventsInit() - install the callbacks on a window, and queue its
+ * current size and cursor position
+ */
+void inputEventsInit(inputEvents *input, GLFWwindow *window) {
+	int width, height;
+	double x, y;
+
+	atomic_init(&input->head, 0);
+	atomic_init(&input->tail, 0);
+	atomic_init(&input->dropped, 0);
+	input->window = window;
+	glfwSetWindowUserPointer(window, input);
+
+	glfwGetWindowSize(window, &width, &height);
+	inputEventsResize(window, width, height);
+	glfwGetCursorPos(window, &x, &y);
+	inputEventsCursor(window, x, y);
+
+	glfwSetKeyCallback(window, inputEventsKey);
+	glfwSetMouseButtonCallback(window, inputEventsButton);
+	glfwSetCursorPosCallback(window, inputEventsCursor);
+	glfwSetWindowSizeCallback(window, inputEventsResize);
+	glfwSetWindowRefreshCallback(window, inputEventsRefresh);
+}
+
+/* Remove the callbacks */
+void inputEventsDelete(inputEvents *input) {
+	unsigned long dropped = atomic_load(&input->dropped);
+
+	glfwSetKeyCallback(input->window, NULL);
+	glfwSetMouseButtonCallback(input->window, NULL);
+	glfwSetCursorPosCallback(input->window, NULL);
+	glfwSetWindowSizeCallback(input->window, NULL);
+	glfwSetWindowRefreshCallback(input->window, NULL);
+	glfwSetWindowUserPointer(input->window, NULL);
+	if(dropped > 0) fprintf(stderr, "Input: %lu events were dropped, the queue was full\n", dropped);
+}
+
+/* Take the oldest event from the queue. Returns 0 if it is empty. */
+int inputEventsPop(inputEvents *input, inputEvent *event) {
+	unsigned int head = atomic_load_explicit(&input->head, memory_order_relaxed);
+
+	if(head == atomic_load_explicit(&input->tail, memory_order_acquire)) return 0;
+	*event = input->events[head & (INPUTEVENTS_QUEUESIZE - 1)];
+	atomic_store_explicit(&input->head, head + 1, memory_order_release); // Hand the slot back
+	return 1;
+}
@@ -0,0 +1,110 @@
+/* inputLatency.c */
+/* Timestamps for mouse and key input, and the time from each event to the swap that shows it */
+
+#include <stdio.h>
+
+#include <GLFW/glfw3.h>
+
+#include "inputLatency.h"
+#include "timer.h"
+
+static inputLatency *inputLatencyCurrent = NULL; // GLFW callbacks carry no user data of ours
+
+/* Stamp an event, keeping the oldest one since the last latch */
+static void inputLatencyEvent(void) {
+	if(!inputLatencyCurrent) return;
+	inputLatencyCurrent->events++;
+	if(inputLatencyCurrent->pending == 0.0) inputLatencyCurrent->pending = timerSeconds();
+}
+
+/* Motion only counts while the left button drags the rotator, hovering moves nothing */
+static void inputLatencyCursorPos(GLFWwindow *window, double x, double y) {
+	if(glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) inputLatencyEvent();
+	if(inputLatencyCurrent && inputLatencyCurrent->previouspos)
+		inputLatencyCurrent->previouspos(window, x, y);
+}
+
+static void inputLatencyMouseButton(GLFWwindow *window, int button, int action, int mods) {
+	inputLatencyEvent();
+	if(inputLatencyCurrent && inputLatencyCurrent->previousbutton)
+		inputLatencyCurrent->previousbutton(window, button, action, mods);
+}
+
+static void inputLatencyKey(GLFWwindow *window, int key, int scancode, int action, int mods) {
+	if(action != GLFW_REPEAT) inputLatencyEvent(); // A held key already keeps the view moving
+	if(inputLatencyCurrent && inputLatencyCurrent->previouskey)
+		inputLatencyCurrent->previouskey(window, key, scancode, action, mods);
+}
+
+/* Install the mouse and key callbacks on a window. Only one inputLatency can be active at a time. */
+void inputLatencyInit(inputLatency *latency, GLFWwindow *window) {
+	latency->pending = 0.0;
+	latency->latched = 0.0;
+	latency->latchtime = 0.0;
+	latency->events = 0;
+	latency->frames = 0;
+	histogramInit(&latency->eventToSwap);
+	histogramInit(&latency->latchToSwap);
+	inputLatencyCurrent = latency;
+	latency->previouspos = glfwSetCursorPosCallback(window, inputLatencyCursorPos);
+	latency->previousbutton = glfwSetMouseButtonCallback(window, inputLatencyMouseButton);
+	latency->previouskey = glfwSetKeyCallback(window, inputLatencyKey);
+}
+
+/* Remove the callbacks again */
+void inputLatencyDelete(inputLatency *latency, GLFWwindow *window) {
+	glfwSetCursorPosCallback(window, latency->previouspos);
+	glfwSetMouseButtonCallback(window, latency->previousbutton);
+	glfwSetKeyCallback(window, latency->previouskey);
+	if(inputLatencyCurrent == latency) inputLatencyCurrent = NULL;
+}
+
+/* The frame reads the input now. Call right where the input is sampled. */
+void inputLatencyLatch(inputLatency *latency) {
+	latency->latchtime = timerSeconds();
+	latency->latched = latency->pending;
+	latency->pending = 0.0;
+}
+
+/* Forget the events not yet latched, when they will not lead to a new frame */
+void inputLatencyDiscard(inputLatency *latency) {
+	latency->pending = 0.0;
+}
+
+/* The frame that read the input has been swapped. Call right after glfwSwapBuffers(). */
+void inputLatencySwapped(inputLatency *latency) {
+	double now = timerSeconds();
+
+	histogramRecord(&latency->latchToSwap, 1000.0 * (now - latency->latchtime));
+	if(latency->latched > 0.0) {
+		histogramRecord(&latency->eventToSwap, 1000.0 * (now - latency->latched));
+		latency->frames++;
+		latency->latched = 0.0;
+	}
+}
+
+/* Print the latency percentiles to the console */
+void inputLatencyPrint(const inputLatency *latency) {
+	const histogram *e = &latency->eventToSwap, *l = &latency->latchToSwap;
+
+	printf("Input latency: %lu input events, shown in %lu frames\n", latency->events, latency->frames);
+	if(e->total > 0) {
+		printf("  Event to swap:  p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+			histogramPercentile(e, 0.50), histogramPercentile(e, 0.95),
+			histogramPercentile(e, 0.99), e->max);
+	}
+	if(l->total > 0) {
+		printf("  Latch to swap:  p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+			histogramPercentile(l, 0.50), histogramPercentile(l, 0.95),
+			histogramPercentile(l, 0.99), l->max);
+	}
+}
+
+/* Print the latency distributions as a JSON object */
+void inputLatencyPrintJSON(FILE *file, const inputLatency *latency) {
+	fprintf(file, "{\"events\": %lu, \"frames\": %lu, \"event_to_swap_ms\": ", latency->events, latency->frames);
+	histogramPrintJSON(file, &latency->eventToSwap);
+	fprintf(file, ", \"latch_to_swap_ms\": ");
+	histogramPrintJSON(file, &latency->latchToSwap);
+	fprintf(file, "}");
+}
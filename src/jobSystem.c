@@ -0,0 +1,458 @@
+/* jobSystem.c */
+/* A work stealing job scheduler shared by everything that runs in parallel */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __WIN32__
+#include <windows.h> // For GetSystemInfo()
+#else
+#include <unistd.h>  // For sysconf()
+#endif
+
+#include "jobSystem.h"
+#include "timer.h"
+#include "arena.h"
+
+#define JOBSYSTEM_MAXTHREADS 256
+#define JOBQUEUE_INITIALSIZE 64
+
+/* Which worker of which system the calling thread is, if any */
+static _Thread_local jobSystem *jobCurrentSystem = NULL;
+static _Thread_local int jobCurrentThread = -1;
+
+
+/* Number of processors, at least 1 */
+int jobSystemProcessors(void) {
+#ifdef __WIN32__
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int)n : 1;
+#endif
+}
+
+/* Our worker index in system, or -1 for a thread that is not one of its workers */
+static int jobSelf(jobSystem *system) {
+	return (jobCurrentSystem == system) ? jobCurrentThread : -1;
+}
+
+static void jobQueueInit(jobQueue *queue) {
+	pthread_mutex_init(&queue->lock, NULL);
+	queue->jobs = NULL;
+	queue->capacity = 0;
+	queue->head = 0;
+	queue->count = 0;
+}
+
+static void jobQueueDelete(jobQueue *queue) {
+	pthread_mutex_destroy(&queue->lock);
+	free(queue->jobs);
+	queue->jobs = NULL;
+	queue->capacity = 0;
+}
+
+/*
+ * jobQueuePush() - add a job at the tail, growing the ring as needed.
+ * queued, if not NULL, is counted up while the lock is held.
+ * Returns 0 if there was no memory for it.
+ */
+static int jobQueuePush(jobQueue *queue, job *j, atomic_int *queued) {
+	job **grown;
+	int i, capacity;
+
+	pthread_mutex_lock(&queue->lock);
+	if(queue->count == queue->capacity) {
+		capacity = queue->capacity ? 2 * queue->capacity : JOBQUEUE_INITIALSIZE;
+		grown = (job**)malloc(capacity * sizeof(job*));
+		if(grown == NULL) {
+			pthread_mutex_unlock(&queue->lock);
+			return 0;
+		}
+		for(i=0; i<queue->count; i++) grown[i] = queue->jobs[(queue->head + i) % queue->capacity];
+		free(queue->jobs);
+		queue->jobs = grown;
+		queue->capacity = capacity;
+		queue->head = 0;
+	}
+	queue->jobs[(queue->head + queue->count) % queue->capacity] = j;
+	queue->count++;
+	if(queued) atomic_fetch_add(queued, 1);
+	pthread_mutex_unlock(&queue->lock);
+	return 1;
+}
+
+/*
+ * jobQueuePop() - take the newest job (the owner) or the oldest one
+ * (a thief). Returns NULL if the queue is empty.
+ */
+static job *jobQueuePop(jobQueue *queue, int steal, atomic_int *queued) {
+	job *j = NULL;
+
+	pthread_mutex_lock(&queue->lock);
+	if(queue->count > 0) {
+		if(steal) {
+			j = queue->jobs[queue->head];
+			queue->head = (queue->head + 1) % queue->capacity;
+		}
+		else j = queue->jobs[(queue->head + queue->count - 1) % queue->capacity];
+		queue->count--;
+		if(queued) atomic_fetch_sub(queued, 1);
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return j;
+}
+
+static int jobQueueCount(jobQueue *queue) {
+	int count;
+
+	pthread_mutex_lock(&queue->lock);
+	count = queue->count;
+	pthread_mutex_unlock(&queue->lock);
+	return count;
+}
+
+/* Wake every thread that sleeps on the system */
+static void jobWakeAll(jobSystem *system) {
+	pthread_mutex_lock(&system->lock);
+	if(system->sleepers > 0) pthread_cond_broadcast(&system->wake);
+	pthread_mutex_unlock(&system->lock);
+}
+
+static void jobExecute(jobSystem *system, job *j, int self, int stolen);
+
+/*
+ * jobEnqueue() - put a ready job where it can be run: the main thread
+ * queue, our own queue if we are a worker, or else worker 0's queue
+ */
+static void jobEnqueue(jobSystem *system, job *j) {
+	int self = jobSelf(system), queued;
+
+	if(j->flags & JOB_MAIN_THREAD) queued = jobQueuePush(&system->mainqueue, j, NULL);
+	else queued = jobQueuePush(&system->queues[self >= 0 ? self : 0], j, &system->queued);
+	if(!queued) {
+		// Nowhere to put it, so run it here and now
+		fprintf(stderr, "jobEnqueue: out of memory, running the job directly.\n");
+		jobExecute(system, j, self >= 0 ? self : 0, 0);
+		return;
+	}
+	jobWakeAll(system);
+}
+
+/*
+ * jobTake() - a job from our own queue, or else stolen from another.
+ * Returns NULL if there is nothing to do.
+ */
+static job *jobTake(jobSystem *system, int self, int *stolen) {
+	job *j;
+	int victim;
+
+	*stolen = 0;
+	j = jobQueuePop(&system->queues[self], 0, &system->queued);
+	for(victim=1; j == NULL && victim < system->nthreads; victim++) {
+		if(atomic_load(&system->queued) == 0) return NULL;
+		j = jobQueuePop(&system->queues[(self + victim) % system->nthreads], 1, &system->queued);
+		*stolen = (j != NULL);
+	}
+	return j;
+}
+
+/*
+ * jobExecute() - run a job, mark it done and release the jobs that were
+ * waiting for it. The job struct is not touched after it is marked
+ * done, since its owner may free it right away.
+ */
+static void jobExecute(jobSystem *system, job *j, int self, int stolen) {
+	jobWorker *worker = &system->workers[self];
+	unsigned long long start = timerNanoseconds();
+	job *continuations[JOB_MAXCONTINUATIONS];
+	int i, n;
+
+	j->function(j->data, self);
+	atomic_fetch_add(&worker->busy, timerNanoseconds() - start);
+	atomic_fetch_add(&worker->jobs, 1);
+	if(stolen) atomic_fetch_add(&worker->steals, 1);
+
+	n = j->ncontinuations;
+	for(i=0; i<n; i++) continuations[i] = j->continuations[i];
+	atomic_store(&j->done, 1);
+	for(i=0; i<n; i++) {
+		if(atomic_fetch_sub(&continuations[i]->unfinished, 1) == 1) jobEnqueue(system, continuations[i]);
+	}
+	jobWakeAll(system);
+}
+
+/*
+ * jobWorkerMain() - the loop of a worker thread: run jobs while there
+ * are any, and sleep when there are none
+ */
+static void *jobWorkerMain(void *arg) {
+	jobWorker *worker = (jobWorker*)arg;
+	jobSystem *system = worker->system;
+	job *j;
+	int stolen;
+
+	jobCurrentSystem = system;
+	jobCurrentThread = worker->index;
+	for(;;) {
+		j = jobTake(system, worker->index, &stolen);
+		if(j) {
+			jobExecute(system, j, worker->index, stolen);
+			continue;
+		}
+		pthread_mutex_lock(&system->lock);
+		while(!system->quit && atomic_load(&system->queued) == 0) {
+			system->sleepers++;
+			pthread_cond_wait(&system->wake, &system->lock);
+			system->sleepers--;
+		}
+		if(system->quit) {
+			pthread_mutex_unlock(&system->lock);
+			arenaScratchDelete();
+			return NULL;
+		}
+		pthread_mutex_unlock(&system->lock);
+	}
+}
+
+
+/* Start nthreads-1 workers. nthreads <= 0 means one per processor. Returns 1 on success. */
+int jobSystemInit(jobSystem *system, int nthreads) {
+	int i;
+
+	if(nthreads <= 0) nthreads = jobSystemProcessors();
+	if(nthreads > JOBSYSTEM_MAXTHREADS) nthreads = JOBSYSTEM_MAXTHREADS;
+	system->nthreads = nthreads;
+	system->sleepers = 0;
+	system->quit = 0;
+	atomic_init(&system->queued, 0);
+	system->threads = (pthread_t*)malloc(nthreads * sizeof(pthread_t));
+	system->workers = (jobWorker*)malloc(nthreads * sizeof(jobWorker));
+	system->queues = (jobQueue*)malloc(nthreads * sizeof(jobQueue));
+	if(!system->threads || !system->workers || !system->queues) {
+		fprintf(stderr, "jobSystemInit: out of memory.\n");
+		free(system->threads);
+		free(system->workers);
+		free(system->queues);
+		return 0;
+	}
+	pthread_mutex_init(&system->lock, NULL);
+	pthread_cond_init(&system->wake, NULL);
+	jobQueueInit(&system->mainqueue);
+	for(i=0; i<nthreads; i++) {
+		jobQueueInit(&system->queues[i]);
+		system->workers[i].system = system;
+		system->workers[i].index = i;
+		atomic_init(&system->workers[i].jobs, 0);
+		atomic_init(&system->workers[i].steals, 0);
+		atomic_init(&system->workers[i].busy, 0);
+	}
+	jobCurrentSystem = system;
+	jobCurrentThread = 0;
+	for(i=1; i<nthreads; i++) {
+		if(pthread_create(&system->threads[i], NULL, jobWorkerMain, &system->workers[i]) != 0) {
+			// Carry on with the threads we got
+			fprintf(stderr, "jobSystemInit: could only start %d threads.\n", i);
+			system->nthreads = i;
+			break;
+		}
+	}
+	return 1;
+}
+
+/* Stop and join the workers. All submitted jobs must be done. */
+void jobSystemDelete(jobSystem *system) {
+	int i;
+
+	pthread_mutex_lock(&system->lock);
+	system->quit = 1;
+	pthread_cond_broadcast(&system->wake);
+	pthread_mutex_unlock(&system->lock);
+	for(i=1; i<system->nthreads; i++) pthread_join(system->threads[i], NULL);
+
+	for(i=0; i<system->nthreads; i++) jobQueueDelete(&system->queues[i]);
+	jobQueueDelete(&system->mainqueue);
+	pthread_mutex_destroy(&system->lock);
+	pthread_cond_destroy(&system->wake);
+	free(system->threads);
+	free(system->workers);
+	free(system->queues);
+	system->threads = NULL;
+	system->workers = NULL;
+	system->queues = NULL;
+	system->nthreads = 0;
+	if(jobCurrentSystem == system) jobCurrentSystem = NULL;
+}
+
+/* Set up a job. It does not run until it is submitted. */
+void jobInit(job *j, jobFunction function, void *data, int flags) {
+	j->function = function;
+	j->data = data;
+	j->flags = flags;
+	atomic_init(&j->unfinished, 1);
+	atomic_init(&j->done, 0);
+	j->ncontinuations = 0;
+}
+
+/* Make later wait for earlier. Call before submitting earlier. Returns 1 on success. */
+int jobAddDependency(job *later, job *earlier) {
+	if(earlier->ncontinuations == JOB_MAXCONTINUATIONS) {
+		fprintf(stderr, "jobAddDependency: more than %d jobs depend on one job.\n", JOB_MAXCONTINUATIONS);
+		return 0;
+	}
+	earlier->continuations[earlier->ncontinuations++] = later;
+	atomic_fetch_add(&later->unfinished, 1);
+	return 1;
+}
+
+/* Queue the job, or let it be queued when its dependencies are done */
+void jobSubmit(jobSystem *system, job *j) {
+	if(atomic_fetch_sub(&j->unfinished, 1) == 1) jobEnqueue(system, j);
+}
+
+/* Nonzero if the job has run */
+int jobDone(job *j) {
+	return atomic_load(&j->done);
+}
+
+/*
+ * jobWait(system, j) - wait for a submitted job. Workers run other jobs
+ * meanwhile, and the main thread also runs its JOB_MAIN_THREAD jobs.
+ * Other threads just sleep.
+ */
+void jobWait(jobSystem *system, job *j) {
+	int self = jobSelf(system), stolen;
+	job *other;
+
+	while(!atomic_load(&j->done)) {
+		if(self == 0 && (other = jobQueuePop(&system->mainqueue, 1, NULL)) != NULL) {
+			jobExecute(system, other, 0, 0);
+			continue;
+		}
+		if(self >= 0 && (other = jobTake(system, self, &stolen)) != NULL) {
+			jobExecute(system, other, self, stolen);
+			continue;
+		}
+		pthread_mutex_lock(&system->lock);
+		while(!atomic_load(&j->done) && (self < 0 || atomic_load(&system->queued) == 0)
+			&& (self != 0 || jobQueueCount(&system->mainqueue) == 0)) {
+			system->sleepers++;
+			pthread_cond_wait(&system->wake, &system->lock);
+			system->sleepers--;
+		}
+		pthread_mutex_unlock(&system->lock);
+	}
+}
+
+/* One piece of a jobParallelFor() */
+typedef struct {
+	jobRangeFunction function;
+	void *data;
+	int begin, end;
+} jobRange;
+
+static void jobRangeRun(void *data, int thread) {
+	jobRange *range = (jobRange*)data;
+	range->function(range->data, range->begin, range->end, thread);
+}
+
+static void jobNothing(void *data, int thread) {
+	(void)data;
+	(void)thread;
+}
+
+/*
+ * jobParallelFor(system, begin, end, grain, function, data) - split a
+ * range into pieces, run them as jobs and wait for all of them. Call
+ * it from the main thread or from inside a job.
+ */
+void jobParallelFor(jobSystem *system, int begin, int end, int grain, jobRangeFunction function, void *data) {
+	int self = jobSelf(system), npieces, i;
+	jobRange *ranges;
+	job *pieces, join;
+
+	if(end <= begin) return;
+	if(grain < 1) grain = 1;
+	npieces = (int)(((long)end - begin + grain - 1) / grain);
+	if(self < 0) self = 0;
+	if(npieces == 1 || system->nthreads <= 1) {
+		function(data, begin, end, self);
+		return;
+	}
+	ranges = (jobRange*)malloc(npieces * sizeof(jobRange));
+	pieces = (job*)malloc(npieces * sizeof(job));
+	if(!ranges || !pieces) {
+		free(ranges);
+		free(pieces);
+		function(data, begin, end, self);
+		return;
+	}
+
+	// A job that does nothing, but only runs when all the pieces are done
+	jobInit(&join, jobNothing, NULL, 0);
+	for(i=0; i<npieces; i++) {
+		ranges[i].function = function;
+		ranges[i].data = data;
+		ranges[i].begin = begin + i*grain;
+		ranges[i].end = (i == npieces-1) ? end : begin + (i+1)*grain;
+		jobInit(&pieces[i], jobRangeRun, &ranges[i], 0);
+		jobAddDependency(&join, &pieces[i]);
+	}
+	// The last pieces are at the tail, where we take from, so others steal from the front
+	for(i=0; i<npieces; i++) jobSubmit(system, &pieces[i]);
+	jobSubmit(system, &join);
+	jobWait(system, &join);
+
+	free(ranges);
+	free(pieces);
+}
+
+/* Run the JOB_MAIN_THREAD jobs that are ready. Call from the main thread, e.g. once per frame. Returns the number run. */
+int jobRunMainThread(jobSystem *system) {
+	job *j;
+	int n = 0;
+
+	if(jobSelf(system) != 0) {
+		fprintf(stderr, "jobRunMainThread: not called from the main thread.\n");
+		return 0;
+	}
+	while((j = jobQueuePop(&system->mainqueue, 1, NULL)) != NULL) {
+		jobExecute(system, j, 0, 0);
+		n++;
+	}
+	return n;
+}
+
+/* Read the counters of one worker */
+void jobSystemCounters(jobSystem *system, int thread, jobCounters *counters) {
+	jobWorker *worker = &system->workers[thread];
+
+	counters->jobs = atomic_load(&worker->jobs);
+	counters->steals = atomic_load(&worker->steals);
+	counters->busy = 1e-9 * (double)atomic_load(&worker->busy);
+}
+
+/* Zero all counters */
+void jobSystemResetCounters(jobSystem *system) {
+	int i;
+
+	for(i=0; i<system->nthreads; i++) {
+		atomic_store(&system->workers[i].jobs, 0);
+		atomic_store(&system->workers[i].steals, 0);
+		atomic_store(&system->workers[i].busy, 0);
+	}
+}
+
+/* Print the counters of all workers to stdout */
+void jobSystemPrintCounters(jobSystem *system) {
+	jobCounters counters;
+	int i;
+
+	for(i=0; i<system->nthreads; i++) {
+		jobSystemCounters(system, i, &counters);
+		printf("worker %d: %lu jobs, %lu stolen, %.2f ms busy\n", i, counters.jobs, counters.steals,
+			1000.0 * counters.busy);
+	}
+}
@@ -0,0 +1,404 @@
+/* json.c */
+/* A small JSON reader that builds a tree of values */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json.h"
+
+/* Parser state: a position in the text, and the first error seen */
+typedef struct {
+	const char *pos;
+	const char *end;
+	const char *start; // For reporting error offsets
+	char *error;
+	int errorsize;
+	int failed;
+} jsonParser;
+
+static jsonValue *jsonParseValue(jsonParser *p, int depth);
+
+
+/*
+ * jsonFail() - record an error at the current position (only the first one)
+ */
+static void jsonFail(jsonParser *p, const char *message) {
+	if(p->failed) return;
+	p->failed = 1;
+	if(p->error && p->errorsize > 0) {
+		snprintf(p->error, p->errorsize, "%s at byte %ld", message, (long)(p->pos - p->start));
+	}
+}
+
+static void jsonSkipSpace(jsonParser *p) {
+	while(p->pos < p->end && (*p->pos == ' ' || *p->pos == '\t' || *p->pos == '\n' || *p->pos == '\r')) {
+		p->pos++;
+	}
+}
+
+static jsonValue *jsonNewValue(jsonParser *p, int type) {
+	jsonValue *value = (jsonValue*)calloc(1, sizeof(jsonValue));
+	if(value == NULL) jsonFail(p, "Out of memory");
+	else value->type = type;
+	return value;
+}
+
+/*
+ * jsonHex() - value of four hex digits, or -1
+ */
+static long jsonHex(jsonParser *p) {
+	long code = 0;
+	int i;
+
+	if(p->end - p->pos < 4) return -1;
+	for(i=0; i<4; i++) {
+		char c = *p->pos++;
+		code *= 16;
+		if(c >= '0' && c <= '9') code += c - '0';
+		else if(c >= 'a' && c <= 'f') code += c - 'a' + 10;
+		else if(c >= 'A' && c <= 'F') code += c - 'A' + 10;
+		else return -1;
+	}
+	return code;
+}
+
+/*
+ * jsonParseString() - parse a string literal into a new zero terminated
+ * UTF-8 string. The opening quote has not been consumed yet.
+ */
+static char *jsonParseString(jsonParser *p) {
+	const char *scan;
+	char *out, *o;
+	long code, low;
+
+	p->pos++; // The opening quote
+	// Escapes only ever make the string shorter, so this is enough room
+	for(scan = p->pos; scan < p->end && *scan != '"'; scan++) {
+		if(*scan == '\\') scan++;
+	}
+	if(scan >= p->end) {
+		jsonFail(p, "Unterminated string");
+		return NULL;
+	}
+	out = o = (char*)malloc(scan - p->pos + 1);
+	if(out == NULL) {
+		jsonFail(p, "Out of memory");
+		return NULL;
+	}
+	while(*p->pos != '"') {
+		if((unsigned char)*p->pos < 0x20) {
+			jsonFail(p, "Control character in string");
+			free(out);
+			return NULL;
+		}
+		if(*p->pos != '\\') {
+			*o++ = *p->pos++;
+			continue;
+		}
+		p->pos++;
+		switch(*p->pos++) {
+			case '"': *o++ = '"'; break;
+			case '\\': *o++ = '\\'; break;
+			case '/': *o++ = '/'; break;
+			case 'b': *o++ = '\b'; break;
+			case 'f': *o++ = '\f'; break;
+			case 'n': *o++ = '\n'; break;
+			case 'r': *o++ = '\r'; break;
+			case 't': *o++ = '\t'; break;
+			case 'u':
+				code = jsonHex(p);
+				// A surrogate pair is two escapes for one code point
+				if(code >= 0xD800 && code < 0xDC00 && p->end - p->pos >= 6
+					&& p->pos[0] == '\\' && p->pos[1] == 'u') {
+					p->pos += 2;
+					low = jsonHex(p);
+					if(low >= 0xDC00 && low < 0xE000) code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+					else code = -1;
+				}
+				if(code < 0) {
+					jsonFail(p, "Bad \\u escape in string");
+					free(out);
+					return NULL;
+				}
+				// Encode as UTF-8. Six escaped bytes always cover the encoded ones.
+				if(code < 0x80) *o++ = (char)code;
+				else if(code < 0x800) {
+					*o++ = (char)(0xC0 | (code >> 6));
+					*o++ = (char)(0x80 | (code & 0x3F));
+				}
+				else if(code < 0x10000) {
+					*o++ = (char)(0xE0 | (code >> 12));
+					*o++ = (char)(0x80 | ((code >> 6) & 0x3F));
+					*o++ = (char)(0x80 | (code & 0x3F));
+				}
+				else {
+					*o++ = (char)(0xF0 | (code >> 18));
+					*o++ = (char)(0x80 | ((code >> 12) & 0x3F));
+					*o++ = (char)(0x80 | ((code >> 6) & 0x3F));
+					*o++ = (char)(0x80 | (code & 0x3F));
+				}
+				break;
+			default:
+				p->pos--;
+				jsonFail(p, "Bad escape in string");
+				free(out);
+				return NULL;
+		}
+	}
+	p->pos++; // The closing quote
+	*o = '\0';
+	return out;
+}
+
+/*
+ * jsonParseNumber() - parse a number, checking the JSON syntax before
+ * handing the conversion to strtod()
+ */
+static jsonValue *jsonParseNumber(jsonParser *p) {
+	const char *s = p->pos;
+	char buffer[64];
+	jsonValue *value;
+
+	if(s < p->end && *s == '-') s++;
+	if(s < p->end && *s == '0') s++;
+	else if(s < p->end && *s >= '1' && *s <= '9') while(s < p->end && *s >= '0' && *s <= '9') s++;
+	else {
+		jsonFail(p, "Bad number");
+		return NULL;
+	}
+	if(s < p->end && *s == '.') {
+		s++;
+		if(s >= p->end || *s < '0' || *s > '9') {
+			jsonFail(p, "Bad number");
+			return NULL;
+		}
+		while(s < p->end && *s >= '0' && *s <= '9') s++;
+	}
+	if(s < p->end && (*s == 'e' || *s == 'E')) {
+		s++;
+		if(s < p->end && (*s == '+' || *s == '-')) s++;
+		if(s >= p->end || *s < '0' || *s > '9') {
+			jsonFail(p, "Bad number");
+			return NULL;
+		}
+		while(s < p->end && *s >= '0' && *s <= '9') s++;
+	}
+	if(s - p->pos >= (long)sizeof(buffer)) {
+		jsonFail(p, "Number too long");
+		return NULL;
+	}
+	// The text is not necessarily zero terminated, so copy it out
+	memcpy(buffer, p->pos, s - p->pos);
+	buffer[s - p->pos] = '\0';
+	value = jsonNewValue(p, JSON_NUMBER);
+	if(value) value->number = strtod(buffer, NULL);
+	p->pos = s;
+	return value;
+}
+
+/*
+ * jsonParseLiteral() - true, false or null
+ */
+static jsonValue *jsonParseLiteral(jsonParser *p, const char *word, int type) {
+	size_t n = strlen(word);
+	jsonValue *value;
+
+	if((size_t)(p->end - p->pos) < n || strncmp(p->pos, word, n)) {
+		jsonFail(p, "Unexpected character");
+		return NULL;
+	}
+	p->pos += n;
+	value = jsonNewValue(p, type);
+	if(value && type == JSON_TRUE) value->number = 1.0;
+	return value;
+}
+
+/*
+ * jsonParseContainer() - an array or an object. Members are linked in
+ * the order they appear, and duplicate keys are kept as they are.
+ */
+static jsonValue *jsonParseContainer(jsonParser *p, int depth, int type) {
+	jsonValue *container, *item, **last;
+	char *key = NULL;
+	char close = (type == JSON_ARRAY) ? ']' : '}';
+
+	container = jsonNewValue(p, type);
+	if(container == NULL) return NULL;
+	last = &container->child;
+	p->pos++; // The opening bracket
+	jsonSkipSpace(p);
+	if(p->pos < p->end && *p->pos == close) {
+		p->pos++;
+		return container;
+	}
+	for(;;) {
+		jsonSkipSpace(p);
+		if(type == JSON_OBJECT) {
+			if(p->pos >= p->end || *p->pos != '"') {
+				jsonFail(p, "Expected a member name");
+				break;
+			}
+			key = jsonParseString(p);
+			if(key == NULL) break;
+			jsonSkipSpace(p);
+			if(p->pos >= p->end || *p->pos != ':') {
+				jsonFail(p, "Expected ':'");
+				break;
+			}
+			p->pos++;
+		}
+		item = jsonParseValue(p, depth+1);
+		if(item == NULL) break;
+		item->key = key;
+		key = NULL;
+		*last = item;
+		last = &item->next;
+		container->count++;
+
+		jsonSkipSpace(p);
+		if(p->pos < p->end && *p->pos == ',') {
+			p->pos++;
+			continue;
+		}
+		if(p->pos < p->end && *p->pos == close) {
+			p->pos++;
+			return container;
+		}
+		jsonFail(p, (type == JSON_ARRAY) ? "Expected ',' or ']'" : "Expected ',' or '}'");
+		break;
+	}
+	free(key);
+	jsonFree(container);
+	return NULL;
+}
+
+/*
+ * jsonParseValue() - parse any value, after optional white space
+ */
+static jsonValue *jsonParseValue(jsonParser *p, int depth) {
+	jsonValue *value;
+	char *string;
+
+	if(depth > JSON_MAXDEPTH) {
+		jsonFail(p, "Nested too deep");
+		return NULL;
+	}
+	jsonSkipSpace(p);
+	if(p->pos >= p->end) {
+		jsonFail(p, "Unexpected end of text");
+		return NULL;
+	}
+	switch(*p->pos) {
+		case '{': return jsonParseContainer(p, depth, JSON_OBJECT);
+		case '[': return jsonParseContainer(p, depth, JSON_ARRAY);
+		case 't': return jsonParseLiteral(p, "true", JSON_TRUE);
+		case 'f': return jsonParseLiteral(p, "false", JSON_FALSE);
+		case 'n': return jsonParseLiteral(p, "null", JSON_NULL);
+		case '"':
+			string = jsonParseString(p);
+			if(string == NULL) return NULL;
+			value = jsonNewValue(p, JSON_STRING);
+			if(value) value->string = string;
+			else free(string);
+			return value;
+		default:
+			return jsonParseNumber(p);
+	}
+}
+
+/* Parse a JSON text of the given length. Returns NULL and a message in error on failure. */
+jsonValue *jsonParse(const char *text, long length, char *error, int errorsize) {
+	jsonParser p;
+	jsonValue *value;
+
+	p.pos = p.start = text;
+	p.end = text + length;
+	p.error = error;
+	p.errorsize = errorsize;
+	p.failed = 0;
+	value = jsonParseValue(&p, 0);
+	if(value) {
+		jsonSkipSpace(&p);
+		if(p.pos != p.end) {
+			jsonFail(&p, "Trailing characters after the value");
+			jsonFree(value);
+			value = NULL;
+		}
+	}
+	return value;
+}
+
+/* Read and parse a JSON file. Errors are printed. Returns NULL on failure. */
+jsonValue *jsonReadFile(const char *filename) {
+	FILE *file;
+	char *text, error[128];
+	long length;
+	jsonValue *value;
+
+	file = fopen(filename, "rb");
+	if(file == NULL) {
+		fprintf(stderr, "Cannot open JSON file %s.\n", filename);
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	text = (char*)malloc(length > 0 ? length : 1);
+	if(text == NULL) {
+		fclose(file);
+		fprintf(stderr, "Out of memory reading %s.\n", filename);
+		return NULL;
+	}
+	length = (long)fread(text, 1, length, file);
+	fclose(file);
+	value = jsonParse(text, length, error, sizeof(error));
+	if(value == NULL) fprintf(stderr, "%s: %s\n", filename, error);
+	free(text);
+	return value;
+}
+
+/* Free a value and everything below it */
+void jsonFree(jsonValue *value) {
+	jsonValue *next;
+
+	// Siblings are freed in a loop, only children recurse
+	while(value) {
+		next = value->next;
+		jsonFree(value->child);
+		free(value->string);
+		free(value->key);
+		free(value);
+		value = next;
+	}
+}
+
+/* Member of an object by name, or NULL */
+jsonValue *jsonGet(const jsonValue *object, const char *key) {
+	jsonValue *member;
+
+	if(object == NULL || object->type != JSON_OBJECT) return NULL;
+	for(member = object->child; member; member = member->next) {
+		if(!strcmp(member->key, key)) return member;
+	}
+	return NULL;
+}
+
+/* Element of an array by index, or NULL */
+jsonValue *jsonIndex(const jsonValue *array, int index) {
+	jsonValue *element;
+
+	if(array == NULL || array->type != JSON_ARRAY || index < 0) return NULL;
+	for(element = array->child; element && index > 0; element = element->next) index--;
+	return element;
+}
+
+/* The number in a value, or fallback if it is missing or not a number */
+double jsonNumber(const jsonValue *value, double fallback) {
+	return (value && value->type == JSON_NUMBER) ? value->number : fallback;
+}
+
+/* The string in a value, or fallback if it is missing or not a string */
+const char *jsonString(const jsonValue *value, const char *fallback) {
+	return (value && value->type == JSON_STRING) ? value->string : fallback;
+}
@@ -0,0 +1,81 @@
+/* lateLatch.c */
+/* A small uniform buffer for the view transform, written right before the draw */
+
+#include <stdio.h>
+#include <string.h>
+
+// In Linux, tell GLFW to include the modern OpenGL functions.
+#ifdef __linux__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <GLFW/glfw3.h>
+
+#ifdef __WIN32__
+#include <GL/glext.h>
+#endif
+
+#include "tnm084.h" // To be able to use OpenGL extensions below
+#include "lateLatch.h"
+
+#define LATELATCH_BLOCKSIZE (16 * sizeof(GLfloat)) // One mat4, std140
+
+
+/* Create the buffer with a ring of slots. Requires a current GL context. Returns 1 on success. */
+int lateLatchInit(lateLatch *latch, int slots) {
+	GLint alignment = 0;
+
+	if(slots < 1) slots = 1;
+	if(slots > LATELATCH_MAXSLOTS) slots = LATELATCH_MAXSLOTS;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if(alignment < 1) alignment = 256; // The largest that GL allows
+	latch->stride = ((LATELATCH_BLOCKSIZE + alignment - 1) / alignment) * alignment;
+	latch->slots = slots;
+	latch->slot = 0;
+	glGenBuffers(1, &latch->buffer);
+	glBindBuffer(GL_UNIFORM_BUFFER, latch->buffer);
+	glBufferData(GL_UNIFORM_BUFFER, latch->stride * slots, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	if(latch->buffer == 0) {
+		printError("GL error", "Cannot create the late latch uniform buffer");
+		return 0;
+	}
+	return 1;
+}
+
+/* Delete the buffer */
+void lateLatchDelete(lateLatch *latch) {
+	if(latch->buffer) glDeleteBuffers(1, &latch->buffer);
+	latch->buffer = 0;
+}
+
+/* Connect the "LateLatch" block of a program to the buffer. Returns 0 if the program has no such block. */
+int lateLatchBind(const lateLatch *latch, GLuint program) {
+	GLuint index = glGetUniformBlockIndex(program, "LateLatch");
+
+	(void)latch;
+	if(index == GL_INVALID_INDEX) return 0;
+	glUniformBlockBinding(program, index, LATELATCH_BINDING);
+	return 1;
+}
+
+/*
+ * lateLatchWrite() - write MV to the next slot, without waiting for
+ * the GPU (the slot was last read several frames ago), and bind it
+ */
+void lateLatchWrite(lateLatch *latch, const GLfloat MV[16]) {
+	GLfloat *mapped;
+
+	latch->slot = (latch->slot + 1) % latch->slots;
+	glBindBuffer(GL_UNIFORM_BUFFER, latch->buffer);
+	mapped = (GLfloat*)glMapBufferRange(GL_UNIFORM_BUFFER, latch->slot * latch->stride, LATELATCH_BLOCKSIZE,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if(mapped) {
+		memcpy(mapped, MV, LATELATCH_BLOCKSIZE);
+		glUnmapBuffer(GL_UNIFORM_BUFFER);
+	}
+	else glBufferSubData(GL_UNIFORM_BUFFER, latch->slot * latch->stride, LATELATCH_BLOCKSIZE, MV);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferRange(GL_UNIFORM_BUFFER, LATELATCH_BINDING, latch->buffer, latch->slot * latch->stride,
+		LATELATCH_BLOCKSIZE);
+}
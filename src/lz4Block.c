@@ -0,0 +1,150 @@
+/* lz4Block.c */
+/* Compression and decompression in the LZ4 block format */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "lz4Block.h"
+
+#define LZ4_MINMATCH 4
+#define LZ4_LASTLITERALS 5   // The format requires the block to end with this many literals
+#define LZ4_MFLIMIT 12       // and the last match to start at least this far from the end
+#define LZ4_MAXOFFSET 65535
+#define LZ4_HASHBITS 12
+
+/* Largest compressed size for srcsize bytes of input */
+int lz4CompressBound(int srcsize) {
+	return srcsize + srcsize / 255 + 16;
+}
+
+static unsigned int lz4Read32(const unsigned char *p) {
+	unsigned int v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static unsigned int lz4Hash(unsigned int sequence) {
+	return (sequence * 2654435761u) >> (32 - LZ4_HASHBITS);
+}
+
+/* Write a length continuation: bytes of 255, then the rest */
+static unsigned char *lz4WriteLength(unsigned char *out, int length) {
+	while(length >= 255) {
+		*out++ = 255;
+		length -= 255;
+	}
+	*out++ = (unsigned char)length;
+	return out;
+}
+
+/*
+ * lz4Compress() - greedy compression: look up the last position where
+ * the same four bytes were seen, extend the match as far as it goes
+ * and emit it with the literals before it. Returns 0 if dst is too small.
+ */
+int lz4Compress(const unsigned char *src, int srcsize, unsigned char *dst, int dstcapacity) {
+	int *table;
+	const unsigned char *ip = src, *anchor = src, *end = src + srcsize;
+	const unsigned char *matchlimit = end - LZ4_LASTLITERALS;
+	const unsigned char *mflimit = end - LZ4_MFLIMIT;
+	unsigned char *op = dst, *token;
+	int i, literals, matchlength;
+
+	if(dstcapacity < lz4CompressBound(srcsize)) return 0;
+	table = (int*)malloc(sizeof(int) << LZ4_HASHBITS);
+	if(!table) return 0;
+	for(i = 0; i < (1 << LZ4_HASHBITS); i++) table[i] = -1;
+
+	if(srcsize >= LZ4_MFLIMIT) {
+		while(ip < mflimit) {
+			unsigned int h = lz4Hash(lz4Read32(ip));
+			const unsigned char *match = (table[h] >= 0) ? src + table[h] : NULL;
+
+			table[h] = (int)(ip - src);
+			if(!match || ip - match > LZ4_MAXOFFSET || lz4Read32(match) != lz4Read32(ip)) {
+				ip++;
+				continue;
+			}
+			// Extend the match backwards over literals, and forwards
+			while(ip > anchor && match > src && ip[-1] == match[-1]) {
+				ip--;
+				match--;
+			}
+			matchlength = LZ4_MINMATCH;
+			while(ip + matchlength < matchlimit && ip[matchlength] == match[matchlength]) matchlength++;
+
+			literals = (int)(ip - anchor);
+			token = op++;
+			*token = (unsigned char)((literals >= 15 ? 15 : literals) << 4);
+			if(literals >= 15) op = lz4WriteLength(op, literals - 15);
+			memcpy(op, anchor, literals);
+			op += literals;
+			*op++ = (unsigned char)((ip - match) & 0xff);
+			*op++ = (unsigned char)((ip - match) >> 8);
+			*token |= (unsigned char)(matchlength - LZ4_MINMATCH >= 15 ? 15 : matchlength - LZ4_MINMATCH);
+			if(matchlength - LZ4_MINMATCH >= 15) op = lz4WriteLength(op, matchlength - LZ4_MINMATCH - 15);
+
+			ip += matchlength;
+			anchor = ip;
+		}
+	}
+
+	// The rest goes out as literals
+	literals = (int)(end - anchor);
+	token = op++;
+	*token = (unsigned char)((literals >= 15 ? 15 : literals) << 4);
+	if(literals >= 15) op = lz4WriteLength(op, literals - 15);
+	memcpy(op, anchor, literals);
+	op += literals;
+
+	free(table);
+	return (int)(op - dst);
+}
+
+/*
+ * lz4Decompress() - decompress a block into exactly dstsize bytes,
+ * checking every length and offset against the buffers
+ */
+int lz4Decompress(const unsigned char *src, int srcsize, unsigned char *dst, int dstsize) {
+	const unsigned char *ip = src, *iend = src + srcsize;
+	unsigned char *op = dst, *oend = dst + dstsize;
+	const unsigned char *match;
+	int token, length, offset;
+
+	while(ip < iend) {
+		token = *ip++;
+
+		// Literals
+		length = token >> 4;
+		if(length == 15) {
+			do {
+				if(ip >= iend) return -1;
+				length += *ip;
+			} while(*ip++ == 255);
+		}
+		if(length > iend - ip || length > oend - op) return -1;
+		memcpy(op, ip, length);
+		ip += length;
+		op += length;
+		if(ip == iend) break; // The last sequence has no match
+
+		// Match
+		if(iend - ip < 2) return -1;
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if(offset == 0 || offset > op - dst) return -1;
+		match = op - offset;
+		length = (token & 15);
+		if(length == 15) {
+			do {
+				if(ip >= iend) return -1;
+				length += *ip;
+			} while(*ip++ == 255);
+		}
+		length += LZ4_MINMATCH;
+		if(length > oend - op) return -1;
+		// Byte by byte, since the match may overlap what it produces
+		while(length-- > 0) *op++ = *match++;
+	}
+	return (op == oend) ? dstsize : -1;
+}
@@ -0,0 +1,78 @@
+/* mappedFile.c */
+/* A whole file in memory, mapped where the system can, read where it cannot */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef __WIN32__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "mappedFile.h"
+
+/*
+ * mappedFileOpen() - map the whole file, or read it where there is no
+ * mmap(). Returns 1 on success.
+ */
+int mappedFileOpen(mappedFile *file, const char *filename) {
+#ifndef __WIN32__
+	struct stat info;
+	void *data;
+	int fd = open(filename, O_RDONLY);
+
+	file->data = NULL;
+	file->size = 0;
+	file->mapped = 0;
+	if(fd < 0) return 0;
+	if(fstat(fd, &info) != 0 || info.st_size <= 0) {
+		close(fd);
+		return 0;
+	}
+	data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); // The mapping stays valid
+	if(data == MAP_FAILED) return 0;
+	file->data = (const unsigned char*)data;
+	file->size = info.st_size;
+	file->mapped = 1;
+	return 1;
+#else
+	FILE *stream = fopen(filename, "rb");
+	unsigned char *data;
+	long size;
+
+	file->data = NULL;
+	file->size = 0;
+	file->mapped = 0;
+	if(stream == NULL) return 0;
+	fseek(stream, 0, SEEK_END);
+	size = ftell(stream);
+	fseek(stream, 0, SEEK_SET);
+	data = (unsigned char*)malloc(size > 0 ? size : 1);
+	if(!data || size <= 0 || fread(data, 1, size, stream) != (size_t)size) {
+		free(data);
+		fclose(stream);
+		return 0;
+	}
+	fclose(stream);
+	file->data = data;
+	file->size = size;
+	return 1;
+#endif
+}
+
+/* Unmap or free the file */
+void mappedFileClose(mappedFile *file) {
+	if(file->data) {
+#ifndef __WIN32__
+		if(file->mapped) munmap((void*)file->data, (size_t)file->size);
+		else
+#endif
+		free((void*)file->data);
+	}
+	file->data = NULL;
+	file->size = 0;
+	file->mapped = 0;
+}
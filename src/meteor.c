@@ -0,0 +1,157 @@
+/*
+ * meteor.c - the meteor look of the shaders, evaluated on the CPU.
+ *
+ * The displacement in the vertex shader depends only on the rest
+ * position of each vertex, not on time, so it can be computed once
+ * and stored with the mesh. A shader compiled with BAKED_DISPLACEMENT
+ * then reads it as a vertex attribute instead of evaluating a dozen
+ * noise functions per vertex and frame. The gradient of the
+ * displacement, which bends the normal, is baked along with it.
+ *
+ * meteorShade() is the fragment shader, for the software renderer.
+ * The code here must be kept in step with main() in the two shaders.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <GLFW/glfw3.h>
+
+#include "meteor.h"
+#include "noise.h"
+#include "trace.h"
+
+#define METEOR_BAKECHUNK 4096 // Vertices per bake job
+
+/* A bake in progress, for the jobs */
+typedef struct {
+	const triangleSoup *soup;
+	int octaves;
+	GLfloat *displacement;
+} meteorBake;
+
+/*
+ * meteorDisplacement(x, y, z, octaves, gradient) - offset along the
+ * normal, and its gradient if gradient is not NULL. octaves is the
+ * number of fBm octaves, OCTAVES in the shader.
+ */
+float meteorDisplacement(float x, float y, float z, int octaves, float gradient[3]) {
+	float classicalnoise, elevation, freq = 1.0f;
+	float noisegradient[3], classicalgradient[3], elevationgradient[3];
+	int octave, c;
+
+	classicalnoise = noiseClassic4Grad(x, y, z, 1.0f, classicalgradient);
+	elevation = noiseSimplex3Grad(1.6f*x - 0.5f, 1.6f*y - 0.5f, 1.6f*z - 0.5f, noisegradient);
+	for(c=0; c<3; c++) elevationgradient[c] = 1.6f * noisegradient[c];
+	for(octave=0; octave<octaves; octave++) {
+		elevation += 0.5f/freq*(noiseSimplex3Grad(x*4.0f*freq, y*4.0f*freq, z*4.0f*freq, noisegradient)-0.5f);
+		for(c=0; c<3; c++) elevationgradient[c] += 2.0f * noisegradient[c];
+		freq *= 2.0f;
+	}
+	if(gradient) {
+		for(c=0; c<3; c++)
+			gradient[c] = 0.02f * 10.0f * classicalgradient[c] + 10.0f * 0.01f * elevationgradient[c];
+	}
+	return 0.02f * 10.0f * classicalnoise + 10.0f * elevation * 0.01f;
+}
+
+/*
+ * meteorBendNormal(normal, gradient, bent) - tilt the normal against the
+ * part of the gradient in the tangent plane, as the vertex shader does
+ */
+void meteorBendNormal(const float normal[3], const float gradient[3], float bent[3]) {
+	float n[3], length, along;
+	int c;
+
+	length = sqrtf(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+	for(c=0; c<3; c++) n[c] = (length > 0.0f) ? normal[c] / length : 0.0f;
+	along = gradient[0]*n[0] + gradient[1]*n[1] + gradient[2]*n[2];
+	for(c=0; c<3; c++) bent[c] = n[c] - (gradient[c] - along * n[c]);
+	length = sqrtf(bent[0]*bent[0] + bent[1]*bent[1] + bent[2]*bent[2]);
+	for(c=0; c<3; c++) bent[c] = (length > 0.0f) ? bent[c] / length : 0.0f;
+}
+
+/* Bake the vertices begin to end-1 */
+static void meteorBakeTask(void *data, int begin, int end, int thread) {
+	meteorBake *bake = (meteorBake*)data;
+	const GLfloat *v;
+	GLfloat *out;
+	int i;
+
+	(void)thread;
+	for(i=begin; i<end; i++) {
+		v = bake->soup->vertexarray + 8*i;
+		out = bake->displacement + METEOR_BAKEDFLOATS*i;
+		out[0] = meteorDisplacement(v[0], v[1], v[2], bake->octaves, out + 1);
+	}
+}
+
+/*
+ * meteorBakeDisplacement(soup, octaves, jobs) - displacement and its
+ * gradient for every vertex, spread over jobs if it is not NULL. The soup must still have
+ * its vertex array (residency SOUP_KEEP). The array is malloc()ed, and
+ * is meant for soupSetAttribute().
+ */
+GLfloat *meteorBakeDisplacement(const triangleSoup *soup, int octaves, jobSystem *jobs) {
+	meteorBake bake;
+
+	if(soup->vertexarray == NULL) {
+		fprintf(stderr, "meteorBakeDisplacement: the vertex array has been released.\n");
+		return NULL;
+	}
+	TRACE_ZONE("meteorBakeDisplacement");
+	bake.soup = soup;
+	bake.octaves = octaves;
+	bake.displacement = (GLfloat*)malloc((size_t)METEOR_BAKEDFLOATS * soup->nverts * sizeof(GLfloat));
+	if(bake.displacement == NULL) return NULL;
+	if(jobs) jobParallelFor(jobs, 0, soup->nverts, METEOR_BAKECHUNK, meteorBakeTask, &bake);
+	else meteorBakeTask(&bake, 0, soup->nverts, 0);
+	return bake.displacement;
+}
+
+static float smoothstep(float edge0, float edge1, float x) {
+	float t = (x - edge0) / (edge1 - edge0);
+	t = (t < 0.0f) ? 0.0f : (t > 1.0f) ? 1.0f : t;
+	return t*t*(3.0f - 2.0f*t);
+}
+
+/*
+ * meteorShade(pos, normal, time, f1only, rgb) - the fragment shader
+ */
+void meteorShade(const float pos[3], const float normal[3], float time, int f1only, float rgb[3]) {
+	float F[2], f, offset, variety, lavanoise, surfacenoise, surface, lava[3], t;
+	float L[3], R[3], length, NdotL, specularLight, diffuselighting;
+	int c;
+
+	offset = 0.003f * sinf(1.2f*time);
+	noiseCellular3(pos[0] + offset, pos[1] + offset, pos[2] + offset, F);
+	f = f1only ? 0.0f : F[1] - F[0]; // Only F1, duplicated, with CELLULAR_F1_ONLY
+
+	variety = fmaxf(0.2f, fabsf(time));
+	lavanoise = noiseSimplex4(7.0f * pos[0], 2.0f * pos[1], 0.7f * pos[2], 0.18f * variety);
+	surfacenoise = noiseSimplex4(0.5f * pos[0], 0.7f * pos[1], 1.0f * pos[2], 1.0f);
+
+	surface = 0.2f - 0.1f * fabsf(sinf(1.3f*surfacenoise));
+	lava[0] = 0.8f + fabsf(lavanoise);
+	lava[1] = 0.15f + 1.0f * lavanoise;
+	lava[2] = 0.0f;
+	t = 1.0f - smoothstep(0.03f + 0.01f * sinf(1.5f*time), 0.05f, f);
+
+	// Specular light: reflect() with the unnormalized normal, as in the shader
+	length = sqrtf(0.8f*0.8f + 0.5f*0.5f + 1.0f*1.0f);
+	L[0] = 0.8f / length;
+	L[1] = 0.5f / length;
+	L[2] = 1.0f / length;
+	NdotL = normal[0]*L[0] + normal[1]*L[1] + normal[2]*L[2];
+	for(c=0; c<3; c++) R[c] = L[c] - 2.0f * NdotL * normal[c];
+	length = sqrtf(R[0]*R[0] + R[1]*R[1] + R[2]*R[2]);
+	specularLight = (length > 0.0f) ? fmaxf(0.0f, -R[2] / length) : 0.0f;
+	specularLight = powf(specularLight, 2.5f);
+
+	length = sqrtf(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+	diffuselighting = (length > 0.0f) ? fmaxf(0.0f, normal[2] / length) : 0.0f;
+
+	rgb[0] = (surface + (lava[0] - surface) * t) * diffuselighting + specularLight * 1.0f * 0.3f;
+	rgb[1] = (surface + (lava[1] - surface) * t) * diffuselighting + specularLight * 0.7f * 0.3f;
+	rgb[2] = (surface + (lava[2] - surface) * t) * diffuselighting + specularLight * 0.4f * 0.3f;
+}
@@ -0,0 +1,306 @@
+/*
+ * noise.c - CPU versions of the GLSL noise functions used by the shaders.
+ *
+ * The shaders compute several corners at once in vec4 registers. Here
+ * each corner is done in turn, but with the same arithmetic in the same
+ * order, so the results agree with the GPU to within float rounding.
+ *
+ * Original GLSL code:
+ * Copyright (c) 2011 Stefan Gustavson, Ashima Arts. All rights reserved.
+ * Distributed under the MIT license.
+ * https://github.com/stegu/webgl-noise
+ */
+
+#include <stddef.h>
+#include <math.h>
+
+#include "noise.h"
+
+static float mod289(float x) {
+	return x - floorf(x * (1.0f / 289.0f)) * 289.0f;
+}
+
+static float permute(float x) {
+	return mod289(((x*34.0f)+1.0f)*x);
+}
+
+static float taylorInvSqrt(float r) {
+	return 1.79284291400159f - 0.85373472095314f * r;
+}
+
+static float fract(float x) {
+	return x - floorf(x);
+}
+
+static float fade(float t) {
+	return t*t*t*(t*(t*6.0f-15.0f)+10.0f);
+}
+
+static float dfade(float t) {
+	return 30.0f*t*t*(t*(t-2.0f)+1.0f);
+}
+
+
+/*
+ * noiseSimplex3(x, y, z) - 3D simplex noise
+ */
+float noiseSimplex3(float x, float y, float z) {
+	return noiseSimplex3Grad(x, y, z, NULL);
+}
+
+/*
+ * noiseSimplex3Grad(x, y, z, gradient) - 3D simplex noise and its
+ * gradient, like snoise(v, gradient). gradient may be NULL.
+ */
+float noiseSimplex3Grad(float x, float y, float z, float gradient[3]) {
+	const float Cx = 1.0f/6.0f, Cy = 1.0f/3.0f;
+	float v[3] = { x, y, z };
+	float i[3], x0[3], xk[3], g[3], l[3], i1[3], i2[3], offset[4][3], dsum[3] = { 0.0f, 0.0f, 0.0f };
+	float s, t, p, j, x_, y_, gx, gy, h, sh, norm, m, m2, pdotx, sum = 0.0f;
+	int c, k;
+
+	// First corner
+	s = (v[0] + v[1] + v[2]) * Cy;
+	for(c=0; c<3; c++) i[c] = floorf(v[c] + s);
+	t = (i[0] + i[1] + i[2]) * Cx;
+	for(c=0; c<3; c++) x0[c] = v[c] - i[c] + t;
+
+	// Other corners
+	for(c=0; c<3; c++) {
+		g[c] = (x0[c] >= x0[(c+1)%3]) ? 1.0f : 0.0f; // step(x0.yzx, x0.xyz)
+		l[c] = 1.0f - g[c];
+	}
+	for(c=0; c<3; c++) {
+		i1[c] = fminf(g[c], l[(c+2)%3]); // min(g.xyz, l.zxy)
+		i2[c] = fmaxf(g[c], l[(c+2)%3]);
+		offset[0][c] = 0.0f;
+		offset[1][c] = i1[c];
+		offset[2][c] = i2[c];
+		offset[3][c] = 1.0f;
+	}
+
+	for(c=0; c<3; c++) i[c] = mod289(i[c]);
+	for(k=0; k<4; k++) {
+		// Offset of this corner from x0, as for x1, x2 and x3 in the shader
+		for(c=0; c<3; c++) {
+			if(k == 0) xk[c] = x0[c];
+			else if(k == 1) xk[c] = x0[c] - i1[c] + Cx;
+			else if(k == 2) xk[c] = x0[c] - i2[c] + Cy;
+			else xk[c] = x0[c] - 0.5f;
+		}
+
+		// Permutations
+		p = permute(permute(permute(i[2] + offset[k][2])
+			+ i[1] + offset[k][1]) + i[0] + offset[k][0]);
+
+		// Gradients: 7x7 points over a square, mapped onto an octahedron
+		j = p - 49.0f * floorf(p * (1.0f/7.0f) * (1.0f/7.0f));
+		x_ = floorf(j * (1.0f/7.0f));
+		y_ = floorf(j - 7.0f * x_);
+		gx = x_ * (2.0f/7.0f) + (0.5f/7.0f - 1.0f);
+		gy = y_ * (2.0f/7.0f) + (0.5f/7.0f - 1.0f);
+		h = 1.0f - fabsf(gx) - fabsf(gy);
+		sh = (h <= 0.0f) ? -1.0f : 0.0f;
+		gx = gx + (floorf(gx)*2.0f + 1.0f) * sh;
+		gy = gy + (floorf(gy)*2.0f + 1.0f) * sh;
+
+		// Normalise the gradient, and mix in the contribution and its derivative
+		norm = taylorInvSqrt(gx*gx + gy*gy + h*h);
+		gx *= norm;
+		gy *= norm;
+		h *= norm;
+		m = fmaxf(0.6f - (xk[0]*xk[0] + xk[1]*xk[1] + xk[2]*xk[2]), 0.0f);
+		m2 = m * m;
+		pdotx = gx*xk[0] + gy*xk[1] + h*xk[2];
+		sum += m2 * m2 * pdotx;
+		for(c=0; c<3; c++) dsum[c] -= 8.0f * m2 * m * pdotx * xk[c];
+		dsum[0] += m2 * m2 * gx;
+		dsum[1] += m2 * m2 * gy;
+		dsum[2] += m2 * m2 * h;
+	}
+	if(gradient) for(c=0; c<3; c++) gradient[c] = 42.0f * dsum[c];
+	return 42.0f * sum;
+}
+
+
+/*
+ * noiseClassic4(x, y, z, w) - 4D classic Perlin noise
+ */
+float noiseClassic4(float x, float y, float z, float w) {
+	return noiseClassic4Grad(x, y, z, w, NULL);
+}
+
+/*
+ * noiseClassic4Grad(x, y, z, w, gradient) - 4D classic Perlin noise and
+ * its gradient with respect to x, y and z, like cnoise(P, gradient).
+ * gradient may be NULL.
+ */
+float noiseClassic4Grad(float x, float y, float z, float w, float gradient[3]) {
+	float P[4] = { x, y, z, w };
+	float Pi0[4], Pi1[4], Pf0[4], Pf1[4], f[4], df[4], g[4], d[4], dsum[3] = { 0.0f, 0.0f, 0.0f };
+	float hash, gw, sw, n, norm, weight, dweight, sum = 0.0f;
+	int corner, c, k;
+
+	for(c=0; c<4; c++) {
+		Pi0[c] = floorf(P[c]);
+		Pi1[c] = mod289(Pi0[c] + 1.0f);
+		Pi0[c] = mod289(Pi0[c]);
+		Pf0[c] = fract(P[c]);
+		Pf1[c] = Pf0[c] - 1.0f;
+		f[c] = fade(Pf0[c]);
+		df[c] = dfade(Pf0[c]);
+	}
+
+	// Bit c of corner chooses between the lower and upper lattice point
+	for(corner=0; corner<16; corner++) {
+		hash = permute((corner & 1) ? Pi1[0] : Pi0[0]);
+		hash = permute(hash + ((corner & 2) ? Pi1[1] : Pi0[1]));
+		hash = permute(hash + ((corner & 4) ? Pi1[2] : Pi0[2]));
+		hash = permute(hash + ((corner & 8) ? Pi1[3] : Pi0[3]));
+
+		g[0] = hash * (1.0f / 7.0f);
+		g[1] = floorf(g[0]) * (1.0f / 7.0f);
+		g[2] = floorf(g[1]) * (1.0f / 6.0f);
+		g[0] = fract(g[0]) - 0.5f;
+		g[1] = fract(g[1]) - 0.5f;
+		g[2] = fract(g[2]) - 0.5f;
+		gw = 0.75f - fabsf(g[0]) - fabsf(g[1]) - fabsf(g[2]);
+		sw = (gw <= 0.0f) ? 1.0f : 0.0f;
+		g[0] -= sw * ((g[0] >= 0.0f ? 1.0f : 0.0f) - 0.5f);
+		g[1] -= sw * ((g[1] >= 0.0f ? 1.0f : 0.0f) - 0.5f);
+		g[3] = gw;
+
+		weight = 1.0f;
+		for(c=0; c<4; c++) {
+			d[c] = (corner & (1 << c)) ? Pf1[c] : Pf0[c];
+			weight *= (corner & (1 << c)) ? f[c] : 1.0f - f[c];
+		}
+		norm = taylorInvSqrt(g[0]*g[0] + g[1]*g[1] + g[2]*g[2] + g[3]*g[3]);
+		n = norm * (g[0]*d[0] + g[1]*d[1] + g[2]*d[2] + g[3]*d[3]);
+		sum += weight * n;
+
+		// The corner gradient, blended like the value, and the change of the weight
+		for(c=0; c<3; c++) {
+			dweight = (corner & (1 << c)) ? df[c] : -df[c];
+			for(k=0; k<4; k++) {
+				if(k != c) dweight *= (corner & (1 << k)) ? f[k] : 1.0f - f[k];
+			}
+			dsum[c] += weight * norm * g[c] + dweight * n;
+		}
+	}
+	if(gradient) for(c=0; c<3; c++) gradient[c] = 2.2f * dsum[c];
+	return 2.2f * sum;
+}
+
+
+/*
+ * grad4() - gradient for 4D simplex noise from a permuted index j
+ */
+static void grad4(float j, float p[4]) {
+	const float ip[3] = { 1.0f/294.0f, 1.0f/49.0f, 1.0f/7.0f };
+	int c;
+
+	for(c=0; c<3; c++) p[c] = floorf(fract(j * ip[c]) * 7.0f) * ip[2] - 1.0f;
+	p[3] = 1.5f - (fabsf(p[0]) + fabsf(p[1]) + fabsf(p[2]));
+	if(p[3] < 0.0f) {
+		for(c=0; c<3; c++) p[c] += (p[c] < 0.0f) ? 1.0f : -1.0f;
+	}
+}
+
+/*
+ * noiseSimplex4(x, y, z, w) - 4D simplex noise
+ */
+float noiseSimplex4(float x, float y, float z, float w) {
+	const float F4 = 0.309016994374947451f;
+	const float C[4] = { 0.138196601125011f, 0.276393202250021f,
+		0.414589803375032f, -0.447213595499958f };
+	float v[4] = { x, y, z, w };
+	float i[4], x0[4], i0[4], ik[4][4], xk[4], g[4], s, t, j, m, sum = 0.0f;
+	float isX[3], isYZ[3];
+	int c, k;
+
+	// First corner
+	s = (v[0] + v[1] + v[2] + v[3]) * F4;
+	for(c=0; c<4; c++) i[c] = floorf(v[c] + s);
+	t = (i[0] + i[1] + i[2] + i[3]) * C[0];
+	for(c=0; c<4; c++) x0[c] = v[c] - i[c] + t;
+
+	// Rank sorting, to find the order of the other corners
+	for(c=0; c<3; c++) isX[c] = (x0[0] >= x0[c+1]) ? 1.0f : 0.0f;
+	isYZ[0] = (x0[1] >= x0[2]) ? 1.0f : 0.0f;
+	isYZ[1] = (x0[1] >= x0[3]) ? 1.0f : 0.0f;
+	isYZ[2] = (x0[2] >= x0[3]) ? 1.0f : 0.0f;
+	i0[0] = isX[0] + isX[1] + isX[2];
+	i0[1] = 1.0f - isX[0] + isYZ[0] + isYZ[1];
+	i0[2] = 1.0f - isX[1] + 1.0f - isYZ[0] + isYZ[2];
+	i0[3] = 1.0f - isX[2] + 1.0f - isYZ[1] + 1.0f - isYZ[2];
+
+	// Offsets of corners 1 to 4: i1, i2, i3 and all ones
+	for(c=0; c<4; c++) {
+		ik[0][c] = fminf(fmaxf(i0[c] - 2.0f, 0.0f), 1.0f);
+		ik[1][c] = fminf(fmaxf(i0[c] - 1.0f, 0.0f), 1.0f);
+		ik[2][c] = fminf(fmaxf(i0[c], 0.0f), 1.0f);
+		ik[3][c] = 1.0f;
+	}
+
+	for(c=0; c<4; c++) i[c] = mod289(i[c]);
+	for(k=0; k<5; k++) {
+		if(k == 0) {
+			for(c=0; c<4; c++) xk[c] = x0[c];
+			j = permute(permute(permute(permute(i[3]) + i[2]) + i[1]) + i[0]);
+		}
+		else {
+			for(c=0; c<4; c++) xk[c] = (k < 4) ? x0[c] - ik[k-1][c] + C[k-1] : x0[c] + C[3];
+			j = permute(permute(permute(permute(i[3] + ik[k-1][3])
+				+ i[2] + ik[k-1][2]) + i[1] + ik[k-1][1]) + i[0] + ik[k-1][0]);
+		}
+		grad4(j, g);
+		m = fmaxf(0.6f - (xk[0]*xk[0] + xk[1]*xk[1] + xk[2]*xk[2] + xk[3]*xk[3]), 0.0f);
+		m = m * m;
+		sum += m * m * taylorInvSqrt(g[0]*g[0] + g[1]*g[1] + g[2]*g[2] + g[3]*g[3])
+			* (g[0]*xk[0] + g[1]*xk[1] + g[2]*xk[2] + g[3]*xk[3]);
+	}
+	return 49.0f * sum;
+}
+
+
+/*
+ * noiseCellular3(x, y, z, F) - 3D cellular ("Worley") noise.
+ * One jittered feature point per unit cell, and the 3x3x3 cells around
+ * the one that (x, y, z) is in are searched for the two nearest.
+ */
+void noiseCellular3(float x, float y, float z, float F[2]) {
+	const float K = 0.142857142857f;   // 1/7
+	const float Ko = 0.428571428571f;  // 1/2-K/2
+	const float K2 = 0.020408163265306f; // 1/(7*7)
+	const float Kz = 0.166666666667f;  // 1/6
+	const float Kzo = 0.416666666667f; // 1/2-1/6*2
+	float Pi[3], Pf[3], p, dx, dy, dz, d, d1 = 1e10f, d2 = 1e10f;
+	int i, j, k;
+
+	Pi[0] = mod289(floorf(x));
+	Pi[1] = mod289(floorf(y));
+	Pi[2] = mod289(floorf(z));
+	Pf[0] = fract(x) - 0.5f;
+	Pf[1] = fract(y) - 0.5f;
+	Pf[2] = fract(z) - 0.5f;
+
+	for(i=-1; i<=1; i++) {
+		for(j=-1; j<=1; j++) {
+			for(k=-1; k<=1; k++) {
+				p = permute(permute(permute(Pi[0] + i) + Pi[1] + j) + Pi[2] + k);
+				dx = Pf[0] - i + (fract(p*K) - Ko);
+				dy = Pf[1] - j + (floorf(p*K) - floorf(floorf(p*K) * (1.0f/7.0f)) * 7.0f) * K - Ko;
+				dz = Pf[2] - k + floorf(p*K2)*Kz - Kzo;
+				d = dx*dx + dy*dy + dz*dz;
+				if(d < d1) {
+					d2 = d1;
+					d1 = d;
+				}
+				else if(d < d2) d2 = d;
+			}
+		}
+	}
+	F[0] = sqrtf(d1);
+	F[1] = sqrtf(d2);
+}
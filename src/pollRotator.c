@@ -6,6 +6,7 @@
 void initRotatorKey(rotatorKey *state) {
      state->phi = 0.0;
      state->theta = 0.0;
+     state->keys = 0;
 };
 
 void pollRotatorKey(GLFWwindow *window, rotatorKey *state) {
@@ -42,6 +43,10 @@ void pollRotatorKey(GLFWwindow *window, rotatorKey *state) {
 void initRotatorMouse(rotatorMouse *state) {
      state->phi = 0.0;
      state->theta = 0.0;
+     state->lastLeft = 0;
+     state->lastRight = 0;
+     state->windowWidth = 1;
+     state->windowHeight = 1;
 }
 
 void pollRotatorMouse(GLFWwindow *window, rotatorMouse *state) {
@@ -77,3 +82,85 @@ void pollRotatorMouse(GLFWwindow *window, rotatorMouse *state) {
   state->lastY = thisY;  
 }
 
+
+void rotatorKeyEvent(rotatorKey *state, const inputEvent *event) {
+
+	int bit;
+
+	if(event->type != INPUT_KEY || event->action == GLFW_REPEAT) return;
+	switch(event->key) {
+		case GLFW_KEY_RIGHT: bit = ROTATOR_RIGHT; break;
+		case GLFW_KEY_LEFT: bit = ROTATOR_LEFT; break;
+		case GLFW_KEY_UP: bit = ROTATOR_UP; break;
+		case GLFW_KEY_DOWN: bit = ROTATOR_DOWN; break;
+		default: return;
+	}
+	if(event->action == GLFW_PRESS) {
+		if(!state->keys) state->lastTime = glfwGetTime(); // Start timing from the first key down
+		state->keys |= bit;
+	}
+	else state->keys &= ~bit;
+}
+
+void updateRotatorKey(rotatorKey *state) {
+
+	double thisTime, elapsedTime;
+
+	if(!state->keys) return; // Nothing held down, nothing to do
+
+	thisTime = glfwGetTime();
+	elapsedTime = thisTime - state->lastTime;
+	state->lastTime = thisTime;
+
+	if(state->keys & ROTATOR_RIGHT) {
+		state->phi += elapsedTime*90.0; // Rotate 90 degrees per second
+		state->phi = fmod(state->phi, 360.0); // Wrap around at 360.0
+	}
+
+	if(state->keys & ROTATOR_LEFT) {
+		state->phi -= elapsedTime*90.0; // Rotate 90 degrees per second
+		state->phi = fmod(state->phi, 360.0);
+		if (state->phi < 0.0) state->phi += 360.0; // If phi<0, then fmod(phi,360)<0
+	}
+
+	if(state->keys & ROTATOR_UP) {
+		state->theta += elapsedTime*90.0; // Rotate 90 degrees per second
+		if (state->theta >= 90.0) state->theta = 90.0; // Clamp at 90
+	}
+
+	if(state->keys & ROTATOR_DOWN) {
+		state->theta -= elapsedTime*90.0; // Rotate 90 degrees per second
+		if (state->theta < -90.0) state->theta = -90.0;      // Clamp at -90
+	}
+}
+
+void rotatorMouseEvent(rotatorMouse *state, const inputEvent *event) {
+
+  double moveX;
+  double moveY;
+
+  switch(event->type) {
+  case INPUT_RESIZE:
+    state->windowWidth = (event->x > 0) ? (int)event->x : 1;
+    state->windowHeight = (event->y > 0) ? (int)event->y : 1;
+    break;
+  case INPUT_BUTTON:
+    if(event->key == GLFW_MOUSE_BUTTON_LEFT) state->lastLeft = (event->action == GLFW_PRESS);
+    if(event->key == GLFW_MOUSE_BUTTON_RIGHT) state->lastRight = (event->action == GLFW_PRESS);
+    break;
+  case INPUT_CURSOR:
+    if(state->lastLeft) { // If a left button drag is in progress
+      moveX = event->x - state->lastX;
+      moveY = event->y - state->lastY;
+      state->phi += 180.0 * moveX/state->windowWidth; // Longest drag rotates 180 degrees
+      if (state->phi >= 360.0) state->phi = fmod(state->phi, 360.0);
+      if (state->phi < 0.0) state->phi += 360.0; // If phi<0, then fmod(phi,360)<0
+      state->theta += 180.0 * moveY/state->windowHeight; // Longest drag rotates 180 deg
+      if (state->theta >= 90.0) state->theta = 90.0; // Clamp at 90
+      if (state->theta < -90.0) state->theta = -90.0;      // Clamp at -90
+    }
+    state->lastX = event->x;
+    state->lastY = event->y;
+    break;
+  }
+}
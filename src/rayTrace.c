@@ -0,0 +1,488 @@
+/* rayTrace.c */
+/* A CPU ray tracer for reference images of a displaced triangleSoup */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <GLFW/glfw3.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "tnm084.h" // For printError()
+#include "rayTrace.h"
+#include "meteor.h"
+#include "trace.h"
+#include "arena.h"
+
+#define RAYTRACE_STACKSIZE 64 // Deepest hierarchy that can be traversed
+#define RAYTRACE_EPSILON 1e-7f
+
+/* Four rays from the eye, which is at the origin in view space */
+typedef struct {
+	float dx[4], dy[4], dz[4];    // Directions
+	float ix[4], iy[4], iz[4];    // Their reciprocals, for the box tests
+	float t[4];                   // Distance to the nearest hit so far
+	float u[4], v[4];             // Barycentric coordinates of that hit
+	int tri[4];                   // Triangle hit, or -1
+} rayPacket;
+
+/* Scratch data while building the hierarchy */
+typedef struct {
+	rayScene *scene;
+	const float *vertices; // Displaced view space positions, 3 per vertex
+	int *order;            // Triangle indices, partitioned as the tree is built
+	float *centroids;      // 3 per triangle
+	float *bounds;         // 6 per triangle: min xyz, max xyz
+} rayBuilder;
+
+
+/*
+ * rayBuildNode() - fill in a node for the triangles order[first] to
+ * order[first+count-1], and the subtree below it. The triangles are
+ * split in the middle of their centroids along the longest axis.
+ */
+static void rayBuildNode(rayBuilder *b, int node, int first, int count) {
+	rayNode *n = b->scene->nodes + node;
+	float cmin[3], cmax[3], mid, *c;
+	int i, k, axis, left, tmp, children;
+
+	for(k=0; k<3; k++) {
+		n->bmin[k] = cmin[k] = 1e30f;
+		n->bmax[k] = cmax[k] = -1e30f;
+	}
+	for(i=first; i<first+count; i++) {
+		c = b->centroids + 3*b->order[i];
+		for(k=0; k<3; k++) {
+			n->bmin[k] = fminf(n->bmin[k], b->bounds[6*b->order[i]+k]);
+			n->bmax[k] = fmaxf(n->bmax[k], b->bounds[6*b->order[i]+3+k]);
+			cmin[k] = fminf(cmin[k], c[k]);
+			cmax[k] = fmaxf(cmax[k], c[k]);
+		}
+	}
+	if(count <= RAYTRACE_LEAFSIZE) {
+		n->first = first;
+		n->count = count;
+		return;
+	}
+
+	axis = 0;
+	if(cmax[1] - cmin[1] > cmax[axis] - cmin[axis]) axis = 1;
+	if(cmax[2] - cmin[2] > cmax[axis] - cmin[axis]) axis = 2;
+	mid = 0.5f * (cmin[axis] + cmax[axis]);
+	left = first;
+	for(i=first; i<first+count; i++) {
+		if(b->centroids[3*b->order[i]+axis] < mid) {
+			tmp = b->order[i];
+			b->order[i] = b->order[left];
+			b->order[left++] = tmp;
+		}
+	}
+	// All centroids on one side (e.g. all equal): split by count instead
+	if(left == first || left == first+count) left = first + count/2;
+
+	children = b->scene->nnodes;
+	b->scene->nnodes += 2;
+	n->first = children;
+	n->count = 0;
+	rayBuildNode(b, children, first, left - first);
+	rayBuildNode(b, children+1, left, first + count - left);
+}
+
+/*
+ * rayTraceBuild(scene, soup, MV, shading) - set up a scene for tracing.
+ * The soup must have its vertex and index arrays in main memory.
+ */
+int rayTraceBuild(rayScene *scene, const triangleSoup *soup, const GLfloat MV[16], const softShading *shading) {
+	rayBuilder b;
+	arena *scratch;
+	long mark;
+	float *vertices, p[3], d, gradient[3], normal[3], *a, *v1, *v2;
+	const GLfloat *in;
+	int i, k, r;
+
+	memset(scene, 0, sizeof(rayScene));
+	if(soup->vertexarray == NULL || soup->indexarray == NULL) {
+		fprintf(stderr, "rayTraceBuild: the soup arrays have been released.\n");
+		return 0;
+	}
+	TRACE_ZONE("rayTraceBuild");
+	scene->shading = *shading;
+	scene->ntriangles = soup->ntris;
+	// What only the build needs comes from the scratch arena, the scene from the heap
+	scratch = arenaScratch();
+	mark = arenaMark(scratch);
+	vertices = (float*)arenaAlloc(scratch, 3L * soup->nverts * sizeof(float));
+	scene->pos = (float*)malloc(3 * soup->nverts * sizeof(float));
+	scene->normal = (float*)malloc(3 * soup->nverts * sizeof(float));
+	scene->triangles = (rayTriangle*)malloc(soup->ntris * sizeof(rayTriangle));
+	scene->nodes = (rayNode*)malloc((2 * soup->ntris + 1) * sizeof(rayNode));
+	b.scene = scene;
+	b.vertices = vertices;
+	b.order = (int*)arenaAlloc(scratch, soup->ntris * sizeof(int));
+	b.centroids = (float*)arenaAlloc(scratch, 3L * soup->ntris * sizeof(float));
+	b.bounds = (float*)arenaAlloc(scratch, 6L * soup->ntris * sizeof(float));
+	if(!vertices || !scene->pos || !scene->normal || !scene->triangles || !scene->nodes
+		|| !b.order || !b.centroids || !b.bounds) {
+		printError("Memory error", "Cannot allocate ray tracing scene");
+		arenaRelease(scratch, mark);
+		arenaTrim(scratch);
+		rayTraceDelete(scene);
+		return 0;
+	}
+
+	// The vertex shader: displace, and move to view space
+	for(i=0; i<soup->nverts; i++) {
+		in = soup->vertexarray + 8*i;
+		if(shading->displacement) {
+			d = shading->displacement[METEOR_BAKEDFLOATS*i];
+			for(k=0; k<3; k++) gradient[k] = shading->displacement[METEOR_BAKEDFLOATS*i+1+k];
+		}
+		else d = meteorDisplacement(in[0], in[1], in[2], shading->octaves, gradient);
+		for(k=0; k<3; k++) p[k] = in[k] + d * in[3+k];
+		meteorBendNormal(in + 3, gradient, normal);
+		for(r=0; r<3; r++) {
+			vertices[3*i+r] = MV[r]*p[0] + MV[4+r]*p[1] + MV[8+r]*p[2] + MV[12+r];
+			scene->normal[3*i+r] = MV[r]*normal[0] + MV[4+r]*normal[1] + MV[8+r]*normal[2];
+			scene->pos[3*i+r] = in[r];
+		}
+	}
+
+	for(i=0; i<soup->ntris; i++) {
+		a = vertices + 3*soup->indexarray[3*i];
+		v1 = vertices + 3*soup->indexarray[3*i+1];
+		v2 = vertices + 3*soup->indexarray[3*i+2];
+		b.order[i] = i;
+		for(k=0; k<3; k++) {
+			b.centroids[3*i+k] = (a[k] + v1[k] + v2[k]) / 3.0f;
+			b.bounds[6*i+k] = fminf(a[k], fminf(v1[k], v2[k]));
+			b.bounds[6*i+3+k] = fmaxf(a[k], fmaxf(v1[k], v2[k]));
+		}
+	}
+	scene->nnodes = 1;
+	if(soup->ntris > 0) rayBuildNode(&b, 0, 0, soup->ntris);
+	else memset(scene->nodes, 0, sizeof(rayNode));
+
+	// Store the triangles in tree order, so that leaves are contiguous
+	for(i=0; i<soup->ntris; i++) {
+		rayTriangle *t = scene->triangles + i;
+		for(k=0; k<3; k++) t->v[k] = soup->indexarray[3*b.order[i]+k];
+		a = vertices + 3*t->v[0];
+		v1 = vertices + 3*t->v[1];
+		v2 = vertices + 3*t->v[2];
+		for(k=0; k<3; k++) {
+			t->v0[k] = a[k];
+			t->e1[k] = v1[k] - a[k];
+			t->e2[k] = v2[k] - a[k];
+		}
+	}
+
+	arenaRelease(scratch, mark);
+	arenaTrim(scratch);
+	return 1;
+}
+
+/* Free a scene */
+void rayTraceDelete(rayScene *scene) {
+	free(scene->nodes);
+	free(scene->triangles);
+	free(scene->pos);
+	free(scene->normal);
+	memset(scene, 0, sizeof(rayScene));
+}
+
+
+/*
+ * rayPacketHitsBox() - nonzero if any ray in the packet enters the box
+ * closer than its nearest hit so far
+ */
+static int rayPacketHitsBox(const rayPacket *r, const rayNode *n) {
+#ifdef __SSE2__
+	__m128 t1, t2, tmin, tmax;
+
+	t1 = _mm_mul_ps(_mm_set1_ps(n->bmin[0]), _mm_loadu_ps(r->ix));
+	t2 = _mm_mul_ps(_mm_set1_ps(n->bmax[0]), _mm_loadu_ps(r->ix));
+	tmin = _mm_min_ps(t1, t2);
+	tmax = _mm_max_ps(t1, t2);
+	t1 = _mm_mul_ps(_mm_set1_ps(n->bmin[1]), _mm_loadu_ps(r->iy));
+	t2 = _mm_mul_ps(_mm_set1_ps(n->bmax[1]), _mm_loadu_ps(r->iy));
+	tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+	tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
+	t1 = _mm_mul_ps(_mm_set1_ps(n->bmin[2]), _mm_loadu_ps(r->iz));
+	t2 = _mm_mul_ps(_mm_set1_ps(n->bmax[2]), _mm_loadu_ps(r->iz));
+	tmin = _mm_max_ps(tmin, _mm_min_ps(t1, t2));
+	tmax = _mm_min_ps(tmax, _mm_max_ps(t1, t2));
+	tmin = _mm_max_ps(tmin, _mm_setzero_ps());
+	return _mm_movemask_ps(_mm_and_ps(_mm_cmple_ps(tmin, tmax),
+		_mm_cmplt_ps(tmin, _mm_loadu_ps(r->t))));
+#else
+	float t1, t2, tmin, tmax;
+	int lane;
+
+	for(lane=0; lane<4; lane++) {
+		t1 = n->bmin[0] * r->ix[lane];
+		t2 = n->bmax[0] * r->ix[lane];
+		tmin = fminf(t1, t2);
+		tmax = fmaxf(t1, t2);
+		t1 = n->bmin[1] * r->iy[lane];
+		t2 = n->bmax[1] * r->iy[lane];
+		tmin = fmaxf(tmin, fminf(t1, t2));
+		tmax = fminf(tmax, fmaxf(t1, t2));
+		t1 = n->bmin[2] * r->iz[lane];
+		t2 = n->bmax[2] * r->iz[lane];
+		tmin = fmaxf(tmin, fminf(t1, t2));
+		tmax = fminf(tmax, fmaxf(t1, t2));
+		tmin = fmaxf(tmin, 0.0f);
+		if(tmin <= tmax && tmin < r->t[lane]) return 1;
+	}
+	return 0;
+#endif
+}
+
+/*
+ * rayPacketIntersect() - Moller-Trumbore test of four rays against one
+ * triangle, keeping the nearest hits. Back faces are skipped, as GL
+ * culls them: a triangle that is counterclockwise on screen has a
+ * positive determinant.
+ */
+static void rayPacketIntersect(rayPacket *r, const rayTriangle *t, int index) {
+#ifdef __SSE2__
+	__m128 dx = _mm_loadu_ps(r->dx), dy = _mm_loadu_ps(r->dy), dz = _mm_loadu_ps(r->dz);
+	__m128 e1x = _mm_set1_ps(t->e1[0]), e1y = _mm_set1_ps(t->e1[1]), e1z = _mm_set1_ps(t->e1[2]);
+	__m128 e2x = _mm_set1_ps(t->e2[0]), e2y = _mm_set1_ps(t->e2[1]), e2z = _mm_set1_ps(t->e2[2]);
+	__m128 sx = _mm_set1_ps(-t->v0[0]), sy = _mm_set1_ps(-t->v0[1]), sz = _mm_set1_ps(-t->v0[2]);
+	__m128 px, py, pz, det, invdet, u, v, tt, hit, one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+	float qx, qy, qz, hitt[4], hitu[4], hitv[4];
+	int mask, lane;
+
+	// p = d x e2, det = e1 . p
+	px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+	py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+	pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+	det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+	hit = _mm_cmpgt_ps(det, _mm_set1_ps(RAYTRACE_EPSILON));
+	if(!_mm_movemask_ps(hit)) return;
+	invdet = _mm_div_ps(one, det);
+	// u = (s . p) / det, where s = origin - v0 = -v0
+	u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)), invdet);
+	hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmple_ps(u, one)));
+	if(!_mm_movemask_ps(hit)) return;
+	// q = s x e1 is the same for all rays, since they share the origin
+	qx = -t->v0[1]*t->e1[2] + t->v0[2]*t->e1[1];
+	qy = -t->v0[2]*t->e1[0] + t->v0[0]*t->e1[2];
+	qz = -t->v0[0]*t->e1[1] + t->v0[1]*t->e1[0];
+	v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_set1_ps(qx)), _mm_mul_ps(dy, _mm_set1_ps(qy))),
+		_mm_mul_ps(dz, _mm_set1_ps(qz))), invdet);
+	tt = _mm_mul_ps(_mm_set1_ps(t->e2[0]*qx + t->e2[1]*qy + t->e2[2]*qz), invdet);
+	hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmple_ps(_mm_add_ps(u, v), one)));
+	hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmpgt_ps(tt, zero), _mm_cmplt_ps(tt, _mm_loadu_ps(r->t))));
+	mask = _mm_movemask_ps(hit);
+	if(!mask) return;
+	_mm_storeu_ps(hitt, tt);
+	_mm_storeu_ps(hitu, u);
+	_mm_storeu_ps(hitv, v);
+	for(lane=0; lane<4; lane++) {
+		if(mask & (1 << lane)) {
+			r->t[lane] = hitt[lane];
+			r->u[lane] = hitu[lane];
+			r->v[lane] = hitv[lane];
+			r->tri[lane] = index;
+		}
+	}
+#else
+	float px, py, pz, det, invdet, u, v, tt, qx, qy, qz;
+	int lane;
+
+	qx = -t->v0[1]*t->e1[2] + t->v0[2]*t->e1[1];
+	qy = -t->v0[2]*t->e1[0] + t->v0[0]*t->e1[2];
+	qz = -t->v0[0]*t->e1[1] + t->v0[1]*t->e1[0];
+	for(lane=0; lane<4; lane++) {
+		px = r->dy[lane]*t->e2[2] - r->dz[lane]*t->e2[1];
+		py = r->dz[lane]*t->e2[0] - r->dx[lane]*t->e2[2];
+		pz = r->dx[lane]*t->e2[1] - r->dy[lane]*t->e2[0];
+		det = t->e1[0]*px + t->e1[1]*py + t->e1[2]*pz;
+		if(!(det > RAYTRACE_EPSILON)) continue;
+		invdet = 1.0f / det;
+		u = (-t->v0[0]*px - t->v0[1]*py - t->v0[2]*pz) * invdet;
+		if(u < 0.0f || u > 1.0f) continue;
+		v = (r->dx[lane]*qx + r->dy[lane]*qy + r->dz[lane]*qz) * invdet;
+		if(v < 0.0f || u + v > 1.0f) continue;
+		tt = (t->e2[0]*qx + t->e2[1]*qy + t->e2[2]*qz) * invdet;
+		if(tt > 0.0f && tt < r->t[lane]) {
+			r->t[lane] = tt;
+			r->u[lane] = u;
+			r->v[lane] = v;
+			r->tri[lane] = index;
+		}
+	}
+#endif
+}
+
+/*
+ * rayPacketTrace() - find the nearest front facing hit for four rays
+ */
+static void rayPacketTrace(const rayScene *scene, rayPacket *r) {
+	int stack[RAYTRACE_STACKSIZE], top = 0, node, i, near;
+	const rayNode *n, *c0, *c1;
+	float d0, d1;
+
+	if(scene->ntriangles == 0) return;
+	stack[top++] = 0;
+	while(top > 0) {
+		n = scene->nodes + stack[--top];
+		if(!rayPacketHitsBox(r, n)) continue;
+		if(n->count > 0) {
+			for(i=n->first; i<n->first+n->count; i++) rayPacketIntersect(r, scene->triangles + i, i);
+			continue;
+		}
+		// Visit the child whose center is nearer along the first ray first
+		c0 = scene->nodes + n->first;
+		c1 = c0 + 1;
+		d0 = r->dx[0]*(c0->bmin[0]+c0->bmax[0]) + r->dy[0]*(c0->bmin[1]+c0->bmax[1]) + r->dz[0]*(c0->bmin[2]+c0->bmax[2]);
+		d1 = r->dx[0]*(c1->bmin[0]+c1->bmax[0]) + r->dy[0]*(c1->bmin[1]+c1->bmax[1]) + r->dz[0]*(c1->bmin[2]+c1->bmax[2]);
+		near = (d0 <= d1) ? n->first : n->first + 1;
+		node = (near == n->first) ? n->first + 1 : n->first;
+		if(top + 2 > RAYTRACE_STACKSIZE) {
+			fprintf(stderr, "rayPacketTrace: hierarchy too deep.\n");
+			return;
+		}
+		stack[top++] = node;
+		stack[top++] = near;
+	}
+}
+
+/* What one tile task needs */
+typedef struct {
+	const rayScene *scene;
+	unsigned char *pixels;
+	int width, height, tilesx;
+	const GLfloat *P;
+	int samples;
+	const float *background;
+} rayJob;
+
+/*
+ * rayShadeLanes() - trace a packet and add the shaded colors to the
+ * pixel accumulators named in pixel[]
+ */
+static void rayShadeLanes(const rayScene *scene, rayPacket *r, int lanes, const int pixel[4],
+	float *sums, const float *background) {
+	const rayTriangle *t;
+	float pos[3], normal[3], rgb[3], w0;
+	int lane, k, c;
+
+	rayPacketTrace(scene, r);
+	for(lane=0; lane<lanes; lane++) {
+		if(r->tri[lane] < 0) {
+			for(c=0; c<4; c++) sums[4*pixel[lane]+c] += background[c];
+			continue;
+		}
+		t = scene->triangles + r->tri[lane];
+		w0 = 1.0f - r->u[lane] - r->v[lane];
+		for(k=0; k<3; k++) {
+			pos[k] = w0 * scene->pos[3*t->v[0]+k] + r->u[lane] * scene->pos[3*t->v[1]+k]
+				+ r->v[lane] * scene->pos[3*t->v[2]+k];
+			normal[k] = w0 * scene->normal[3*t->v[0]+k] + r->u[lane] * scene->normal[3*t->v[1]+k]
+				+ r->v[lane] * scene->normal[3*t->v[2]+k];
+		}
+		meteorShade(pos, normal, scene->shading.time, scene->shading.f1only, rgb);
+		for(c=0; c<3; c++) sums[4*pixel[lane]+c] += fminf(fmaxf(rgb[c], 0.0f), 1.0f);
+		sums[4*pixel[lane]+3] += 1.0f;
+	}
+}
+
+/*
+ * rayTile() - render one tile, four samples at a time
+ */
+static void rayTile(const rayJob *job, int task) {
+	float sums[4*RAYTRACE_TILE*RAYTRACE_TILE], sx, sy, ndcx, ndcy, c;
+	int x0 = (task % job->tilesx) * RAYTRACE_TILE, y0 = (task / job->tilesx) * RAYTRACE_TILE;
+	int x1 = x0 + RAYTRACE_TILE, y1 = y0 + RAYTRACE_TILE;
+	int x, y, i, j, k, lanes = 0, pixel[4];
+	rayPacket r;
+
+	if(x1 > job->width) x1 = job->width;
+	if(y1 > job->height) y1 = job->height;
+	memset(sums, 0, sizeof(sums));
+
+	for(y=y0; y<y1; y++) {
+		for(x=x0; x<x1; x++) {
+			for(j=0; j<job->samples; j++) {
+				for(i=0; i<job->samples; i++) {
+					// A regular grid of samples, which is just the pixel center for one sample
+					sx = x + (i + 0.5f) / job->samples;
+					sy = y + (j + 0.5f) / job->samples;
+					ndcx = 2.0f * sx / job->width - 1.0f;
+					ndcy = 2.0f * sy / job->height - 1.0f;
+					r.dx[lanes] = (ndcx + job->P[8]) / job->P[0];
+					r.dy[lanes] = (ndcy + job->P[9]) / job->P[5];
+					r.dz[lanes] = -1.0f;
+					if(r.dx[lanes] == 0.0f) r.dx[lanes] = 1e-20f; // No infinities times zero
+					if(r.dy[lanes] == 0.0f) r.dy[lanes] = 1e-20f;
+					r.ix[lanes] = 1.0f / r.dx[lanes];
+					r.iy[lanes] = 1.0f / r.dy[lanes];
+					r.iz[lanes] = -1.0f;
+					r.t[lanes] = 1e30f;
+					r.tri[lanes] = -1;
+					pixel[lanes] = (y - y0) * RAYTRACE_TILE + (x - x0);
+					if(++lanes == 4) {
+						rayShadeLanes(job->scene, &r, 4, pixel, sums, job->background);
+						lanes = 0;
+					}
+				}
+			}
+		}
+	}
+	if(lanes > 0) {
+		// Fill the packet with copies of the last ray, which are not counted
+		for(k=lanes; k<4; k++) {
+			r.dx[k] = r.dx[lanes-1];
+			r.dy[k] = r.dy[lanes-1];
+			r.dz[k] = r.dz[lanes-1];
+			r.ix[k] = r.ix[lanes-1];
+			r.iy[k] = r.iy[lanes-1];
+			r.iz[k] = r.iz[lanes-1];
+			r.t[k] = 1e30f;
+			r.tri[k] = -1;
+		}
+		rayShadeLanes(job->scene, &r, lanes, pixel, sums, job->background);
+	}
+
+	for(y=y0; y<y1; y++) {
+		for(x=x0; x<x1; x++) {
+			for(k=0; k<4; k++) {
+				c = sums[4*((y - y0) * RAYTRACE_TILE + (x - x0)) + k] / (job->samples * job->samples);
+				job->pixels[4*((long)y * job->width + x) + k] = (unsigned char)(fminf(fmaxf(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+			}
+		}
+	}
+}
+
+/* The tiles begin to end-1 */
+static void rayTileTask(void *data, int begin, int end, int thread) {
+	int task;
+
+	(void)thread;
+	for(task=begin; task<end; task++) rayTile((const rayJob*)data, task);
+}
+
+/*
+ * rayTraceRender() - render the scene, one job per tile
+ */
+void rayTraceRender(const rayScene *scene, jobSystem *jobs, unsigned char *pixels,
+	int width, int height, const GLfloat P[16], int samples, const float background[4]) {
+	rayJob job;
+
+	TRACE_ZONE("rayTraceRender");
+	job.scene = scene;
+	job.pixels = pixels;
+	job.width = width;
+	job.height = height;
+	job.tilesx = (width + RAYTRACE_TILE - 1) / RAYTRACE_TILE;
+	job.P = P;
+	job.samples = (samples < 1) ? 1 : samples;
+	job.background = background;
+	jobParallelFor(jobs, 0, job.tilesx * ((height + RAYTRACE_TILE - 1) / RAYTRACE_TILE), 1, rayTileTask, &job);
+}
@@ -0,0 +1,103 @@
+/* renderTarget.c */
+/* An offscreen framebuffer to render into, for headless runs and readback */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// In Linux, tell GLFW to include the modern OpenGL functions.
+#ifdef __linux__
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GLFW/glfw3.h>
+
+#ifdef __WIN32__
+#include <GL/glext.h>
+#endif
+
+#include "tnm084.h" // To be able to use OpenGL extensions below
+#include "resources.h"
+#include "renderTarget.h"
+
+
+/* Create a framebuffer of the given size. Returns 1 on success, 0 on failure. */
+int renderTargetInit(renderTarget *target, int width, int height) {
+	GLenum status;
+
+	target->width = width;
+	target->height = height;
+	target->pixels = NULL;
+
+	glGenTextures(1, &(target->colortexture));
+	glBindTexture(GL_TEXTURE_2D, target->colortexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenRenderbuffers(1, &(target->depthbuffer));
+	glBindRenderbuffer(GL_RENDERBUFFER, target->depthbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &(target->framebuffer));
+	glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->colortexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target->depthbuffer);
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if(status != GL_FRAMEBUFFER_COMPLETE) {
+		printError("GL error", "Offscreen framebuffer is incomplete");
+		renderTargetDelete(target);
+		return 0;
+	}
+	resourceTrack(RESOURCE_TEXTURE, target, "renderTarget", 0, (long)width*height*(4+4));
+	return 1;
+}
+
+/* Free the framebuffer and its attachments */
+void renderTargetDelete(renderTarget *target) {
+	if(target->framebuffer) glDeleteFramebuffers(1, &(target->framebuffer));
+	if(target->depthbuffer) glDeleteRenderbuffers(1, &(target->depthbuffer));
+	if(target->colortexture) glDeleteTextures(1, &(target->colortexture));
+	if(target->pixels) free(target->pixels);
+	target->framebuffer = 0;
+	target->depthbuffer = 0;
+	target->colortexture = 0;
+	target->pixels = NULL;
+	resourceRelease(RESOURCE_TEXTURE, target);
+}
+
+/* Render into the framebuffer from now on, and set the viewport to cover it */
+void renderTargetBind(renderTarget *target) {
+	glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+	glViewport(0, 0, target->width, target->height);
+}
+
+/* Render into the window again */
+void renderTargetUnbind(void) {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/*
+ * renderTargetRead() - copy the color attachment to target->pixels.
+ * The buffer is allocated on first use and reused after that.
+ * glReadPixels() into client memory waits for all rendering to finish.
+ */
+unsigned char *renderTargetRead(renderTarget *target) {
+	long bytes = 4L * target->width * target->height;
+
+	if(target->pixels == NULL) {
+		target->pixels = (unsigned char*)malloc(bytes);
+		if(target->pixels == NULL) {
+			printError("Memory error", "Cannot allocate pixel readback buffer");
+			return NULL;
+		}
+		resourceTrack(RESOURCE_TEXTURE, target, NULL, bytes, (long)target->width*target->height*(4+4));
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, target->framebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, target->width, target->height, GL_RGBA, GL_UNSIGNED_BYTE, target->pixels);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	return target->pixels;
+}
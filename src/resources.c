@@ -0,0 +1,218 @@
+/* resources.c */
+/* Registry of CPU and GPU memory held by soups, textures and shader programs */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "resources.h"
+
+static resourceEntry resourceEntries[RESOURCE_MAX];
+static int resourceCount = 0;
+static long resourceCPU = 0, resourceGPU = 0;
+static long resourcePeakCPUBytes = 0, resourcePeakGPUBytes = 0;
+static long resourceBudgetCPU = 0, resourceBudgetGPU = 0;
+static int resourceWarned = 0; // Warn once per budget overrun, not on every update
+static atomic_flag resourceLock = ATOMIC_FLAG_INIT;
+
+static const char *resourceKindNames[RESOURCE_KINDS] = { "soup", "texture", "program" };
+
+/* Updates are rare and short, so a spinlock is all we need */
+static void resourceAcquire(void) {
+	while(atomic_flag_test_and_set_explicit(&resourceLock, memory_order_acquire));
+}
+
+static void resourceUnlock(void) {
+	atomic_flag_clear_explicit(&resourceLock, memory_order_release);
+}
+
+/*
+ * resourceFind() - index of an entry, or -1. Call with the lock held.
+ */
+static int resourceFind(int kind, const void *key) {
+	int i;
+	for(i=0; i<resourceCount; i++) {
+		if(resourceEntries[i].kind == kind && resourceEntries[i].key == key) return i;
+	}
+	return -1;
+}
+
+/*
+ * resourceCheck() - update peaks and warn about budgets. Call with the lock held.
+ */
+static void resourceCheck(void) {
+	int over;
+
+	if(resourceCPU > resourcePeakCPUBytes) resourcePeakCPUBytes = resourceCPU;
+	if(resourceGPU > resourcePeakGPUBytes) resourcePeakGPUBytes = resourceGPU;
+	over = (resourceBudgetCPU > 0 && resourceCPU > resourceBudgetCPU)
+		|| (resourceBudgetGPU > 0 && resourceGPU > resourceBudgetGPU);
+	if(over && !resourceWarned) {
+		fprintf(stderr, "Memory budget exceeded: CPU %.1f MB (budget %.1f MB), GPU %.1f MB (budget %.1f MB)\n",
+			resourceCPU / 1048576.0, resourceBudgetCPU / 1048576.0,
+			resourceGPU / 1048576.0, resourceBudgetGPU / 1048576.0);
+	}
+	resourceWarned = over;
+}
+
+/* Register a resource, or update the sizes of one already registered */
+void resourceTrack(int kind, const void *key, const char *name, long cpuBytes, long gpuBytes) {
+	int i;
+
+	resourceAcquire();
+	i = resourceFind(kind, key);
+	if(i < 0) {
+		if(resourceCount == RESOURCE_MAX) {
+			resourceUnlock();
+			fprintf(stderr, "Resource registry full, not tracking more resources.\n");
+			return;
+		}
+		i = resourceCount++;
+		resourceEntries[i].key = key;
+		resourceEntries[i].kind = kind;
+		resourceEntries[i].name[0] = '\0';
+		resourceEntries[i].cpuBytes = 0;
+		resourceEntries[i].gpuBytes = 0;
+	}
+	if(name) {
+		strncpy(resourceEntries[i].name, name, sizeof(resourceEntries[i].name)-1);
+		resourceEntries[i].name[sizeof(resourceEntries[i].name)-1] = '\0';
+	}
+	resourceCPU += cpuBytes - resourceEntries[i].cpuBytes;
+	resourceGPU += gpuBytes - resourceEntries[i].gpuBytes;
+	resourceEntries[i].cpuBytes = cpuBytes;
+	resourceEntries[i].gpuBytes = gpuBytes;
+	resourceCheck();
+	resourceUnlock();
+}
+
+/* Remove a resource from the registry */
+void resourceRelease(int kind, const void *key) {
+	int i;
+
+	resourceAcquire();
+	i = resourceFind(kind, key);
+	if(i >= 0) {
+		resourceCPU -= resourceEntries[i].cpuBytes;
+		resourceGPU -= resourceEntries[i].gpuBytes;
+		resourceEntries[i] = resourceEntries[--resourceCount];
+		resourceCheck();
+	}
+	resourceUnlock();
+}
+
+/* Current total bytes for one kind of resource, or for all if kind is -1 */
+long resourceTotalCPU(int kind) {
+	long total = 0;
+	int i;
+
+	resourceAcquire();
+	if(kind < 0) total = resourceCPU;
+	else for(i=0; i<resourceCount; i++) {
+		if(resourceEntries[i].kind == kind) total += resourceEntries[i].cpuBytes;
+	}
+	resourceUnlock();
+	return total;
+}
+
+long resourceTotalGPU(int kind) {
+	long total = 0;
+	int i;
+
+	resourceAcquire();
+	if(kind < 0) total = resourceGPU;
+	else for(i=0; i<resourceCount; i++) {
+		if(resourceEntries[i].kind == kind) total += resourceEntries[i].gpuBytes;
+	}
+	resourceUnlock();
+	return total;
+}
+
+/* Highest totals seen so far */
+long resourcePeakCPU(void) {
+	return resourcePeakCPUBytes;
+}
+
+long resourcePeakGPU(void) {
+	return resourcePeakGPUBytes;
+}
+
+/* Set budgets in bytes (0 for none). Exceeding one prints a warning. */
+void resourceSetBudget(long cpuBytes, long gpuBytes) {
+	resourceAcquire();
+	resourceBudgetCPU = cpuBytes;
+	resourceBudgetGPU = gpuBytes;
+	resourceWarned = 0;
+	resourceCheck();
+	resourceUnlock();
+}
+
+/* Nonzero if the current totals exceed a budget */
+int resourceOverBudget(void) {
+	return (resourceBudgetCPU > 0 && resourceCPU > resourceBudgetCPU)
+		|| (resourceBudgetGPU > 0 && resourceGPU > resourceBudgetGPU);
+}
+
+/* Sort order for reports: largest total footprint first */
+static int resourceCompare(const void *a, const void *b) {
+	const resourceEntry *ra = (const resourceEntry*)a;
+	const resourceEntry *rb = (const resourceEntry*)b;
+	long sa = ra->cpuBytes + ra->gpuBytes;
+	long sb = rb->cpuBytes + rb->gpuBytes;
+	return (sa < sb) - (sa > sb);
+}
+
+/*
+ * resourceSnapshot() - copy the entries, sorted largest first.
+ * Reports work on a copy so the lock is not held while printing.
+ */
+static int resourceSnapshot(resourceEntry *entries) {
+	int n;
+
+	resourceAcquire();
+	n = resourceCount;
+	memcpy(entries, resourceEntries, n * sizeof(resourceEntry));
+	resourceUnlock();
+	qsort(entries, n, sizeof(resourceEntry), resourceCompare);
+	return n;
+}
+
+/* Print all live resources, largest first, with totals and peaks */
+void resourcePrint(void) {
+	static resourceEntry entries[RESOURCE_MAX];
+	int i, n;
+
+	n = resourceSnapshot(entries);
+	printf("Resource memory (MB), largest first:\n");
+	printf("%-8s %-40s %10s %10s\n", "kind", "name", "CPU", "GPU");
+	for(i=0; i<n; i++) {
+		printf("%-8s %-40s %10.2f %10.2f\n", resourceKindNames[entries[i].kind],
+			entries[i].name, entries[i].cpuBytes / 1048576.0, entries[i].gpuBytes / 1048576.0);
+	}
+	for(i=0; i<RESOURCE_KINDS; i++) {
+		printf("total %-43s %10.2f %10.2f\n", resourceKindNames[i],
+			resourceTotalCPU(i) / 1048576.0, resourceTotalGPU(i) / 1048576.0);
+	}
+	printf("%-49s %10.2f %10.2f\n", "total", resourceTotalCPU(-1) / 1048576.0,
+		resourceTotalGPU(-1) / 1048576.0);
+	printf("%-49s %10.2f %10.2f\n", "peak", resourcePeakCPU() / 1048576.0,
+		resourcePeakGPU() / 1048576.0);
+}
+
+/* Print totals, peaks and all live resources as a JSON object */
+void resourcePrintJSON(FILE *file) {
+	static resourceEntry entries[RESOURCE_MAX];
+	int i, n;
+
+	n = resourceSnapshot(entries);
+	fprintf(file, "{\"cpu_bytes\": %ld, \"gpu_bytes\": %ld, \"peak_cpu_bytes\": %ld, "
+		"\"peak_gpu_bytes\": %ld, \"resources\": [", resourceTotalCPU(-1), resourceTotalGPU(-1),
+		resourcePeakCPU(), resourcePeakGPU());
+	for(i=0; i<n; i++) {
+		fprintf(file, "%s\n  {\"kind\": \"%s\", \"name\": \"%s\", \"cpu_bytes\": %ld, \"gpu_bytes\": %ld}",
+			i ? "," : "", resourceKindNames[entries[i].kind], entries[i].name,
+			entries[i].cpuBytes, entries[i].gpuBytes);
+	}
+	fprintf(file, "]}");
+}
@@ -0,0 +1,171 @@
+/* scene.c */
+/* Many copies of one mesh, animated and culled on the CPU every frame */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <GLFW/glfw3.h>
+
+#include "tnm084.h" // For mat4roty() and friends
+#include "scene.h"
+#include "trace.h"
+
+#define SCENE_CHUNK 256 // Objects per update job
+
+/* A sceneUpdate() in progress, for the jobs */
+typedef struct {
+	const scene *s;
+	int frame;
+	GLfloat planes[6][4]; // View frustum, in view space, normals pointing in
+	sceneDrawList *list;
+} sceneWork;
+
+
+/* Set up nobjects copies of the soup, which needs valid bounds. Returns 1 on success. */
+int sceneInit(scene *s, const triangleSoup *soup, int nobjects) {
+	float dx, dy, dz;
+
+	if(nobjects < 1) {
+		fprintf(stderr, "sceneInit: need at least one object.\n");
+		return 0;
+	}
+	s->nobjects = nobjects;
+	dx = soup->bounds[1] - soup->bounds[0];
+	dy = soup->bounds[3] - soup->bounds[2];
+	dz = soup->bounds[5] - soup->bounds[4];
+	s->radius = 0.5f * sqrtf(dx*dx + dy*dy + dz*dz);
+	s->center[0] = 0.5f * (soup->bounds[0] + soup->bounds[1]);
+	s->center[1] = 0.5f * (soup->bounds[2] + soup->bounds[3]);
+	s->center[2] = 0.5f * (soup->bounds[4] + soup->bounds[5]);
+	return 1;
+}
+
+/* Nothing to free at the moment, but pairs with sceneInit() */
+void sceneDelete(scene *s) {
+	s->nobjects = 0;
+}
+
+/* Allocate a draw list with room for all objects in a scene. Returns 1 on success. */
+int sceneDrawListInit(sceneDrawList *list, const scene *s) {
+	list->frame = -1;
+	list->count = 0;
+	list->capacity = s->nobjects;
+	list->MV = (GLfloat*)malloc(16 * s->nobjects * sizeof(GLfloat));
+	list->visible = (unsigned char*)malloc(s->nobjects);
+	if(!list->MV || !list->visible) {
+		printError("Memory error", "Cannot allocate scene draw list");
+		sceneDrawListDelete(list);
+		return 0;
+	}
+	return 1;
+}
+
+/* Free a draw list */
+void sceneDrawListDelete(sceneDrawList *list) {
+	free(list->MV);
+	free(list->visible);
+	list->MV = NULL;
+	list->visible = NULL;
+	list->count = list->capacity = 0;
+}
+
+/*
+ * sceneObjectMatrix() - modelview matrix for one object in a frame:
+ * fit the bounding sphere of the mesh inside the object's grid cell,
+ * with a margin, and spin it
+ */
+static void sceneObjectMatrix(const scene *s, int object, int frame, GLfloat MV[16]) {
+	GLfloat R1[16], R2[16], S[16];
+	int columns = (int)ceil(sqrt((double)s->nobjects));
+	float cell = 2.5f / columns; // The view is about 2.5 units across at z = -5
+	float scale = (s->radius > 0.0f) ? 0.45f * cell / s->radius : 1.0f;
+	int i;
+
+	for(i=0; i<16; i++) S[i] = 0.0f;
+	S[0] = S[5] = S[10] = scale;
+	S[15] = 1.0f;
+	S[12] = -scale * s->center[0];
+	S[13] = -scale * s->center[1];
+	S[14] = -scale * s->center[2];
+
+	mat4roty(R1, 0.01f * frame);
+	mat4rotx(R2, 0.3f);
+	mat4mult(R2, R1, MV);
+	mat4mult(MV, S, MV);
+	MV[12] += cell * ((object % columns) - 0.5f * (columns - 1));
+	MV[13] += cell * ((object / columns) - 0.5f * (columns - 1));
+	MV[14] += -5.0f;
+}
+
+/*
+ * sceneFrustum() - the six planes of the view frustum of P, from the
+ * sums and differences of its rows, normalized so that plane distances
+ * are in view space units
+ */
+static void sceneFrustum(const GLfloat P[16], GLfloat planes[6][4]) {
+	float length;
+	int i, k, row;
+
+	for(i=0; i<6; i++) {
+		row = i / 2;
+		for(k=0; k<4; k++) {
+			planes[i][k] = P[4*k+3] + ((i & 1) ? -P[4*k+row] : P[4*k+row]);
+		}
+		length = sqrtf(planes[i][0]*planes[i][0] + planes[i][1]*planes[i][1] + planes[i][2]*planes[i][2]);
+		if(length > 0.0f) for(k=0; k<4; k++) planes[i][k] /= length;
+	}
+}
+
+/* Animate and cull the objects begin to end-1 */
+static void sceneUpdateTask(void *data, int begin, int end, int thread) {
+	sceneWork *work = (sceneWork*)data;
+	const scene *s = work->s;
+	GLfloat *MV, c[3], radius;
+	int object, i, visible;
+
+	(void)thread;
+	for(object=begin; object<end; object++) {
+		MV = work->list->MV + 16*object;
+		sceneObjectMatrix(s, object, work->frame, MV);
+		// The mesh center ends up at the translation, and the radius scales with the matrix
+		c[0] = MV[12];
+		c[1] = MV[13];
+		c[2] = MV[14];
+		radius = s->radius * sqrtf(MV[0]*MV[0] + MV[1]*MV[1] + MV[2]*MV[2]);
+		visible = 1;
+		for(i=0; i<6 && visible; i++) {
+			if(work->planes[i][0]*c[0] + work->planes[i][1]*c[1] + work->planes[i][2]*c[2]
+				+ work->planes[i][3] < -radius) visible = 0;
+		}
+		work->list->visible[object] = (unsigned char)visible;
+	}
+}
+
+/*
+ * sceneUpdate(s, frame, P, list, jobs) - animate and cull for a frame.
+ * The objects are handled in parallel, and the visible ones are then
+ * moved to the front of the list in order, so the draw order does not
+ * depend on the scheduling.
+ */
+void sceneUpdate(const scene *s, int frame, const GLfloat P[16], sceneDrawList *list, jobSystem *jobs) {
+	sceneWork work;
+	int object, i;
+
+	TRACE_ZONE("sceneUpdate");
+	work.s = s;
+	work.frame = frame;
+	work.list = list;
+	sceneFrustum(P, work.planes);
+	if(jobs) jobParallelFor(jobs, 0, s->nobjects, SCENE_CHUNK, sceneUpdateTask, &work);
+	else sceneUpdateTask(&work, 0, s->nobjects, 0);
+
+	list->count = 0;
+	for(object=0; object<s->nobjects; object++) {
+		if(!list->visible[object]) continue;
+		if(list->count != object) {
+			for(i=0; i<16; i++) list->MV[16*list->count + i] = list->MV[16*object + i];
+		}
+		list->count++;
+	}
+	list->frame = frame;
+}
@@ -0,0 +1,382 @@
+/* softRaster.c */
+/* A multithreaded software renderer for triangleSoup objects with the meteor shaders */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <GLFW/glfw3.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "tnm084.h" // For mat4mult()
+#include "softRaster.h"
+#include "meteor.h"
+#include "trace.h"
+
+#define SOFTRASTER_VERTEXCHUNK 1024 // Vertices per vertex stage task
+
+
+/* Allocate the buffers. The stages run on jobs. Returns 1 on success. */
+int softRasterInit(softRaster *raster, int width, int height, jobSystem *jobs) {
+	int i;
+
+	memset(raster, 0, sizeof(softRaster));
+	raster->width = width;
+	raster->height = height;
+	raster->tilesx = (width + SOFTRASTER_TILE - 1) / SOFTRASTER_TILE;
+	raster->tilesy = (height + SOFTRASTER_TILE - 1) / SOFTRASTER_TILE;
+	raster->color = (unsigned char*)malloc(4L * width * height);
+	raster->depth = (float*)malloc((long)width * height * sizeof(float));
+	raster->bins = (softBin*)calloc(raster->tilesx * raster->tilesy, sizeof(softBin));
+	if(!raster->color || !raster->depth || !raster->bins) {
+		printError("Memory error", "Cannot allocate software render target");
+		softRasterDelete(raster);
+		return 0;
+	}
+	raster->jobs = jobs;
+	for(i=0; i<raster->tilesx*raster->tilesy; i++) raster->bins[i].count = 0;
+	softRasterClear(raster, 0.0f, 0.0f, 0.0f, 0.0f);
+	return 1;
+}
+
+/* Free everything */
+void softRasterDelete(softRaster *raster) {
+	int i;
+
+	if(raster->bins) {
+		for(i=0; i<raster->tilesx*raster->tilesy; i++) free(raster->bins[i].triangles);
+	}
+	free(raster->bins);
+	free(raster->color);
+	free(raster->depth);
+	free(raster->vertices);
+	free(raster->triangles);
+	memset(raster, 0, sizeof(softRaster));
+}
+
+/*
+ * toByte() - float color to 8 bits, rounded like GL does for RGBA8
+ */
+static unsigned char toByte(float c) {
+	if(c <= 0.0f) return 0;
+	if(c >= 1.0f) return 255;
+	return (unsigned char)(c * 255.0f + 0.5f);
+}
+
+/* Fill the color buffer with one color and the depth buffer with 1 */
+void softRasterClear(softRaster *raster, float r, float g, float b, float a) {
+	unsigned char rgba[4];
+	long i, n = (long)raster->width * raster->height;
+
+	rgba[0] = toByte(r);
+	rgba[1] = toByte(g);
+	rgba[2] = toByte(b);
+	rgba[3] = toByte(a);
+	for(i=0; i<n; i++) {
+		memcpy(raster->color + 4*i, rgba, 4);
+		raster->depth[i] = 1.0f;
+	}
+}
+
+
+/*
+ * softVertexTask() - the vertex shader, for the vertices begin to end-1
+ */
+static void softVertexTask(void *data, int begin, int end, int thread) {
+	softRaster *raster = (softRaster*)data;
+	const triangleSoup *soup = raster->soup;
+	const GLfloat *M = raster->MVP, *MV = raster->MV;
+	const GLfloat *in;
+	softVertex *out;
+	float d, gradient[3], normal[3], p[3], clip[4];
+	int i, r;
+
+	(void)thread;
+	for(i=begin; i<end; i++) {
+		in = soup->vertexarray + 8*i;
+		out = raster->vertices + i;
+
+		if(raster->shading.displacement) {
+			d = raster->shading.displacement[METEOR_BAKEDFLOATS*i];
+			for(r=0; r<3; r++) gradient[r] = raster->shading.displacement[METEOR_BAKEDFLOATS*i+1+r];
+		}
+		else d = meteorDisplacement(in[0], in[1], in[2], raster->shading.octaves, gradient);
+		p[0] = in[0] + d * in[3];
+		p[1] = in[1] + d * in[4];
+		p[2] = in[2] + d * in[5];
+		for(r=0; r<4; r++) clip[r] = M[r]*p[0] + M[4+r]*p[1] + M[8+r]*p[2] + M[12+r];
+
+		out->clipped = (clip[3] <= 0.0f || clip[2] < -clip[3] || clip[2] > clip[3]);
+		out->invw = (clip[3] != 0.0f) ? 1.0f / clip[3] : 0.0f;
+		out->x = (clip[0] * out->invw + 1.0f) * 0.5f * raster->width;
+		out->y = (clip[1] * out->invw + 1.0f) * 0.5f * raster->height;
+		out->z = (clip[2] * out->invw + 1.0f) * 0.5f;
+		meteorBendNormal(in + 3, gradient, normal);
+		for(r=0; r<3; r++) {
+			out->pos[r] = in[r];
+			out->normal[r] = MV[r]*normal[0] + MV[4+r]*normal[1] + MV[8+r]*normal[2];
+		}
+	}
+}
+
+/*
+ * softSetupTriangle() - edge functions and bounding box of a triangle.
+ * Returns 0 if it is culled, clipped away or covers no pixel centers.
+ */
+static int softSetupTriangle(softRaster *raster, const GLuint *index, softTriangle *t) {
+	const softVertex *v[3], *a, *b;
+	float area, xmin, xmax, ymin, ymax;
+	int k;
+
+	for(k=0; k<3; k++) {
+		t->v[k] = index[k];
+		v[k] = raster->vertices + index[k];
+		if(v[k]->clipped) return 0;
+	}
+	// Counterclockwise in window coordinates is front facing, as in GL
+	area = (v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) - (v[2]->x - v[0]->x) * (v[1]->y - v[0]->y);
+	if(!(area > 0.0f)) return 0;
+	t->invarea = 1.0f / area;
+
+	// Edge k is opposite vertex k, and its function is zero on the edge
+	// and equal to the area at vertex k
+	for(k=0; k<3; k++) {
+		a = v[(k+1)%3];
+		b = v[(k+2)%3];
+		t->A[k] = a->y - b->y;
+		t->B[k] = b->x - a->x;
+		t->C[k] = -(t->A[k] * a->x + t->B[k] * a->y);
+		// The interior is to the right of a left edge, and below a top edge
+		t->topleft[k] = (t->A[k] > 0.0f) || (t->A[k] == 0.0f && t->B[k] < 0.0f);
+	}
+
+	xmin = fminf(v[0]->x, fminf(v[1]->x, v[2]->x));
+	xmax = fmaxf(v[0]->x, fmaxf(v[1]->x, v[2]->x));
+	ymin = fminf(v[0]->y, fminf(v[1]->y, v[2]->y));
+	ymax = fmaxf(v[0]->y, fmaxf(v[1]->y, v[2]->y));
+	// Pixel centers are at half integers
+	t->xmin = (int)fmaxf(ceilf(xmin - 0.5f), 0.0f);
+	t->ymin = (int)fmaxf(ceilf(ymin - 0.5f), 0.0f);
+	t->xmax = (int)fminf(floorf(xmax - 0.5f), (float)(raster->width - 1));
+	t->ymax = (int)fminf(floorf(ymax - 0.5f), (float)(raster->height - 1));
+	return (t->xmin <= t->xmax && t->ymin <= t->ymax);
+}
+
+/*
+ * softBinAdd() - append a triangle to the list of a tile
+ */
+static int softBinAdd(softBin *bin, int triangle) {
+	int *grown;
+
+	if(bin->count == bin->capacity) {
+		grown = (int*)realloc(bin->triangles, (bin->capacity ? 2*bin->capacity : 256) * sizeof(int));
+		if(grown == NULL) return 0;
+		bin->triangles = grown;
+		bin->capacity = bin->capacity ? 2*bin->capacity : 256;
+	}
+	bin->triangles[bin->count++] = triangle;
+	return 1;
+}
+
+/*
+ * softCover4() - coverage and depth test for four pixels in a row,
+ * starting at pixel x, of which the first n are inside the triangle's
+ * bounding box. Returns a bit mask of the pixels to shade, and their
+ * depth and the edge function values in z[] and w[][].
+ */
+static int softCover4(const softRaster *raster, const softTriangle *t, int x, int y, int n,
+	float z[4], float w[3][4]) {
+	const softVertex *v0 = raster->vertices + t->v[0];
+	const softVertex *v1 = raster->vertices + t->v[1];
+	const softVertex *v2 = raster->vertices + t->v[2];
+	const float *depth = raster->depth + (long)y * raster->width + x;
+	float py = y + 0.5f;
+	int mask, k;
+
+#ifdef __SSE2__
+	__m128 px = _mm_add_ps(_mm_set1_ps(x + 0.5f), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+	__m128 zero = _mm_setzero_ps();
+	__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+	__m128 we[3], zz, dd;
+	float d[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+	for(k=0; k<3; k++) {
+		we[k] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(t->A[k]), px), _mm_set1_ps(t->B[k] * py + t->C[k]));
+		if(t->topleft[k]) inside = _mm_and_ps(inside, _mm_cmpge_ps(we[k], zero));
+		else inside = _mm_and_ps(inside, _mm_cmpgt_ps(we[k], zero));
+		_mm_storeu_ps(w[k], we[k]);
+	}
+	zz = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(we[0], _mm_set1_ps(v0->z)),
+		_mm_mul_ps(we[1], _mm_set1_ps(v1->z))), _mm_mul_ps(we[2], _mm_set1_ps(v2->z))),
+		_mm_set1_ps(t->invarea));
+	_mm_storeu_ps(z, zz);
+	memcpy(d, depth, n * sizeof(float)); // Lanes past the box keep 1, and are masked below
+	dd = _mm_loadu_ps(d);
+	inside = _mm_and_ps(inside, _mm_cmplt_ps(zz, dd));
+	mask = _mm_movemask_ps(inside) & ((1 << n) - 1);
+#else
+	int lane, covered;
+	float px;
+
+	mask = 0;
+	for(lane=0; lane<n; lane++) {
+		px = x + lane + 0.5f;
+		covered = 1;
+		for(k=0; k<3; k++) {
+			w[k][lane] = t->A[k] * px + (t->B[k] * py + t->C[k]);
+			if(t->topleft[k] ? w[k][lane] < 0.0f : w[k][lane] <= 0.0f) covered = 0;
+		}
+		z[lane] = (w[0][lane] * v0->z + w[1][lane] * v1->z + w[2][lane] * v2->z) * t->invarea;
+		if(covered && z[lane] < depth[lane]) mask |= 1 << lane;
+	}
+#endif
+	return mask;
+}
+
+/*
+ * softShadePixel() - interpolate the varyings and run the fragment shader
+ */
+static void softShadePixel(const softRaster *raster, const softTriangle *t, const float l[3],
+	unsigned char *color) {
+	const softVertex *v[3];
+	float b[3], sum, pos[3], normal[3], rgb[3];
+	int k, c;
+
+	// Perspective correct weights
+	for(k=0; k<3; k++) {
+		v[k] = raster->vertices + t->v[k];
+		b[k] = l[k] * v[k]->invw;
+	}
+	sum = b[0] + b[1] + b[2];
+	for(k=0; k<3; k++) b[k] /= sum;
+	for(c=0; c<3; c++) {
+		pos[c] = b[0] * v[0]->pos[c] + b[1] * v[1]->pos[c] + b[2] * v[2]->pos[c];
+		normal[c] = b[0] * v[0]->normal[c] + b[1] * v[1]->normal[c] + b[2] * v[2]->normal[c];
+	}
+	meteorShade(pos, normal, raster->shading.time, raster->shading.f1only, rgb);
+	color[0] = toByte(rgb[0]);
+	color[1] = toByte(rgb[1]);
+	color[2] = toByte(rgb[2]);
+	color[3] = 255;
+}
+
+/*
+ * softTile() - rasterize and shade all triangles in one tile.
+ * Tiles do not overlap, so no two threads ever touch the same pixel.
+ */
+static void softTile(softRaster *raster, int task) {
+	const softBin *bin = raster->bins + task;
+	const softTriangle *t;
+	int tx0 = (task % raster->tilesx) * SOFTRASTER_TILE;
+	int ty0 = (task / raster->tilesx) * SOFTRASTER_TILE;
+	int tx1 = tx0 + SOFTRASTER_TILE - 1, ty1 = ty0 + SOFTRASTER_TILE - 1;
+	int i, x, y, x0, x1, y0, y1, n, lane, mask;
+	float z[4], w[3][4], l[3];
+	long pixel;
+
+	for(i=0; i<bin->count; i++) {
+		t = raster->triangles + bin->triangles[i];
+		x0 = (t->xmin > tx0) ? t->xmin : tx0;
+		x1 = (t->xmax < tx1) ? t->xmax : tx1;
+		y0 = (t->ymin > ty0) ? t->ymin : ty0;
+		y1 = (t->ymax < ty1) ? t->ymax : ty1;
+		for(y=y0; y<=y1; y++) {
+			for(x=x0; x<=x1; x+=4) {
+				n = (x1 - x + 1 < 4) ? x1 - x + 1 : 4;
+				mask = softCover4(raster, t, x, y, n, z, w);
+				for(lane=0; mask; lane++, mask >>= 1) {
+					if(!(mask & 1)) continue;
+					pixel = (long)y * raster->width + x + lane;
+					raster->depth[pixel] = z[lane];
+					l[0] = w[0][lane] * t->invarea;
+					l[1] = w[1][lane] * t->invarea;
+					l[2] = w[2][lane] * t->invarea;
+					softShadePixel(raster, t, l, raster->color + 4*pixel);
+				}
+			}
+		}
+	}
+}
+
+/* The tiles begin to end-1 */
+static void softTileTask(void *data, int begin, int end, int thread) {
+	int task;
+
+	(void)thread;
+	for(task=begin; task<end; task++) softTile((softRaster*)data, task);
+}
+
+/*
+ * softRasterDraw(raster, soup, MV, P, shading) - draw a soup.
+ * The stages run one after the other, each spread over all workers.
+ */
+void softRasterDraw(softRaster *raster, const triangleSoup *soup,
+	const GLfloat MV[16], const GLfloat P[16], const softShading *shading) {
+	softTriangle *grown;
+	GLfloat Pcopy[16], MVcopy[16];
+	int i, tx, ty, tx0, tx1, ty0, ty1;
+
+	if(soup->vertexarray == NULL || soup->indexarray == NULL) {
+		fprintf(stderr, "softRasterDraw: the soup arrays have been released.\n");
+		return;
+	}
+	TRACE_ZONE("softRasterDraw");
+
+	if(raster->vertexcapacity < soup->nverts) {
+		free(raster->vertices);
+		raster->vertices = (softVertex*)malloc(soup->nverts * sizeof(softVertex));
+		raster->vertexcapacity = raster->vertices ? soup->nverts : 0;
+	}
+	if(raster->trianglecapacity < soup->ntris) {
+		grown = (softTriangle*)realloc(raster->triangles, soup->ntris * sizeof(softTriangle));
+		if(grown) {
+			raster->triangles = grown;
+			raster->trianglecapacity = soup->ntris;
+		}
+	}
+	if(raster->vertexcapacity < soup->nverts || raster->trianglecapacity < soup->ntris) {
+		printError("Memory error", "Cannot allocate software renderer buffers");
+		return;
+	}
+
+	raster->soup = soup;
+	raster->shading = *shading;
+	memcpy(Pcopy, P, sizeof(Pcopy));
+	memcpy(MVcopy, MV, sizeof(MVcopy));
+	memcpy(raster->MV, MV, sizeof(raster->MV));
+	mat4mult(Pcopy, MVcopy, raster->MVP);
+
+	// Vertex stage
+	TRACE_BEGIN("vertices");
+	jobParallelFor(raster->jobs, 0, soup->nverts, SOFTRASTER_VERTEXCHUNK, softVertexTask, raster);
+	TRACE_END();
+
+	// Triangle setup and binning, in order, so that ties in the depth
+	// test are resolved the same way as on the GPU
+	TRACE_BEGIN("binning");
+	for(i=0; i<raster->tilesx*raster->tilesy; i++) raster->bins[i].count = 0;
+	raster->ntriangles = 0;
+	for(i=0; i<soup->ntris; i++) {
+		softTriangle *t = raster->triangles + raster->ntriangles;
+		if(!softSetupTriangle(raster, soup->indexarray + 3*i, t)) continue;
+		tx0 = t->xmin / SOFTRASTER_TILE;
+		tx1 = t->xmax / SOFTRASTER_TILE;
+		ty0 = t->ymin / SOFTRASTER_TILE;
+		ty1 = t->ymax / SOFTRASTER_TILE;
+		for(ty=ty0; ty<=ty1; ty++) {
+			for(tx=tx0; tx<=tx1; tx++) {
+				softBinAdd(raster->bins + ty*raster->tilesx + tx, raster->ntriangles);
+			}
+		}
+		raster->ntriangles++;
+	}
+	TRACE_END();
+
+	// Rasterization and fragment shading, one task per tile
+	TRACE_BEGIN("tiles");
+	jobParallelFor(raster->jobs, 0, raster->tilesx * raster->tilesy, 1, softTileTask, raster);
+	TRACE_END();
+}
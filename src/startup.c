@@ -0,0 +1,174 @@
+/* startup.c */
+/* Startup profiler: times each loading phase, with bytes and throughput */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "timer.h"
+#include "startup.h"
+
+static startupPhase startupPhases[STARTUP_MAXPHASES];
+static int startupCount = 0;
+static int startupStack[STARTUP_MAXDEPTH]; // Indices of open phases, -1 if not recorded
+static int startupDepth = 0;
+static int startupSync = 0;
+static double startupOrigin = 0.0;
+static double startupTotal = -1.0;  // Time to first frame, once known
+static _Thread_local int startupOwner = 0; // Nonzero on the profiling thread
+
+static const char *startupKindNames[] = { "cpu", "io", "parse", "upload", "compile" };
+
+/* Start profiling. If syncGPU is nonzero, GPU phases wait for the GPU to finish. */
+void startupInit(int syncGPU) {
+	startupCount = 0;
+	startupDepth = 0;
+	startupSync = syncGPU;
+	startupOrigin = timerSeconds();
+	startupTotal = -1.0;
+	startupOwner = 1;
+}
+
+/* Nonzero if GPU phases should call glFinish() before they end */
+int startupSyncGPU(void) {
+	return startupOwner && startupSync;
+}
+
+/* Begin a phase. The detail string may be NULL. */
+void startupBegin(const char *name, const char *detail, int kind) {
+	startupPhase *phase;
+
+	if(!startupOwner) return;
+	if(startupDepth >= STARTUP_MAXDEPTH) {
+		startupDepth++; // Keep begin/end balanced, but do not record
+		return;
+	}
+	if(startupCount == STARTUP_MAXPHASES) {
+		startupStack[startupDepth++] = -1;
+		return;
+	}
+	phase = &startupPhases[startupCount];
+	phase->name = name;
+	phase->detail[0] = '\0';
+	if(detail) {
+		strncpy(phase->detail, detail, sizeof(phase->detail)-1);
+		phase->detail[sizeof(phase->detail)-1] = '\0';
+	}
+	phase->kind = kind;
+	phase->depth = startupDepth;
+	phase->bytes = 0;
+	phase->seconds = 0.0;
+	startupStack[startupDepth++] = startupCount++;
+	phase->start = timerSeconds();
+}
+
+/* End the innermost phase, reporting how many bytes it processed */
+void startupEnd(long bytes) {
+	double now = timerSeconds();
+	int index;
+
+	if(!startupOwner || startupDepth == 0) return;
+	startupDepth--;
+	if(startupDepth >= STARTUP_MAXDEPTH) return;
+	index = startupStack[startupDepth];
+	if(index < 0) return;
+	startupPhases[index].seconds = now - startupPhases[index].start;
+	startupPhases[index].bytes = bytes;
+}
+
+/* Mark the end of startup. Returns 1 the first time it is called, else 0. */
+int startupFirstFrame(void) {
+	if(!startupOwner || startupTotal >= 0.0) return 0;
+	startupTotal = timerSeconds() - startupOrigin;
+	return 1;
+}
+
+/*
+ * startupSelfTime() - time of a phase that is not spent in its children
+ */
+static double startupSelfTime(int index) {
+	double self = startupPhases[index].seconds;
+	int i;
+
+	for(i=index+1; i<startupCount && startupPhases[i].depth > startupPhases[index].depth; i++) {
+		if(startupPhases[i].depth == startupPhases[index].depth + 1) {
+			self -= startupPhases[i].seconds;
+		}
+	}
+	return self;
+}
+
+/* Print a table of all phases, and the largest contributors */
+void startupPrint(void) {
+	int i, j, top[3];
+	double total, self, best;
+	startupPhase *p;
+
+	total = startupTotal;
+	if(total < 0.0) total = timerSeconds() - startupOrigin;
+	printf("Startup profile (time to first frame %.1f ms):\n", 1000.0 * total);
+	printf("%-32s %-7s %9s %6s %12s %10s\n", "phase", "kind", "ms", "%", "bytes", "MB/s");
+	for(i=0; i<startupCount; i++) {
+		p = &startupPhases[i];
+		printf("%*s%-*s %-7s %9.2f %6.1f", 2*p->depth, "", 32-2*p->depth, p->name,
+			startupKindNames[p->kind], 1000.0 * p->seconds, 100.0 * p->seconds / total);
+		if(p->bytes > 0 && p->seconds > 0.0) {
+			printf(" %12ld %10.1f", p->bytes, p->bytes / p->seconds / 1.0e6);
+		}
+		else {
+			printf(" %12s %10s", "", "");
+		}
+		if(p->detail[0]) printf("  %s", p->detail);
+		printf("\n");
+	}
+
+	// The largest contributors, counting only time not spent in sub-phases
+	for(j=0; j<3; j++) {
+		top[j] = -1;
+		best = 0.0;
+		for(i=0; i<startupCount; i++) {
+			if((j > 0 && i == top[0]) || (j > 1 && i == top[1])) continue;
+			self = startupSelfTime(i);
+			if(self > best) {
+				best = self;
+				top[j] = i;
+			}
+		}
+		if(top[j] < 0) break;
+		printf("%s %s%s%s%s: %.2f ms self time\n", j ? "        " : "Largest:",
+			startupPhases[top[j]].name, startupPhases[top[j]].detail[0] ? " (" : "",
+			startupPhases[top[j]].detail, startupPhases[top[j]].detail[0] ? ")" : "",
+			1000.0 * best);
+	}
+}
+
+/* Print all phases as a JSON object */
+void startupPrintJSON(FILE *file) {
+	int i;
+	startupPhase *p;
+	double total = startupTotal;
+
+	if(total < 0.0) total = timerSeconds() - startupOrigin;
+	fprintf(file, "{\"first_frame_ms\": %.3f, \"phases\": [", 1000.0 * total);
+	for(i=0; i<startupCount; i++) {
+		p = &startupPhases[i];
+		fprintf(file, "%s\n  {\"name\": \"%s\", \"detail\": \"%s\", \"kind\": \"%s\", \"depth\": %d, "
+			"\"start_ms\": %.3f, \"ms\": %.3f, \"self_ms\": %.3f, \"bytes\": %ld, \"mb_per_s\": %.2f}",
+			i ? "," : "", p->name, p->detail, startupKindNames[p->kind], p->depth,
+			1000.0 * (p->start - startupOrigin), 1000.0 * p->seconds, 1000.0 * startupSelfTime(i),
+			p->bytes, (p->bytes > 0 && p->seconds > 0.0) ? p->bytes / p->seconds / 1.0e6 : 0.0);
+	}
+	fprintf(file, "]}");
+}
+
+/* Write all phases to a JSON file */
+int startupWriteJSON(const char *filename) {
+	FILE *file = fopen(filename, "w");
+	if(file == NULL) {
+		fprintf(stderr, "Cannot write startup profile to %s.\n", filename);
+		return 0;
+	}
+	startupPrintJSON(file);
+	fprintf(file, "\n");
+	fclose(file);
+	return 1;
+}
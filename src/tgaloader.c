@@ -3,6 +3,9 @@
 /* Stefan Gustavson (stefan.gustavson@liu.se 2013-11-20 */
 
 #include "tgaloader.h"
+#include "trace.h"
+#include "startup.h"
+#include "resources.h"
 
 /*
  * loadTGA(Texture * texture, char * filename)
@@ -17,6 +20,8 @@ int loadTGA(Texture *texture, char *filename)
 	GLubyte uTGAcompare[12] = {0,0,2, 0,0,0,0,0,0,0,0,0}; // Uncompressed TGA Header
 	GLubyte cTGAcompare[12] = {0,0,10,0,0,0,0,0,0,0,0,0}; // RLE Compressed TGA Header
 
+	TRACE_ZONE("loadTGA");
+
 	fTGA = fopen(filename, "rb");
 
 	if(fTGA == NULL) // If the file didn't open...
@@ -135,7 +140,17 @@ int loadUncompressedTGA(Texture *texture, FILE *fTGA) // Load an uncompressed TG
  * Load and activate a 2D texture from a TGA file
  */
 void createTexture(Texture *texture, char *filename) {
-    loadTGA(texture, filename);
+	long bytes;
+
+	TRACE_ZONE("createTexture");
+	startupBegin("createTexture", filename, STARTUP_CPU);
+	startupBegin("loadTGA", NULL, STARTUP_IO);
+	bytes = 0;
+    if(loadTGA(texture, filename)) {
+		bytes = (long)texture->width * texture->height * (texture->bpp / 8);
+	}
+	startupEnd(bytes);
+	startupBegin("upload", NULL, STARTUP_UPLOAD);
 	glEnable(GL_TEXTURE_2D); // Required for glBuildMipmap() to work (!)
 	glGenTextures(1, &(texture->texID));     // Create The texture ID
     glBindTexture ( GL_TEXTURE_2D , texture->texID );
@@ -148,6 +163,76 @@ void createTexture(Texture *texture, char *filename) {
     // Read the texture data from file and upload it to the GPU
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture->width, texture->height, 0,
 		texture->type, GL_UNSIGNED_BYTE, texture->imageData);
+	if(startupSyncGPU()) glFinish();
+	startupEnd(bytes);
+	startupBegin("mipmaps", NULL, STARTUP_CPU);
 	glGenerateMipmap(GL_TEXTURE_2D);
+	if(startupSyncGPU()) glFinish();
+	startupEnd(0);
+	startupEnd(bytes);
+
+	// The image stays in main memory. On the GPU it is stored as RGBA,
+	// and a full mipmap chain adds another third to that.
+	resourceTrack(RESOURCE_TEXTURE, texture, filename,
+		texture->imageData ? bytes : 0, (long)texture->width * texture->height * 4 * 4 / 3);
 }
 
+/*
+ * Delete a texture and free the image data
+ */
+void deleteTexture(Texture *texture) {
+	if(texture->imageData) {
+		free(texture->imageData);
+	}
+	texture->imageData = NULL;
+	glDeleteTextures(1, &(texture->texID));
+	texture->texID = 0;
+	resourceRelease(RESOURCE_TEXTURE, texture);
+}
+
+
+/*
+ * saveTGA(char *filename, GLubyte *pixels, int width, int height)
+ * Write RGBA pixels, bottom row first as from glReadPixels(), to an
+ * uncompressed 32 bit TGA file, which loadTGA() can read back.
+ */
+int saveTGA(char *filename, const GLubyte *pixels, int width, int height)
+{
+	FILE *fTGA;
+	GLubyte header[18] = {0,0,2, 0,0,0,0,0, 0,0,0,0, 0,0,0,0, 32,8}; // Uncompressed, 8 alpha bits, bottom-up
+	GLubyte *row;
+	long x, y;
+
+	header[12] = width & 0xFF;
+	header[13] = (width >> 8) & 0xFF;
+	header[14] = height & 0xFF;
+	header[15] = (height >> 8) & 0xFF;
+
+	fTGA = fopen(filename, "wb");
+	if(fTGA == NULL)
+	{
+		fprintf(stderr, "Could not write image file %s.\n", filename);
+		return GL_FALSE;
+	}
+	row = (GLubyte *)malloc(4*width);
+	if(row == NULL)
+	{
+		fclose(fTGA);
+		return GL_FALSE;
+	}
+	fwrite(header, 1, sizeof(header), fTGA);
+	for(y=0; y<height; y++)
+	{
+		for(x=0; x<width; x++) // TGA stores BGRA
+		{
+			row[4*x] = pixels[4*(y*width+x)+2];
+			row[4*x+1] = pixels[4*(y*width+x)+1];
+			row[4*x+2] = pixels[4*(y*width+x)];
+			row[4*x+3] = pixels[4*(y*width+x)+3];
+		}
+		fwrite(row, 1, 4*width, fTGA);
+	}
+	free(row);
+	fclose(fTGA);
+	return GL_TRUE;
+}
@@ -0,0 +1,77 @@
+/* timer.c */
+/* Portable high resolution wall clock and thread CPU clock */
+
+#ifdef __WIN32__
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "timer.h"
+
+/*
+ * timerNanoseconds() - read the monotonic clock in nanoseconds.
+ * Windows has QueryPerformanceCounter(), everything else has
+ * clock_gettime(CLOCK_MONOTONIC).
+ */
+unsigned long long timerNanoseconds(void) {
+#ifdef __WIN32__
+	static LARGE_INTEGER frequency = {0};
+	LARGE_INTEGER counter;
+	if(frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	// Split the division to avoid overflow for long uptimes
+	return (unsigned long long)(counter.QuadPart / frequency.QuadPart) * 1000000000ULL
+		+ (unsigned long long)(counter.QuadPart % frequency.QuadPart) * 1000000000ULL
+		/ frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+#endif
+}
+
+/*
+ * timerSeconds() - the monotonic clock in seconds, as a double
+ */
+double timerSeconds(void) {
+	return (double)timerNanoseconds() * 1e-9;
+}
+
+/*
+ * timerCPUSeconds() - CPU time used by the calling thread.
+ * The difference between this and the wall clock over a frame
+ * tells how much of the frame was spent waiting (swap, vsync, sleep).
+ */
+double timerCPUSeconds(void) {
+#ifdef __WIN32__
+	FILETIME creation, exit, kernel, user;
+	ULARGE_INTEGER k, u;
+	GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+	k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+	return (double)(k.QuadPart + u.QuadPart) * 1e-7; // 100 ns units
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+/*
+ * timerSleep() - give up the CPU for a while. Windows sleeps in whole
+ * milliseconds, rounded to the scheduler tick unless timeBeginPeriod()
+ * has been called, so callers that need precision should sleep a bit
+ * short and spin for the rest.
+ */
+void timerSleep(double seconds) {
+#ifdef __WIN32__
+	if(seconds >= 0.001) Sleep((DWORD)(seconds * 1000.0));
+#else
+	struct timespec ts;
+	if(seconds <= 0.0) return;
+	ts.tv_sec = (time_t)seconds;
+	ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+	nanosleep(&ts, NULL);
+#endif
+}
@@ -17,6 +17,7 @@
 #include <stdio.h>  // For shader files and console messages
 #include <stdlib.h> // For malloc() and free() in shader creation
 #include <math.h>   // For fmod() in computeFPS()
+#include <string.h> // For strlen() in createShader()
 #include <GLFW/glfw3.h>
 
 #ifdef __WIN32__
@@ -24,6 +25,11 @@
 #endif
 
 #include "tnm084.h"
+#include "timer.h"
+#include "frameStats.h"
+#include "trace.h"
+#include "startup.h"
+#include "resources.h"
 
 #ifdef __WIN32__
 /* Global function pointers for everything we need beyond OpenGL 1.1 */
@@ -60,6 +66,32 @@ PFNGLVERTEXATTRIBPOINTERPROC     glVertexAttribPointer = NULL;
 PFNGLDISABLEVERTEXATTRIBARRAYPROC glDisableVertexAttribArray = NULL;
 PFNGLACTIVETEXTUREPROC           glActiveTexture      = NULL;
 PFNGLGENERATEMIPMAPPROC          glGenerateMipmap     = NULL;
+PFNGLGENQUERIESPROC              glGenQueries         = NULL;
+PFNGLDELETEQUERIESPROC           glDeleteQueries      = NULL;
+PFNGLQUERYCOUNTERPROC            glQueryCounter       = NULL;
+PFNGLGETQUERYOBJECTIVPROC        glGetQueryObjectiv   = NULL;
+PFNGLGETQUERYOBJECTUI64VPROC     glGetQueryObjectui64v = NULL;
+PFNGLGETINTEGER64VPROC           glGetInteger64v      = NULL;
+PFNGLGENFRAMEBUFFERSPROC         glGenFramebuffers    = NULL;
+PFNGLDELETEFRAMEBUFFERSPROC      glDeleteFramebuffers = NULL;
+PFNGLBINDFRAMEBUFFERPROC         glBindFramebuffer    = NULL;
+PFNGLFRAMEBUFFERTEXTURE2DPROC    glFramebufferTexture2D = NULL;
+PFNGLFRAMEBUFFERRENDERBUFFERPROC glFramebufferRenderbuffer = NULL;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC  glCheckFramebufferStatus = NULL;
+PFNGLGENRENDERBUFFERSPROC        glGenRenderbuffers   = NULL;
+PFNGLDELETERENDERBUFFERSPROC     glDeleteRenderbuffers = NULL;
+PFNGLBINDRENDERBUFFERPROC        glBindRenderbuffer   = NULL;
+PFNGLRENDERBUFFERSTORAGEPROC     glRenderbufferStorage = NULL;
+PFNGLFENCESYNCPROC               glFenceSync          = NULL;
+PFNGLCLIENTWAITSYNCPROC          glClientWaitSync     = NULL;
+PFNGLDELETESYNCPROC              glDeleteSync         = NULL;
+PFNGLBUFFERSUBDATAPROC           glBufferSubData      = NULL;
+PFNGLMAPBUFFERRANGEPROC          glMapBufferRange     = NULL;
+PFNGLUNMAPBUFFERPROC             glUnmapBuffer        = NULL;
+PFNGLBINDBUFFERRANGEPROC         glBindBufferRange    = NULL;
+PFNGLGETUNIFORMBLOCKINDEXPROC    glGetUniformBlockIndex = NULL;
+PFNGLUNIFORMBLOCKBINDINGPROC     glUniformBlockBinding = NULL;
+PFNGLCOMPRESSEDTEXIMAGE2DPROC   glCompressedTexImage2D = NULL;
 #endif
 
 
@@ -148,6 +180,71 @@ void loadExtensions() {
             printError("GL init error", "One or more required OpenGL functions were not found");
             return;
         }
+
+		glGenQueries               = (PFNGLGENQUERIESPROC)glfwGetProcAddress("glGenQueries");
+		glDeleteQueries            = (PFNGLDELETEQUERIESPROC)glfwGetProcAddress("glDeleteQueries");
+		glQueryCounter             = (PFNGLQUERYCOUNTERPROC)glfwGetProcAddress("glQueryCounter");
+		glGetQueryObjectiv         = (PFNGLGETQUERYOBJECTIVPROC)glfwGetProcAddress("glGetQueryObjectiv");
+		glGetQueryObjectui64v      = (PFNGLGETQUERYOBJECTUI64VPROC)glfwGetProcAddress("glGetQueryObjectui64v");
+		glGetInteger64v            = (PFNGLGETINTEGER64VPROC)glfwGetProcAddress("glGetInteger64v");
+
+		if( !glGenQueries || !glDeleteQueries || !glQueryCounter ||
+		    !glGetQueryObjectiv || !glGetQueryObjectui64v || !glGetInteger64v )
+        {
+            printError("GL init error", "OpenGL timer query functions were not found");
+            return;
+        }
+
+		glGenFramebuffers          = (PFNGLGENFRAMEBUFFERSPROC)glfwGetProcAddress("glGenFramebuffers");
+		glDeleteFramebuffers       = (PFNGLDELETEFRAMEBUFFERSPROC)glfwGetProcAddress("glDeleteFramebuffers");
+		glBindFramebuffer          = (PFNGLBINDFRAMEBUFFERPROC)glfwGetProcAddress("glBindFramebuffer");
+		glFramebufferTexture2D     = (PFNGLFRAMEBUFFERTEXTURE2DPROC)glfwGetProcAddress("glFramebufferTexture2D");
+		glFramebufferRenderbuffer  = (PFNGLFRAMEBUFFERRENDERBUFFERPROC)glfwGetProcAddress("glFramebufferRenderbuffer");
+		glCheckFramebufferStatus   = (PFNGLCHECKFRAMEBUFFERSTATUSPROC)glfwGetProcAddress("glCheckFramebufferStatus");
+		glGenRenderbuffers         = (PFNGLGENRENDERBUFFERSPROC)glfwGetProcAddress("glGenRenderbuffers");
+		glDeleteRenderbuffers      = (PFNGLDELETERENDERBUFFERSPROC)glfwGetProcAddress("glDeleteRenderbuffers");
+		glBindRenderbuffer         = (PFNGLBINDRENDERBUFFERPROC)glfwGetProcAddress("glBindRenderbuffer");
+		glRenderbufferStorage      = (PFNGLRENDERBUFFERSTORAGEPROC)glfwGetProcAddress("glRenderbufferStorage");
+
+		if( !glGenFramebuffers || !glDeleteFramebuffers || !glBindFramebuffer ||
+		    !glFramebufferTexture2D || !glFramebufferRenderbuffer || !glCheckFramebufferStatus ||
+		    !glGenRenderbuffers || !glDeleteRenderbuffers || !glBindRenderbuffer || !glRenderbufferStorage )
+        {
+            printError("GL init error", "OpenGL framebuffer object functions were not found");
+            return;
+        }
+
+		glFenceSync                = (PFNGLFENCESYNCPROC)glfwGetProcAddress("glFenceSync");
+		glClientWaitSync           = (PFNGLCLIENTWAITSYNCPROC)glfwGetProcAddress("glClientWaitSync");
+		glDeleteSync               = (PFNGLDELETESYNCPROC)glfwGetProcAddress("glDeleteSync");
+
+		if( !glFenceSync || !glClientWaitSync || !glDeleteSync )
+        {
+            printError("GL init error", "OpenGL sync object functions were not found");
+            return;
+        }
+
+		glBufferSubData            = (PFNGLBUFFERSUBDATAPROC)glfwGetProcAddress("glBufferSubData");
+		glMapBufferRange           = (PFNGLMAPBUFFERRANGEPROC)glfwGetProcAddress("glMapBufferRange");
+		glUnmapBuffer              = (PFNGLUNMAPBUFFERPROC)glfwGetProcAddress("glUnmapBuffer");
+		glBindBufferRange          = (PFNGLBINDBUFFERRANGEPROC)glfwGetProcAddress("glBindBufferRange");
+		glGetUniformBlockIndex     = (PFNGLGETUNIFORMBLOCKINDEXPROC)glfwGetProcAddress("glGetUniformBlockIndex");
+		glUniformBlockBinding      = (PFNGLUNIFORMBLOCKBINDINGPROC)glfwGetProcAddress("glUniformBlockBinding");
+
+		if( !glBufferSubData || !glMapBufferRange || !glUnmapBuffer || !glBindBufferRange ||
+		    !glGetUniformBlockIndex || !glUniformBlockBinding )
+        {
+            printError("GL init error", "OpenGL uniform buffer functions were not found");
+            return;
+        }
+
+		glCompressedTexImage2D     = (PFNGLCOMPRESSEDTEXIMAGE2DPROC)glfwGetProcAddress("glCompressedTexImage2D");
+
+		if( !glCompressedTexImage2D )
+        {
+            printError("GL init error", "OpenGL compressed texture functions were not found");
+            return;
+        }
 #endif
 }
 
@@ -164,6 +261,12 @@ unsigned char* readShaderFile(const char *filename) {
     }
     int bytesinfile = filelength(file);
     unsigned char *buffer = (unsigned char*)malloc(bytesinfile+1);
+    if(buffer == NULL)
+    {
+        printError("Memory error", "Cannot allocate shader source buffer");
+        fclose(file);
+        return 0;
+    }
     int bytesread = fread( buffer, 1, bytesinfile, file);
     buffer[bytesread] = 0; // Terminate the string with 0
     fclose(file);
@@ -172,37 +275,118 @@ unsigned char* readShaderFile(const char *filename) {
 }
 
 
+/*
+ * shaderSourceWithDefines() - hand a shader source to OpenGL with extra
+ * lines inserted right after the #version line, which has to come first.
+ */
+static void shaderSourceWithDefines(GLuint shader, const char *source, const char *defines) {
+    const char *strings[3];
+    GLint lengths[3];
+    const char *body = source;
+
+    if(defines == NULL || defines[0] == 0) {
+        glShaderSource(shader, 1, &source, NULL);
+        return;
+    }
+    if(strncmp(source, "#version", 8) == 0) {
+        body = strchr(source, '\n');
+        body = body ? body+1 : source + strlen(source);
+    }
+    strings[0] = source;
+    lengths[0] = (GLint)(body - source);
+    strings[1] = defines;
+    lengths[1] = (GLint)strlen(defines);
+    strings[2] = body;
+    lengths[2] = (GLint)strlen(body);
+    glShaderSource(shader, 3, strings, lengths);
+}
+
+
 /*
  * createShader() - create, load, compile and link the GLSL shader objects.
  */
 GLuint createShader(char *vertexshaderfile, char *fragmentshaderfile) {
+    return createShaderWithDefines(vertexshaderfile, fragmentshaderfile, NULL);
+}
+
+
+/*
+ * createShaderWithDefines() - same as createShader(), but with a block of
+ * preprocessor lines (e.g. "#define OCTAVES 4\n") added to both shaders.
+ */
+GLuint createShaderWithDefines(char *vertexshaderfile, char *fragmentshaderfile, const char *defines) {
+	unsigned char *vertexShaderAssembly;
+	unsigned char *fragmentShaderAssembly;
+	GLuint programObject;
+
+	startupBegin("read", vertexshaderfile, STARTUP_IO);
+	vertexShaderAssembly = readShaderFile(vertexshaderfile);
+	startupEnd(vertexShaderAssembly ? (long)strlen((char*)vertexShaderAssembly) : 0);
+	startupBegin("read", fragmentshaderfile, STARTUP_IO);
+	fragmentShaderAssembly = readShaderFile(fragmentshaderfile);
+	startupEnd(fragmentShaderAssembly ? (long)strlen((char*)fragmentShaderAssembly) : 0);
+
+	programObject = createShaderFromSource((char*)vertexShaderAssembly, (char*)fragmentShaderAssembly,
+		fragmentshaderfile, defines);
+	free((void *)vertexShaderAssembly);
+	free((void *)fragmentShaderAssembly);
+	return programObject;
+}
+
+
+/*
+ * createShaderFromSource() - compile and link shader sources that are
+ * already in memory, e.g. from an asset bundle. A NULL source is
+ * reported as a compile error. The name is for the resource registry.
+ * Unless the block has a #line directive of its own, "#line 2" is added
+ * at its end so that compiler messages refer to lines in the files.
+ */
+GLuint createShaderFromSource(const char *vertexsource, const char *fragmentsource, const char *name,
+	const char *defines) {
      GLuint programObject;
      GLuint vertexShader;
      GLuint fragmentShader;
 
-     const char *vertexShaderStrings[1];
-     const char *fragmentShaderStrings[1];
-	 unsigned char *vertexShaderAssembly;
-	 unsigned char *fragmentShaderAssembly;
-
      GLint vertexCompiled;
      GLint fragmentCompiled;
      GLint shadersLinked;
      char str[4096]; // For error messages from the GLSL compiler and linker
+     long sourcebytes, totalbytes = 0;
+     GLint binarybytes = 0;
+     char *prelude = NULL;
+
+     TRACE_ZONE("createShader");
+     startupBegin("createShader", NULL, STARTUP_CPU);
+
+    if(defines && defines[0]) {
+        prelude = (char*)malloc(strlen(defines) + 16);
+        if(prelude == NULL)
+        {
+            printError("Memory error", "Cannot allocate shader defines");
+            startupEnd(0);
+            return 0;
+        }
+        strcpy(prelude, defines);
+        if(prelude[strlen(prelude)-1] != '\n') strcat(prelude, "\n");
+        if(!strstr(prelude, "#line")) strcat(prelude, "#line 2\n");
+    }
 
     // Create the vertex shader.
     vertexShader = glCreateShader(GL_VERTEX_SHADER);
 
-    vertexShaderAssembly = readShaderFile(vertexshaderfile);
-    if(vertexShaderAssembly) { // Don't try to use a NULL pointer
-        vertexShaderStrings[0] = (char*)vertexShaderAssembly;
-        glShaderSource(vertexShader, 1, vertexShaderStrings, NULL);
+    sourcebytes = vertexsource ? (long)strlen(vertexsource) : 0;
+    totalbytes += sourcebytes;
+    // Drivers may defer the actual compilation to the status query,
+    // so that query is included in the timed compile phase.
+    startupBegin("compile", "vertex", STARTUP_COMPILE);
+    if(vertexsource) { // Don't try to use a NULL pointer
+        shaderSourceWithDefines(vertexShader, vertexsource, prelude);
         glCompileShader(vertexShader);
-        free((void *)vertexShaderAssembly);
     }
 
     glGetShaderiv(vertexShader, GL_COMPILE_STATUS,
                                &vertexCompiled);
+    startupEnd(sourcebytes);
     if(vertexCompiled  == GL_FALSE)
   	{
         glGetShaderInfoLog(vertexShader, sizeof(str), NULL, str);
@@ -216,15 +400,16 @@ GLuint createShader(char *vertexshaderfile, char *fragmentshaderfile) {
   	// Create the fragment shader.
     fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 
-    fragmentShaderAssembly = readShaderFile(fragmentshaderfile);
-    if(fragmentShaderAssembly) { // Don't try to use a NULL pointer
-    	fragmentShaderStrings[0] = (char*)fragmentShaderAssembly;
-        glShaderSource(fragmentShader, 1, fragmentShaderStrings, NULL);
+    sourcebytes = fragmentsource ? (long)strlen(fragmentsource) : 0;
+    totalbytes += sourcebytes;
+    startupBegin("compile", "fragment", STARTUP_COMPILE);
+    if(fragmentsource) { // Don't try to use a NULL pointer
+        shaderSourceWithDefines(fragmentShader, fragmentsource, prelude);
         glCompileShader(fragmentShader);
-        free((void *)fragmentShaderAssembly);
     }
 
-    glGetProgramiv(fragmentShader, GL_COMPILE_STATUS, &fragmentCompiled);
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &fragmentCompiled);
+    startupEnd(sourcebytes);
     if(fragmentCompiled == GL_FALSE)
    	{
         glGetShaderInfoLog(fragmentShader, sizeof(str), NULL, str);
@@ -242,8 +427,10 @@ GLuint createShader(char *vertexshaderfile, char *fragmentshaderfile) {
     glAttachShader(programObject, fragmentShader);
 
     // Link the program object and print out the info log.
+    startupBegin("link", NULL, STARTUP_COMPILE);
     glLinkProgram(programObject);
     glGetProgramiv(programObject, GL_LINK_STATUS, &shadersLinked);
+    startupEnd(0);
 
     if(shadersLinked == GL_FALSE)
 	{
@@ -256,17 +443,31 @@ GLuint createShader(char *vertexshaderfile, char *fragmentshaderfile) {
 	glDeleteShader(vertexShader);   // These are no longer needed
 	glDeleteShader(fragmentShader); // after successful linking
 
+	// The size of the linked program can only be asked for if program
+	// binaries are supported. Otherwise use the source size as an estimate.
+#ifdef GL_PROGRAM_BINARY_LENGTH
+	if(glfwExtensionSupported("GL_ARB_get_program_binary")) {
+		glGetProgramiv(programObject, GL_PROGRAM_BINARY_LENGTH, &binarybytes);
+	}
+#endif
+	resourceTrack(RESOURCE_PROGRAM, (void*)(size_t)programObject, name,
+		0, binarybytes > 0 ? binarybytes : totalbytes);
+	free(prelude);
+
+	startupEnd(0);
 	return programObject;
 }
 
 
 /*
  * computeFPS() - Calculate, display and return frame rate statistics.
- * Called every frame, but statistics are updated only once per second.
+ * Called every frame, but the display is updated only once per second.
  * The time per frame is a better measure of performance than the
  * number of frames per second, so both are displayed.
+ * If stats is not NULL, every frame is also recorded there, which
+ * gives percentiles and hitch counts that a one-second average hides.
  */
-double computeFPS(GLFWwindow *window) {
+double computeFPS(GLFWwindow *window, frameStats *stats) {
 
     static double t0 = 0.0;
     static int frames = 0;
@@ -278,12 +479,24 @@ double computeFPS(GLFWwindow *window) {
     
     // Get current time
     t = glfwGetTime();  // Gets number of seconds since glfwInit()
+    if(stats) frameStatsTick(stats, t, timerCPUSeconds());
     // If one second has passed, or if this is the very first frame
     if( (t-t0) > 1.0 || frames == 0 )
     {
         fps = (double)frames / (t-t0);
         if(frames > 0) frametime = 1000.0 * (t-t0) / frames;
-        sprintf(titlestring, "TNM046, %.2f ms/frame (%.1f FPS)", frametime, fps);
+        if(stats && stats->gpu.total > 0) {
+            sprintf(titlestring, "TNM046, %.2f ms/frame (%.1f FPS), p99 %.2f ms, %lu hitches, GPU %.2f ms",
+                frametime, fps, histogramPercentile(&stats->wall, 0.99), stats->hitches,
+                histogramPercentile(&stats->gpu, 0.5));
+        }
+        else if(stats) {
+            sprintf(titlestring, "TNM046, %.2f ms/frame (%.1f FPS), p99 %.2f ms, %lu hitches",
+                frametime, fps, histogramPercentile(&stats->wall, 0.99), stats->hitches);
+        }
+        else {
+            sprintf(titlestring, "TNM046, %.2f ms/frame (%.1f FPS)", frametime, fps);
+        }
         glfwSetWindowTitle(window, titlestring);
         // printf("Speed: %.1f FPS\n", fps);
         t0 = t;
@@ -0,0 +1,191 @@
+/* trace.c */
+/* Timeline zones for CPU threads and the GPU, written as Chrome trace JSON */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include "timer.h"
+#include "trace.h"
+
+#define TRACE_CHUNKSIZE 4096 // Events per allocation in a thread buffer
+
+/* One recorded event. Begin/end pairs have phase 'B'/'E', complete zones 'X'. */
+typedef struct {
+	const char *name;
+	unsigned long long time;     // Nanoseconds, timerNanoseconds() clock
+	unsigned long long duration; // For 'X' events only
+	int thread;
+	char phase;
+} traceEvent;
+
+typedef struct traceChunk {
+	traceEvent events[TRACE_CHUNKSIZE];
+	struct traceChunk *next;
+} traceChunk;
+
+/* The events of one thread, in a list of fixed size chunks */
+typedef struct traceBuffer {
+	traceChunk *first;
+	traceChunk *last;
+	int count;          // Events in the last chunk
+	int thread;         // Small sequential thread id
+	const char *name;   // Thread name, or NULL
+	struct traceBuffer *next;
+} traceBuffer;
+
+static _Atomic(traceBuffer*) traceBuffers = NULL; // All thread buffers
+static atomic_int traceThreadCount = 0;
+static unsigned long long traceOrigin = 0;
+static _Thread_local traceBuffer *traceLocal = NULL;
+
+/*
+ * traceThreadBuffer() - the calling thread's buffer, created on first use.
+ * This is the only place where threads touch shared state, and it is a
+ * lock-free push onto the list of buffers.
+ */
+static traceBuffer *traceThreadBuffer(void) {
+	traceBuffer *buffer = traceLocal;
+	traceBuffer *head;
+
+	if(buffer) return buffer;
+	buffer = (traceBuffer*)malloc(sizeof(traceBuffer));
+	if(buffer == NULL) return NULL;
+	buffer->first = buffer->last = NULL;
+	buffer->count = TRACE_CHUNKSIZE; // Forces a chunk to be allocated on first use
+	buffer->thread = atomic_fetch_add(&traceThreadCount, 1);
+	buffer->name = NULL;
+	head = atomic_load(&traceBuffers);
+	do {
+		buffer->next = head;
+	} while(!atomic_compare_exchange_weak(&traceBuffers, &head, buffer));
+	traceLocal = buffer;
+	return buffer;
+}
+
+/*
+ * traceAppend() - get space for one more event in the calling thread's buffer
+ */
+static traceEvent *traceAppend(void) {
+	traceBuffer *buffer = traceThreadBuffer();
+	traceChunk *chunk;
+
+	if(buffer == NULL) return NULL;
+	if(buffer->count == TRACE_CHUNKSIZE) {
+		chunk = (traceChunk*)malloc(sizeof(traceChunk));
+		if(chunk == NULL) return NULL;
+		chunk->next = NULL;
+		if(buffer->last) buffer->last->next = chunk;
+		else buffer->first = chunk;
+		buffer->last = chunk;
+		buffer->count = 0;
+	}
+	return &(buffer->last->events[buffer->count++]);
+}
+
+/* Set the time origin of the trace and name the calling thread */
+void traceInit(const char *threadname) {
+	traceOrigin = timerNanoseconds();
+	traceSetThreadName(threadname);
+}
+
+/* Name the calling thread in the trace */
+void traceSetThreadName(const char *name) {
+	traceBuffer *buffer = traceThreadBuffer();
+	if(buffer) buffer->name = name;
+}
+
+/* Start a zone on the calling thread */
+void traceBegin(const char *name) {
+	traceEvent *event = traceAppend();
+	if(event == NULL) return;
+	event->name = name;
+	event->phase = 'B';
+	event->thread = traceLocal->thread;
+	event->time = timerNanoseconds();
+}
+
+/* End the most recently started zone on the calling thread */
+void traceEnd(void) {
+	unsigned long long time = timerNanoseconds(); // Read the clock before any allocation
+	traceEvent *event = traceAppend();
+	if(event == NULL) return;
+	event->name = NULL;
+	event->phase = 'E';
+	event->thread = traceLocal->thread;
+	event->time = time;
+}
+
+/* Record a finished zone with explicit timing on any track */
+void traceComplete(const char *name, int thread, unsigned long long start,
+	unsigned long long duration) {
+	traceEvent *event = traceAppend();
+	if(event == NULL) return;
+	event->name = name;
+	event->phase = 'X';
+	event->thread = thread;
+	event->time = start;
+	event->duration = duration;
+}
+
+/* Helpers for TRACE_ZONE() */
+int traceBeginScope(const char *name) {
+	traceBegin(name);
+	return 0;
+}
+
+void traceEndScope(int *unused) {
+	(void)unused;
+	traceEnd();
+}
+
+/*
+ * traceWrite() - write all events in the Chrome trace event format.
+ * Timestamps in that format are microseconds, so nanoseconds are
+ * written with three decimals to keep the full resolution.
+ */
+int traceWrite(const char *filename) {
+	FILE *file;
+	traceBuffer *buffer;
+	traceChunk *chunk;
+	traceEvent *e;
+	int i, n, first, gpu;
+	double t;
+
+	file = fopen(filename, "w");
+	if(file == NULL) {
+		fprintf(stderr, "Cannot write trace to %s.\n", filename);
+		return 0;
+	}
+	fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+	first = 1;
+	gpu = 0;
+	for(buffer = atomic_load(&traceBuffers); buffer; buffer = buffer->next) {
+		if(buffer->name) {
+			fprintf(file, "%s{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"name\": \"thread_name\", "
+				"\"args\": {\"name\": \"%s\"}}", first ? "" : ",\n", buffer->thread, buffer->name);
+			first = 0;
+		}
+		for(chunk = buffer->first; chunk; chunk = chunk->next) {
+			n = (chunk == buffer->last) ? buffer->count : TRACE_CHUNKSIZE;
+			for(i=0; i<n; i++) {
+				e = &(chunk->events[i]);
+				t = 1e-3 * (double)(long long)(e->time - traceOrigin);
+				fprintf(file, "%s{\"ph\": \"%c\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f",
+					first ? "" : ",\n", e->phase, e->thread, t);
+				if(e->name) fprintf(file, ", \"name\": \"%s\"", e->name);
+				if(e->phase == 'X') fprintf(file, ", \"dur\": %.3f", 1e-3 * (double)e->duration);
+				fprintf(file, "}");
+				first = 0;
+				if(e->thread == TRACE_GPU_THREAD) gpu = 1;
+			}
+		}
+	}
+	if(gpu) {
+		fprintf(file, "%s{\"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"name\": \"thread_name\", "
+			"\"args\": {\"name\": \"GPU\"}}", first ? "" : ",\n", TRACE_GPU_THREAD);
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return 1;
+}
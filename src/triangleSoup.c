@@ -2,6 +2,8 @@
 #include <stdlib.h> // For malloc() and free()
 #include <string.h> // For strcmp()
 #include <math.h>   // For sin() and cos() in soupCreateSphere()
+#include <stdatomic.h> // For the allocation counters
+#include <sys/stat.h> // For the file size in soupLoadOBJBegin()
 #include <GLFW/glfw3.h>
 
 #ifdef __WIN32__
@@ -11,6 +13,40 @@
 #include "tnm084.h"  // To be able to use OpenGL extensions below
 
 #include "triangleSoup.h"
+#include "trace.h"
+#include "startup.h"
+#include "resources.h"
+#include "blockReader.h"
+#include "timer.h"
+#include "arena.h"
+
+// Bytes of OBJ text per triangle, on the low side, to size the GPU
+// buffers for a file that is loaded progressively. The meshes here
+// have 80 to 110, counting the v, vn and vt lines.
+#define SOUP_OBJBYTESPERTRI 64
+
+// Heap allocations made for soups, for loader benchmarks
+static atomic_ulong soupAllocCount = 0;
+static atomic_long soupAllocBytes = 0;
+
+/*
+ * soupMalloc() - malloc() that counts how much was asked for
+ */
+static void *soupMalloc(size_t bytes) {
+	atomic_fetch_add(&soupAllocCount, 1);
+	atomic_fetch_add(&soupAllocBytes, (long)bytes);
+	return malloc(bytes);
+}
+
+/* Number of heap allocations made by the soup functions so far */
+unsigned long soupAllocations(void) {
+	return atomic_load(&soupAllocCount);
+}
+
+/* Total bytes requested by those allocations */
+long soupAllocatedBytes(void) {
+	return atomic_load(&soupAllocBytes);
+}
 
 
 /* Initialize a triangleSoup object to all zeros */
@@ -22,44 +58,340 @@ void soupInit(triangleSoup *soup) {
 	soup->indexarray = NULL;
 	soup->nverts = 0;
 	soup->ntris = 0;
+	soup->residency = SOUP_KEEP;
+	soup->positionarray = NULL;
+	soup->bounds[0] = soup->bounds[1] = 0.0f;
+	soup->bounds[2] = soup->bounds[3] = 0.0f;
+	soup->bounds[4] = soup->bounds[5] = 0.0f;
+	soup->attributebuffer = 0;
+	soup->attributesize = 0;
+	soup->indextype = GL_UNSIGNED_INT;
+	soup->vertexbytes = 8*sizeof(GLfloat);
+	soup->groups = NULL;
+	soup->ngroups = 0;
 }
 
 
 /* Clean up allocated data in a triangleSoup object */
 void soupDelete(triangleSoup *soup) {
 
-	if(glIsVertexArray(soup->vao)) {
+	// Soups parsed without a GL context have no GL objects to delete
+	if(soup->vao && glIsVertexArray(soup->vao)) {
 		glDeleteVertexArrays(1, &(soup->vao));
 	}
 	soup->vao = 0;
 
-	if(glIsBuffer(soup->vertexbuffer)) {
+	if(soup->vertexbuffer && glIsBuffer(soup->vertexbuffer)) {
 		glDeleteBuffers(1, &(soup->vertexbuffer));
 	}
 	soup->vertexbuffer = 0;
 
-	if(glIsBuffer(soup->indexbuffer)) {
+	if(soup->indexbuffer && glIsBuffer(soup->indexbuffer)) {
 		glDeleteBuffers(1, &(soup->indexbuffer));
 	}
 	soup->indexbuffer = 0;
 
+	if(soup->attributebuffer && glIsBuffer(soup->attributebuffer)) {
+		glDeleteBuffers(1, &(soup->attributebuffer));
+	}
+	soup->attributebuffer = 0;
+	soup->attributesize = 0;
+
 	if(soup->vertexarray) {
 		free((void*)soup->vertexarray);
 	}
+	soup->vertexarray = NULL;
 	if(soup->indexarray) 	{
 		free((void*)soup->indexarray);
 	}
+	soup->indexarray = NULL;
+	if(soup->positionarray) {
+		free((void*)soup->positionarray);
+	}
+	soup->positionarray = NULL;
+	free(soup->groups);
+	soup->groups = NULL;
+	soup->ngroups = 0;
 	soup->nverts = 0;
 	soup->ntris = 0;
 
+	resourceRelease(RESOURCE_SOUP, soup);
 };
 
 
+/*
+ * soupResidentBytes() - main memory held by the arrays of a triangleSoup
+ */
+static long soupResidentBytes(triangleSoup *soup) {
+	long bytes = 0;
+	if(soup->vertexarray) bytes += 8*soup->nverts*sizeof(GLfloat);
+	if(soup->positionarray) bytes += 3*soup->nverts*sizeof(GLfloat);
+	if(soup->indexarray) bytes += 3*soup->ntris*sizeof(GLuint);
+	return bytes;
+}
+
+/*
+ * soupIndexBytes() - bytes per index on the GPU
+ */
+static long soupIndexBytes(const triangleSoup *soup) {
+	if(soup->indextype == GL_UNSIGNED_SHORT) return sizeof(GLushort);
+	if(soup->indextype == GL_UNSIGNED_BYTE) return sizeof(GLubyte);
+	return sizeof(GLuint);
+}
+
+/*
+ * soupGPUBytes() - size of the buffers of a triangleSoup
+ */
+static long soupGPUBytes(triangleSoup *soup) {
+	return (long)(soup->vertexbytes + soup->attributesize*sizeof(GLfloat))*soup->nverts
+		+ 3*soup->ntris*soupIndexBytes(soup);
+}
+
+/*
+ * soupComputeBounds() - find the extents of the vertex array
+ */
+static void soupComputeBounds(triangleSoup *soup) {
+	int i, j;
+
+	for(j=0; j<3; j++) {
+		soup->bounds[2*j] = soup->bounds[2*j+1] = (soup->nverts > 0) ? soup->vertexarray[j] : 0.0f;
+	}
+	for(i=1; i<soup->nverts; i++) {
+		for(j=0; j<3; j++) {
+			if(soup->vertexarray[8*i+j] < soup->bounds[2*j]) soup->bounds[2*j] = soup->vertexarray[8*i+j];
+			if(soup->vertexarray[8*i+j] > soup->bounds[2*j+1]) soup->bounds[2*j+1] = soup->vertexarray[8*i+j];
+		}
+	}
+}
+
+/*
+ * soupComputeGroupBounds() - find the extents of each group, from the
+ * vertices its triangles use
+ */
+static void soupComputeGroupBounds(triangleSoup *soup) {
+	soupGroup *group;
+	const GLfloat *v;
+	int g, i, j;
+
+	for(g=0; g<soup->ngroups; g++) {
+		group = &soup->groups[g];
+		if(group->ntris == soup->ntris) { // The whole soup, which has its bounds already
+			for(j=0; j<6; j++) group->bounds[j] = soup->bounds[j];
+			continue;
+		}
+		for(j=0; j<6; j++) group->bounds[j] = 0.0f;
+		for(i=3*group->firsttri; i<3*(group->firsttri + group->ntris); i++) {
+			v = &soup->vertexarray[8*soup->indexarray[i]];
+			for(j=0; j<3; j++) {
+				if(i == 3*group->firsttri || v[j] < group->bounds[2*j]) group->bounds[2*j] = v[j];
+				if(i == 3*group->firsttri || v[j] > group->bounds[2*j+1]) group->bounds[2*j+1] = v[j];
+			}
+		}
+	}
+}
+
+/*
+ * soupApplyResidency() - drop what the residency policy says not to keep.
+ * Call only once the geometry has been uploaded.
+ */
+static void soupApplyResidency(triangleSoup *soup) {
+	int i;
+	int residency = soup->residency;
+
+	if(!soup->vertexarray) return; // Already released
+
+	if(residency == SOUP_POSITIONS) {
+		soup->positionarray = (GLfloat*)soupMalloc(3*soup->nverts*sizeof(GLfloat));
+		if(soup->positionarray) {
+			for(i=0; i<soup->nverts; i++) {
+				soup->positionarray[3*i] = soup->vertexarray[8*i];
+				soup->positionarray[3*i+1] = soup->vertexarray[8*i+1];
+				soup->positionarray[3*i+2] = soup->vertexarray[8*i+2];
+			}
+		}
+	}
+	if(residency == SOUP_RELEASE || residency == SOUP_POSITIONS) {
+		free((void*)soup->vertexarray);
+		soup->vertexarray = NULL;
+	}
+	if(residency == SOUP_RELEASE && soup->indexarray) {
+		free((void*)soup->indexarray);
+		soup->indexarray = NULL;
+	}
+	resourceTrack(RESOURCE_SOUP, soup, NULL, soupResidentBytes(soup), soupGPUBytes(soup));
+}
+
+/*
+ * soupSetResidency(triangleSoup *soup, int residency)
+ *
+ * Choose what is kept in main memory once the geometry is on the GPU.
+ * Set this before creating or loading the geometry. If the soup has
+ * already been uploaded, the policy is applied right away, but memory
+ * that has already been released cannot be brought back.
+ */
+void soupSetResidency(triangleSoup *soup, int residency) {
+	soup->residency = residency;
+	if(soup->vao) soupApplyResidency(soup);
+}
+
+
+/*
+ * soupSetAttribute(triangleSoup *soup, GLuint location, int size, const GLfloat *values)
+ *
+ * Add a per-vertex attribute in a separate buffer to an uploaded soup,
+ * for data computed from the geometry, like a precomputed displacement.
+ * values holds size floats for each of the soup->nverts vertices. The
+ * shader reads it from "layout(location = ...) in". A soup has room for
+ * one such attribute, and setting it again replaces the old one.
+ */
+void soupSetAttribute(triangleSoup *soup, GLuint location, int size, const GLfloat *values) {
+	if(!soup->vao || size < 1 || size > 4) return;
+
+	if(!soup->attributebuffer) glGenBuffers(1, &(soup->attributebuffer));
+	soup->attributesize = size;
+
+	glBindVertexArray(soup->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, soup->attributebuffer);
+	glBufferData(GL_ARRAY_BUFFER,
+		size*soup->nverts*sizeof(GLfloat), values, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(location);
+	glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE,
+		size*sizeof(GLfloat), (void*)0);
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	resourceTrack(RESOURCE_SOUP, soup, NULL, soupResidentBytes(soup), soupGPUBytes(soup));
+}
+
+
 /* Create a simple box geometry */
 void soupCreateBox(triangleSoup *soup, float xsize, float ysize, float zsize) {
 	/* Not yet implemented */
 };
 
+/*
+ * soupUpload(triangleSoup *soup, const char *name)
+ *
+ * Create the vertex array object and the two buffers for a triangleSoup
+ * whose vertex and index arrays have been filled in. The vertex array
+ * is interleaved, 8 floats per vertex: x y z nx ny nz s t.
+ * The name is what the soup is listed as in the resource registry.
+ */
+static void soupUpload(triangleSoup *soup, const char *name) {
+
+	long bytes = 8*soup->nverts*sizeof(GLfloat) + 3*soup->ntris*sizeof(GLuint);
+
+	// The extents are kept regardless of residency, so they are computed
+	// here while the full vertex array is still guaranteed to be around.
+	soupComputeBounds(soup);
+
+	startupBegin("upload", NULL, STARTUP_UPLOAD);
+
+	// Generate one vertex array object (VAO) and bind it
+	glGenVertexArrays(1, &(soup->vao));
+	glBindVertexArray(soup->vao);
+
+	// Generate two buffer IDs
+	glGenBuffers(1, &(soup->vertexbuffer));
+	glGenBuffers(1, &(soup->indexbuffer));
+
+ 	// Activate the vertex buffer
+	glBindBuffer(GL_ARRAY_BUFFER, soup->vertexbuffer);
+ 	// Present our vertex coordinates to OpenGL
+	glBufferData(GL_ARRAY_BUFFER,
+		8*soup->nverts * sizeof(GLfloat), soup->vertexarray, GL_STATIC_DRAW);
+	// Specify how many attribute arrays we have in our VAO
+	glEnableVertexAttribArray(0); // Vertex coordinates
+	glEnableVertexAttribArray(1); // Normals
+	glEnableVertexAttribArray(2); // Texture coordinates
+	// Specify how OpenGL should interpret the vertex buffer data:
+	// Attributes 0, 1, 2 (must match the lines above and the layout in the shader)
+	// Number of dimensions (3 means vec3 in the shader, 2 means vec2)
+	// Type GL_FLOAT
+	// Not normalized (GL_FALSE)
+	// Stride 8 (interleaved array with 8 floats per vertex)
+	// Array buffer offset 0, 3, 6 (offset into first vertex)
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
+		8*sizeof(GLfloat), (void*)0); // xyz coordinates
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
+		8*sizeof(GLfloat), (void*)(3*sizeof(GLfloat))); // normals
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
+		8*sizeof(GLfloat), (void*)(6*sizeof(GLfloat))); // texcoords
+
+ 	// Activate the index buffer
+ 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, soup->indexbuffer);
+ 	// Present our vertex indices to OpenGL
+ 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+	 	3*soup->ntris*sizeof(GLuint), soup->indexarray, GL_STATIC_DRAW);
+
+	// Deactivate (unbind) the VAO and the buffers again.
+	// Do NOT unbind the buffers while the VAO is still bound.
+	// The index buffer is an essential part of the VAO state.
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+ 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	// Make the upload phase include the transfer, not just the API calls
+	if(startupSyncGPU()) glFinish();
+	startupEnd(bytes);
+
+	// Register the GPU buffers, then drop whatever the residency policy
+	// says we do not need to keep in main memory
+	resourceTrack(RESOURCE_SOUP, soup, name, bytes, bytes);
+	soupApplyResidency(soup);
+}
+
+/*
+ * soupCreatePacked() - create the GL buffers for a soup from packed
+ * vertices (see SOUP_PACKEDVERTEXBYTES) and indices, e.g. straight
+ * from a mapped asset bundle. No arrays are kept in main memory, so
+ * the soup is like one with SOUP_RELEASE, and the bounds are given.
+ */
+void soupCreatePacked(triangleSoup *soup, const void *vertices, int nverts,
+	const void *indices, int ntris, GLenum indextype, const GLfloat bounds[6], const char *name) {
+
+	long indexbytes = (indextype == GL_UNSIGNED_SHORT) ? sizeof(GLushort) : sizeof(GLuint);
+	long bytes = (long)SOUP_PACKEDVERTEXBYTES*nverts + 3*ntris*indexbytes;
+	int i;
+
+	soup->nverts = nverts;
+	soup->ntris = ntris;
+	soup->indextype = indextype;
+	soup->vertexbytes = SOUP_PACKEDVERTEXBYTES;
+	soup->residency = SOUP_RELEASE;
+	for(i=0; i<6; i++) soup->bounds[i] = bounds[i];
+
+	startupBegin("upload", NULL, STARTUP_UPLOAD);
+	glGenVertexArrays(1, &(soup->vao));
+	glBindVertexArray(soup->vao);
+	glGenBuffers(1, &(soup->vertexbuffer));
+	glGenBuffers(1, &(soup->indexbuffer));
+
+	glBindBuffer(GL_ARRAY_BUFFER, soup->vertexbuffer);
+	glBufferData(GL_ARRAY_BUFFER, (long)SOUP_PACKEDVERTEXBYTES*nverts, vertices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	// The shader still sees vec3, vec3 and vec2: GL converts the formats
+	glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE,
+		SOUP_PACKEDVERTEXBYTES, (void*)0); // xyz coordinates
+	glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE,
+		SOUP_PACKEDVERTEXBYTES, (void*)8); // normals
+	glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE,
+		SOUP_PACKEDVERTEXBYTES, (void*)12); // texcoords
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, soup->indexbuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 3*ntris*indexbytes, indices, GL_STATIC_DRAW);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	if(startupSyncGPU()) glFinish();
+	startupEnd(bytes);
+	resourceTrack(RESOURCE_SOUP, soup, name, 0, bytes);
+}
+
 /*
  * soupCreateSphere(triangleSoup soup, float radius, int segments)
  *
@@ -78,6 +410,26 @@ void soupCreateBox(triangleSoup *soup, float xsize, float ysize, float zsize) {
  */
 void soupCreateSphere(triangleSoup *soup, float radius, int segments) {
 
+	TRACE_ZONE("soupCreateSphere");
+	startupBegin("soupCreateSphere", NULL, STARTUP_CPU);
+
+	soupGenerateSphere(soup, radius, segments);
+
+	// Send the data off to the GPU
+	soupUpload(soup, "sphere");
+
+	startupEnd(0);
+};
+
+/*
+ * soupGenerateSphere(triangleSoup soup, float radius, int segments)
+ *
+ * The CPU half of soupCreateSphere(): fill in the vertex and index
+ * arrays, but do not touch OpenGL. For renderers that run without a
+ * GL context, and for callers that upload the arrays later.
+ */
+void soupGenerateSphere(triangleSoup *soup, float radius, int segments) {
+
 	int i, j, base, i0;
 	float x, y, z, R;
 	double theta, phi;
@@ -92,8 +444,8 @@ void soupCreateSphere(triangleSoup *soup, float radius, int segments) {
 	hsegs = vsegs * 2;
 	soup->nverts = 1 + (vsegs-1) * (hsegs+1) + 1; // top + middle + bottom
 	soup->ntris = hsegs + (vsegs-2) * hsegs * 2 + hsegs; // top + middle + bottom
-	soup->vertexarray = (float*)malloc(soup->nverts * 8 * sizeof(float));
-	soup->indexarray = (unsigned int*)malloc(soup->ntris * 3 * sizeof(int));
+	soup->vertexarray = (float*)soupMalloc(soup->nverts * 8 * sizeof(float));
+	soup->indexarray = (unsigned int*)soupMalloc(soup->ntris * 3 * sizeof(int));
 
 	// The vertex array: 3D xyz, 3D normal, 2D st (8 floats per vertex)
 	// First vertex: top pole (+y is "up" in object local coords)
@@ -165,58 +517,297 @@ void soupCreateSphere(triangleSoup *soup, float radius, int segments) {
 		soup->indexarray[base+3*i+1] = soup->nverts-2-i;
 		soup->indexarray[base+3*i+2] = soup->nverts-3-i;
 	}
+	soupComputeBounds(soup);
+};
 
-	// Generate one vertex array object (VAO) and bind it
-	glGenVertexArrays(1, &(soup->vao));
-	glBindVertexArray(soup->vao);
 
-	// Generate two buffer IDs
-	glGenBuffers(1, &(soup->vertexbuffer));
-	glGenBuffers(1, &(soup->indexbuffer));
+/*
+ * soupGrow() - make room for at least needed elements in *array by
+ * doubling its capacity, counted like soupMalloc(). Returns 0 on failure.
+ */
+static int soupGrow(void **array, int *capacity, int needed, size_t elementsize) {
+	int grown = *capacity > 0 ? *capacity : 1024;
+	void *moved;
 
- 	// Activate the vertex buffer
-	glBindBuffer(GL_ARRAY_BUFFER, soup->vertexbuffer);
- 	// Present our vertex coordinates to OpenGL
-	glBufferData(GL_ARRAY_BUFFER,
-		8*soup->nverts * sizeof(GLfloat), soup->vertexarray, GL_STATIC_DRAW);
-	// Specify how many attribute arrays we have in our VAO
-	glEnableVertexAttribArray(0); // Vertex coordinates
-	glEnableVertexAttribArray(1); // Normals
-	glEnableVertexAttribArray(2); // Texture coordinates
-	// Specify how OpenGL should interpret the vertex buffer data:
-	// Attributes 0, 1, 2 (must match the lines above and the layout in the shader)
-	// Number of dimensions (3 means vec3 in the shader, 2 means vec2)
-	// Type GL_FLOAT
-	// Not normalized (GL_FALSE)
-	// Stride 8 (interleaved array with 8 floats per vertex)
-	// Array buffer offset 0, 3, 6 (offset into first vertex)
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-		8*sizeof(GLfloat), (void*)0); // xyz coordinates
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-		8*sizeof(GLfloat), (void*)(3*sizeof(GLfloat))); // normals
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
-		8*sizeof(GLfloat), (void*)(6*sizeof(GLfloat))); // texcoords
+	if(needed <= *capacity) return 1;
+	while(grown < needed) grown *= 2;
+	atomic_fetch_add(&soupAllocCount, 1);
+	atomic_fetch_add(&soupAllocBytes, (long)((grown - *capacity) * elementsize));
+	moved = realloc(*array, grown * elementsize);
+	if(!moved) {
+		printError("Memory error", "soupParseOBJ");
+		return 0;
+	}
+	*array = moved;
+	*capacity = grown;
+	return 1;
+}
 
- 	// Activate the index buffer
- 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, soup->indexbuffer);
- 	// Present our vertex indices to OpenGL
- 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-	 	3*soup->ntris*sizeof(GLuint), soup->indexarray, GL_STATIC_DRAW);
+/*
+ * soupGrowScratch() - soupGrow() for a temporary array in an arena
+ */
+static int soupGrowScratch(arena *scratch, void **array, int *capacity, int needed, size_t elementsize) {
+	int grown = *capacity > 0 ? *capacity : 1024;
+	void *moved;
 
-	// Deactivate (unbind) the VAO and the buffers again.
-	// Do NOT unbind the buffers while the VAO is still bound.
-	// The index buffer is an essential part of the VAO state.
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
- 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	if(needed <= *capacity) return 1;
+	while(grown < needed) grown *= 2;
+	moved = arenaGrow(scratch, *array, (long)(*capacity * elementsize), (long)(grown * elementsize));
+	if(!moved) {
+		printError("Memory error", "soupParseOBJ");
+		return 0;
+	}
+	*array = moved;
+	*capacity = grown;
+	return 1;
+}
 
-};
+/*
+ * soupParseOBJGroup() - start a new group with the next face. Faces
+ * before the first group go in one called "default", and a group that
+ * gets no faces before the next one is only renamed. Returns 0 on failure.
+ */
+static int soupParseOBJGroup(objParser *p, const char *name) {
+	soupGroup *group;
+	int length;
 
+	if(p->ngroups > 0) p->groups[p->ngroups-1].ntris = p->i_f - p->groups[p->ngroups-1].firsttri;
+	if(p->ngroups == 0 && p->i_f > 0) { // Put the faces so far in a group of their own
+		if(!soupGrow((void**)&p->groups, &p->capgroups, 1, sizeof(soupGroup))) return 0;
+		strcpy(p->groups[0].name, "default");
+		p->groups[0].firsttri = 0;
+		p->groups[0].ntris = p->i_f;
+		p->groups[0].visible = 1;
+		p->ngroups = 1;
+	}
+	if(p->ngroups == 0 || p->groups[p->ngroups-1].ntris > 0) {
+		if(!soupGrow((void**)&p->groups, &p->capgroups, p->ngroups+1, sizeof(soupGroup))) return 0;
+		p->ngroups++;
+	}
+	group = &p->groups[p->ngroups-1];
+	group->firsttri = p->i_f;
+	group->ntris = 0;
+	group->visible = 1;
+
+	// The name is the rest of the line, without surrounding white space
+	while(*name == ' ' || *name == '\t') name++;
+	for(length = (int)strlen(name); length > 0 && (unsigned char)name[length-1] <= ' '; length--);
+	if(length > SOUP_GROUPNAMESIZE-1) length = SOUP_GROUPNAMESIZE-1;
+	memcpy(group->name, name, length);
+	group->name[length] = '\0';
+	return 1;
+}
 
 /*
- * soupReadObj(triangleSoup* soup, char* filename)
+ * soupParseOBJLine() - take one line of an OBJ file into the parser and
+ * the soup. Faces can only refer to data on earlier lines. Returns 0 if
+ * the line is malformed.
+ */
+static int soupParseOBJLine(objParser *p, arena *scratch, triangleSoup *soup, const char *line) {
+	char tag[3];
+	int v[3], n[3], t[3];
+	int numargs, currentv, k;
+
+	p->lines++;
+	tag[0] = '\0';
+	sscanf(line, "%2s ", tag);
+	if(!strcmp(tag, "v")) {
+		if(!soupGrowScratch(scratch, (void**)&p->verts, &p->capverts, 3*(p->i_v+1), sizeof(float))) return 0;
+		numargs = sscanf(line, "v %f %f %f",
+			&p->verts[3*p->i_v], &p->verts[3*p->i_v+1], &p->verts[3*p->i_v+2]);
+		if(numargs != 3) {
+			printf("Malformed vertex data found at vertex %d.\n", p->i_v+1);
+			printf("Aborting.\n");
+			return 0;
+		}
+		p->i_v++;
+	}
+	else if(!strcmp(tag, "vn")) {
+		if(!soupGrowScratch(scratch, (void**)&p->normals, &p->capnormals, 3*(p->i_n+1), sizeof(float))) return 0;
+		numargs = sscanf(line, "vn %f %f %f",
+			&p->normals[3*p->i_n], &p->normals[3*p->i_n+1], &p->normals[3*p->i_n+2]);
+		if(numargs != 3) {
+			printf("Malformed normal data found at normal %d.\n", p->i_n+1);
+			printf("Aborting.\n");
+			return 0;
+		}
+		p->i_n++;
+	}
+	else if(!strcmp(tag, "vt"))  {
+		if(!soupGrowScratch(scratch, (void**)&p->texcoords, &p->captexcoords, 2*(p->i_t+1), sizeof(float))) return 0;
+		numargs = sscanf(line, "vt %f %f",
+			&p->texcoords[2*p->i_t], &p->texcoords[2*p->i_t+1]);
+		if(numargs != 2) {
+			printf("Malformed texcoord data found at texcoord %d.\n", p->i_t+1);
+			printf("Aborting.\n");
+			return 0;
+		}
+		p->i_t++;
+	}
+	else if(!strcmp(tag, "f")) {
+		numargs = sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
+			&v[0], &t[0], &n[0], &v[1], &t[1], &n[1], &v[2], &t[2], &n[2]);
+		if(numargs != 9) {
+			printf("Malformed face data found at face %d.\n", p->i_f+1);
+			printf("Aborting.\n");
+			return 0;
+		}
+		for(k = 0; k < 3; k++) {
+			if(v[k] < 1 || v[k] > p->i_v || n[k] < 1 || n[k] > p->i_n || t[k] < 1 || t[k] > p->i_t) {
+				printf("Face %d refers to data that is not there.\n", p->i_f+1);
+				printf("Aborting.\n");
+				return 0;
+			}
+		}
+		if(!soupGrow((void**)&soup->vertexarray, &p->capfaces, p->i_f+1, 8*3*sizeof(float))
+			|| !soupGrow((void**)&soup->indexarray, &p->capindices, p->i_f+1, 3*sizeof(unsigned int))) return 0;
+		currentv = 8*3*p->i_f;
+		for(k = 0; k < 3; k++) {
+			soup->vertexarray[currentv+8*k] = p->verts[3*(v[k]-1)];
+			soup->vertexarray[currentv+8*k+1] = p->verts[3*(v[k]-1)+1];
+			soup->vertexarray[currentv+8*k+2] = p->verts[3*(v[k]-1)+2];
+			soup->vertexarray[currentv+8*k+3] = p->normals[3*(n[k]-1)];
+			soup->vertexarray[currentv+8*k+4] = p->normals[3*(n[k]-1)+1];
+			soup->vertexarray[currentv+8*k+5] = p->normals[3*(n[k]-1)+2];
+			soup->vertexarray[currentv+8*k+6] = p->texcoords[2*(t[k]-1)];
+			soup->vertexarray[currentv+8*k+7] = p->texcoords[2*(t[k]-1)+1];
+			soup->indexarray[3*p->i_f+k] = 3*p->i_f+k;
+		}
+		p->i_f++;
+	}
+	else if(!strcmp(tag, "g") || !strcmp(tag, "o")) {
+		if(!soupParseOBJGroup(p, line + 1)) return 0;
+	}
+	//else printf("Ignoring line starting with \"%s\"\n", tag);
+	return 1;
+}
+
+
+/*
+ * soupLoaderOpen() - start the reader thread on an OBJ file, and empty
+ * the soup for the parser, freeing anything it held from before. The
+ * soup is left as it was if the file cannot be opened, and 0 returned.
+ */
+static int soupLoaderOpen(soupLoader *loader, triangleSoup *soup, const char *filename) {
+	memset(loader, 0, sizeof(soupLoader));
+	if(!blockReaderOpen(&loader->reader, filename)) return 0;
+	arenaInit(&loader->scratch, 0);
+	soupDelete(soup);
+	// A soup that held a packed or .glb mesh goes back to the OBJ layout
+	soup->indextype = GL_UNSIGNED_INT;
+	soup->vertexbytes = 8*sizeof(GLfloat);
+	return 1;
+}
+
+/*
+ * soupLoaderParse() - parse lines until the end of the file, or until
+ * seconds have passed if seconds > 0. Sets loader->done at the end of
+ * the file, and loader->error on a malformed line.
+ */
+static void soupLoaderParse(soupLoader *loader, triangleSoup *soup, double seconds) {
+	const char *block, *newline;
+	double deadline = timerSeconds() + seconds;
+	int blocksize, copied;
+	long lines = 0;
+
+	while(!loader->done && !loader->error) {
+		if(loader->blockpos == loader->blockend) {
+			block = blockReaderNext(&loader->reader, &blocksize);
+			if(!block) {
+				loader->done = 1;
+				break;
+			}
+			loader->blockpos = block;
+			loader->blockend = block + blocksize;
+		}
+		// Lines do not end where blocks do: a line that is cut off at
+		// the end of a block stays in line[] and is continued from the
+		// next. Overlong lines are truncated rather than split.
+		newline = (const char*)memchr(loader->blockpos, '\n', loader->blockend - loader->blockpos);
+		copied = (int)((newline ? newline : loader->blockend) - loader->blockpos);
+		if(copied > (int)sizeof(loader->line) - 1 - loader->length)
+			copied = (int)sizeof(loader->line) - 1 - loader->length;
+		memcpy(loader->line + loader->length, loader->blockpos, copied);
+		loader->length += copied;
+		if(!newline) {
+			loader->blockpos = loader->blockend;
+			continue;
+		}
+		loader->line[loader->length] = '\0';
+		loader->length = 0;
+		loader->blockpos = newline + 1;
+		if(!soupParseOBJLine(&loader->parser, &loader->scratch, soup, loader->line)) loader->error = 1;
+		// Reading the clock costs more than a short line, so do it now and then
+		if(seconds > 0.0 && ++lines % 64 == 0 && timerSeconds() >= deadline) break;
+	}
+}
+
+/*
+ * soupLoaderFinish() - close the reader, parse the last line and hand
+ * the arrays and groups over to the soup. If anything went wrong, the
+ * soup is deleted instead. Returns 1 on success.
+ */
+static int soupLoaderFinish(soupLoader *loader, triangleSoup *soup, objInfo *info) {
+	objParser *parser = &loader->parser;
+	GLfloat *shrunk;
+
+	loader->finished = 1;
+	if(!blockReaderClose(&loader->reader)) loader->error = 1;
+	if(!loader->error && loader->length > 0) { // The last line had no newline
+		loader->line[loader->length] = '\0';
+		if(!soupParseOBJLine(parser, &loader->scratch, soup, loader->line)) loader->error = 1;
+	}
+
+	if(info) {
+		info->bytes = loader->reader.bytes;
+		info->filebytes = loader->reader.filebytes;
+		info->lines = parser->lines;
+		info->positions = parser->i_v;
+		info->normals = parser->i_n;
+		info->texcoords = parser->i_t;
+		info->faces = parser->i_f;
+	}
+
+	// Free the temporary arrays all at once. The arena's blocks are
+	// counted with the soup's allocations, for the loader benchmarks.
+	atomic_fetch_add(&soupAllocCount, loader->scratch.nblocks);
+	atomic_fetch_add(&soupAllocBytes, loader->scratch.reserved);
+	arenaDelete(&loader->scratch);
+	parser->verts = parser->normals = parser->texcoords = NULL;
+
+	soup->nverts = 3*parser->i_f;
+	soup->ntris = parser->i_f;
+	// Close the last group, and drop it if it got no faces
+	if(parser->ngroups > 0) {
+		parser->groups[parser->ngroups-1].ntris = parser->i_f - parser->groups[parser->ngroups-1].firsttri;
+		if(parser->ngroups > 1 && parser->groups[parser->ngroups-1].ntris == 0) parser->ngroups--;
+	}
+	soup->groups = parser->groups;
+	soup->ngroups = parser->ngroups;
+	parser->groups = NULL;
+	if(loader->error) { // Delete corrupt data and bail out if a read error occured
+		soupDelete(soup);
+		return 0;
+	}
+	// Give back what the arrays grew by beyond the last face
+	if(parser->i_f > 0) {
+		shrunk = (GLfloat*)realloc(soup->vertexarray, 8*soup->nverts*sizeof(GLfloat));
+		if(shrunk) soup->vertexarray = shrunk;
+	}
+	soupComputeBounds(soup);
+	soupComputeGroupBounds(soup);
+	return 1;
+}
+
+/*
+ * soupParseOBJ(triangleSoup* soup, const char* filename, objInfo *info)
  *
- * Load triangleSoup geometry data from an OBJ file.
+ * Read triangleSoup geometry data from an OBJ file into main memory,
+ * without touching OpenGL, so it can also run on a thread without a
+ * GL context or in a command line tool. If info is not NULL, it is
+ * filled in with the size of the file and the number of elements.
+ * Returns 1 on success, 0 if the file could not be read or parsed.
+ * The file may be gzip or Zstandard compressed (see blockReader.h).
  * The vertex array is on interleaved format. For each vertex, there
  * are 8 floats: three for the vertex coordinates (x, y, z), three
  * for the normal vector (n_x, n_y, n_z) and finally two for texture
@@ -227,174 +818,88 @@ void soupCreateSphere(triangleSoup *soup, float radius, int segments) {
  * Author: Stefan Gustavson (stegu@itn.liu.se) 2013.
  * This code is in the public domain.
  */
-void soupReadOBJ(triangleSoup* soup, char* filename) {
+int soupParseOBJ(triangleSoup* soup, const char* filename, objInfo *info) {
 
-	FILE *objfile;
+	soupLoader loader;
+	int ok;
 
-	int numverts = 0;
-	int numnormals = 0;
-	int numtexcoords = 0;
-	int numfaces = 0;
-	int i_v = 0;
-	int i_n = 0;
-	int i_t = 0;
-	int i_f = 0;
-	float *verts, *normals, *texcoords;
+	TRACE_ZONE("soupParseOBJ");
 
-	char line[256];
-	char tag[3];
-	int v1,v2,v3,n1,n2,n3,t1,t2,t3;
-	int numargs, readerror, currentv;
-
-	objfile = fopen(filename, "r");
-	
-	// Scan through the file to count the number of data elements
-	while(fgets(line, 256, objfile)) {
-		sscanf(line, "%2s ", tag);
-		if(!strcmp(tag, "v")) numverts++;
-		else if(!strcmp(tag, "vn")) numnormals++;
-		else if(!strcmp(tag, "vt")) numtexcoords++;
-		else if(!strcmp(tag, "f")) numfaces++;
-		//else printf("Ignoring line starting with \"%s\"\n", tag);
-	}
-	
-	printf("loadObj(\"%s\"): found %d vertices, %d normals, %d texcoords, %d faces.\n",
-		filename, numverts, numnormals, numtexcoords, numfaces);
-
-	verts = (float*)malloc(3*numverts*sizeof(float));
-	normals = (float*)malloc(3*numnormals*sizeof(float));
-	texcoords = (float*)malloc(2*numtexcoords*sizeof(float));
-
-	soup->vertexarray = (float*)malloc(8*3*numfaces*sizeof(float));
-	soup->indexarray = (unsigned int*)malloc(3*numfaces*sizeof(unsigned int));
-	soup->nverts = 3*numfaces;
-	soup->ntris = numfaces;
-
-	rewind(objfile); // Start from the top again to read data
-
-	readerror = 0;
-	while(fgets(line, 256, objfile)) {
-		tag[0] = '\0';
-		sscanf(line, "%2s ", tag);
-		if(!strcmp(tag, "v")) {
-//			printf("Reading vertex %d\n", i_v+1);
-			numargs = sscanf(line, "v %f %f %f",
-				&verts[3*i_v], &verts[3*i_v+1], &verts[3*i_v+2]);
-			if(numargs != 3) {
-				printf("Malformed vertex data found at vertex %d.\n", i_v+1);
-				printf("Aborting.\n");
-				readerror = 1;
-				break;
-			}
-//			printf("Read vertex coord %d: %8.2f %8.2f %8.2f\n",
-//			i_v, verts[3*i_v], verts[3*i_v+1], verts[3*i_v+2]);
-			i_v++;
-		}
-		else if(!strcmp(tag, "vn")) {
-//			printf("Reading normal %d\n", i_n+1);
-			numargs = sscanf(line, "vn %f %f %f",
-				&normals[3*i_n], &normals[3*i_n+1], &normals[3*i_n+2]);
-			if(numargs != 3) {
-				printf("Malformed normal data found at normal %d.\n", i_n+1);
-				printf("Aborting.\n");
-				readerror = 1;
-				break;
-			}
-			i_n++;
-		}
-		else if(!strcmp(tag, "vt"))  {
-//          printf("Reading texcoord %d\n", i_t+1);
-			numargs = sscanf(line, "vt %f %f",
-				&texcoords[2*i_t], &texcoords[2*i_t+1]);
-			if(numargs != 2) {
-				printf("Malformed texcoord data found at texcoord %d.\n", i_t+1);
-				printf("Aborting.\n");
-				readerror = 1;
-				break;
-			}
-			i_t++;
-		}
-		else if(!strcmp(tag, "f")) {
-//			printf("Reading face %d\n", i_f+1);
-			numargs = sscanf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
-				&v1, &t1, &n1, &v2, &t2, &n2, &v3, &t3, &n3);
-			if(numargs != 9) {
-				printf("Malformed face data found at face %d.\n", i_f+1);
-				printf("Aborting.\n");
-				readerror = 1;
-				break;
-			}
-//			printf("Read vertex data %d/%d/%d %d/%d/%d %d/%d/%d\n",
-//			v1, t1, n1, v2, t2, n2, v3, t3, n3);
-			v1--; v2--; v3--; n1--; n2--; n3--; t1--; t2--; t3--;
-			currentv = 8*3*i_f;
-			soup->vertexarray[currentv] = verts[3*v1];
-			soup->vertexarray[currentv+1] = verts[3*v1+1];
-			soup->vertexarray[currentv+2] = verts[3*v1+2];
-			soup->vertexarray[currentv+3] = normals[3*n1];
-			soup->vertexarray[currentv+4] = normals[3*n1+1];
-			soup->vertexarray[currentv+5] = normals[3*n1+2];
-			soup->vertexarray[currentv+6] = texcoords[2*t1];
-			soup->vertexarray[currentv+7] = texcoords[2*t1+1];
-			soup->vertexarray[currentv+8] = verts[3*v2];
-			soup->vertexarray[currentv+9] = verts[3*v2+1];
-			soup->vertexarray[currentv+10] = verts[3*v2+2];
-			soup->vertexarray[currentv+11] = normals[3*n2];
-			soup->vertexarray[currentv+12] = normals[3*n2+1];
-			soup->vertexarray[currentv+13] = normals[3*n2+2];
-			soup->vertexarray[currentv+14] = texcoords[2*t2];
-			soup->vertexarray[currentv+15] = texcoords[2*t2+1];
-			soup->vertexarray[currentv+16] = verts[3*v3];
-			soup->vertexarray[currentv+17] = verts[3*v3+1];
-			soup->vertexarray[currentv+18] = verts[3*v3+2];
-			soup->vertexarray[currentv+19] = normals[3*n3];
-			soup->vertexarray[currentv+20] = normals[3*n3+1];
-			soup->vertexarray[currentv+21] = normals[3*n3+2];
-			soup->vertexarray[currentv+22] = texcoords[2*t3];
-			soup->vertexarray[currentv+23] = texcoords[2*t3+1];
-			soup->indexarray[3*i_f] = 3*i_f;
-			soup->indexarray[3*i_f+1] = 3*i_f+1;
-			soup->indexarray[3*i_f+2] = 3*i_f+2;
-			i_f++;
-		};
-	}
-
-	// Free the temporary arrays we created
-	free(verts);
-	free(normals);
-	free(texcoords);
-	fclose(objfile);
-
-	if(readerror) { // Delete corrupt data and bail out if a read error occured
-		soupDelete(soup);
+	// A reader thread reads and decompresses the file block by block while
+	// this one parses it, so reading and parsing overlap and make up one
+	// phase. Nothing is counted in a first pass, which would need all of
+	// the text at once, so the arrays grow as the lines come in.
+	startupBegin("parse", NULL, STARTUP_PARSE);
+	if(!soupLoaderOpen(&loader, soup, filename)) {
+		startupEnd(0);
+		return 0;
+	}
+	soupLoaderParse(&loader, soup, 0.0);
+	ok = soupLoaderFinish(&loader, soup, info);
+	startupEnd(loader.reader.bytes);
+	return ok;
+};
+
+
+/*
+ * soupReadObj(triangleSoup* soup, char* filename)
+ *
+ * Load triangleSoup geometry data from an OBJ file and send it to
+ * the GPU. See soupParseOBJ() for the format of the arrays.
+ */
+void soupReadOBJ(triangleSoup* soup, char* filename) {
+	objInfo info;
+
+	TRACE_ZONE("soupReadOBJ");
+	startupBegin("soupReadOBJ", filename, STARTUP_CPU);
+
+	if(!soupParseOBJ(soup, filename, &info)) {
+		startupEnd(0);
 		return;
 	}
-		
-	// Generate one vertex array object (VAO) and bind it
+	printf("loadObj(\"%s\"): found %d vertices, %d normals, %d texcoords, %d faces.\n",
+		filename, info.positions, info.normals, info.texcoords, info.faces);
+
+	// Send the data off to the GPU
+	soupUpload(soup, filename);
+
+	startupEnd(info.bytes);
+	return;
+};
+
+/*
+ * soupLoadOBJBegin(soupLoader *loader, triangleSoup *soup, const char *filename)
+ *
+ * Start loading an OBJ file progressively, so that a large mesh can be
+ * drawn while it is still coming in. The VAO and buffers are created
+ * right away, with room for the number of triangles a file of this size
+ * is likely to have, and soupLoadOBJStep() appends to them a little at
+ * a time, once per frame. soupRender() draws what has been appended so
+ * far. Returns 0 if the file cannot be opened.
+ */
+int soupLoadOBJBegin(soupLoader *loader, triangleSoup *soup, const char *filename) {
+	struct stat info;
+	long estimate = 0;
+
+	if(!soupLoaderOpen(loader, soup, filename)) return 0;
+
+	// Compressed text is guessed to be a quarter of its size. A file with
+	// more triangles than guessed makes the buffers grow, which costs a
+	// new upload of everything so far.
+	if(stat(filename, &info) == 0) estimate = (long)info.st_size / SOUP_OBJBYTESPERTRI;
+	if(loader->reader.format != BLOCKREADER_PLAIN) estimate *= 4;
+	loader->captris = estimate > 1024 ? (int)estimate : 1024;
+
 	glGenVertexArrays(1, &(soup->vao));
 	glBindVertexArray(soup->vao);
-
-	// Generate two buffer IDs
 	glGenBuffers(1, &(soup->vertexbuffer));
 	glGenBuffers(1, &(soup->indexbuffer));
 
- 	// Activate the vertex buffer
 	glBindBuffer(GL_ARRAY_BUFFER, soup->vertexbuffer);
- 	// Present our vertex coordinates to OpenGL
-	glBufferData(GL_ARRAY_BUFFER,
-		8*soup->nverts * sizeof(GLfloat), soup->vertexarray, GL_STATIC_DRAW);
-
-	// Specify how many attribute arrays we have in our VAO
-	glEnableVertexAttribArray(0); // Vertex coordinates
-	glEnableVertexAttribArray(1); // Normals
-	glEnableVertexAttribArray(2); // Texture coordinates
-	// Specify how OpenGL should interpret the vertex buffer data:
-	// Attributes 0, 1, 2 (must match the lines above and the layout in the shader)
-	// Number of dimensions (3 means vec3 in the shader, 2 means vec2)
-	// Type GL_FLOAT
-	// Not normalized (GL_FALSE)
-	// Stride 8 (interleaved array with 8 floats per vertex)
-	// Array buffer offset 0, 3, 6 (offset into first vertex)
+	glBufferData(GL_ARRAY_BUFFER, 3L*8*sizeof(GLfloat)*loader->captris, NULL, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
 		8*sizeof(GLfloat), (void*)0); // xyz coordinates
 	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
@@ -402,33 +907,309 @@ void soupReadOBJ(triangleSoup* soup, char* filename) {
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
 		8*sizeof(GLfloat), (void*)(6*sizeof(GLfloat))); // texcoords
 
- 	// Activate the index buffer
- 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, soup->indexbuffer);
- 	// Present our vertex indices to OpenGL
- 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-	 	3*soup->ntris*sizeof(GLuint), soup->indexarray, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, soup->indexbuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, 3L*sizeof(GLuint)*loader->captris, NULL, GL_STATIC_DRAW);
 
-	// Deactivate (unbind) the VAO and the buffers again.
-	// Do NOT unbind the buffers while the VAO is still bound.
-	// The index buffer is an essential part of the VAO state.
 	glBindVertexArray(0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
- 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-	return;
-};
+	resourceTrack(RESOURCE_SOUP, soup, filename, 0, 3L*(8*sizeof(GLfloat) + sizeof(GLuint))*loader->captris);
+	return 1;
+}
+
+/*
+ * soupLoadOBJStep(soupLoader *loader, triangleSoup *soup, double seconds)
+ *
+ * Parse for about the given number of seconds, and send the triangles
+ * that were completed to the end of the GPU buffers with glBufferSubData().
+ * The triangles are in the order of the file, so soup->ntris grows and
+ * soupRender() draws the first soup->ntris of them. The groups and the
+ * bounds are only there once the whole file is in, and only then are
+ * the arrays released as the residency policy says. Returns 1 while
+ * there is more to load, 0 when it is done. If loader->error is set,
+ * the file could not be read and the soup has been deleted.
+ */
+int soupLoadOBJStep(soupLoader *loader, triangleSoup *soup, double seconds) {
+	int first = soup->ntris, last;
+
+	if(loader->finished) return 0;
+	TRACE_ZONE("soupLoadOBJStep");
+
+	soupLoaderParse(loader, soup, seconds);
+	if((loader->done || loader->error) && !soupLoaderFinish(loader, soup, NULL)) return 0;
+	last = loader->parser.i_f;
+
+	glBindBuffer(GL_ARRAY_BUFFER, soup->vertexbuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, soup->indexbuffer);
+	if(last > loader->captris) {
+		// The VAO refers to the buffers by name, so new storage needs no new setup
+		while(loader->captris < last) loader->captris *= 2;
+		glBufferData(GL_ARRAY_BUFFER, 3L*8*sizeof(GLfloat)*loader->captris, NULL, GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, 3L*sizeof(GLuint)*loader->captris, NULL, GL_STATIC_DRAW);
+		resourceTrack(RESOURCE_SOUP, soup, NULL, 0, 3L*(8*sizeof(GLfloat) + sizeof(GLuint))*loader->captris);
+		first = 0;
+	}
+	if(last > first) {
+		glBufferSubData(GL_ARRAY_BUFFER, 3L*8*sizeof(GLfloat)*first,
+			3L*8*sizeof(GLfloat)*(last - first), soup->vertexarray + 3*8*first);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 3L*sizeof(GLuint)*first,
+			3L*sizeof(GLuint)*(last - first), soup->indexarray + 3*first);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	soup->ntris = last;
+	soup->nverts = 3*last;
+
+	if(!loader->finished) return 1;
+	soupApplyResidency(soup);
+	return 0;
+}
+
+/* Stop loading an OBJ file before the end, and delete the soup */
+void soupLoadOBJCancel(soupLoader *loader, triangleSoup *soup) {
+	if(loader->finished) return;
+	loader->error = 1;
+	soupLoaderFinish(loader, soup, NULL);
+}
+
+/*
+ * soupHashVertex() - FNV-1a hash of the 8 floats of one vertex
+ */
+static unsigned int soupHashVertex(const GLfloat *v) {
+	const unsigned char *bytes = (const unsigned char*)v;
+	unsigned int hash = 2166136261u;
+	int i;
+
+	for(i=0; i<8*(int)sizeof(GLfloat); i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+/*
+ * soupDeduplicate(triangleSoup *soup)
+ *
+ * Merge vertices that are identical in all 8 attributes, and point the
+ * index array at the merged copies. soupReadOBJ() writes three vertices
+ * per triangle, so on a closed mesh this typically removes five out of
+ * six. Vertices are compared bit by bit, so this is exact and never
+ * merges vertices that merely look alike. Call it before the upload.
+ * Returns the new number of vertices.
+ */
+int soupDeduplicate(triangleSoup *soup) {
+	arena *scratch;
+	long mark;
+	int *table, *remap;
+	int tablesize, i, j, slot, unique;
+	unsigned int hash;
+	GLfloat *shrunk;
+
+	if(!soup->vertexarray || !soup->indexarray || soup->nverts == 0) return soup->nverts;
+
+	TRACE_ZONE("soupDeduplicate");
+	// The tables are temporaries, so they go in the thread's scratch arena
+	scratch = arenaScratch();
+	mark = arenaMark(scratch);
+	for(tablesize = 64; tablesize < 2*soup->nverts; tablesize *= 2);
+	table = (int*)arenaAlloc(scratch, tablesize*sizeof(int));
+	remap = (int*)arenaAlloc(scratch, soup->nverts*sizeof(int));
+	if(!table || !remap) {
+		printError("Memory error", "Cannot allocate tables for vertex deduplication");
+		arenaRelease(scratch, mark);
+		arenaTrim(scratch);
+		return soup->nverts;
+	}
+	for(i=0; i<tablesize; i++) table[i] = -1;
+
+	// Unique vertices are moved down to the front of the array as they
+	// are found. A vertex never moves up, so this can be done in place.
+	unique = 0;
+	for(i=0; i<soup->nverts; i++) {
+		hash = soupHashVertex(&soup->vertexarray[8*i]);
+		for(slot = hash & (tablesize-1); table[slot] >= 0; slot = (slot+1) & (tablesize-1)) {
+			if(!memcmp(&soup->vertexarray[8*table[slot]], &soup->vertexarray[8*i], 8*sizeof(GLfloat))) break;
+		}
+		if(table[slot] < 0) {
+			if(unique != i) {
+				memcpy(&soup->vertexarray[8*unique], &soup->vertexarray[8*i], 8*sizeof(GLfloat));
+			}
+			table[slot] = unique++;
+		}
+		remap[i] = table[slot];
+	}
+	for(j=0; j<3*soup->ntris; j++) {
+		soup->indexarray[j] = remap[soup->indexarray[j]];
+	}
+	arenaRelease(scratch, mark);
+	arenaTrim(scratch); // A load is a one-off, so the tables should not stay resident
+
+	// Give back the memory we no longer need
+	shrunk = (GLfloat*)realloc(soup->vertexarray, 8*unique*sizeof(GLfloat));
+	if(shrunk) soup->vertexarray = shrunk;
+	soup->nverts = unique;
+	return unique;
+}
+
+
+// A binary soup file starts with this header, followed by the
+// vertex array, the index array and the groups exactly as they are in memory.
+// The format is native endian, a cache file rather than an archive.
+#define SOUP_CACHEMAGIC "SOUP"
+#define SOUP_CACHEVERSION 2
+typedef struct {
+	char magic[4];
+	int version;
+	int nverts;
+	int ntris;
+	GLfloat bounds[6];
+	int ngroups;
+} soupCacheHeader;
+
+/*
+ * soupGroupsValid() - check that the groups follow each other through
+ * the index array without gaps, as soupRender() assumes
+ */
+static int soupGroupsValid(triangleSoup *soup) {
+	int next = 0, g;
+
+	for(g=0; g<soup->ngroups; g++) {
+		if(soup->groups[g].firsttri != next || soup->groups[g].ntris < 0
+			|| memchr(soup->groups[g].name, 0, SOUP_GROUPNAMESIZE) == NULL) return 0;
+		next += soup->groups[g].ntris;
+	}
+	return soup->ngroups == 0 || next == soup->ntris;
+}
+
+/*
+ * soupIndicesValid() - check that every index names a vertex, so that a
+ * stale or corrupt file cannot make the soup read out of bounds
+ */
+static int soupIndicesValid(const triangleSoup *soup) {
+	long i;
+
+	for(i=0; i<3L*soup->ntris; i++) {
+		if(soup->indexarray[i] >= (GLuint)soup->nverts) return 0;
+	}
+	return 1;
+}
+
+/*
+ * soupWriteCache(const triangleSoup *soup, const char *filename)
+ *
+ * Save the vertex and index arrays to a binary file that
+ * soupReadCache() can load much faster than an OBJ file can
+ * be parsed. Returns 1 on success, 0 on failure.
+ */
+int soupWriteCache(const triangleSoup *soup, const char *filename) {
+	FILE *file;
+	soupCacheHeader header;
+	int ok;
+
+	if(!soup->vertexarray || !soup->indexarray) {
+		printError("Cannot write soup cache, arrays are not resident", filename);
+		return 0;
+	}
+	file = fopen(filename, "wb");
+	if(file == NULL) {
+		printError("Cannot write soup cache", filename);
+		return 0;
+	}
+	memcpy(header.magic, SOUP_CACHEMAGIC, 4);
+	header.version = SOUP_CACHEVERSION;
+	header.nverts = soup->nverts;
+	header.ntris = soup->ntris;
+	memcpy(header.bounds, soup->bounds, sizeof(header.bounds));
+	header.ngroups = soup->ngroups;
+	ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& fwrite(soup->vertexarray, 8*sizeof(GLfloat), soup->nverts, file) == (size_t)soup->nverts
+		&& fwrite(soup->indexarray, 3*sizeof(GLuint), soup->ntris, file) == (size_t)soup->ntris
+		&& (soup->ngroups == 0
+			|| fwrite(soup->groups, sizeof(soupGroup), soup->ngroups, file) == (size_t)soup->ngroups);
+	fclose(file);
+	if(!ok) printError("Error writing soup cache", filename);
+	return ok;
+}
+
+/*
+ * soupReadCache(triangleSoup *soup, const char *filename)
+ *
+ * Load arrays saved by soupWriteCache(), without touching OpenGL.
+ * Returns 1 on success, 0 if the file is missing, truncated or was
+ * written by a different version. A missing file is not reported,
+ * since that is the normal case for a cache that is not yet filled.
+ */
+int soupReadCache(triangleSoup *soup, const char *filename) {
+	FILE *file;
+	soupCacheHeader header;
+	long expected;
+
+	TRACE_ZONE("soupReadCache");
+	file = fopen(filename, "rb");
+	if(file == NULL) return 0;
+
+	startupBegin("read", filename, STARTUP_IO);
+	if(fread(&header, sizeof(header), 1, file) != 1
+		|| memcmp(header.magic, SOUP_CACHEMAGIC, 4) || header.version != SOUP_CACHEVERSION
+		|| header.nverts < 0 || header.ntris < 0 || header.ngroups < 0) {
+		fclose(file);
+		startupEnd(0);
+		printError("Not a valid soup cache file", filename);
+		return 0;
+	}
+	expected = sizeof(header) + 8L*sizeof(GLfloat)*header.nverts + 3L*sizeof(GLuint)*header.ntris
+		+ (long)sizeof(soupGroup)*header.ngroups;
+	if(filelength(file) != expected) {
+		fclose(file);
+		startupEnd(0);
+		printError("Soup cache file has the wrong size", filename);
+		return 0;
+	}
+	soup->vertexarray = (GLfloat*)soupMalloc(8*header.nverts*sizeof(GLfloat));
+	soup->indexarray = (GLuint*)soupMalloc(3*header.ntris*sizeof(GLuint));
+	soup->groups = header.ngroups > 0 ? (soupGroup*)soupMalloc(header.ngroups*sizeof(soupGroup)) : NULL;
+	soup->nverts = header.nverts;
+	soup->ntris = header.ntris;
+	soup->ngroups = header.ngroups;
+	memcpy(soup->bounds, header.bounds, sizeof(soup->bounds));
+	if(!soup->vertexarray || !soup->indexarray || (soup->ngroups > 0 && !soup->groups)
+		|| fread(soup->vertexarray, 8*sizeof(GLfloat), soup->nverts, file) != (size_t)soup->nverts
+		|| fread(soup->indexarray, 3*sizeof(GLuint), soup->ntris, file) != (size_t)soup->ntris
+		|| (soup->ngroups > 0
+			&& fread(soup->groups, sizeof(soupGroup), soup->ngroups, file) != (size_t)soup->ngroups)
+		|| !soupIndicesValid(soup) || !soupGroupsValid(soup)) {
+		fclose(file);
+		startupEnd(0);
+		printError("Error reading soup cache", filename);
+		soupDelete(soup);
+		return 0;
+	}
+	fclose(file);
+	startupEnd(expected);
+	return 1;
+}
 
 /* Print data from a triangleSoup object, for debugging purposes */
 void soupPrint(triangleSoup soup) {
      int i;
 
      printf("triangleSoup vertex data:\n\n");
-     for(i=0; i<soup.nverts; i++) {
-         printf("%d: %8.2f %8.2f %8.2f\n", i,
-         soup.vertexarray[8*i], soup.vertexarray[8*i+1], soup.vertexarray[8*i+2]);
+     if(soup.vertexarray) {
+         for(i=0; i<soup.nverts; i++) {
+             printf("%d: %8.2f %8.2f %8.2f\n", i,
+             soup.vertexarray[8*i], soup.vertexarray[8*i+1], soup.vertexarray[8*i+2]);
+         }
+     }
+     else if(soup.positionarray) {
+         for(i=0; i<soup.nverts; i++) {
+             printf("%d: %8.2f %8.2f %8.2f\n", i,
+             soup.positionarray[3*i], soup.positionarray[3*i+1], soup.positionarray[3*i+2]);
+         }
      }
+     else printf("(released from main memory after upload)\n");
      printf("\ntriangleSoup face index data:\n\n");
-     for(i=0; i<soup.ntris; i++) {
+     if(!soup.indexarray) printf("(released from main memory after upload)\n");
+     else for(i=0; i<soup.ntris; i++) {
          printf("%d: %d %d %d\n", i,
          soup.indexarray[3*i], soup.indexarray[3*i+1], soup.indexarray[3*i+2]);
      }
@@ -437,40 +1218,66 @@ void soupPrint(triangleSoup soup) {
 /* Print information about a triangleSoup object (stats and extents) */
 void soupPrintInfo(triangleSoup soup) {
      int i;
-     float x, y, z, xmin, xmax, ymin, ymax, zmin, zmax;
 
+     // The extents are computed at upload time and kept even when the
+     // vertex array has been released, see soupSetResidency()
      printf("triangleSoup information:\n");
      printf("vertices : %d\n", soup.nverts);
      printf("triangles: %d\n", soup.ntris);
-     xmin = xmax = soup.vertexarray[0];
-     ymin = ymax = soup.vertexarray[1];
-     zmin = zmax = soup.vertexarray[2];
-     for(i=1; i<soup.nverts; i++) {
-         x = soup.vertexarray[8*i];
-         y = soup.vertexarray[8*i+1];
-         z = soup.vertexarray[8*i+2];
-//         printf("x y z : %8.2f %8.2f %8.2f\n", x, y, z);
-         if(x<xmin) xmin = x;
-         if(x>xmax) xmax = x;
-         if(y<ymin) ymin = y;
-         if(y>ymax) ymax = y;
-         if(z<zmin) zmin = z;
-         if(z>zmax) zmax = z;
+     printf("xmin: %8.2f\n", soup.bounds[0]);
+     printf("xmax: %8.2f\n", soup.bounds[1]);
+     printf("ymin: %8.2f\n", soup.bounds[2]);
+     printf("ymax: %8.2f\n", soup.bounds[3]);
+     printf("zmin: %8.2f\n", soup.bounds[4]);
+     printf("zmax: %8.2f\n", soup.bounds[5]);
+     for(i=0; i<soup.ngroups; i++) {
+         printf("group %d: \"%s\", %d triangles\n", i, soup.groups[i].name, soup.groups[i].ntris);
      }
-     printf("xmin: %8.2f\n", xmin);
-     printf("xmax: %8.2f\n", xmax);
-     printf("ymin: %8.2f\n", ymin);
-     printf("ymax: %8.2f\n", ymax);
-     printf("zmin: %8.2f\n", zmin);
-     printf("zmax: %8.2f\n", zmax);
 };
 
-/* Render the geometry in a triangleSoup object */
+/* The group with a given name, or -1 */
+int soupFindGroup(const triangleSoup *soup, const char *name) {
+	int g;
+
+	for(g=0; g<soup->ngroups; g++) {
+		if(!strcmp(soup->groups[g].name, name)) return g;
+	}
+	return -1;
+}
+
+/*
+ * soupRender(triangleSoup soup)
+ *
+ * Render the geometry in a triangleSoup object. Groups that are not
+ * visible are skipped. The groups follow each other in the index array,
+ * so a run of visible groups is drawn with one call.
+ */
 void soupRender(triangleSoup soup) {
-	
-	glBindVertexArray(soup.vao);	
-	glDrawElements(GL_TRIANGLES, 3 * soup.ntris, GL_UNSIGNED_INT, (void*)0);
-	// (mode, vertex count, type, element array buffer offset)
-	glBindVertexArray(0);	
+	long indexbytes = soupIndexBytes(&soup);
+	int first, count, g;
 
+	glBindVertexArray(soup.vao);
+	if(soup.ngroups == 0) {
+		glDrawElements(GL_TRIANGLES, 3 * soup.ntris, soup.indextype, (void*)0);
+		// (mode, vertex count, type, element array buffer offset)
+	}
+	else for(g=0; g<soup.ngroups; ) {
+		if(!soup.groups[g].visible) {
+			g++;
+			continue;
+		}
+		first = soup.groups[g].firsttri;
+		for(count=0; g<soup.ngroups && soup.groups[g].visible; g++) count += soup.groups[g].ntris;
+		if(count > 0) glDrawElements(GL_TRIANGLES, 3*count, soup.indextype, (void*)(3*first*indexbytes));
+	}
+	glBindVertexArray(0);
 };
+
+/* Render one group of a triangleSoup object, visible or not */
+void soupRenderGroup(triangleSoup soup, int group) {
+	if(group < 0 || group >= soup.ngroups) return;
+	glBindVertexArray(soup.vao);
+	glDrawElements(GL_TRIANGLES, 3*soup.groups[group].ntris, soup.indextype,
+		(void*)(3*soup.groups[group].firsttri*soupIndexBytes(&soup)));
+	glBindVertexArray(0);
+}
@@ -0,0 +1,355 @@
+/*
+ * benchCompare - compare benchmark results against a baseline, and fail
+ * if anything got slower by more than the noise allows.
+ *
+ *   benchCompare [options] --base A1.json A2.json ... --new B1.json B2.json ...
+ *
+ * Every file is one run of a benchmark (sceneBench, objBench, or any
+ * tool that writes JSON). All numeric values are flattened to dotted
+ * paths like "frames.wall_ms.p99", and array elements with a "name"
+ * member are keyed by that name rather than by position, so startup
+ * phases line up between runs even if some are missing. The metrics
+ * that are compared, and which way is better, follow from the names:
+ *   higher is better  anything with "per_s" or "throughput" in it
+ *   lower is better   times (a name that is "ms" or ends in "_ms", or
+ *                     anything below such a name, like wall_ms.p99),
+ *                     hitches, allocations and peak RSS
+ * Everything else (configuration, sizes, counts) is left alone, and so
+ * are the few times that are not performance, listed in ignoredNames.
+ *
+ * For each metric, the median over the baseline runs is compared to the
+ * median over the new runs. The noise is estimated from the median
+ * absolute deviation (MAD) of both sets, scaled by 1.4826 so it matches
+ * a standard deviation for normally distributed values. A change counts
+ * as a regression only if it is worse than all of:
+ *   - the relative threshold (--threshold, or a --metric override)
+ *   - the noise factor (--noise) times the larger of the two MADs
+ *   - an absolute floor for times (--floor, in ms), since sub-0.05 ms
+ *     timings are mostly timer and scheduling jitter
+ * With a single run on each side there is no noise estimate, so only
+ * the threshold and the floor apply; three or more runs are advised.
+ *
+ * The exit status is 0 if nothing regressed, 1 if something did, and
+ * 2 if the input could not be read.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "json.h"
+
+#define MAXRUNS 64
+#define MAXOVERRIDES 32
+#define MAXPATH 256
+
+#define LOWERBETTER 1
+#define HIGHERBETTER 2
+
+/* All values seen for one metric */
+typedef struct {
+	char *path;
+	int direction;       // LOWERBETTER or HIGHERBETTER
+	int istime;          // Nonzero if the value is in milliseconds
+	double base[MAXRUNS];
+	double test[MAXRUNS];
+	int nbase, ntest;
+} metric;
+
+/* A set of metrics, kept in the order they were first seen */
+typedef struct {
+	metric *metrics;
+	int count, size;
+} metricSet;
+
+/* A per-metric relative threshold, for metrics matching a pattern */
+typedef struct {
+	const char *pattern;
+	double threshold;
+} thresholdOverride;
+
+static thresholdOverride overrides[MAXOVERRIDES];
+static int noverrides = 0;
+
+/* Names that look like metrics but are not: when things happened, and how frame pacing waited */
+static const char *ignoredNames[] = {
+	"start_ms", "slept_ms", "spun_ms", "predicted_cost_ms", NULL
+};
+
+
+/*
+ * metricDirection() - which way is better for a flattened path, or 0
+ * if the path is not a performance metric. The last name decides,
+ * but a time unit on any name further up counts too, so that all of
+ * "wall_ms.p99" and "gpu_passes.soupRender.mean" are times.
+ */
+static int metricDirection(const char *path, int *istime) {
+	char copy[MAXPATH];
+	char *name, *last;
+	size_t n;
+	int i;
+
+	*istime = 0;
+	strncpy(copy, path, sizeof(copy)-1);
+	copy[sizeof(copy)-1] = '\0';
+	for(name = strtok(copy, "."); name; name = strtok(NULL, ".")) {
+		for(i=0; ignoredNames[i]; i++) {
+			if(!strcmp(name, ignoredNames[i])) return 0;
+		}
+	}
+
+	if(strstr(path, "per_s") || strstr(path, "throughput")) return HIGHERBETTER;
+	last = strrchr(path, '.');
+	last = last ? last+1 : (char*)path;
+	if(strstr(last, "hitches") || strstr(last, "allocations") || strstr(last, "rss_kb")) return LOWERBETTER;
+	if(!strcmp(last, "frames") || strstr(last, "_frames")) return 0;
+
+	strncpy(copy, path, sizeof(copy)-1);
+	copy[sizeof(copy)-1] = '\0';
+	for(name = strtok(copy, "."); name; name = strtok(NULL, ".")) {
+		n = strlen(name);
+		if(!strcmp(name, "ms") || (n >= 3 && !strcmp(name + n - 3, "_ms"))) {
+			*istime = 1;
+			return LOWERBETTER;
+		}
+	}
+	// GPU pass statistics are times, one object per pass
+	if(!strncmp(path, "gpu_passes.", 11)) {
+		*istime = 1;
+		return LOWERBETTER;
+	}
+	return 0;
+}
+
+/*
+ * metricFind() - the metric for a path, created if it is new
+ */
+static metric *metricFind(metricSet *set, const char *path, int direction, int istime) {
+	int i;
+
+	for(i=0; i<set->count; i++) {
+		if(!strcmp(set->metrics[i].path, path)) return &set->metrics[i];
+	}
+	if(set->count == set->size) {
+		set->size = set->size ? 2*set->size : 256;
+		set->metrics = (metric*)realloc(set->metrics, set->size * sizeof(metric));
+		if(set->metrics == NULL) {
+			fprintf(stderr, "Out of memory.\n");
+			exit(2);
+		}
+	}
+	set->metrics[set->count].path = (char*)malloc(strlen(path)+1);
+	strcpy(set->metrics[set->count].path, path);
+	set->metrics[set->count].direction = direction;
+	set->metrics[set->count].istime = istime;
+	set->metrics[set->count].nbase = 0;
+	set->metrics[set->count].ntest = 0;
+	return &set->metrics[set->count++];
+}
+
+/*
+ * flatten() - add every numeric metric below a value to the set
+ */
+static void flatten(metricSet *set, const jsonValue *value, const char *path, int isbase) {
+	char childpath[MAXPATH], name[128];
+	const jsonValue *child, *other;
+	const char *label;
+	int index, duplicates, direction, istime;
+	metric *m;
+
+	if(value->type == JSON_NUMBER) {
+		direction = metricDirection(path, &istime);
+		if(!direction) return;
+		m = metricFind(set, path, direction, istime);
+		if(isbase && m->nbase < MAXRUNS) m->base[m->nbase++] = value->number;
+		if(!isbase && m->ntest < MAXRUNS) m->test[m->ntest++] = value->number;
+		return;
+	}
+	if(value->type != JSON_OBJECT && value->type != JSON_ARRAY) return;
+
+	for(child = value->child, index = 0; child; child = child->next, index++) {
+		if(value->type == JSON_OBJECT) label = child->key;
+		else {
+			// Key array elements by name (and detail) if they have one,
+			// numbering repeats like the "upload" phase of several loaders
+			label = jsonString(jsonGet(child, "name"), NULL);
+			if(label) {
+				if(jsonString(jsonGet(child, "detail"), "")[0]) {
+					snprintf(name, sizeof(name), "%s(%s)", label, jsonString(jsonGet(child, "detail"), ""));
+				}
+				else snprintf(name, sizeof(name), "%s", label);
+				duplicates = 0;
+				for(other = value->child; other != child; other = other->next) {
+					if(!strcmp(jsonString(jsonGet(other, "name"), ""), label)
+						&& !strcmp(jsonString(jsonGet(other, "detail"), ""), jsonString(jsonGet(child, "detail"), ""))) {
+						duplicates++;
+					}
+				}
+				if(duplicates) snprintf(name + strlen(name), sizeof(name) - strlen(name), "#%d", duplicates+1);
+			}
+			else snprintf(name, sizeof(name), "%d", index);
+			label = name;
+		}
+		if(path[0]) snprintf(childpath, sizeof(childpath), "%s.%s", path, label);
+		else snprintf(childpath, sizeof(childpath), "%s", label);
+		flatten(set, child, childpath, isbase);
+	}
+}
+
+static int compareDoubles(const void *a, const void *b) {
+	double da = *(const double*)a, db = *(const double*)b;
+	return (da > db) - (da < db);
+}
+
+/*
+ * median() - median of n values (the array is sorted in place)
+ */
+static double median(double *values, int n) {
+	qsort(values, n, sizeof(double), compareDoubles);
+	return (n % 2) ? values[n/2] : 0.5 * (values[n/2-1] + values[n/2]);
+}
+
+/*
+ * mad() - median absolute deviation from the median, scaled to match
+ * a standard deviation for normally distributed values
+ */
+static double mad(const double *values, int n, double center) {
+	double deviations[MAXRUNS];
+	int i;
+
+	for(i=0; i<n; i++) deviations[i] = fabs(values[i] - center);
+	return 1.4826 * median(deviations, n);
+}
+
+/*
+ * patternMatch() - simple wildcard match, '*' matches any run of characters
+ */
+static int patternMatch(const char *pattern, const char *text) {
+	if(*pattern == '\0') return *text == '\0';
+	if(*pattern == '*') {
+		for(; ; text++) {
+			if(patternMatch(pattern+1, text)) return 1;
+			if(*text == '\0') return 0;
+		}
+	}
+	return *text == *pattern && patternMatch(pattern+1, text+1);
+}
+
+static double thresholdFor(const char *path, double fallback) {
+	int i;
+
+	for(i=noverrides-1; i>=0; i--) { // Later overrides win
+		if(patternMatch(overrides[i].pattern, path)) return overrides[i].threshold;
+	}
+	return fallback;
+}
+
+static int readRuns(metricSet *set, char **files, int nfiles, int isbase) {
+	jsonValue *root;
+	int i;
+
+	for(i=0; i<nfiles; i++) {
+		root = jsonReadFile(files[i]);
+		if(root == NULL) return 0;
+		flatten(set, root, "", isbase);
+		jsonFree(root);
+	}
+	return 1;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"Usage: benchCompare [options] --base FILE... --new FILE...\n"
+		"  --threshold PCT        allowed slowdown in percent (default 5)\n"
+		"  --metric PATTERN=PCT   threshold for metrics matching PATTERN ('*' wildcard)\n"
+		"  --noise K              allowed slowdown in units of the MAD (default 3)\n"
+		"  --floor MS             ignore time changes smaller than this (default 0.05)\n"
+		"  --all                  list every metric, not only the changed ones\n"
+		"Exit status: 0 no regression, 1 regression, 2 bad input.\n");
+}
+
+/*
+ * main(argc, argv) - read both sets of runs, compare, report
+ */
+int main(int argc, char *argv[]) {
+	char *basefiles[MAXRUNS], *testfiles[MAXRUNS], *eq;
+	int nbase = 0, ntest = 0, mode = 0, listall = 0, i;
+	int regressions = 0, improvements = 0, compared = 0, unmatched = 0;
+	double threshold = 5.0, noise = 3.0, floorms = 0.05;
+	double mbase, mtest, noiseband, allowed, change, worse;
+	metricSet set = { NULL, 0, 0 };
+	metric *m;
+	const char *status;
+
+	for(i=1; i<argc; i++) {
+		if(!strcmp(argv[i], "--base")) mode = 1;
+		else if(!strcmp(argv[i], "--new")) mode = 2;
+		else if(!strcmp(argv[i], "--all")) listall = 1;
+		else if(!strcmp(argv[i], "--threshold") && i+1 < argc) threshold = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--noise") && i+1 < argc) noise = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--floor") && i+1 < argc) floorms = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--metric") && i+1 < argc && noverrides < MAXOVERRIDES
+			&& (eq = strrchr(argv[i+1], '=')) != NULL) {
+			*eq = '\0';
+			overrides[noverrides].pattern = argv[++i];
+			overrides[noverrides++].threshold = atof(eq+1);
+		}
+		else if(argv[i][0] == '-') {
+			usage();
+			return 2;
+		}
+		else if(mode == 1 && nbase < MAXRUNS) basefiles[nbase++] = argv[i];
+		else if(mode == 2 && ntest < MAXRUNS) testfiles[ntest++] = argv[i];
+		else {
+			usage();
+			return 2;
+		}
+	}
+	if(nbase == 0 || ntest == 0) {
+		usage();
+		return 2;
+	}
+	if(!readRuns(&set, basefiles, nbase, 1) || !readRuns(&set, testfiles, ntest, 0)) return 2;
+
+	printf("Comparing %d baseline run%s with %d new run%s (threshold %.1f%%, noise %.1f x MAD, floor %.3f ms)\n\n",
+		nbase, nbase > 1 ? "s" : "", ntest, ntest > 1 ? "s" : "", threshold, noise, floorms);
+	printf("%-56s %12s %12s %8s %8s  %s\n", "metric", "baseline", "new", "change", "allowed", "");
+	for(i=0; i<set.count; i++) {
+		m = &set.metrics[i];
+		if(m->nbase == 0 || m->ntest == 0) {
+			unmatched++;
+			continue;
+		}
+		compared++;
+		mbase = median(m->base, m->nbase);
+		mtest = median(m->test, m->ntest);
+		noiseband = noise * fmax(mad(m->base, m->nbase, mbase), mad(m->test, m->ntest, mtest));
+		allowed = fmax(fabs(mbase) * thresholdFor(m->path, threshold) / 100.0, noiseband);
+		if(m->istime) allowed = fmax(allowed, floorms);
+		worse = (m->direction == LOWERBETTER) ? mtest - mbase : mbase - mtest;
+		change = (mbase != 0.0) ? 100.0 * (mtest - mbase) / fabs(mbase) : 0.0;
+
+		if(worse > allowed) {
+			status = "REGRESSED";
+			regressions++;
+		}
+		else if(-worse > allowed) {
+			status = "improved";
+			improvements++;
+		}
+		else {
+			status = "";
+			if(!listall) continue;
+		}
+		printf("%-56s %12.4g %12.4g %+7.1f%% %7.1f%%  %s\n", m->path, mbase, mtest, change,
+			(mbase != 0.0) ? 100.0 * allowed / fabs(mbase) : 0.0, status);
+	}
+	printf("\n%d metrics compared, %d regressed, %d improved", compared, regressions, improvements);
+	if(unmatched) printf(", %d only in one set", unmatched);
+	printf("\n");
+
+	for(i=0; i<set.count; i++) free(set.metrics[i].path);
+	free(set.metrics);
+	return regressions ? 1 : 0;
+}
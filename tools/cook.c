@@ -0,0 +1,692 @@
+/*
+ * cook - convert meshes, textures and shaders into one asset bundle.
+ *
+ * Everything that the program would otherwise do to its assets at
+ * startup is done here once, and the results are written to a bundle
+ * (see bundle.h) that the program maps and uses as it is:
+ *   meshes    OBJ files are parsed and deduplicated, quantized to the
+ *             packed soup vertex format (half float positions and
+ *             texture coordinates, 10 bit normals), deduplicated again
+ *             since quantizing makes more vertices equal, reordered for
+ *             the post-transform vertex cache (Tom Forsyth's linear-speed
+ *             algorithm) and then for fetch locality, and given 16 bit
+ *             indices where they fit.
+ *   textures  TGA files get their full mipmap chain made with a box
+ *             filter, and with --bc1 every level is compressed to BC1
+ *             (DXT1) blocks, which cuts an RGB texture to a sixth. BC1
+ *             has no real alpha, so RGBA textures are left uncompressed.
+ *             Loading BC1 needs GL_EXT_texture_compression_s3tc.
+ *   shaders   GLSL sources are stored as 0-terminated strings.
+ * With --lz4, every blob is LZ4 compressed where that saves at least
+ * an eighth. Resources are named by their file name without the
+ * directory. With no files, the bundled assets in ../meshes,
+ * ../textures and ../shaders are cooked. Run with --help for options.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __linux__
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GLFW/glfw3.h>
+
+#ifdef __WIN32__
+#include <GL/glext.h>
+#endif
+
+#include "tnm084.h"
+#include "triangleSoup.h"
+#include "tgaloader.h"
+#include "bundle.h"
+#include "timer.h"
+#include "arena.h"
+
+#define CACHESIZE 32 // Vertex cache entries assumed by the optimizer and the ACMR figures
+
+static const char *defaultAssets[] = {
+	"../meshes/cube.obj", "../meshes/pyramid.obj", "../meshes/teapot_coarse.obj",
+	"../meshes/teapot.obj", "../meshes/trex.obj", "../meshes/zergling.obj",
+	"../textures/earth2048.tga", "../textures/pyramid.tga", "../textures/trex.tga",
+	"../shaders/vertexshader.glsl", "../shaders/fragmentshader.glsl"
+};
+
+/* A mesh in the packed soup vertex format, on its way into the bundle */
+typedef struct {
+	unsigned char *vertices;  // SOUP_PACKEDVERTEXBYTES per vertex
+	unsigned int *indices;
+	int nverts;
+	int ntris;
+	float bounds[6];
+} packedMesh;
+
+
+/*
+ * halfFromFloat() - convert to an IEEE half float, rounding to nearest
+ * even, with overflow to infinity and underflow to subnormals or zero
+ */
+static unsigned short halfFromFloat(float value) {
+	unsigned int f, sign, mantissa;
+	int exponent;
+	unsigned short h;
+
+	memcpy(&f, &value, 4);
+	sign = (f >> 16) & 0x8000;
+	exponent = (int)((f >> 23) & 0xff) - 127 + 15;
+	mantissa = f & 0x7fffff;
+
+	if(((f >> 23) & 0xff) == 0xff) return (unsigned short)(sign | 0x7c00 | (mantissa ? 0x200 : 0)); // Inf, NaN
+	if(exponent >= 31) return (unsigned short)(sign | 0x7c00);
+	if(exponent <= 0) {
+		if(exponent < -10) return (unsigned short)sign;
+		mantissa |= 0x800000; // Make the implicit 1 explicit, and shift it down into a subnormal
+		h = (unsigned short)(mantissa >> (14 - exponent));
+		if((mantissa >> (13 - exponent)) & 1 && ((mantissa & ((1u << (13 - exponent)) - 1)) || (h & 1))) h++;
+		return (unsigned short)(sign | h);
+	}
+	h = (unsigned short)(sign | (exponent << 10) | (mantissa >> 13));
+	if((mantissa & 0x1000) && ((mantissa & 0xfff) || (h & 1))) h++; // Carries into the exponent if needed
+	return h;
+}
+
+/* Convert an IEEE half float back, to see what the GPU will see */
+static float floatFromHalf(unsigned short h) {
+	int exponent = (h >> 10) & 31, mantissa = h & 1023;
+	float value;
+
+	if(exponent == 0) value = ldexpf((float)mantissa, -24);
+	else if(exponent == 31) value = mantissa ? NAN : INFINITY;
+	else value = ldexpf((float)(mantissa | 1024), exponent - 25);
+	return (h & 0x8000) ? -value : value;
+}
+
+/* Pack a unit normal as GL_INT_2_10_10_10_REV, signed normalized */
+static unsigned int packNormal(const GLfloat *n) {
+	unsigned int packed = 0;
+	int i, q;
+	float c;
+
+	for(i = 0; i < 3; i++) {
+		c = n[i] < -1.0f ? -1.0f : (n[i] > 1.0f ? 1.0f : n[i]);
+		q = (int)lrintf(c * 511.0f);
+		packed |= ((unsigned int)q & 0x3ff) << (10 * i);
+	}
+	return packed;
+}
+
+/*
+ * acmr() - average cache miss ratio: vertices transformed per triangle
+ * with an LRU cache of CACHESIZE entries. 3 is the worst, 0.5 about the best.
+ */
+static double acmr(const unsigned int *indices, int ntris) {
+	unsigned int cache[CACHESIZE];
+	int ncache = 0, misses = 0, i, j, k;
+
+	for(i = 0; i < 3*ntris; i++) {
+		for(j = 0; j < ncache && cache[j] != indices[i]; j++);
+		if(j == ncache) {
+			misses++;
+			if(ncache < CACHESIZE) ncache++;
+			j = ncache - 1;
+		}
+		for(k = j; k > 0; k--) cache[k] = cache[k-1];
+		cache[0] = indices[i];
+	}
+	return ntris > 0 ? (double)misses / ntris : 0.0;
+}
+
+/* Merge packed vertices that are bit for bit the same. Returns the new count. */
+static int dedupPacked(packedMesh *mesh) {
+	arena *scratch = arenaScratch();
+	long mark = arenaMark(scratch);
+	int tablesize, i, slot, unique = 0;
+	int *table, *remap;
+	unsigned int hash;
+	const unsigned char *v;
+
+	for(tablesize = 64; tablesize < 2*mesh->nverts; tablesize *= 2);
+	table = (int*)arenaAlloc(scratch, tablesize*sizeof(int));
+	remap = (int*)arenaAlloc(scratch, mesh->nverts*sizeof(int));
+	if(!table || !remap) {
+		printError("Memory error", "dedupPacked");
+		arenaRelease(scratch, mark);
+		return mesh->nverts;
+	}
+	for(i = 0; i < tablesize; i++) table[i] = -1;
+	for(i = 0; i < mesh->nverts; i++) {
+		v = mesh->vertices + SOUP_PACKEDVERTEXBYTES*i;
+		hash = 2166136261u; // FNV-1a over the 16 bytes
+		for(slot = 0; slot < SOUP_PACKEDVERTEXBYTES; slot++) hash = (hash ^ v[slot]) * 16777619u;
+		for(slot = hash & (tablesize-1); table[slot] >= 0; slot = (slot+1) & (tablesize-1)) {
+			if(!memcmp(mesh->vertices + SOUP_PACKEDVERTEXBYTES*table[slot], v, SOUP_PACKEDVERTEXBYTES)) break;
+		}
+		if(table[slot] < 0) {
+			if(unique != i) memmove(mesh->vertices + SOUP_PACKEDVERTEXBYTES*unique, v, SOUP_PACKEDVERTEXBYTES);
+			table[slot] = unique++;
+		}
+		remap[i] = table[slot];
+	}
+	for(i = 0; i < 3*mesh->ntris; i++) mesh->indices[i] = remap[mesh->indices[i]];
+	arenaRelease(scratch, mark);
+	mesh->nverts = unique;
+	return unique;
+}
+
+/* Forsyth's vertex score: recently used vertices and ones with few triangles left score high */
+static float vertexScore(int cachepos, int remaining) {
+	float score;
+
+	if(remaining == 0) return -1.0f;
+	if(cachepos < 0) score = 0.0f;
+	else if(cachepos < 3) score = 0.75f; // The last triangle's vertices, equally good
+	else score = powf(1.0f - (cachepos - 3) / (float)(CACHESIZE - 3), 1.5f);
+	return score + 2.0f / sqrtf((float)remaining);
+}
+
+/*
+ * optimizeTriangles() - reorder the triangles for the post-transform
+ * vertex cache. Greedily emits the best scoring triangle among those
+ * that use a vertex in a simulated LRU cache, or the next unused one
+ * if there are none. Returns 1 on success.
+ */
+static int optimizeTriangles(packedMesh *mesh) {
+	arena *scratch = arenaScratch();
+	long mark = arenaMark(scratch);
+	int nverts = mesh->nverts, ntris = mesh->ntris;
+	int *offsets, *remaining, *trilist, *cachepos;
+	float *vscore, *tscore;
+	char *emitted;
+	unsigned int *out;
+	int cache[CACHESIZE + 3], newcache[CACHESIZE + 3];
+	int ncache = 0, nnew, cursor = 0, best = -1, n, i, j, k, t, v;
+	float bestscore;
+
+	offsets = (int*)arenaAlloc(scratch, (nverts + 1) * sizeof(int));
+	remaining = (int*)arenaAlloc(scratch, nverts * sizeof(int));
+	trilist = (int*)arenaAlloc(scratch, 3L*ntris * sizeof(int));
+	cachepos = (int*)arenaAlloc(scratch, nverts * sizeof(int));
+	vscore = (float*)arenaAlloc(scratch, nverts * sizeof(float));
+	tscore = (float*)arenaAlloc(scratch, ntris * sizeof(float));
+	emitted = (char*)arenaAlloc(scratch, ntris);
+	out = (unsigned int*)arenaAlloc(scratch, 3L*ntris * sizeof(unsigned int));
+	if(!offsets || !remaining || !trilist || !cachepos || !vscore || !tscore || !emitted || !out) {
+		printError("Memory error", "optimizeTriangles");
+		arenaRelease(scratch, mark);
+		return 0;
+	}
+	memset(offsets, 0, (nverts + 1) * sizeof(int));
+	memset(remaining, 0, nverts * sizeof(int));
+	memset(emitted, 0, ntris);
+
+	// The triangles of every vertex, as lists in one array
+	for(i = 0; i < 3*ntris; i++) offsets[mesh->indices[i] + 1]++;
+	for(v = 0; v < nverts; v++) offsets[v+1] += offsets[v];
+	for(i = 0; i < 3*ntris; i++) {
+		v = mesh->indices[i];
+		trilist[offsets[v] + remaining[v]++] = i / 3;
+	}
+	for(v = 0; v < nverts; v++) {
+		cachepos[v] = -1;
+		vscore[v] = vertexScore(-1, remaining[v]);
+	}
+	for(t = 0; t < ntris; t++) {
+		tscore[t] = vscore[mesh->indices[3*t]] + vscore[mesh->indices[3*t+1]] + vscore[mesh->indices[3*t+2]];
+	}
+
+	for(n = 0; n < ntris; n++) {
+		if(best < 0) {
+			while(emitted[cursor]) cursor++;
+			best = cursor;
+		}
+		memcpy(&out[3*n], &mesh->indices[3*best], 3*sizeof(unsigned int));
+		emitted[best] = 1;
+
+		// Take the triangle off its vertices' lists, and put them first in the cache
+		nnew = 0;
+		for(i = 0; i < 3; i++) {
+			v = mesh->indices[3*best+i];
+			for(j = offsets[v]; trilist[j] != best; j++);
+			trilist[j] = trilist[offsets[v] + --remaining[v]];
+			newcache[nnew++] = v;
+		}
+		for(i = 0; i < ncache; i++) {
+			v = cache[i];
+			if(v != newcache[0] && v != newcache[1] && v != newcache[2]) newcache[nnew++] = v;
+		}
+		for(i = 0; i < nnew; i++) {
+			v = newcache[i];
+			cachepos[v] = (i < CACHESIZE) ? i : -1;
+			vscore[v] = vertexScore(cachepos[v], remaining[v]);
+		}
+
+		// Rescore the triangles around the cached vertices, and pick the best
+		best = -1;
+		bestscore = -1.0f;
+		for(i = 0; i < nnew; i++) {
+			v = newcache[i];
+			for(j = offsets[v]; j < offsets[v] + remaining[v]; j++) {
+				t = trilist[j];
+				tscore[t] = vscore[mesh->indices[3*t]] + vscore[mesh->indices[3*t+1]]
+					+ vscore[mesh->indices[3*t+2]];
+				if(i < CACHESIZE && tscore[t] > bestscore) {
+					bestscore = tscore[t];
+					best = t;
+				}
+			}
+		}
+		ncache = (nnew < CACHESIZE) ? nnew : CACHESIZE;
+		for(k = 0; k < ncache; k++) cache[k] = newcache[k];
+	}
+
+	memcpy(mesh->indices, out, 3*ntris*sizeof(unsigned int));
+	arenaRelease(scratch, mark);
+	return 1;
+}
+
+/*
+ * reorderVertices() - renumber the vertices in the order the triangles
+ * first use them, for fetch locality. The new vertices stay in the
+ * scratch arena, like the old ones, until cookMesh() releases it.
+ */
+static int reorderVertices(packedMesh *mesh) {
+	arena *scratch = arenaScratch();
+	unsigned char *vertices = (unsigned char*)arenaAlloc(scratch, (long)mesh->nverts * SOUP_PACKEDVERTEXBYTES);
+	long mark = arenaMark(scratch); // Only remap goes at the end
+	int *remap = (int*)arenaAlloc(scratch, mesh->nverts * sizeof(int));
+	int i, next = 0;
+	unsigned int v;
+
+	if(!remap || !vertices) {
+		printError("Memory error", "reorderVertices");
+		arenaRelease(scratch, mark);
+		return 0;
+	}
+	for(i = 0; i < mesh->nverts; i++) remap[i] = -1;
+	for(i = 0; i < 3*mesh->ntris; i++) {
+		v = mesh->indices[i];
+		if(remap[v] < 0) {
+			remap[v] = next;
+			memcpy(vertices + SOUP_PACKEDVERTEXBYTES*next, mesh->vertices + SOUP_PACKEDVERTEXBYTES*v,
+				SOUP_PACKEDVERTEXBYTES);
+			next++;
+		}
+		mesh->indices[i] = remap[v];
+	}
+	arenaRelease(scratch, mark);
+	mesh->vertices = vertices;
+	mesh->nverts = next; // Vertices no triangle uses are dropped
+	return 1;
+}
+
+/*
+ * cookMesh() - parse, quantize and optimize an OBJ mesh, and add it
+ * to the bundle. Everything but the indices, which come from the soup,
+ * is in the scratch arena and is released at once. Returns 1 on success.
+ */
+static int cookMesh(bundleWriter *writer, const char *filename, const char *name) {
+	arena *scratch = arenaScratch();
+	long mark = arenaMark(scratch);
+	triangleSoup soup;
+	packedMesh mesh;
+	bundleMesh header;
+	unsigned char *blob;
+	unsigned short *shortindices;
+	long long size;
+	double before;
+	int i, j, parsed, ok;
+	unsigned short half;
+	unsigned int normal;
+
+	soupInit(&soup);
+	if(!soupParseOBJ(&soup, filename, NULL)) return 0;
+	parsed = soup.nverts;
+	soupDeduplicate(&soup);
+
+	mesh.nverts = soup.nverts;
+	mesh.ntris = soup.ntris;
+	mesh.vertices = (unsigned char*)arenaAlloc(scratch, (long)soup.nverts * SOUP_PACKEDVERTEXBYTES);
+	mesh.indices = soup.indexarray; // Taken over from the soup
+	soup.indexarray = NULL;
+	if(!mesh.vertices) {
+		printError("Memory error", "cookMesh");
+		soupDelete(&soup);
+		free(mesh.indices);
+		return 0;
+	}
+	// The bounds are of the rounded positions, so they still contain the mesh that is drawn
+	for(j = 0; j < 3; j++) {
+		mesh.bounds[2*j] = soup.nverts > 0 ? floatFromHalf(halfFromFloat(soup.vertexarray[j])) : 0.0f;
+		mesh.bounds[2*j+1] = mesh.bounds[2*j];
+	}
+	memset(mesh.vertices, 0, (size_t)soup.nverts * SOUP_PACKEDVERTEXBYTES);
+	for(i = 0; i < soup.nverts; i++) {
+		const GLfloat *v = &soup.vertexarray[8*i];
+		unsigned char *p = mesh.vertices + SOUP_PACKEDVERTEXBYTES*i;
+		for(j = 0; j < 3; j++) {
+			half = halfFromFloat(v[j]);
+			memcpy(p + 2*j, &half, 2); // Bytes 6-7 stay zero
+			if(floatFromHalf(half) < mesh.bounds[2*j]) mesh.bounds[2*j] = floatFromHalf(half);
+			if(floatFromHalf(half) > mesh.bounds[2*j+1]) mesh.bounds[2*j+1] = floatFromHalf(half);
+		}
+		normal = packNormal(&v[3]);
+		memcpy(p + 8, &normal, 4);
+		for(j = 0; j < 2; j++) {
+			half = halfFromFloat(v[6+j]);
+			memcpy(p + 12 + 2*j, &half, 2);
+		}
+	}
+	soupDelete(&soup);
+
+	dedupPacked(&mesh);
+	before = acmr(mesh.indices, mesh.ntris);
+	ok = optimizeTriangles(&mesh) && reorderVertices(&mesh);
+
+	memset(&header, 0, sizeof(header));
+	header.nverts = mesh.nverts;
+	header.ntris = mesh.ntris;
+	header.vertexbytes = SOUP_PACKEDVERTEXBYTES;
+	header.indexbytes = (mesh.nverts <= 65536) ? 2 : 4;
+	header.vertexoffset = BUNDLE_ALIGN;
+	header.indexoffset = header.vertexoffset + mesh.nverts * SOUP_PACKEDVERTEXBYTES;
+	for(j = 0; j < 6; j++) header.bounds[j] = mesh.bounds[j];
+	size = header.indexoffset + 3LL * mesh.ntris * header.indexbytes;
+
+	blob = ok ? (unsigned char*)arenaAlloc(scratch, (long)size) : NULL;
+	if(blob) {
+		memset(blob, 0, (size_t)size);
+		memcpy(blob, &header, sizeof(header));
+		memcpy(blob + header.vertexoffset, mesh.vertices, (size_t)mesh.nverts * SOUP_PACKEDVERTEXBYTES);
+		if(header.indexbytes == 2) {
+			shortindices = (unsigned short*)(blob + header.indexoffset);
+			for(i = 0; i < 3*mesh.ntris; i++) shortindices[i] = (unsigned short)mesh.indices[i];
+		}
+		else memcpy(blob + header.indexoffset, mesh.indices, 3 * (size_t)mesh.ntris * sizeof(unsigned int));
+		printf("%-24s %7d -> %7d vertices, %7d triangles, ACMR %.2f -> %.2f, %d bit indices, %.2f MB\n",
+			name, parsed, mesh.nverts, mesh.ntris, before, acmr(mesh.indices, mesh.ntris),
+			8 * header.indexbytes, size / 1048576.0);
+		ok = bundleWriterAdd(writer, name, BUNDLE_MESH, blob, size);
+	}
+	else ok = 0;
+	arenaRelease(scratch, mark);
+	free(mesh.indices);
+	return ok;
+}
+
+/* Halve an image with a 2x2 box filter. Odd sizes repeat the last row or column. */
+static void downsample(const unsigned char *src, int w, int h, unsigned char *dst, int bytes) {
+	int nw = w > 1 ? w/2 : 1, nh = h > 1 ? h/2 : 1;
+	int x, y, c, x0, x1, y0, y1;
+
+	for(y = 0; y < nh; y++) {
+		y0 = 2*y < h ? 2*y : h-1;
+		y1 = 2*y+1 < h ? 2*y+1 : h-1;
+		for(x = 0; x < nw; x++) {
+			x0 = 2*x < w ? 2*x : w-1;
+			x1 = 2*x+1 < w ? 2*x+1 : w-1;
+			for(c = 0; c < bytes; c++) {
+				dst[(y*nw + x)*bytes + c] = (unsigned char)((src[(y0*w + x0)*bytes + c] + src[(y0*w + x1)*bytes + c]
+					+ src[(y1*w + x0)*bytes + c] + src[(y1*w + x1)*bytes + c] + 2) / 4);
+			}
+		}
+	}
+}
+
+/* RGB888 to RGB565, rounded */
+static unsigned short pack565(const int *rgb) {
+	return (unsigned short)((((rgb[0] * 31 + 127) / 255) << 11) | (((rgb[1] * 63 + 127) / 255) << 5)
+		| ((rgb[2] * 31 + 127) / 255));
+}
+
+/* RGB565 back to RGB888, the way the GPU expands it */
+static void unpack565(unsigned short c, int *rgb) {
+	rgb[0] = ((c >> 11) & 31) * 255 / 31;
+	rgb[1] = ((c >> 5) & 63) * 255 / 63;
+	rgb[2] = (c & 31) * 255 / 31;
+}
+
+/*
+ * compressBC1() - compress an RGB image to BC1 blocks: the endpoints
+ * span the bounding box of each block's colors (moved in by 1/16 at
+ * both ends, which lowers the average error), and every pixel takes
+ * the nearest of the four palette colors. Returns the size in bytes.
+ */
+static int compressBC1(const unsigned char *src, int w, int h, int bytes, unsigned char *dst) {
+	int bx, by, x, y, c, i, best, dist, bestdist;
+	int block[16][3], lo[3], hi[3], inset, palette[4][3];
+	unsigned short c0, c1, swap;
+	unsigned int indices;
+	unsigned char *out = dst;
+
+	for(by = 0; by < (h + 3) / 4; by++) {
+		for(bx = 0; bx < (w + 3) / 4; bx++) {
+			for(c = 0; c < 3; c++) {
+				lo[c] = 255;
+				hi[c] = 0;
+			}
+			for(i = 0; i < 16; i++) {
+				x = 4*bx + (i & 3);
+				y = 4*by + (i >> 2);
+				if(x >= w) x = w-1; // Repeat the edge in partial blocks
+				if(y >= h) y = h-1;
+				for(c = 0; c < 3; c++) {
+					block[i][c] = src[(y*w + x)*bytes + c];
+					if(block[i][c] < lo[c]) lo[c] = block[i][c];
+					if(block[i][c] > hi[c]) hi[c] = block[i][c];
+				}
+			}
+			for(c = 0; c < 3; c++) {
+				inset = (hi[c] - lo[c]) / 16;
+				lo[c] += inset;
+				hi[c] -= inset;
+			}
+			c0 = pack565(hi);
+			c1 = pack565(lo);
+			if(c0 < c1) { // c0 > c1 selects the four color mode
+				swap = c0;
+				c0 = c1;
+				c1 = swap;
+			}
+			indices = 0;
+			if(c0 != c1) {
+				unpack565(c0, palette[0]);
+				unpack565(c1, palette[1]);
+				for(c = 0; c < 3; c++) {
+					palette[2][c] = (2*palette[0][c] + palette[1][c]) / 3;
+					palette[3][c] = (palette[0][c] + 2*palette[1][c]) / 3;
+				}
+				for(i = 0; i < 16; i++) {
+					best = 0;
+					bestdist = 1 << 30;
+					for(x = 0; x < 4; x++) {
+						dist = 0;
+						for(c = 0; c < 3; c++) dist += (block[i][c] - palette[x][c]) * (block[i][c] - palette[x][c]);
+						if(dist < bestdist) {
+							bestdist = dist;
+							best = x;
+						}
+					}
+					indices |= (unsigned int)best << (2*i);
+				}
+			}
+			out[0] = c0 & 0xff;
+			out[1] = c0 >> 8;
+			out[2] = c1 & 0xff;
+			out[3] = c1 >> 8;
+			out[4] = indices & 0xff;
+			out[5] = (indices >> 8) & 0xff;
+			out[6] = (indices >> 16) & 0xff;
+			out[7] = indices >> 24;
+			out += 8;
+		}
+	}
+	return (int)(out - dst);
+}
+
+/*
+ * cookTexture() - load a TGA file, make its mipmaps, compress them if
+ * asked to, and add the texture to the bundle. Returns 1 on success.
+ */
+static int cookTexture(bundleWriter *writer, const char *filename, const char *name, int bc1) {
+	arena *scratch = arenaScratch();
+	long mark = arenaMark(scratch);
+	Texture texture;
+	bundleTexture header;
+	unsigned char *blob, *level, *next;
+	int bytes, w, h, i, offset, ok;
+	long long capacity;
+
+	if(!loadTGA(&texture, (char*)filename)) return 0;
+	bytes = texture.bpp / 8;
+	if(bc1 && bytes == 4) {
+		printf("%-24s has alpha, which BC1 cannot keep: stored uncompressed\n", name);
+		bc1 = 0;
+	}
+
+	memset(&header, 0, sizeof(header));
+	header.width = texture.width;
+	header.height = texture.height;
+	header.format = bc1 ? BUNDLE_BC1 : (bytes == 4 ? BUNDLE_RGBA8 : BUNDLE_RGB8);
+	// Room for the header and every level, with some to spare for alignment
+	capacity = sizeof(header) + 2LL * texture.width * texture.height * bytes + 16 * (BUNDLE_MAXLEVELS + 8);
+	blob = (unsigned char*)arenaAlloc(scratch, (long)capacity);
+	next = (unsigned char*)arenaAlloc(scratch, (long)texture.width * texture.height * bytes);
+	if(!blob || !next) {
+		printError("Memory error", "cookTexture");
+		arenaRelease(scratch, mark);
+		free(texture.imageData);
+		return 0;
+	}
+	memset(blob, 0, (size_t)capacity);
+
+	level = texture.imageData;
+	w = texture.width;
+	h = texture.height;
+	offset = (sizeof(header) + 15) & ~15;
+	for(i = 0; i < BUNDLE_MAXLEVELS; i++) {
+		header.offsets[i] = offset;
+		if(bc1) header.sizes[i] = compressBC1(level, w, h, bytes, blob + offset);
+		else {
+			header.sizes[i] = w * h * bytes;
+			memcpy(blob + offset, level, header.sizes[i]);
+		}
+		offset = (offset + header.sizes[i] + 15) & ~15;
+		header.levels = i + 1;
+		if(w == 1 && h == 1) break;
+		downsample(level, w, h, next, bytes);
+		memcpy(level, next, (size_t)(w > 1 ? w/2 : 1) * (h > 1 ? h/2 : 1) * bytes);
+		w = w > 1 ? w/2 : 1;
+		h = h > 1 ? h/2 : 1;
+	}
+	memcpy(blob, &header, sizeof(header));
+
+	printf("%-24s %5d x %-5d %s, %2d levels, %.2f MB\n", name, header.width, header.height,
+		bc1 ? "BC1  " : (bytes == 4 ? "RGBA8" : "RGB8 "), header.levels, offset / 1048576.0);
+	ok = bundleWriterAdd(writer, name, BUNDLE_TEXTURE, blob, offset);
+	arenaRelease(scratch, mark);
+	free(texture.imageData);
+	return ok;
+}
+
+/* Add a shader source, with its terminating 0. Returns 1 on success. */
+static int cookShader(bundleWriter *writer, const char *filename, const char *name) {
+	unsigned char *source = readShaderFile(filename);
+	int ok;
+
+	if(!source) return 0;
+	printf("%-24s %ld bytes of GLSL\n", name, (long)strlen((char*)source));
+	ok = bundleWriterAdd(writer, name, BUNDLE_SHADER, source, strlen((char*)source) + 1);
+	free(source);
+	return ok;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"Usage: cook [options] [file ...]\n"
+		"  --out FILE   bundle to write (default assets.bundle)\n"
+		"  --lz4        compress the blobs with LZ4 where it helps\n"
+		"  --bc1        compress RGB textures to BC1 (DXT1) blocks\n"
+		"Files ending in .obj are meshes, .tga textures and .glsl shaders.\n"
+		"With no files, the bundled meshes, textures and shaders are cooked.\n");
+}
+
+/*
+ * main(argc, argv) - cook every file into the bundle, then read the
+ * bundle back and check that every blob in it can be used
+ */
+int main(int argc, char *argv[]) {
+	const char **files, **given;
+	const char *outfile = "assets.bundle", *name, *extension;
+	int nfiles = 0, lz4 = 0, bc1 = 0, failed = 0, i;
+	bundleWriter writer;
+	bundle check;
+	double t0;
+
+	given = (const char**)malloc(argc * sizeof(char*));
+	if(given == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		return 1;
+	}
+	for(i = 1; i < argc; i++) {
+		if(!strcmp(argv[i], "--out") && i+1 < argc) outfile = argv[++i];
+		else if(!strcmp(argv[i], "--lz4")) lz4 = 1;
+		else if(!strcmp(argv[i], "--bc1")) bc1 = 1;
+		else if(argv[i][0] == '-') {
+			usage();
+			free(given);
+			return 1;
+		}
+		else given[nfiles++] = argv[i];
+	}
+	files = given;
+	if(nfiles == 0) {
+		files = defaultAssets;
+		nfiles = sizeof(defaultAssets) / sizeof(defaultAssets[0]);
+	}
+
+	t0 = timerSeconds();
+	if(!bundleWriterOpen(&writer, outfile, lz4)) {
+		free(given);
+		return 1;
+	}
+	for(i = 0; i < nfiles; i++) {
+		name = strrchr(files[i], '/');
+		if(!name) name = strrchr(files[i], '\\');
+		name = name ? name+1 : files[i];
+		extension = strrchr(name, '.');
+		if(extension && !strcmp(extension, ".obj")) {
+			if(!cookMesh(&writer, files[i], name)) failed++;
+		}
+		else if(extension && !strcmp(extension, ".tga")) {
+			if(!cookTexture(&writer, files[i], name, bc1)) failed++;
+		}
+		else if(extension && !strcmp(extension, ".glsl")) {
+			if(!cookShader(&writer, files[i], name)) failed++;
+		}
+		else {
+			fprintf(stderr, "Skipping %s: not a .obj, .tga or .glsl file.\n", files[i]);
+			failed++;
+		}
+	}
+	free(given);
+	if(!bundleWriterClose(&writer)) return 1;
+	printf("Wrote %s in %.2f s: %.2f MB of resources, %.2f MB stored\n", outfile, timerSeconds() - t0,
+		writer.rawbytes / 1048576.0, writer.storedbytes / 1048576.0);
+	arenaPrint(arenaScratch(), "Scratch arena");
+	arenaScratchDelete();
+
+	// Read it back the way the program will
+	if(!bundleOpen(&check, outfile)) return 1;
+	for(i = 0; i < check.count; i++) {
+		if(!bundleData(&check, &check.entries[i])) {
+			fprintf(stderr, "Cannot read back %s.\n", check.entries[i].name);
+			failed++;
+		}
+	}
+	bundlePrintInfo(&check);
+	bundleClose(&check);
+
+	if(failed) fprintf(stderr, "%d file%s could not be cooked.\n", failed, failed == 1 ? "" : "s");
+	return failed ? 1 : 0;
+}
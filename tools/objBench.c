@@ -0,0 +1,254 @@
+/*
+ * objBench - OBJ loader throughput over a set of meshes, without OpenGL.
+ *
+ * Every mesh is loaded along three paths, each timed over a number of
+ * repetitions (the median is reported):
+ *   parse        soupParseOBJ(), text to interleaved arrays
+ *   parse+dedup  the same, followed by soupDeduplicate()
+ *   cache hit    soupReadCache() of the deduplicated arrays
+ * For each path, the table shows throughput in lines/s and MB/s of
+ * input, the number of heap allocations made by the soup code, and
+ * the peak resident set size of the process.
+ *
+ * Only the CPU side of loading is measured, since the GL upload does
+ * not depend on how the arrays were produced. With no arguments, the
+ * bundled meshes in ../meshes are used. Run with --help for options.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#define GL_GLEXT_PROTOTYPES
+#endif
+#include <GLFW/glfw3.h>
+
+#ifdef __WIN32__
+#include <GL/glext.h>
+#else
+#include <sys/resource.h> // For getrusage()
+#endif
+
+#include "tnm084.h" // For filelength()
+#include "triangleSoup.h"
+#include "timer.h"
+
+#define MAXREPEAT 100
+#define CACHEFILENAME "objBench.soup"
+
+// The bundled meshes, smallest to largest
+static const char *defaultMeshes[] = {
+	"../meshes/cube.obj", "../meshes/pyramid.obj", "../meshes/teapot_coarse.obj",
+	"../meshes/teapot.obj", "../meshes/trex.obj", "../meshes/zergling.obj"
+};
+
+/* One timed path through the loader */
+typedef struct {
+	double ms;                 // Median time
+	unsigned long allocations; // Heap allocations per load
+	long allocbytes;           // Bytes requested per load
+	long peakrss;              // Peak resident set size in kB, 0 if unknown
+	int vertices;              // Vertices in the result
+} benchPath;
+
+
+/*
+ * resetPeakRSS() - start a new peak RSS measurement, where possible.
+ * On Linux, writing 5 to clear_refs resets the high water mark, so
+ * each path gets its own peak. Elsewhere the peak is for the whole run.
+ */
+static void resetPeakRSS(void) {
+#ifdef __linux__
+	FILE *file = fopen("/proc/self/clear_refs", "w");
+	if(file) {
+		fputs("5", file);
+		fclose(file);
+	}
+#endif
+}
+
+/*
+ * peakRSS() - peak resident set size in kB, or 0 if unknown
+ */
+static long peakRSS(void) {
+#ifdef __linux__
+	char line[256];
+	long kb = 0;
+	FILE *file = fopen("/proc/self/status", "r");
+	if(file) {
+		while(fgets(line, sizeof(line), file)) {
+			if(sscanf(line, "VmHWM: %ld", &kb) == 1) break;
+		}
+		fclose(file);
+		if(kb > 0) return kb;
+	}
+#endif
+#ifndef __WIN32__
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+		return usage.ru_maxrss / 1024; // Bytes on MacOS, kB elsewhere
+#else
+		return usage.ru_maxrss;
+#endif
+	}
+#endif
+	return 0;
+}
+
+static int compareDoubles(const void *a, const void *b) {
+	double da = *(const double*)a, db = *(const double*)b;
+	return (da > db) - (da < db);
+}
+
+/*
+ * runPath() - load a mesh repeat times along one path, and measure it.
+ * path is 0 for parse, 1 for parse+dedup, 2 for a cache hit.
+ * Returns 1 on success.
+ */
+static int runPath(const char *filename, int path, int repeat, objInfo *info, benchPath *result) {
+	double times[MAXREPEAT], t0;
+	unsigned long allocations;
+	long allocbytes;
+	triangleSoup soup;
+	int r, ok;
+
+	resetPeakRSS();
+	for(r=0; r<repeat; r++) {
+		soupInit(&soup);
+		allocations = soupAllocations();
+		allocbytes = soupAllocatedBytes();
+		t0 = timerSeconds();
+		if(path == 2) ok = soupReadCache(&soup, CACHEFILENAME);
+		else ok = soupParseOBJ(&soup, filename, info);
+		if(ok && path == 1) soupDeduplicate(&soup);
+		times[r] = 1000.0 * (timerSeconds() - t0);
+		if(!ok) {
+			soupDelete(&soup); // Whatever a failed load left behind
+			return 0;
+		}
+		result->allocations = soupAllocations() - allocations;
+		result->allocbytes = soupAllocatedBytes() - allocbytes;
+		result->vertices = soup.nverts;
+		// Leave a cache behind for the cache hit path
+		if(path == 1 && r == 0 && !soupWriteCache(&soup, CACHEFILENAME)) {
+			soupDelete(&soup);
+			return 0;
+		}
+		soupDelete(&soup);
+	}
+	result->peakrss = peakRSS();
+	qsort(times, repeat, sizeof(double), compareDoubles);
+	result->ms = times[repeat/2];
+	return 1;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+		"Usage: objBench [options] [file.obj ...]\n"
+		"  --repeat N    loads per path and mesh, median is reported (default 5)\n"
+		"  --json FILE   also write the results as JSON\n"
+		"With no files, the bundled meshes in ../meshes are used.\n");
+}
+
+/*
+ * main(argc, argv) - load each mesh along every path and report
+ */
+int main(int argc, char *argv[]) {
+	const char **meshes, **given;
+	const char *jsonfile = NULL, *name;
+	int nmeshes = 0, repeat = 5, written = 0, i, m, p;
+	objInfo info;
+	benchPath paths[3];
+	double seconds;
+	long cachebytes;
+	FILE *json = NULL, *cache;
+	static const char *pathNames[3] = { "parse", "parse_dedup", "cache_hit" };
+
+	given = (const char**)malloc(argc * sizeof(char*));
+	if(given == NULL) {
+		fprintf(stderr, "Out of memory.\n");
+		return 1;
+	}
+	for(i=1; i<argc; i++) {
+		if(!strcmp(argv[i], "--repeat") && i+1 < argc) repeat = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--json") && i+1 < argc) jsonfile = argv[++i];
+		else if(argv[i][0] == '-') {
+			usage();
+			free(given);
+			return 1;
+		}
+		else given[nmeshes++] = argv[i];
+	}
+	meshes = given;
+	if(nmeshes == 0) {
+		meshes = defaultMeshes;
+		nmeshes = sizeof(defaultMeshes) / sizeof(defaultMeshes[0]);
+	}
+	if(repeat < 1) repeat = 1;
+	if(repeat > MAXREPEAT) repeat = MAXREPEAT;
+
+	if(jsonfile) {
+		json = fopen(jsonfile, "w");
+		if(json == NULL) {
+			fprintf(stderr, "Cannot write results to %s.\n", jsonfile);
+			free(given);
+			return 1;
+		}
+		fprintf(json, "{\"benchmark\": \"objBench\", \"repeat\": %d, \"meshes\": {", repeat);
+	}
+
+	printf("%-18s %8s %9s | %-11s %9s %10s %8s %7s %9s %9s\n", "mesh", "MB", "lines",
+		"path", "ms", "lines/s", "MB/s", "allocs", "vertices", "peak MB");
+	for(m=0; m<nmeshes; m++) {
+		name = strrchr(meshes[m], '/');
+		if(!name) name = strrchr(meshes[m], '\\');
+		name = name ? name+1 : meshes[m];
+
+		if(!runPath(meshes[m], 0, repeat, &info, &paths[0])
+			|| !runPath(meshes[m], 1, repeat, &info, &paths[1])
+			|| !runPath(meshes[m], 2, repeat, &info, &paths[2])) {
+			fprintf(stderr, "Skipping %s.\n", meshes[m]);
+			continue;
+		}
+		cache = fopen(CACHEFILENAME, "rb");
+		cachebytes = cache ? filelength(cache) : 0;
+		if(cache) fclose(cache);
+
+		for(p=0; p<3; p++) {
+			seconds = paths[p].ms / 1000.0;
+			if(p == 0) printf("%-18s %8.2f %9ld | ", name, info.bytes / 1.0e6, info.lines);
+			else printf("%-18s %8s %9s | ", "", "", "");
+			printf("%-11s %9.2f ", pathNames[p], paths[p].ms);
+			if(p < 2 && seconds > 0.0) printf("%10.0f ", info.lines / seconds);
+			else printf("%10s ", "-"); // A cache has no lines
+			printf("%8.1f %7lu %9d %9.1f\n",
+				seconds > 0.0 ? ((p < 2) ? info.bytes : cachebytes) / seconds / 1.0e6 : 0.0,
+				paths[p].allocations, paths[p].vertices, paths[p].peakrss / 1024.0);
+		}
+
+		if(json) {
+			fprintf(json, "%s\n  \"%s\": {\"bytes\": %ld, \"lines\": %ld, \"triangles\": %d, \"cache_bytes\": %ld",
+				written++ ? "," : "", name, info.bytes, info.lines, info.faces, cachebytes);
+			for(p=0; p<3; p++) {
+				seconds = paths[p].ms / 1000.0;
+				fprintf(json, ",\n   \"%s\": {\"ms\": %.4f, ", pathNames[p], paths[p].ms);
+				if(p < 2) fprintf(json, "\"lines_per_s\": %.0f, ", seconds > 0.0 ? info.lines / seconds : 0.0);
+				fprintf(json, "\"mb_per_s\": %.3f, \"allocations\": %lu, \"alloc_bytes\": %ld, "
+					"\"vertices\": %d, \"peak_rss_kb\": %ld}",
+					seconds > 0.0 ? ((p < 2) ? info.bytes : cachebytes) / seconds / 1.0e6 : 0.0,
+					paths[p].allocations, paths[p].allocbytes, paths[p].vertices, paths[p].peakrss);
+			}
+			fprintf(json, "}");
+		}
+	}
+	remove(CACHEFILENAME);
+
+	if(json) {
+		fprintf(json, "}}\n");
+		fclose(json);
+	}
+	free(given);
+	return 0;
+}
@@ -0,0 +1,457 @@
+/*
+ * qualitySweep - how much each quality setting of the meteor shaders
+ * costs in frame time, and how much it changes the image.
+ *
+ * The scene is rendered headless for every combination of
+ *   sphere segments     tessellation of the base mesh
+ *   fBm octaves         OCTAVES in the vertex shader
+ *   cellular F1 / F1F2  CELLULAR_F1_ONLY in the fragment shader
+ *   analytic / baked    noise displacement per frame on the GPU, or
+ *                       once per vertex on the CPU (BAKED_DISPLACEMENT)
+ * Each combination is timed over a number of frames, and one frame at a
+ * fixed pose and time is compared to the same frame rendered at full
+ * quality (most segments and octaves, F1F2, analytic), giving PSNR and
+ * SSIM. The results are printed as a table sorted by cost, where a star
+ * marks the Pareto front: settings that no other setting beats on both
+ * cost and SSIM. Those are the only ones worth choosing between.
+ * Run with --help for the options.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// In MacOS X, tell GLFW to include the modern OpenGL headers.
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#endif
+
+// In Linux, tell GLFW to include the modern OpenGL functions.
+#ifdef __linux__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <GLFW/glfw3.h>
+
+#ifdef __WIN32__
+#include <GL/glext.h>
+#endif
+
+#include "tnm084.h"
+#include "triangleSoup.h"
+#include "frameStats.h"
+#include "gpuTimer.h"
+#include "timer.h"
+#include "resources.h"
+#include "renderTarget.h"
+#include "imageCompare.h"
+#include "meteor.h"
+
+#define VERTEXSHADERFILENAME "../shaders/vertexshader.glsl"
+#define FRAGMENTSHADERFILENAME "../shaders/fragmentshader.glsl"
+#define MAXVALUES 16 // Most values in one list on the command line
+
+/* Everything that can be set from the command line */
+typedef struct {
+	int segments[MAXVALUES]; // Sphere resolutions to try
+	int nsegments;
+	int octaves[MAXVALUES];  // Octave counts to try
+	int noctaves;
+	const char *vertexshader;
+	const char *fragmentshader;
+	int width, height;       // Render resolution in pixels
+	int frames;              // Measured frames per setting
+	int warmup;              // Frames rendered before measuring starts
+	float time;              // Shader time for the compared image
+	const char *out;         // JSON output file, or NULL
+} sweepConfig;
+
+/* One combination of settings, and what it costs */
+typedef struct {
+	int segments;
+	int octaves;
+	int f1only;    // Nonzero for CELLULAR_F1_ONLY
+	int baked;     // Nonzero for BAKED_DISPLACEMENT
+	int triangles;
+	double gpums;  // Median GPU time per frame, or -1 if not measured
+	double wallms; // Median wall clock time per frame
+	double bakems; // Time to bake the displacement on the CPU (once, at load)
+	double psnr;   // Against the reference image, in dB
+	double ssim;
+	int pareto;    // Nonzero if on the Pareto front of cost and SSIM
+} sweepPoint;
+
+
+static void usage(void) {
+	fprintf(stderr,
+		"Usage: qualitySweep [options]\n"
+		"  --segments LIST   sphere segments to try (default 200,100,50,25)\n"
+		"  --octaves LIST    fBm octaves to try (default 10,6,4,2)\n"
+		"  --vs FILE         vertex shader (default " VERTEXSHADERFILENAME ")\n"
+		"  --fs FILE         fragment shader (default " FRAGMENTSHADERFILENAME ")\n"
+		"  --size WxH        render resolution (default 640x360)\n"
+		"  --frames N        measured frames per setting (default 200)\n"
+		"  --warmup N        unmeasured frames first (default 20)\n"
+		"  --time T          shader time of the compared image (default 2.0)\n"
+		"  --out FILE        also write the results as JSON\n"
+		"LIST is comma separated, e.g. 200,100,50. The largest values, with\n"
+		"F1F2 cellular noise and analytic displacement, make the reference.\n");
+}
+
+/*
+ * parseList() - read a comma separated list of positive numbers.
+ * Returns the number of values, or 0 if the list is bad.
+ */
+static int parseList(const char *text, int values[]) {
+	int n = 0;
+	char *end;
+
+	while(*text && n < MAXVALUES) {
+		values[n] = (int)strtol(text, &end, 10);
+		if(end == text || values[n] < 0) return 0;
+		n++;
+		text = (*end == ',') ? end+1 : end;
+		if(*end && *end != ',') return 0;
+	}
+	return n;
+}
+
+/*
+ * parseArgs() - fill in a sweepConfig from the command line.
+ * Returns 1 if all is well, 0 if the program should exit.
+ */
+static int parseArgs(int argc, char *argv[], sweepConfig *config) {
+	int i;
+
+	config->nsegments = parseList("200,100,50,25", config->segments);
+	config->noctaves = parseList("10,6,4,2", config->octaves);
+	config->vertexshader = VERTEXSHADERFILENAME;
+	config->fragmentshader = FRAGMENTSHADERFILENAME;
+	config->width = 640;
+	config->height = 360;
+	config->frames = 200;
+	config->warmup = 20;
+	config->time = 2.0f;
+	config->out = NULL;
+
+	for(i=1; i<argc; i++) {
+		if(!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
+			usage();
+			return 0;
+		}
+		else if(i+1 == argc) {
+			fprintf(stderr, "Unknown option or missing value: %s\n", argv[i]);
+			usage();
+			return 0;
+		}
+		else if(!strcmp(argv[i], "--segments")) {
+			config->nsegments = parseList(argv[++i], config->segments);
+		}
+		else if(!strcmp(argv[i], "--octaves")) {
+			config->noctaves = parseList(argv[++i], config->octaves);
+		}
+		else if(!strcmp(argv[i], "--vs")) config->vertexshader = argv[++i];
+		else if(!strcmp(argv[i], "--fs")) config->fragmentshader = argv[++i];
+		else if(!strcmp(argv[i], "--frames")) config->frames = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--warmup")) config->warmup = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--time")) config->time = (float)atof(argv[++i]);
+		else if(!strcmp(argv[i], "--out")) config->out = argv[++i];
+		else if(!strcmp(argv[i], "--size")) {
+			if(sscanf(argv[++i], "%dx%d", &config->width, &config->height) != 2) {
+				fprintf(stderr, "Bad size: %s (expected WxH)\n", argv[i]);
+				return 0;
+			}
+		}
+		else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			usage();
+			return 0;
+		}
+	}
+	if(config->nsegments == 0 || config->noctaves == 0) {
+		fprintf(stderr, "Bad list of segments or octaves.\n");
+		return 0;
+	}
+	if(config->width < 1 || config->height < 1 || config->frames < 1 || config->warmup < 0) {
+		fprintf(stderr, "Sizes and counts must be positive.\n");
+		return 0;
+	}
+	return 1;
+}
+
+static int largest(const int values[], int n) {
+	int i, m = values[0];
+	for(i=1; i<n; i++) if(values[i] > m) m = values[i];
+	return m;
+}
+
+/*
+ * renderFrame() - draw the sphere into the bound target, spun by angle.
+ * The pose and projection are the same as in GLSLprimer.c.
+ */
+static void renderFrame(GLuint program, triangleSoup *soup, float angle, float time, int width, int height) {
+	GLfloat R1[16], R2[16], MV[16];
+	GLfloat P[16] = {
+		4.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 4.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, -2.5f, -1.0f,
+		0.0f, 0.0f, -10.5f, 0.0f
+	};
+
+	P[0] = P[5] * height / width;
+	mat4roty(R1, angle);
+	mat4rotx(R2, 0.3f);
+	mat4mult(R2, R1, MV);
+	MV[14] += -5.0f;
+
+	glClearColor(0.3f, 0.3f, 0.3f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glUseProgram(program);
+	glUniformMatrix4fv(glGetUniformLocation(program, "MV"), 1, GL_FALSE, MV);
+	glUniformMatrix4fv(glGetUniformLocation(program, "P"), 1, GL_FALSE, P);
+	glUniform1f(glGetUniformLocation(program, "time"), time);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_BACK);
+	soupRender(*soup);
+	glUseProgram(0);
+}
+
+/*
+ * measurePoint() - build the scene for one setting, time it, and copy
+ * the image at the compared pose to image. Returns 1 on success.
+ */
+static int measurePoint(const sweepConfig *config, sweepPoint *point, renderTarget *target, unsigned char *image) {
+	triangleSoup soup;
+	GLfloat *displacement;
+	GLuint program;
+	frameStats stats;
+	gpuTimer gputimer;
+	char defines[256];
+	double t0;
+	int frame;
+
+	soupInit(&soup);
+	soupCreateSphere(&soup, 1.0, point->segments);
+	point->triangles = soup.ntris;
+	point->bakems = 0.0;
+	if(point->baked) {
+		t0 = timerSeconds();
+		displacement = meteorBakeDisplacement(&soup, point->octaves, NULL);
+		point->bakems = 1000.0 * (timerSeconds() - t0);
+		if(displacement == NULL) {
+			soupDelete(&soup);
+			return 0;
+		}
+		soupSetAttribute(&soup, 3, METEOR_BAKEDFLOATS, displacement);
+		free(displacement);
+	}
+	soupSetResidency(&soup, SOUP_RELEASE);
+
+	snprintf(defines, sizeof(defines), "#define OCTAVES %d\n%s%s", point->octaves,
+		point->f1only ? "#define CELLULAR_F1_ONLY\n" : "",
+		point->baked ? "#define BAKED_DISPLACEMENT\n" : "");
+	program = createShaderWithDefines((char*)config->vertexshader,
+		(char*)config->fragmentshader, defines);
+	if(!soup.vao || !program) {
+		soupDelete(&soup);
+		return 0;
+	}
+
+	frameStatsInit(&stats);
+	gpuTimerInit(&gputimer, &stats);
+	for(frame=0; frame<config->warmup+config->frames; frame++) {
+		// Start over once the caches and the driver have warmed up
+		if(frame == config->warmup) {
+			gpuTimerFlush(&gputimer);
+			gpuTimerDelete(&gputimer);
+			frameStatsDelete(&stats);
+			frameStatsInit(&stats);
+			gpuTimerInit(&gputimer, &stats);
+		}
+		frameStatsTick(&stats, timerSeconds(), timerCPUSeconds());
+		gpuTimerBeginFrame(&gputimer, stats.frames);
+		renderTargetBind(target);
+		gpuTimerBegin(&gputimer, "frame");
+		renderFrame(program, &soup, 0.01f * frame, frame / 60.0f, target->width, target->height);
+		gpuTimerEnd(&gputimer);
+		renderTargetUnbind();
+		// One frame in flight, so that wall time is the cost of a whole frame
+		glFinish();
+	}
+	frameStatsTick(&stats, timerSeconds(), timerCPUSeconds());
+	gpuTimerFlush(&gputimer);
+	point->gpums = (stats.gpu.total > 0) ? histogramPercentile(&stats.gpu, 0.5) : -1.0;
+	point->wallms = histogramPercentile(&stats.wall, 0.5);
+
+	// The compared image, at a pose and time that do not depend on --frames
+	renderTargetBind(target);
+	renderFrame(program, &soup, 0.5f, config->time, target->width, target->height);
+	renderTargetUnbind();
+	if(renderTargetRead(target)) {
+		memcpy(image, target->pixels, 4L * target->width * target->height);
+	}
+
+	gpuTimerDelete(&gputimer);
+	frameStatsDelete(&stats);
+	glDeleteProgram(program);
+	resourceRelease(RESOURCE_PROGRAM, (void*)(size_t)program);
+	soupDelete(&soup);
+	return 1;
+}
+
+/* Frame cost used for the comparison: GPU time where it was measured */
+static double pointCost(const sweepPoint *point) {
+	return (point->gpums >= 0.0) ? point->gpums : point->wallms;
+}
+
+static int compareCost(const void *a, const void *b) {
+	double ca = pointCost((const sweepPoint*)a), cb = pointCost((const sweepPoint*)b);
+	return (ca > cb) - (ca < cb);
+}
+
+/*
+ * markPareto() - flag the points that no other point beats on both
+ * cost and SSIM, i.e. that are at least as good in one and better
+ * in the other.
+ */
+static void markPareto(sweepPoint *points, int n) {
+	int i, j;
+	double ci, cj;
+
+	for(i=0; i<n; i++) {
+		points[i].pareto = 1;
+		ci = pointCost(&points[i]);
+		for(j=0; j<n && points[i].pareto; j++) {
+			cj = pointCost(&points[j]);
+			if(j != i && cj <= ci && points[j].ssim >= points[i].ssim
+				&& (cj < ci || points[j].ssim > points[i].ssim)) {
+				points[i].pareto = 0;
+			}
+		}
+	}
+}
+
+/*
+ * main(argc, argv) - sweep over all settings and report
+ */
+int main(int argc, char *argv[]) {
+	sweepConfig config;
+	sweepPoint *points, reference;
+	renderTarget target;
+	GLFWwindow* window;
+	unsigned char *referenceimage, *image;
+	int npoints = 0, s, o, f, b, i;
+	FILE *out;
+
+	if(!parseArgs(argc, argv, &config)) return 1;
+
+	if (!glfwInit()) {
+		fprintf(stderr, "Failed to initialise GLFW. Exiting.\n");
+		return 1;
+	}
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	window = glfwCreateWindow(64, 64, "qualitySweep", NULL, NULL);
+	if (!window) {
+		fprintf(stderr, "Failed to open GLFW window. Exiting.\n");
+		glfwTerminate();
+		return 1;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0);
+	loadExtensions();
+	if(!renderTargetInit(&target, config.width, config.height)) {
+		glfwTerminate();
+		return 1;
+	}
+
+	points = (sweepPoint*)malloc(4 * config.nsegments * config.noctaves * sizeof(sweepPoint));
+	referenceimage = (unsigned char*)malloc(4L * config.width * config.height);
+	image = (unsigned char*)malloc(4L * config.width * config.height);
+	if(!points || !referenceimage || !image) {
+		printError("Memory error", "Cannot allocate sweep buffers");
+		return 1;
+	}
+
+	// The reference: everything at the highest quality
+	memset(&reference, 0, sizeof(reference));
+	reference.segments = largest(config.segments, config.nsegments);
+	reference.octaves = largest(config.octaves, config.noctaves);
+	if(!measurePoint(&config, &reference, &target, referenceimage)) {
+		fprintf(stderr, "Failed to render the reference. Exiting.\n");
+		glfwTerminate();
+		return 1;
+	}
+
+	for(s=0; s<config.nsegments; s++)
+	for(o=0; o<config.noctaves; o++)
+	for(f=0; f<2; f++)
+	for(b=0; b<2; b++) {
+		sweepPoint *point = &points[npoints];
+		memset(point, 0, sizeof(sweepPoint));
+		point->segments = config.segments[s];
+		point->octaves = config.octaves[o];
+		point->f1only = f;
+		point->baked = b;
+		fprintf(stderr, "segments %d, octaves %d, %s, %s\n", point->segments, point->octaves,
+			f ? "F1" : "F1F2", b ? "baked" : "analytic");
+		if(!measurePoint(&config, point, &target, image)) {
+			fprintf(stderr, "Skipping this setting.\n");
+			continue;
+		}
+		point->psnr = imagePSNR(referenceimage, image, config.width, config.height);
+		point->ssim = imageSSIM(referenceimage, image, config.width, config.height);
+		npoints++;
+	}
+
+	markPareto(points, npoints);
+	qsort(points, npoints, sizeof(sweepPoint), compareCost);
+
+	printf("%8s %7s %5s %9s %9s | %8s %8s %8s | %7s %7s %s\n", "segments", "octaves",
+		"cell", "noise", "triangles", "gpu ms", "wall ms", "bake ms", "PSNR", "SSIM", "pareto");
+	for(i=0; i<npoints; i++) {
+		printf("%8d %7d %5s %9s %9d | ", points[i].segments, points[i].octaves,
+			points[i].f1only ? "F1" : "F1F2", points[i].baked ? "baked" : "analytic", points[i].triangles);
+		if(points[i].gpums >= 0.0) printf("%8.3f ", points[i].gpums);
+		else printf("%8s ", "-");
+		printf("%8.3f %8.1f | %7.2f %7.4f %s\n", points[i].wallms, points[i].bakems,
+			points[i].psnr, points[i].ssim, points[i].pareto ? "*" : "");
+	}
+
+	if(config.out) {
+		out = fopen(config.out, "w");
+		if(out == NULL) fprintf(stderr, "Cannot write results to %s.\n", config.out);
+		else {
+			fprintf(out, "{\"benchmark\": \"qualitySweep\", \"width\": %d, \"height\": %d, "
+				"\"frames\": %d, \"time\": %.3f,\n \"reference\": {\"segments\": %d, \"octaves\": %d},\n"
+				" \"points\": [", config.width, config.height, config.frames, config.time,
+				reference.segments, reference.octaves);
+			for(i=0; i<npoints; i++) {
+				fprintf(out, "%s\n  {\"name\": \"s%d_o%d_%s_%s\", \"segments\": %d, \"octaves\": %d, "
+					"\"cellular\": \"%s\", \"noise\": \"%s\", \"triangles\": %d, ",
+					i ? "," : "", points[i].segments, points[i].octaves,
+					points[i].f1only ? "f1" : "f1f2", points[i].baked ? "baked" : "analytic",
+					points[i].segments, points[i].octaves, points[i].f1only ? "F1" : "F1F2",
+					points[i].baked ? "baked" : "analytic", points[i].triangles);
+				if(points[i].gpums >= 0.0) fprintf(out, "\"gpu_ms\": %.4f, ", points[i].gpums);
+				fprintf(out, "\"wall_ms\": %.4f, \"bake_ms\": %.3f, \"psnr\": %.3f, \"ssim\": %.5f, \"pareto\": %s}",
+					points[i].wallms, points[i].bakems, points[i].psnr, points[i].ssim,
+					points[i].pareto ? "true" : "false");
+			}
+			fprintf(out, "]}\n");
+			fclose(out);
+		}
+	}
+
+	free(points);
+	free(referenceimage);
+	free(image);
+	renderTargetDelete(&target);
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	return 0;
+}
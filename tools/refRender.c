@@ -0,0 +1,224 @@
+/*
+ * refRender - ray trace a reference image of the meteor on the CPU.
+ *
+ * The displaced mesh is traced exactly, with samples x samples rays per
+ * pixel and the fragment shader lighting, so the result can be used as
+ * ground truth for the faster paths. The view is the same as in
+ * softRender, so images from both tools (and softRender --gl-out) can
+ * be compared directly with --compare, which reports PSNR and SSIM.
+ * No OpenGL context is needed. Run with --help for the options.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLFW/glfw3.h>
+
+#include "tnm084.h"
+#include "tgaloader.h"
+#include "triangleSoup.h"
+#include "timer.h"
+#include "imageCompare.h"
+#include "meteor.h"
+#include "jobSystem.h"
+#include "rayTrace.h"
+
+/* Everything that can be set from the command line */
+typedef struct {
+	const char *mesh;     // OBJ file, or NULL for a sphere
+	int segments;         // Sphere resolution, if no mesh is given
+	int width, height;    // Render resolution in pixels
+	int threads;          // Worker threads, 0 for one per processor
+	int samples;          // Rays per pixel along each axis
+	float time;           // The "time" uniform
+	int octaves;          // OCTAVES
+	int f1only;           // CELLULAR_F1_ONLY
+	int baked;            // BAKED_DISPLACEMENT
+	const char *out;      // TGA file for the image
+	const char *compare;  // TGA file to compare against, or NULL
+} refConfig;
+
+
+static void usage(void) {
+	fprintf(stderr,
+		"Usage: refRender [options]\n"
+		"  --mesh FILE       OBJ mesh to render (default: a sphere)\n"
+		"  --sphere N        sphere segments when no mesh is given (default 400)\n"
+		"  --size WxH        render resolution (default 640x360)\n"
+		"  --threads N       worker threads, 0 for one per processor (default 0)\n"
+		"  --samples N       N x N rays per pixel (default 3)\n"
+		"  --time T          shader time (default 2.0)\n"
+		"  --octaves N       fBm octaves (default 10)\n"
+		"  --f1only          F1 only cellular noise\n"
+		"  --baked           bake the displacement before tracing\n"
+		"  --out FILE        save the image as TGA (default reference.tga)\n"
+		"  --compare FILE    report PSNR and SSIM against a TGA of the same size\n");
+}
+
+/*
+ * parseArgs() - fill in a refConfig from the command line.
+ * Returns 1 if all is well, 0 if the program should exit.
+ */
+static int parseArgs(int argc, char *argv[], refConfig *config) {
+	int i;
+
+	config->mesh = NULL;
+	config->segments = 400;
+	config->width = 640;
+	config->height = 360;
+	config->threads = 0;
+	config->samples = 3;
+	config->time = 2.0f;
+	config->octaves = 10;
+	config->f1only = 0;
+	config->baked = 0;
+	config->out = "reference.tga";
+	config->compare = NULL;
+
+	for(i=1; i<argc; i++) {
+		if(!strcmp(argv[i], "--f1only")) config->f1only = 1;
+		else if(!strcmp(argv[i], "--baked")) config->baked = 1;
+		else if(!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
+			usage();
+			return 0;
+		}
+		else if(i+1 == argc) {
+			fprintf(stderr, "Unknown option or missing value: %s\n", argv[i]);
+			usage();
+			return 0;
+		}
+		else if(!strcmp(argv[i], "--mesh")) config->mesh = argv[++i];
+		else if(!strcmp(argv[i], "--sphere")) config->segments = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--threads")) config->threads = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--samples")) config->samples = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--time")) config->time = (float)atof(argv[++i]);
+		else if(!strcmp(argv[i], "--octaves")) config->octaves = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--out")) config->out = argv[++i];
+		else if(!strcmp(argv[i], "--compare")) config->compare = argv[++i];
+		else if(!strcmp(argv[i], "--size")) {
+			if(sscanf(argv[++i], "%dx%d", &config->width, &config->height) != 2) {
+				fprintf(stderr, "Bad size: %s (expected WxH)\n", argv[i]);
+				return 0;
+			}
+		}
+		else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			usage();
+			return 0;
+		}
+	}
+	if(config->width < 1 || config->height < 1 || config->samples < 1 || config->octaves < 0) {
+		fprintf(stderr, "Sizes and counts must be positive.\n");
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * sceneMatrices() - the same view as in softRender
+ */
+static void sceneMatrices(GLfloat MV[16], GLfloat P[16], int width, int height) {
+	GLfloat R1[16], R2[16];
+	int i;
+
+	for(i=0; i<16; i++) P[i] = 0.0f;
+	P[5] = 4.0f;
+	P[0] = P[5] * height / width;
+	P[10] = -2.5f;
+	P[11] = -1.0f;
+	P[14] = -10.5f;
+	mat4roty(R1, 0.5f);
+	mat4rotx(R2, 0.3f);
+	mat4mult(R2, R1, MV);
+	MV[14] += -5.0f;
+}
+
+/*
+ * compareImage() - compare the pixels to a TGA file and report.
+ * Returns 1 if the comparison could be made.
+ */
+static int compareImage(const char *filename, const unsigned char *pixels, int width, int height) {
+	Texture texture;
+
+	memset(&texture, 0, sizeof(Texture));
+	if(!loadTGA(&texture, (char*)filename)) {
+		fprintf(stderr, "Cannot read %s for comparison.\n", filename);
+		return 0;
+	}
+	if((int)texture.width != width || (int)texture.height != height || texture.bpp != 32) {
+		fprintf(stderr, "%s is %dx%d at %d bits, expected %dx%d at 32 bits.\n", filename,
+			texture.width, texture.height, texture.bpp, width, height);
+		free(texture.imageData);
+		return 0;
+	}
+	printf("against %s: PSNR %.2f dB, SSIM %.4f\n", filename,
+		imagePSNR(pixels, texture.imageData, width, height),
+		imageSSIM(pixels, texture.imageData, width, height));
+	free(texture.imageData);
+	return 1;
+}
+
+/*
+ * main(argc, argv) - build, trace, save and compare if asked to
+ */
+int main(int argc, char *argv[]) {
+	static const float background[4] = {0.3f, 0.3f, 0.3f, 0.0f}; // As glClearColor() in softRender
+	refConfig config;
+	triangleSoup soup;
+	jobSystem jobs;
+	rayScene scene;
+	softShading shading;
+	GLfloat *displacement = NULL;
+	GLfloat MV[16], P[16];
+	unsigned char *pixels;
+	double t0, bakems = 0.0, buildms, renderms;
+	int status = 0;
+
+	if(!parseArgs(argc, argv, &config)) return 1;
+
+	soupInit(&soup);
+	if(config.mesh) {
+		if(!soupParseOBJ(&soup, config.mesh, NULL)) return 1;
+	}
+	else soupGenerateSphere(&soup, 1.0, config.segments);
+	if(!jobSystemInit(&jobs, config.threads)) return 1;
+	if(config.baked) {
+		t0 = timerSeconds();
+		displacement = meteorBakeDisplacement(&soup, config.octaves, &jobs);
+		bakems = 1000.0 * (timerSeconds() - t0);
+	}
+
+	pixels = (unsigned char*)malloc(4 * (size_t)config.width * config.height);
+	if(!pixels) {
+		printError("Memory error", "Cannot allocate the image");
+		return 1;
+	}
+	shading.time = config.time;
+	shading.octaves = config.octaves;
+	shading.f1only = config.f1only;
+	shading.displacement = displacement;
+	sceneMatrices(MV, P, config.width, config.height);
+
+	t0 = timerSeconds();
+	if(!rayTraceBuild(&scene, &soup, MV, &shading)) return 1;
+	buildms = 1000.0 * (timerSeconds() - t0);
+	t0 = timerSeconds();
+	rayTraceRender(&scene, &jobs, pixels, config.width, config.height, P, config.samples, background);
+	renderms = 1000.0 * (timerSeconds() - t0);
+
+	printf("refRender: %dx%d, %d triangles, %d nodes, %dx%d samples, %d threads\n", config.width,
+		config.height, scene.ntriangles, scene.nnodes, config.samples, config.samples, jobs.nthreads);
+	printf("ms: build %.2f, render %.2f", buildms, renderms);
+	if(config.baked) printf(", bake %.2f", bakems);
+	printf("\n");
+	if(!saveTGA((char*)config.out, pixels, config.width, config.height)) status = 1;
+	if(config.compare && !compareImage(config.compare, pixels, config.width, config.height)) status = 1;
+
+	rayTraceDelete(&scene);
+	jobSystemDelete(&jobs);
+	soupDelete(&soup);
+	free(displacement);
+	free(pixels);
+	return status;
+}
@@ -0,0 +1,492 @@
+/*
+ * sceneBench - render a scene for a fixed number of frames and report
+ * load times, frame time percentiles and GPU pass times as JSON.
+ *
+ * Everything that GLSLprimer.c fixes at compile time (mesh, texture,
+ * shaders, window size) is a command line option here, so a series of
+ * configurations can be benchmarked with one build. Run with --help
+ * for the options. The output is a single JSON object, written to
+ * stdout or to the file given with --out, meant to be collected by a
+ * script and tracked over time.
+ *
+ * In headless mode the window is hidden and the scene is rendered into
+ * an offscreen framebuffer of the requested size, so the results do not
+ * depend on the desktop or on vertical sync.
+ *
+ * By default each frame is animated and culled, then submitted, in
+ * sequence. With --pipeline, the animation and culling for frame N+1
+ * run on the workers while the main thread submits frame N, and the
+ * GPU may be at most --inflight frames behind, enforced with fences.
+ * Compare the two at high --instances counts to see what it gains.
+ *
+ * --fps caps the frame rate by sleeping between frames, and the JSON
+ * then shows how much CPU time that saved compared to running uncapped.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// In MacOS X, tell GLFW to include the modern OpenGL headers.
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#endif
+
+// In Linux, tell GLFW to include the modern OpenGL functions.
+#ifdef __linux__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <GLFW/glfw3.h>
+
+#ifdef __WIN32__
+#include <GL/glext.h>
+#endif
+
+#include "tnm084.h"
+#include "tgaloader.h"
+#include "triangleSoup.h"
+#include "glb.h"
+#include "frameStats.h"
+#include "gpuTimer.h"
+#include "timer.h"
+#include "trace.h"
+#include "startup.h"
+#include "resources.h"
+#include "renderTarget.h"
+#include "jobSystem.h"
+#include "scene.h"
+#include "framePipeline.h"
+#include "framePacer.h"
+
+// Defaults, the same files as the interactive viewer uses
+#define TEXTUREFILENAME "../textures/earth2048.tga"
+#define VERTEXSHADERFILENAME "../shaders/vertexshader.glsl"
+#define FRAGMENTSHADERFILENAME "../shaders/fragmentshader.glsl"
+
+/* Everything that can be set from the command line */
+typedef struct {
+	const char *label;      // Free text, copied to the output to tell runs apart
+	const char *mesh;       // OBJ or .glb file, or NULL for a sphere
+	int segments;           // Sphere resolution, if no mesh is given
+	const char *texture;
+	const char *vertexshader;
+	const char *fragmentshader;
+	int width, height;      // Render resolution in pixels
+	int instances;          // Copies of the mesh drawn each frame
+	int frames;             // Measured frames
+	int warmup;             // Frames rendered before measuring starts
+	int headless;           // Nonzero to render offscreen in a hidden window
+	int capture;            // Nonzero to read back the image every frame
+	int pipeline;           // Nonzero to update the next frame while submitting this one
+	int inflight;           // Frames the GPU may lag behind, with pipeline
+	int threads;            // Worker threads, 0 for one per processor
+	double fps;             // Frame rate cap, 0 for none
+	const char *out;        // Output file, or NULL for stdout
+} benchConfig;
+
+
+static void usage(void) {
+	fprintf(stderr,
+		"Usage: sceneBench [options]\n"
+		"  --mesh FILE       OBJ or .glb mesh to render (default: a sphere)\n"
+		"  --sphere N        sphere segments when no mesh is given (default 50)\n"
+		"  --texture FILE    TGA texture (default " TEXTUREFILENAME ")\n"
+		"  --vs FILE         vertex shader (default " VERTEXSHADERFILENAME ")\n"
+		"  --fs FILE         fragment shader (default " FRAGMENTSHADERFILENAME ")\n"
+		"  --size WxH        render resolution (default 1280x720)\n"
+		"  --instances N     copies of the mesh per frame (default 1)\n"
+		"  --frames N        measured frames (default 500)\n"
+		"  --warmup N        unmeasured frames first (default 50)\n"
+		"  --headless        hidden window, render offscreen (default)\n"
+		"  --windowed        render to a visible window\n"
+		"  --capture         read back the rendered image every frame\n"
+		"  --pipeline        update frame N+1 on workers while frame N is submitted\n"
+		"  --inflight N      frames the GPU may lag behind with --pipeline (default 2)\n"
+		"  --threads N       worker threads, 0 for one per processor (default 0)\n"
+		"  --fps N           cap the frame rate at N by sleeping (default: uncapped)\n"
+		"  --label TEXT      copied to the output as is\n"
+		"  --out FILE        write JSON here instead of to stdout\n");
+}
+
+/*
+ * parseArgs() - fill in a benchConfig from the command line.
+ * Returns 1 if all is well, 0 if the program should exit.
+ */
+static int parseArgs(int argc, char *argv[], benchConfig *config) {
+	int i;
+
+	config->label = "";
+	config->mesh = NULL;
+	config->segments = 50;
+	config->texture = TEXTUREFILENAME;
+	config->vertexshader = VERTEXSHADERFILENAME;
+	config->fragmentshader = FRAGMENTSHADERFILENAME;
+	config->width = 1280;
+	config->height = 720;
+	config->instances = 1;
+	config->frames = 500;
+	config->warmup = 50;
+	config->headless = 1;
+	config->capture = 0;
+	config->pipeline = 0;
+	config->inflight = 2;
+	config->threads = 0;
+	config->fps = 0.0;
+	config->out = NULL;
+
+	for(i=1; i<argc; i++) {
+		if(!strcmp(argv[i], "--headless")) config->headless = 1;
+		else if(!strcmp(argv[i], "--windowed")) config->headless = 0;
+		else if(!strcmp(argv[i], "--capture")) config->capture = 1;
+		else if(!strcmp(argv[i], "--pipeline")) config->pipeline = 1;
+		else if(!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
+			usage();
+			return 0;
+		}
+		else if(i+1 == argc) {
+			fprintf(stderr, "Unknown option or missing value: %s\n", argv[i]);
+			usage();
+			return 0;
+		}
+		else if(!strcmp(argv[i], "--mesh")) config->mesh = argv[++i];
+		else if(!strcmp(argv[i], "--sphere")) config->segments = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--texture")) config->texture = argv[++i];
+		else if(!strcmp(argv[i], "--vs")) config->vertexshader = argv[++i];
+		else if(!strcmp(argv[i], "--fs")) config->fragmentshader = argv[++i];
+		else if(!strcmp(argv[i], "--instances")) config->instances = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--frames")) config->frames = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--warmup")) config->warmup = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--inflight")) config->inflight = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--threads")) config->threads = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--fps")) config->fps = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--label")) config->label = argv[++i];
+		else if(!strcmp(argv[i], "--out")) config->out = argv[++i];
+		else if(!strcmp(argv[i], "--size")) {
+			if(sscanf(argv[++i], "%dx%d", &config->width, &config->height) != 2) {
+				fprintf(stderr, "Bad size: %s (expected WxH)\n", argv[i]);
+				return 0;
+			}
+		}
+		else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			usage();
+			return 0;
+		}
+	}
+	if(config->width < 1 || config->height < 1 || config->instances < 1
+		|| config->frames < 1 || config->warmup < 0) {
+		fprintf(stderr, "Sizes and counts must be positive.\n");
+		return 0;
+	}
+	if(config->inflight < 1 || config->inflight > FRAMEPIPELINE_MAXINFLIGHT) {
+		fprintf(stderr, "Frames in flight must be 1 to %d.\n", FRAMEPIPELINE_MAXINFLIGHT);
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * printString() - print a JSON string literal, escaping as needed
+ */
+static void printString(FILE *file, const char *s) {
+	fputc('"', file);
+	for(; s && *s; s++) {
+		if(*s == '"' || *s == '\\') fprintf(file, "\\%c", *s);
+		else if((unsigned char)*s < 0x20) fprintf(file, "\\u%04x", (unsigned char)*s);
+		else fputc(*s, file);
+	}
+	fputc('"', file);
+}
+
+/* What the update job for the next frame needs */
+typedef struct {
+	const scene *s;
+	int frame;
+	const GLfloat *P;
+	sceneDrawList *list;
+	jobSystem *jobs;
+} benchUpdate;
+
+static void benchUpdateJob(void *data, int thread) {
+	benchUpdate *update = (benchUpdate*)data;
+
+	(void)thread;
+	sceneUpdate(update->s, update->frame, update->P, update->list, update->jobs);
+}
+
+/*
+ * main(argc, argv) - load the scene, render it, and report
+ */
+int main(int argc, char *argv[]) {
+
+	benchConfig config;
+	triangleSoup soup;
+	Texture texture;
+	GLuint programObject;
+	GLint location_time, location_MV, location_P, location_tex;
+	frameStats stats;
+	gpuTimer gputimer;
+	renderTarget target;
+	jobSystem jobs;
+	scene objects;
+	sceneDrawList lists[2];   // The frame being submitted, and the next one with pipeline
+	benchUpdate update;
+	framePipeline pipeline;
+	framePacer pacer;
+	job next;
+	int current = 0;
+	int drawn = 0;            // Objects in the last frame drawn, before the lists are swapped
+	GLFWwindow* window;
+	FILE *out;
+	unsigned char *pixels = NULL; // Readback buffer when capturing from a window
+	long pixelbytes = 0;
+	int frame, instance, width, height;
+	GLfloat P[16] = { // Same projection as in GLSLprimer.c
+		4.0f, 0.0f, 0.0f, 0.0f,
+		0.0f, 4.0f, 0.0f, 0.0f,
+		0.0f, 0.0f, -2.5f, -1.0f,
+		0.0f, 0.0f, -10.5f, 0.0f
+	};
+
+	if(!parseArgs(argc, argv, &config)) return 1;
+
+	TRACE_INIT("main");
+	startupInit(1);
+	frameStatsInit(&stats);
+
+	startupBegin("glfwInit", NULL, STARTUP_CPU);
+	if (!glfwInit()) {
+		fprintf(stderr, "Failed to initialise GLFW. Exiting.\n");
+		return 1;
+	}
+	startupEnd(0);
+
+	startupBegin("createWindow", NULL, STARTUP_CPU);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	if(config.headless) glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	window = glfwCreateWindow(config.headless ? 64 : config.width,
+		config.headless ? 64 : config.height, "sceneBench", NULL, NULL);
+	if (!window) {
+		fprintf(stderr, "Failed to open GLFW window. Exiting.\n");
+		glfwTerminate();
+		return 1;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0); // Measure rendering, not the display refresh rate
+	loadExtensions();
+	startupEnd(0);
+
+	if(config.headless && !renderTargetInit(&target, config.width, config.height)) {
+		glfwTerminate();
+		return 1;
+	}
+
+	// Load the scene, with every step timed by the startup profiler
+	soupInit(&soup);
+	soupSetResidency(&soup, SOUP_RELEASE);
+	if(config.mesh && strlen(config.mesh) > 4 && !strcmp(config.mesh + strlen(config.mesh) - 4, ".glb"))
+		glbReadSoup(&soup, config.mesh);
+	else if(config.mesh) soupReadOBJ(&soup, (char*)config.mesh);
+	else soupCreateSphere(&soup, 1.0, config.segments);
+	glEnable(GL_TEXTURE_2D);
+	createTexture(&texture, (char*)config.texture);
+	programObject = createShader((char*)config.vertexshader, (char*)config.fragmentshader);
+	if(!soup.vao || !programObject) {
+		fprintf(stderr, "Failed to load the scene. Exiting.\n");
+		glfwTerminate();
+		return 1;
+	}
+	location_MV = glGetUniformLocation(programObject, "MV");
+	location_P = glGetUniformLocation(programObject, "P");
+	location_time = glGetUniformLocation(programObject, "time");
+	location_tex = glGetUniformLocation(programObject, "tex");
+
+	if(!jobSystemInit(&jobs, config.threads) || !sceneInit(&objects, &soup, config.instances)
+		|| !sceneDrawListInit(&lists[0], &objects) || !sceneDrawListInit(&lists[1], &objects)) {
+		glfwTerminate();
+		return 1;
+	}
+	P[0] = P[5] * config.height / config.width;
+	update.s = &objects;
+	update.P = P;
+	update.jobs = &jobs;
+	framePipelineInit(&pipeline, config.inflight);
+	gpuTimerInit(&gputimer, &stats);
+	framePacerInit(&pacer, config.fps);
+
+	for(frame=0; frame<config.warmup+config.frames; frame++) {
+		// Start over once the caches and the driver have warmed up
+		if(frame == config.warmup) {
+			gpuTimerFlush(&gputimer);
+			gpuTimerDelete(&gputimer);
+			frameStatsDelete(&stats);
+			frameStatsInit(&stats);
+			gpuTimerInit(&gputimer, &stats);
+			pipeline.waited = 0.0;
+			pipeline.stalls = 0;
+			framePacerReset(&pacer);
+		}
+		framePacerWait(&pacer);
+		frameStatsTick(&stats, timerSeconds(), timerCPUSeconds());
+		TRACE_BEGIN("frame");
+		if(config.pipeline) {
+			framePipelineBeginFrame(&pipeline);
+			// The list for this frame was made while the last one was submitted
+			if(frame == 0) sceneUpdate(&objects, frame, P, &lists[current], &jobs);
+			update.frame = frame + 1;
+			update.list = &lists[1 - current];
+			jobInit(&next, benchUpdateJob, &update, 0);
+			jobSubmit(&jobs, &next);
+		}
+		else sceneUpdate(&objects, frame, P, &lists[current], &jobs);
+		gpuTimerBeginFrame(&gputimer, stats.frames);
+
+		if(config.headless) renderTargetBind(&target);
+		else {
+			glfwGetFramebufferSize(window, &width, &height);
+			glViewport(0, 0, width, height);
+		}
+
+		gpuTimerBegin(&gputimer, "clear");
+		glClearColor(0.3f, 0.3f, 0.3f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		gpuTimerEnd(&gputimer);
+
+		glUseProgram(programObject);
+		if(location_tex != -1) glUniform1i(location_tex, 0);
+		if(location_time != -1) glUniform1f(location_time, frame / 60.0f); // Not wall time, for repeatable images
+		if(location_P != -1) glUniformMatrix4fv(location_P, 1, GL_FALSE, P);
+		glEnable(GL_DEPTH_TEST);
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_BACK);
+
+		TRACE_BEGIN("soupRender");
+		gpuTimerBegin(&gputimer, "soupRender");
+		for(instance=0; instance<lists[current].count; instance++) {
+			if(location_MV != -1) glUniformMatrix4fv(location_MV, 1, GL_FALSE, lists[current].MV + 16*instance);
+			soupRender(soup);
+		}
+		drawn = lists[current].count;
+		gpuTimerEnd(&gputimer);
+		TRACE_END();
+		glUseProgram(0);
+
+		if(config.headless) {
+			if(config.capture) {
+				TRACE_BEGIN("capture");
+				gpuTimerBegin(&gputimer, "capture");
+				renderTargetRead(&target);
+				gpuTimerEnd(&gputimer);
+				TRACE_END();
+			}
+			renderTargetUnbind();
+			glFlush();
+		}
+		else {
+			if(config.capture) {
+				// Read from the back buffer we just rendered
+				TRACE_BEGIN("capture");
+				gpuTimerBegin(&gputimer, "capture");
+				glReadBuffer(GL_BACK);
+				if(pixelbytes != 4L * width * height) {
+					free(pixels);
+					pixelbytes = 4L * width * height;
+					pixels = (unsigned char*)malloc(pixelbytes);
+				}
+				glPixelStorei(GL_PACK_ALIGNMENT, 1);
+				if(pixels) glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+				gpuTimerEnd(&gputimer);
+				TRACE_END();
+			}
+			TRACE_BEGIN("swap");
+			glfwSwapBuffers(window);
+			TRACE_END();
+		}
+
+		if(config.pipeline) {
+			framePipelineEndFrame(&pipeline);
+			jobWait(&jobs, &next);
+			current = 1 - current;
+		}
+		framePacerFrameDone(&pacer);
+		if(startupFirstFrame()) {
+			// Make sure the first frame is really done before calling it done
+			glFinish();
+		}
+		glfwPollEvents();
+		TRACE_END(); // frame
+		if(glfwWindowShouldClose(window)) break;
+	}
+	frameStatsTick(&stats, timerSeconds(), timerCPUSeconds()); // End of the last frame
+	gpuTimerFlush(&gputimer);
+
+	// One JSON object with the configuration and all the measurements
+	out = config.out ? fopen(config.out, "w") : stdout;
+	if(out == NULL) {
+		fprintf(stderr, "Cannot write results to %s.\n", config.out);
+		out = stdout;
+	}
+	fprintf(out, "{\"benchmark\": \"sceneBench\", \"label\": ");
+	printString(out, config.label);
+	fprintf(out, ",\n \"config\": {\"mesh\": ");
+	printString(out, config.mesh ? config.mesh : "sphere");
+	fprintf(out, ", \"sphere_segments\": %d, \"texture\": ", config.mesh ? 0 : config.segments);
+	printString(out, config.texture);
+	fprintf(out, ", \"vertex_shader\": ");
+	printString(out, config.vertexshader);
+	fprintf(out, ", \"fragment_shader\": ");
+	printString(out, config.fragmentshader);
+	fprintf(out, ", \"width\": %d, \"height\": %d, \"instances\": %d, \"frames\": %d, "
+		"\"warmup\": %d, \"headless\": %s, \"capture\": %s, \"pipeline\": %s, \"inflight\": %d, "
+		"\"threads\": %d, \"fps\": %.3f},\n", config.width, config.height,
+		config.instances, config.frames, config.warmup, config.headless ? "true" : "false",
+		config.capture ? "true" : "false", config.pipeline ? "true" : "false", config.inflight,
+		jobs.nthreads, config.fps);
+	fprintf(out, " \"gl\": {\"vendor\": ");
+	printString(out, (const char*)glGetString(GL_VENDOR));
+	fprintf(out, ", \"renderer\": ");
+	printString(out, (const char*)glGetString(GL_RENDERER));
+	fprintf(out, ", \"version\": ");
+	printString(out, (const char*)glGetString(GL_VERSION));
+	fprintf(out, "},\n \"scene\": {\"vertices\": %d, \"triangles\": %d, \"triangles_per_frame\": %ld},\n",
+		soup.nverts, soup.ntris, (long)soup.ntris * config.instances);
+	fprintf(out, " \"startup\": ");
+	startupPrintJSON(out);
+	fprintf(out, ",\n \"frames\": ");
+	frameStatsPrintJSON(out, &stats, 0);
+	fprintf(out, ",\n \"gpu_passes\": ");
+	gpuTimerPrintJSON(out, &gputimer);
+	fprintf(out, ",\n \"gpu_frames_not_timed\": %lu,\n \"objects_drawn\": %d,\n", gputimer.dropped,
+		drawn);
+	fprintf(out, " \"fence_wait_ms\": %.3f, \"fence_stalls\": %lu,\n \"memory\": ", 1000.0 * pipeline.waited,
+		pipeline.stalls);
+	resourcePrintJSON(out);
+	fprintf(out, ",\n \"pacing\": ");
+	framePacerPrintJSON(out, &pacer);
+	fprintf(out, "}\n");
+	if(out != stdout) fclose(out);
+
+	gpuTimerDelete(&gputimer);
+	framePipelineDelete(&pipeline);
+	sceneDrawListDelete(&lists[0]);
+	sceneDrawListDelete(&lists[1]);
+	sceneDelete(&objects);
+	jobSystemDelete(&jobs);
+	soupDelete(&soup);
+	deleteTexture(&texture);
+	glDeleteProgram(programObject);
+	resourceRelease(RESOURCE_PROGRAM, (void*)(size_t)programObject);
+	if(config.headless) renderTargetDelete(&target);
+	free(pixels);
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	frameStatsDelete(&stats);
+	TRACE_WRITE("sceneBench-trace.json");
+
+	return 0;
+}
@@ -0,0 +1,318 @@
+/*
+ * softRender - render the meteor on the CPU with the software renderer,
+ * time it, and optionally check it against the GL path.
+ *
+ * Without --compare-gl, no OpenGL context is created at all, so this
+ * runs on render servers without a GPU. With --compare-gl, the same
+ * frame is also rendered offscreen with the GL shaders, and PSNR and
+ * SSIM between the two images are reported. The exit status is then 1
+ * if the SSIM is below --min-ssim, which makes it usable as a check.
+ * Run with --help for the options.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// In MacOS X, tell GLFW to include the modern OpenGL headers.
+#ifdef __APPLE__
+#define GLFW_INCLUDE_GLCOREARB
+#endif
+
+// In Linux, tell GLFW to include the modern OpenGL functions.
+#ifdef __linux__
+#define GL_GLEXT_PROTOTYPES
+#endif
+
+#include <GLFW/glfw3.h>
+
+#ifdef __WIN32__
+#include <GL/glext.h>
+#endif
+
+#include "tnm084.h"
+#include "tgaloader.h"
+#include "triangleSoup.h"
+#include "timer.h"
+#include "resources.h"
+#include "renderTarget.h"
+#include "imageCompare.h"
+#include "meteor.h"
+#include "softRaster.h"
+
+#define VERTEXSHADERFILENAME "../shaders/vertexshader.glsl"
+#define FRAGMENTSHADERFILENAME "../shaders/fragmentshader.glsl"
+#define MAXFRAMES 1000
+
+/* Everything that can be set from the command line */
+typedef struct {
+	const char *mesh;     // OBJ file, or NULL for a sphere
+	int segments;         // Sphere resolution, if no mesh is given
+	int width, height;    // Render resolution in pixels
+	int threads;          // Worker threads, 0 for one per processor
+	int frames;           // Timed frames
+	float time;           // The "time" uniform
+	int octaves;          // OCTAVES
+	int f1only;           // CELLULAR_F1_ONLY
+	int baked;            // BAKED_DISPLACEMENT
+	const char *out;      // TGA file for the software image, or NULL
+	int comparegl;        // Nonzero to also render with GL and compare
+	const char *glout;    // TGA file for the GL image, or NULL
+	double minssim;       // Least SSIM that passes the comparison
+} softConfig;
+
+
+static void usage(void) {
+	fprintf(stderr,
+		"Usage: softRender [options]\n"
+		"  --mesh FILE       OBJ mesh to render (default: a sphere)\n"
+		"  --sphere N        sphere segments when no mesh is given (default 50)\n"
+		"  --size WxH        render resolution (default 640x360)\n"
+		"  --threads N       worker threads, 0 for one per processor (default 0)\n"
+		"  --frames N        timed frames, median is reported (default 5)\n"
+		"  --time T          shader time (default 2.0)\n"
+		"  --octaves N       fBm octaves (default 10)\n"
+		"  --f1only          F1 only cellular noise\n"
+		"  --baked           bake the displacement before rendering\n"
+		"  --out FILE        save the image as TGA\n"
+		"  --compare-gl      render the same frame with OpenGL and compare\n"
+		"  --gl-out FILE     save the OpenGL image as TGA\n"
+		"  --min-ssim X      fail the comparison below this SSIM (default 0.95)\n");
+}
+
+/*
+ * parseArgs() - fill in a softConfig from the command line.
+ * Returns 1 if all is well, 0 if the program should exit.
+ */
+static int parseArgs(int argc, char *argv[], softConfig *config) {
+	int i;
+
+	config->mesh = NULL;
+	config->segments = 50;
+	config->width = 640;
+	config->height = 360;
+	config->threads = 0;
+	config->frames = 5;
+	config->time = 2.0f;
+	config->octaves = 10;
+	config->f1only = 0;
+	config->baked = 0;
+	config->out = NULL;
+	config->comparegl = 0;
+	config->glout = NULL;
+	config->minssim = 0.95;
+
+	for(i=1; i<argc; i++) {
+		if(!strcmp(argv[i], "--f1only")) config->f1only = 1;
+		else if(!strcmp(argv[i], "--baked")) config->baked = 1;
+		else if(!strcmp(argv[i], "--compare-gl")) config->comparegl = 1;
+		else if(!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h")) {
+			usage();
+			return 0;
+		}
+		else if(i+1 == argc) {
+			fprintf(stderr, "Unknown option or missing value: %s\n", argv[i]);
+			usage();
+			return 0;
+		}
+		else if(!strcmp(argv[i], "--mesh")) config->mesh = argv[++i];
+		else if(!strcmp(argv[i], "--sphere")) config->segments = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--threads")) config->threads = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--frames")) config->frames = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--time")) config->time = (float)atof(argv[++i]);
+		else if(!strcmp(argv[i], "--octaves")) config->octaves = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--out")) config->out = argv[++i];
+		else if(!strcmp(argv[i], "--gl-out")) {
+			config->glout = argv[++i];
+			config->comparegl = 1;
+		}
+		else if(!strcmp(argv[i], "--min-ssim")) config->minssim = atof(argv[++i]);
+		else if(!strcmp(argv[i], "--size")) {
+			if(sscanf(argv[++i], "%dx%d", &config->width, &config->height) != 2) {
+				fprintf(stderr, "Bad size: %s (expected WxH)\n", argv[i]);
+				return 0;
+			}
+		}
+		else {
+			fprintf(stderr, "Unknown option: %s\n", argv[i]);
+			usage();
+			return 0;
+		}
+	}
+	if(config->width < 1 || config->height < 1 || config->frames < 1 || config->octaves < 0) {
+		fprintf(stderr, "Sizes and counts must be positive.\n");
+		return 0;
+	}
+	if(config->frames > MAXFRAMES) config->frames = MAXFRAMES;
+	return 1;
+}
+
+/*
+ * sceneMatrices() - the same view as in GLSLprimer.c, turned a little
+ */
+static void sceneMatrices(GLfloat MV[16], GLfloat P[16], int width, int height) {
+	GLfloat R1[16], R2[16];
+	int i;
+
+	for(i=0; i<16; i++) P[i] = 0.0f;
+	P[5] = 4.0f;
+	P[0] = P[5] * height / width;
+	P[10] = -2.5f;
+	P[11] = -1.0f;
+	P[14] = -10.5f;
+	mat4roty(R1, 0.5f);
+	mat4rotx(R2, 0.3f);
+	mat4mult(R2, R1, MV);
+	MV[14] += -5.0f;
+}
+
+/*
+ * renderGL() - render one frame with the shaders, for comparison.
+ * Returns the pixels, owned by target, or NULL on failure.
+ */
+static unsigned char *renderGL(const softConfig *config, renderTarget *target, const GLfloat *displacement) {
+	triangleSoup soup;
+	GLuint program;
+	GLfloat MV[16], P[16];
+	char defines[256];
+
+	soupInit(&soup);
+	if(config->mesh) soupReadOBJ(&soup, (char*)config->mesh);
+	else soupCreateSphere(&soup, 1.0, config->segments);
+	if(displacement) soupSetAttribute(&soup, 3, METEOR_BAKEDFLOATS, displacement);
+	snprintf(defines, sizeof(defines), "#define OCTAVES %d\n%s%s", config->octaves,
+		config->f1only ? "#define CELLULAR_F1_ONLY\n" : "",
+		displacement ? "#define BAKED_DISPLACEMENT\n" : "");
+	program = createShaderWithDefines(VERTEXSHADERFILENAME, FRAGMENTSHADERFILENAME, defines);
+	if(!soup.vao || !program) {
+		soupDelete(&soup);
+		return NULL;
+	}
+
+	sceneMatrices(MV, P, config->width, config->height);
+	renderTargetBind(target);
+	glClearColor(0.3f, 0.3f, 0.3f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glUseProgram(program);
+	glUniformMatrix4fv(glGetUniformLocation(program, "MV"), 1, GL_FALSE, MV);
+	glUniformMatrix4fv(glGetUniformLocation(program, "P"), 1, GL_FALSE, P);
+	glUniform1f(glGetUniformLocation(program, "time"), config->time);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+	glCullFace(GL_BACK);
+	soupRender(soup);
+	glUseProgram(0);
+	renderTargetUnbind();
+
+	glDeleteProgram(program);
+	resourceRelease(RESOURCE_PROGRAM, (void*)(size_t)program);
+	soupDelete(&soup);
+	return renderTargetRead(target);
+}
+
+static int compareDoubles(const void *a, const void *b) {
+	double da = *(const double*)a, db = *(const double*)b;
+	return (da > db) - (da < db);
+}
+
+/*
+ * main(argc, argv) - render, report, and compare if asked to
+ */
+int main(int argc, char *argv[]) {
+	softConfig config;
+	triangleSoup soup;
+	softRaster raster;
+	jobSystem jobs;
+	softShading shading;
+	GLfloat *displacement = NULL;
+	GLfloat MV[16], P[16];
+	double times[MAXFRAMES], t0, bakems = 0.0, psnr, ssim;
+	renderTarget target;
+	GLFWwindow *window;
+	unsigned char *glpixels;
+	int frame, status = 0;
+
+	if(!parseArgs(argc, argv, &config)) return 1;
+
+	soupInit(&soup);
+	if(config.mesh) {
+		if(!soupParseOBJ(&soup, config.mesh, NULL)) return 1;
+	}
+	else soupGenerateSphere(&soup, 1.0, config.segments);
+	if(!jobSystemInit(&jobs, config.threads)) return 1;
+	if(config.baked) {
+		t0 = timerSeconds();
+		displacement = meteorBakeDisplacement(&soup, config.octaves, &jobs);
+		bakems = 1000.0 * (timerSeconds() - t0);
+	}
+
+	if(!softRasterInit(&raster, config.width, config.height, &jobs)) return 1;
+	shading.time = config.time;
+	shading.octaves = config.octaves;
+	shading.f1only = config.f1only;
+	shading.displacement = displacement;
+	sceneMatrices(MV, P, config.width, config.height);
+
+	// One untimed frame first, to fault in the buffers
+	for(frame=-1; frame<config.frames; frame++) {
+		if(frame == 0) jobSystemResetCounters(&jobs);
+		t0 = timerSeconds();
+		softRasterClear(&raster, 0.3f, 0.3f, 0.3f, 0.0f);
+		softRasterDraw(&raster, &soup, MV, P, &shading);
+		if(frame >= 0) times[frame] = 1000.0 * (timerSeconds() - t0);
+	}
+	qsort(times, config.frames, sizeof(double), compareDoubles);
+	printf("softRender: %dx%d, %d triangles (%d drawn), %d threads\n", config.width, config.height,
+		soup.ntris, raster.ntriangles, jobs.nthreads);
+	printf("frame ms: median %.2f, min %.2f, max %.2f", times[config.frames/2], times[0],
+		times[config.frames-1]);
+	if(config.baked) printf(", bake %.2f", bakems);
+	printf("\n");
+	jobSystemPrintCounters(&jobs);
+	if(config.out) saveTGA((char*)config.out, raster.color, config.width, config.height);
+
+	if(config.comparegl) {
+		if(!glfwInit()) {
+			fprintf(stderr, "Failed to initialise GLFW, cannot compare.\n");
+			return 1;
+		}
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+		window = glfwCreateWindow(64, 64, "softRender", NULL, NULL);
+		if(!window) {
+			fprintf(stderr, "Failed to open GLFW window, cannot compare.\n");
+			glfwTerminate();
+			return 1;
+		}
+		glfwMakeContextCurrent(window);
+		loadExtensions();
+		glpixels = NULL;
+		if(renderTargetInit(&target, config.width, config.height)) {
+			glpixels = renderGL(&config, &target, displacement);
+		}
+		if(glpixels == NULL) {
+			fprintf(stderr, "Failed to render with OpenGL, cannot compare.\n");
+			status = 1;
+		}
+		else {
+			psnr = imagePSNR(raster.color, glpixels, config.width, config.height);
+			ssim = imageSSIM(raster.color, glpixels, config.width, config.height);
+			printf("against OpenGL: PSNR %.2f dB, SSIM %.4f (%s, at least %.4f)\n", psnr, ssim,
+				ssim >= config.minssim ? "pass" : "FAIL", config.minssim);
+			if(ssim < config.minssim) status = 1;
+			if(config.glout) saveTGA((char*)config.glout, glpixels, config.width, config.height);
+			renderTargetDelete(&target);
+		}
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
+
+	softRasterDelete(&raster);
+	jobSystemDelete(&jobs);
+	soupDelete(&soup);
+	free(displacement);
+	return status;
+}